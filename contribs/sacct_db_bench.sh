@@ -0,0 +1,291 @@
+#!/bin/bash
+#
+# Load synthetic job history into a scratch MySQL/MariaDB database, once into
+# a job table laid out as the slurmdbd creates it and once into one laid out
+# as it does with PartitionJobTable=yes, then time the queries sacct and the
+# rollup run against them, and the updates and inserts the slurmdbd makes as
+# jobs start and end. Last it runs the statements the slurmdbd migrates the
+# job table with when PartitionJobTable is turned on, then off, on a copy of
+# the first table and checks no row was lost or changed.
+#
+# Usage: sacct_db_bench.sh [-d database] [-j jobs] [-m months] [-r repeat]
+#                          [-u users] [-w writes] [mysql client options]
+#
+# The database given (default "sacct_db_bench") is dropped and recreated, so
+# never point this at the real slurm_acct_db.  Generating the rows uses the
+# MariaDB Sequence engine (seq_1_to_N tables), MySQL needs it replaced.
+#
+
+db=sacct_db_bench
+jobs=2000000
+months=24
+repeat=3
+users=1000
+writes=20000
+
+while getopts "d:j:m:r:u:w:" opt; do
+	case $opt in
+	d) db=$OPTARG ;;
+	j) jobs=$OPTARG ;;
+	m) months=$OPTARG ;;
+	r) repeat=$OPTARG ;;
+	u) users=$OPTARG ;;
+	w) writes=$OPTARG ;;
+	*) exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+mysql_cmd() {
+	mysql "$@" -N -B
+}
+
+sql() {
+	mysql_cmd $MYSQL_OPTS -D "$db" -e "$1"
+}
+
+MYSQL_OPTS="$*"
+now=$(date +%s)
+month=$((30 * 86400))
+first=$((now - months * month))
+
+# Same columns the queries below touch and the same keys the slurmdbd
+# creates for <cluster>_job_table.
+cols="job_db_inx bigint unsigned not null auto_increment,
+	id_job int unsigned not null,
+	id_array_job int unsigned default 0 not null,
+	id_assoc int unsigned not null,
+	id_qos int unsigned default 0 not null,
+	id_resv int unsigned default 0 not null,
+	id_user int unsigned not null,
+	id_group int unsigned not null,
+	id_wckey int unsigned not null,
+	account tinytext,
+	\`partition\` tinytext not null,
+	job_name tinytext not null,
+	nodes_alloc int unsigned not null,
+	cpus_req int unsigned not null,
+	state int unsigned not null,
+	exit_code int default 0 not null,
+	time_submit bigint unsigned default 0 not null,
+	time_eligible bigint unsigned default 0 not null,
+	time_start bigint unsigned default 0 not null,
+	time_end bigint unsigned default 0 not null,
+	tres_alloc text not null default ''"
+keys="unique index (id_job, id_assoc, time_submit),
+	key rollup (time_eligible, time_end),
+	key rollup2 (time_end, time_eligible),
+	key nodes_alloc (nodes_alloc),
+	key wckey (id_wckey),
+	key qos (id_qos),
+	key association (id_assoc),
+	key array_job (id_array_job),
+	key reserv (id_resv),
+	key sacct_def (id_user, time_start, time_end),
+	key sacct_def2 (id_user, time_end, time_eligible)"
+
+# Monthly partitions as as_mysql_job_partition_check() adds them
+parts=""
+for ((i = 1; i <= months + 2; i++)); do
+	parts="$parts partition p$i values less than ($((first + i * month))),"
+done
+parts="$parts partition pmax values less than maxvalue"
+
+echo "Loading $jobs jobs of $users users over $months months into $db"
+mysql_cmd $MYSQL_OPTS -e "drop database if exists $db; create database $db" ||
+	exit 1
+sql "create table plain ($cols, primary key (job_db_inx), $keys)
+	engine=innodb" || exit 1
+sql "create table part ($cols, primary key (job_db_inx, time_submit), $keys)
+	engine=innodb partition by range (time_submit) ($parts)" || exit 1
+
+# Jobs submitted evenly over the period, wait up to an hour, run up to a day.
+# One in a thousand is still pending and one in a hundred still running.
+start=$(date +%s.%N)
+sql "insert into plain (id_job, id_assoc, id_user, id_group, id_wckey,
+	account, \`partition\`, job_name, nodes_alloc, cpus_req, state,
+	time_submit, time_eligible, time_start, time_end, tres_alloc)
+	select seq, seq % ($users * 4), seq % $users, seq % 100, 0,
+	concat('acct', seq % 200), 'debug', concat('job', seq),
+	1 + seq % 16, 1 + seq % 512,
+	if(seq % 1000 = 0, 0, if(seq % 100 = 0, 1, 3)),
+	s, s + seq % 3600,
+	if(seq % 1000 = 0, 0, s + seq % 3600 + 60),
+	if(seq % 100 = 0, 0, s + seq % 3600 + 60 + seq % 86400),
+	concat('1=', 1 + seq % 512, ',4=', 1 + seq % 16)
+	from (select seq, $first + seq * ($now - $first) div $jobs as s
+	from seq_1_to_$jobs) as t" || exit 1
+sql "insert into part select * from plain" || exit 1
+sql "analyze table plain, part" >/dev/null
+echo "Loaded in $(echo "$(date +%s.%N) - $start" | bc) seconds"
+
+# A one day window, half a year back, as in "sacct -S <start> -E <end>"
+s=$((now - 6 * month))
+e=$((s + 86400))
+fields="t1.job_db_inx, t1.id_job, t1.id_user, t1.account, t1.state,
+	t1.time_submit, t1.time_start, t1.time_end, t1.tres_alloc"
+window="t1.time_eligible && t1.time_eligible < $e &&
+	(t1.time_end >= $s || t1.time_end = 0)"
+
+queries=(
+	"sacct -a -S -E|select $fields from TABLE as t1 where ($window)"
+	"sacct -u -S -E|select $fields from TABLE as t1
+		where t1.id_user = 42 && ($window)"
+	"sacct -a -s CD -S -E|select $fields from TABLE as t1
+		where (t1.state = 3 && t1.time_end between $s and $e)"
+	"sacct -a -E|select count(*) from TABLE as t1
+		where t1.time_eligible && t1.time_eligible < $e"
+	"hourly rollup|select t1.id_assoc, t1.time_eligible, t1.time_start,
+		t1.time_end, t1.tres_alloc from TABLE as t1
+		where t1.time_eligible < $((s + 3600)) &&
+		(t1.time_end >= $s || t1.time_end = 0)"
+)
+
+run() {
+	local query=$1 best= i t0 t
+	for ((i = 0; i < repeat; i++)); do
+		t0=$(date +%s.%N)
+		sql "$query" >/dev/null || return
+		t=$(echo "$(date +%s.%N) - $t0" | bc)
+		if [ -z "$best" ] || [ "$(echo "$t < $best" | bc)" = 1 ]; then
+			best=$t
+		fi
+	done
+	echo "$best"
+}
+
+printf "%-22s %10s %10s %10s %s\n" query plain part \
+	"part+pred" "partitions read"
+for q in "${queries[@]}"; do
+	name=${q%%|*}
+	query=${q#*|}
+	# The predicate setup_job_cond_limits() adds for pruning, the rollup
+	# doesn't filter on time_submit
+	if [[ $name == "hourly rollup" ]]; then
+		pruned=${query//TABLE/part}
+	else
+		pruned="${query//TABLE/part} && t1.time_submit <= $e"
+	fi
+	read_parts=$(sql "explain partitions $pruned" | cut -f4 | head -1 |
+		     tr ',' '\n' | wc -l)
+	printf "%-22s %10s %10s %10s %s\n" "$name" \
+		"$(run "${query//TABLE/plain}")" \
+		"$(run "${query//TABLE/part}")" \
+		"$(run "$pruned")" "$read_parts/$((months + 3))"
+done
+
+# Write path: $writes updates of random jobs by job_db_inx, as made when a
+# job starts or ends, with and without the time_submit of the job that
+# _add_submit_cond() adds with PartitionJobTable, then $writes inserts of
+# new jobs. Each set is one transaction, like a DBD_SEND_MULT_MSG batch.
+# job_db_inx N was submitted at the time the load above gave job N. Each
+# run updates other jobs, so none finds them cached by the one before.
+updates() {
+	awk -v n="$writes" -v jobs="$jobs" -v first="$first" -v now="$now" \
+	    -v table="$1" -v pred="$2" -v seed="$3" 'BEGIN {
+		srand(seed)
+		print "begin;"
+		for (i = 0; i < n; i++) {
+			k = 1 + int(rand() * jobs)
+			s = first + int(k * (now - first) / jobs)
+			printf "update %s set state=3, time_end=%d " \
+			       "where job_db_inx=%d%s;\n", table, now, k,
+			       pred ? " && time_submit=" s : ""
+		}
+		print "commit;"
+	}'
+}
+
+inserts() {
+	awk -v n="$writes" -v jobs="$jobs" -v now="$now" -v table="$1" 'BEGIN {
+		print "begin;"
+		for (i = 1; i <= n; i++)
+			printf "insert into %s (id_job, id_assoc, id_user, " \
+			       "id_group, id_wckey, `partition`, job_name, " \
+			       "nodes_alloc, cpus_req, state, time_submit, " \
+			       "time_eligible) values (%d, %d, %d, 0, 0, " \
+			       "\"debug\", \"new\", 0, 1, 0, %d, %d);\n",
+			       table, jobs + i, i % 4000, i % 1000,
+			       now + i, now + i
+		print "commit;"
+	}'
+}
+
+timed() {
+	local t0=$(date +%s.%N)
+	"$@" | mysql_cmd $MYSQL_OPTS -D "$db" >/dev/null || return
+	echo "$(date +%s.%N) - $t0" | bc
+}
+
+echo
+printf "%-22s %10s %10s %10s\n" "$writes writes" plain part "part+pred"
+printf "%-22s %10s %10s %10s\n" "update by job_db_inx" \
+	"$(timed updates plain 0 1)" "$(timed updates part 0 2)" \
+	"$(timed updates part 1 3)"
+printf "%-22s %10s %10s %10s\n" "insert new jobs" \
+	"$(timed inserts plain)" "$(timed inserts part)" "-"
+
+# Migration up and down, as create_cluster_tables() and
+# as_mysql_job_partition_check() do it: widen the primary key, partition,
+# add next month's partition out of pmax, then remove partitioning and
+# narrow the primary key back.
+rows() {
+	sql "select count(*), sum(job_db_inx), sum(time_submit),
+		bit_xor(crc32(concat_ws(',', job_db_inx, id_job, id_assoc,
+		time_submit, time_start, time_end, state, tres_alloc)))
+		from $1"
+}
+
+partitions() {
+	sql "select count(*) from information_schema.partitions
+		where table_schema=database() && table_name='$1' &&
+		partition_name is not null"
+}
+
+step() {
+	local t0=$(date +%s.%N)
+	sql "$2" || { echo "FAILED: $1"; exit 1; }
+	printf "%-36s %10s %10s\n" "$1" \
+	       "$(echo "$(date +%s.%N) - $t0" | bc)" "$(partitions mig)"
+}
+
+check() {
+	if [ "$(rows mig)" != "$expect" ]; then
+		echo "FAILED: rows of mig differ from plain $1"
+		exit 1
+	fi
+}
+
+echo
+sql "create table mig like plain" || exit 1
+sql "insert into mig select * from plain" || exit 1
+expect=$(rows plain)
+next=$((first + (months + 3) * month))
+printf "%-36s %10s %10s\n" migration seconds partitions
+step "primary key (job_db_inx, time_submit)" \
+	"alter table mig drop primary key,
+	add primary key (job_db_inx, time_submit)"
+step "partition by range (time_submit)" \
+	"alter table mig partition by range (time_submit) ($parts)"
+check "after partitioning"
+step "reorganize partition pmax" \
+	"alter table mig reorganize partition pmax into
+	(partition pnext values less than ($next),
+	partition pmax values less than maxvalue)"
+check "after adding a partition"
+step "remove partitioning" "alter table mig remove partitioning"
+step "primary key (job_db_inx)" \
+	"alter table mig drop primary key, add primary key (job_db_inx)"
+check "after removing partitioning"
+# New jobs still get the next job_db_inx
+last=$(sql "select max(job_db_inx) from mig")
+sql "insert into mig (id_job, id_assoc, id_user, id_group, id_wckey,
+	\`partition\`, job_name, nodes_alloc, cpus_req, state, time_submit)
+	values (0, 0, 0, 0, 0, 'debug', 'new', 0, 1, 0, $now)" || exit 1
+if [ "$(sql "select max(job_db_inx) from mig")" != $((last + 1)) ]; then
+	echo "FAILED: job_db_inx not assigned after the migration"
+	exit 1
+fi
+echo "Migration kept all $(echo "$expect" | cut -f1) rows"
+
+echo "Drop the scratch database with: mysql -e 'drop database $db'"
@@ -0,0 +1,664 @@
+/*****************************************************************************\
+ *  sdbd_load.c - Send a stream of accounting records to the SlurmDBD the
+ *  way slurmctld does and report how many records per second it stores.
+ *
+ *  The records are either generated (job start, step start, step complete
+ *  and job complete records for a number of jobs, interleaved as a busy
+ *  slurmctld would send them) or replayed from a dbd.messages file saved
+ *  in a slurmctld's StateSaveLocation. They are sent in DBD_SEND_MULT_MSG
+ *  batches over one connection, one batch at a time, each batch being
+ *  written and committed by the SlurmDBD before it replies. It registers
+ *  as the cluster's slurmctld first, so the cluster must have been added
+ *  with sacctmgr. Use a test cluster name, the records are stored.
+ *
+ *  This needs Slurm's internal functions, so build it against a configured
+ *  source tree and the libslurmfull library installed with Slurm:
+ *    gcc -I<src> -I<build> -o sdbd_load sdbd_load.c \
+ *        -L<prefix>/lib/slurm -Wl,-rpath=<prefix>/lib/slurm -lslurmfull
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "slurm/slurm.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/pack.h"
+#include "src/common/read_config.h"
+#include "src/common/slurm_persist_conn.h"
+#include "src/common/slurmdbd_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+/* Layout of dbd.messages, see _save_dbd_rec() in slurmdbd_defs.c */
+#define DBD_MAGIC	0xDEAD3219
+#define MAX_DBD_MSG_LEN	16384
+
+static uint32_t assoc_id = 0;
+static uint32_t bad_rec = 0;
+static uint32_t batch_size = 1000;
+static char    *cluster_name = NULL;
+static uint32_t first_job_id = 1000000;
+static uint32_t inter_jobs = 100;
+static uint32_t job_age = 0;
+static uint32_t job_cnt = 10000;
+static uint16_t my_port = 6817;
+static uint32_t step_cnt = 2;
+static bool     report_batches = false;
+
+static Buf  _add_bad_record(List records);
+static void _drop_record(List records, Buf buffer);
+static void _gen_records(List records);
+static int  _load_records(char *file_name, List records);
+static int  _mult_rc(uint16_t version, Buf buffer, uint32_t *acked);
+static int  _rec_rc(uint16_t version, Buf buffer);
+static int  _register(slurm_persist_conn_t *conn);
+static void _usage(char *prog);
+
+int main(int argc, char **argv)
+{
+	log_options_t log_opts = LOG_OPTS_STDERR_ONLY;
+	slurm_persist_conn_t *conn;
+	time_t shutdown_time = 0;
+	List records, batch_recs;
+	ListIterator itr;
+	slurmdbd_msg_t req;
+	bool bad_acked = false, bad_in_batch;
+	uint32_t bad_pos = 0;
+	dbd_list_msg_t list_msg;
+	char *file_name = NULL, *host = NULL;
+	uint16_t port = 0;
+	Buf bad_buf = NULL, buffer;
+	struct timeval start, end, sent;
+	uint32_t acked, batch_cnt = 0, fail_cnt = 0, rec_cnt, sent_cnt = 0;
+	uint64_t batch_usec, max_usec = 0, tot_usec = 0;
+	double secs;
+	int opt_char, rc;
+
+	while ((opt_char = getopt(argc, argv, "a:b:c:e:f:hH:i:j:n:o:P:p:s:v"))
+	       != -1) {
+		switch (opt_char) {
+		case 'a':
+			assoc_id = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			batch_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			cluster_name = xstrdup(optarg);
+			break;
+		case 'e':
+			bad_rec = strtoul(optarg, NULL, 10);
+			break;
+		case 'f':
+			file_name = optarg;
+			break;
+		case 'H':
+			host = xstrdup(optarg);
+			break;
+		case 'i':
+			inter_jobs = strtoul(optarg, NULL, 10);
+			break;
+		case 'j':
+			first_job_id = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			job_cnt = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			job_age = strtoul(optarg, NULL, 10);
+			break;
+		case 'P':
+			my_port = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			port = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			step_cnt = strtoul(optarg, NULL, 10);
+			break;
+		case 'v':
+			report_batches = true;
+			break;
+		case 'h':
+		default:
+			_usage(argv[0]);
+			exit(1);
+		}
+	}
+	if (!batch_size || !inter_jobs) {
+		_usage(argv[0]);
+		exit(1);
+	}
+
+	log_init(argv[0], log_opts, 0, NULL);
+	slurm_conf_init(NULL);
+	if (!cluster_name)
+		cluster_name = slurm_get_cluster_name();
+	if (!host && !(host = slurm_get_accounting_storage_host()))
+		host = xstrdup("localhost");
+	if (!port && !(port = slurm_get_accounting_storage_port()))
+		port = SLURMDBD_PORT;
+
+	records = list_create(slurmdbd_free_buffer);
+	if (file_name) {
+		if (_load_records(file_name, records) != SLURM_SUCCESS)
+			exit(1);
+	} else
+		_gen_records(records);
+	if (bad_rec)
+		bad_buf = _add_bad_record(records);
+	rec_cnt = list_count(records);
+
+	/* Look like a slurmctld, so the SlurmDBD stores the records and
+	 * commits after each batch */
+	conn = xmalloc(sizeof(slurm_persist_conn_t));
+	conn->cluster_name = xstrdup(cluster_name);
+	conn->flags = PERSIST_FLAG_DBD;
+	conn->my_port = my_port;
+	conn->rem_host = xstrdup(host);
+	conn->rem_port = port;
+	conn->shutdown = &shutdown_time;
+	conn->timeout = (slurm_get_msg_timeout() + 35) * 1000;
+	conn->version = SLURM_PROTOCOL_VERSION;
+	if (slurm_persist_conn_open(conn) != SLURM_SUCCESS) {
+		error("Unable to connect to the SlurmDBD at %s:%u",
+		      host, port);
+		exit(1);
+	}
+	if (_register(conn) != SLURM_SUCCESS)
+		exit(1);
+	info("Sending %u records for cluster %s to %s:%u in batches of %u",
+	     rec_cnt, cluster_name, host, port, batch_size);
+
+	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
+	req.msg_type = DBD_SEND_MULT_MSG;
+	req.data = &list_msg;
+	batch_recs = list_create(NULL);
+	gettimeofday(&start, NULL);
+	while (sent_cnt < rec_cnt) {
+		bad_in_batch = false;
+		itr = list_iterator_create(records);
+		while ((buffer = list_next(itr))) {
+			if (buffer == bad_buf) {
+				bad_in_batch = true;
+				bad_pos = list_count(batch_recs);
+			}
+			list_append(batch_recs, buffer);
+			if (list_count(batch_recs) >= batch_size)
+				break;
+		}
+		list_iterator_destroy(itr);
+		list_msg.my_list = batch_recs;
+		buffer = pack_slurmdbd_msg(&req, conn->version);
+
+		gettimeofday(&sent, NULL);
+		if (slurm_persist_send_msg(conn, buffer) != SLURM_SUCCESS) {
+			error("Unable to send to the SlurmDBD");
+			exit(1);
+		}
+		free_buf(buffer);
+		if (!(buffer = slurm_persist_recv_msg(conn))) {
+			error("No response from the SlurmDBD");
+			exit(1);
+		}
+		gettimeofday(&end, NULL);
+		if (((rc = _mult_rc(conn->version, buffer, &acked))
+		     != SLURM_SUCCESS) && !bad_in_batch)
+			fail_cnt++;
+		free_buf(buffer);
+
+		batch_usec = (end.tv_sec - sent.tv_sec) * 1000000 +
+			     (end.tv_usec - sent.tv_usec);
+		tot_usec += batch_usec;
+		max_usec = MAX(max_usec, batch_usec);
+		batch_cnt++;
+		if (report_batches)
+			info("batch %u: %u of %d records stored in %"PRIu64
+			     " usec", batch_cnt, acked,
+			     list_count(batch_recs), batch_usec);
+
+		/* None of a batch with a record that fails is to be
+		 * written, so none of it is to be acknowledged */
+		if (bad_in_batch) {
+			info("batch %u with the invalid record: %u of %d "
+			     "records acknowledged", batch_cnt, acked,
+			     list_count(batch_recs));
+			if ((rc == SLURM_SUCCESS) || acked) {
+				error("Records of the batch with the invalid "
+				      "record were acknowledged");
+				bad_acked = true;
+			}
+			/* Have the records sent with it sent again */
+			if (acked <= bad_pos) {
+				_drop_record(records, bad_buf);
+				rec_cnt--;
+			}
+			bad_buf = NULL;
+		}
+
+		/* Records not acknowledged are sent again, like the
+		 * slurmctld's agent does */
+		list_flush(batch_recs);
+		sent_cnt += acked;
+		while (acked--)
+			free_buf(list_dequeue(records));
+		if (fail_cnt > 100) {
+			error("Too many failed batches, giving up");
+			break;
+		}
+	}
+	gettimeofday(&end, NULL);
+
+	secs = (end.tv_sec - start.tv_sec) +
+	       (end.tv_usec - start.tv_usec) / 1000000.0;
+	printf("Records stored:       %u of %u\n", sent_cnt, rec_cnt);
+	printf("Batches:              %u (%u failed)\n", batch_cnt, fail_cnt);
+	printf("Elapsed time:         %.3f sec\n", secs);
+	printf("Records per second:   %.1f\n", secs ? sent_cnt / secs : 0.0);
+	if (batch_cnt)
+		printf("Batch response time:  ave %"PRIu64" usec, "
+		       "max %"PRIu64" usec\n",
+		       tot_usec / batch_cnt, max_usec);
+
+	slurm_persist_conn_destroy(conn);
+	FREE_NULL_LIST(batch_recs);
+	FREE_NULL_LIST(records);
+	xfree(cluster_name);
+	xfree(host);
+
+	exit(((sent_cnt == rec_cnt) && !bad_acked) ? 0 : 1);
+}
+
+static void _usage(char *prog)
+{
+	printf("Usage: %s [-a assoc_id] [-b batch_size] [-c cluster] "
+	       "[-e record] [-f dbd.messages] [-H host] [-i jobs] "
+	       "[-j job_id] [-n jobs] [-o secs] [-P port] [-p port] "
+	       "[-s steps] [-v]\n", prog);
+	printf("  -a  Association of the generated jobs (default 0)\n");
+	printf("  -b  Records per DBD_SEND_MULT_MSG (default 1000)\n");
+	printf("  -c  Cluster the records are for (default ClusterName)\n");
+	printf("  -e  Insert a record the SlurmDBD refuses before this one "
+	       "and check none\n      of its batch is acknowledged\n");
+	printf("  -f  Replay the records of a dbd.messages file\n");
+	printf("  -H  SlurmDBD host (default AccountingStorageHost)\n");
+	printf("  -i  Jobs whose records are interleaved (default 100)\n");
+	printf("  -j  First job ID to generate (default 1000000)\n");
+	printf("  -n  Jobs to generate records for (default 10000)\n");
+	printf("  -o  Age in seconds of the generated jobs, older than the "
+	       "last rollup\n      has usage rolled up again (default 0)\n");
+	printf("  -P  slurmctld port to report to the SlurmDBD "
+	       "(default 6817)\n");
+	printf("  -p  SlurmDBD port (default AccountingStoragePort)\n");
+	printf("  -s  Steps per job (default 2)\n");
+	printf("  -v  Report each batch\n");
+}
+
+static void _add_record(List records, uint16_t msg_type, void *data)
+{
+	slurmdbd_msg_t req;
+
+	req.msg_type = msg_type;
+	req.data = data;
+	list_append(records, pack_slurmdbd_msg(&req, SLURM_PROTOCOL_VERSION));
+}
+
+/*
+ * Insert a step start record without the job's submit time, which the
+ * SlurmDBD can't store, before record bad_rec (counted from 1)
+ */
+static Buf _add_bad_record(List records)
+{
+	dbd_step_start_msg_t step_start;
+	slurmdbd_msg_t req;
+	ListIterator itr;
+	Buf buffer;
+	uint32_t i = 0;
+
+	memset(&step_start, 0, sizeof(step_start));
+	step_start.job_id = first_job_id;
+	step_start.name = "sdbd_load";
+	step_start.packjobid = NO_VAL;
+	step_start.packstepid = NO_VAL;
+	step_start.start_time = time(NULL);
+	req.msg_type = DBD_STEP_START;
+	req.data = &step_start;
+	buffer = pack_slurmdbd_msg(&req, SLURM_PROTOCOL_VERSION);
+
+	itr = list_iterator_create(records);
+	while ((++i < bad_rec) && list_next(itr))
+		;
+	if (list_next(itr))
+		list_insert(itr, buffer);
+	else
+		list_append(records, buffer);
+	list_iterator_destroy(itr);
+
+	return buffer;
+}
+
+/* Remove a record and free it */
+static void _drop_record(List records, Buf buffer)
+{
+	ListIterator itr = list_iterator_create(records);
+	Buf rec_buf;
+
+	while ((rec_buf = list_next(itr))) {
+		if (rec_buf == buffer) {
+			list_delete_item(itr);
+			break;
+		}
+	}
+	list_iterator_destroy(itr);
+}
+
+/*
+ * Generate the records of job_cnt single node jobs running step_cnt steps
+ * each. Records of inter_jobs jobs at a time are interleaved: all of them
+ * start, then each step of each of them starts and completes, then all of
+ * them complete. All of them have the same association and times, so
+ * with StorageWriters and an age older than the last rollup each
+ * connection writing them resets the rollup of the cluster.
+ */
+static void _gen_records(List records)
+{
+	dbd_job_start_msg_t job_start;
+	dbd_step_start_msg_t step_start;
+	dbd_step_comp_msg_t step_comp;
+	dbd_job_comp_msg_t job_comp;
+	time_t now = time(NULL) - job_age;
+	char node_name[32];
+	uint32_t first, job_id, last, step_id;
+
+	for (first = 0; first < job_cnt; first += inter_jobs) {
+		last = MIN(first + inter_jobs, job_cnt);
+		for (job_id = first; job_id < last; job_id++) {
+			snprintf(node_name, sizeof(node_name), "node%u",
+				 job_id % 1000);
+			memset(&job_start, 0, sizeof(job_start));
+			job_start.alloc_nodes = 1;
+			job_start.array_task_id = NO_VAL;
+			job_start.assoc_id = assoc_id;
+			job_start.eligible_time = now;
+			job_start.job_id = first_job_id + job_id;
+			job_start.job_state = JOB_RUNNING;
+			job_start.name = "sdbd_load";
+			job_start.nodes = node_name;
+			job_start.partition = "debug";
+			job_start.req_cpus = 1;
+			job_start.start_time = now;
+			job_start.submit_time = now;
+			job_start.timelimit = 60;
+			job_start.tres_alloc_str = "1=1,2=1000,4=1";
+			job_start.tres_req_str = "1=1,2=1000,4=1";
+			_add_record(records, DBD_JOB_START, &job_start);
+		}
+		for (step_id = 0; step_id < step_cnt; step_id++) {
+			for (job_id = first; job_id < last; job_id++) {
+				snprintf(node_name, sizeof(node_name),
+					 "node%u", job_id % 1000);
+				memset(&step_start, 0, sizeof(step_start));
+				step_start.assoc_id = assoc_id;
+				step_start.job_id = first_job_id + job_id;
+				step_start.job_submit_time = now;
+				step_start.name = "sdbd_load";
+				step_start.node_cnt = 1;
+				step_start.nodes = node_name;
+				step_start.packjobid = NO_VAL;
+				step_start.packstepid = NO_VAL;
+				step_start.start_time = now;
+				step_start.step_id = step_id;
+				step_start.total_tasks = 1;
+				step_start.tres_alloc_str = "1=1,2=1000,4=1";
+				_add_record(records, DBD_STEP_START,
+					    &step_start);
+			}
+			for (job_id = first; job_id < last; job_id++) {
+				memset(&step_comp, 0, sizeof(step_comp));
+				step_comp.assoc_id = assoc_id;
+				step_comp.end_time = now;
+				step_comp.job_id = first_job_id + job_id;
+				step_comp.job_submit_time = now;
+				step_comp.start_time = now;
+				step_comp.state = JOB_COMPLETE;
+				step_comp.step_id = step_id;
+				step_comp.total_tasks = 1;
+				_add_record(records, DBD_STEP_COMPLETE,
+					    &step_comp);
+			}
+		}
+		for (job_id = first; job_id < last; job_id++) {
+			snprintf(node_name, sizeof(node_name), "node%u",
+				 job_id % 1000);
+			memset(&job_comp, 0, sizeof(job_comp));
+			job_comp.assoc_id = assoc_id;
+			job_comp.end_time = now;
+			job_comp.job_id = first_job_id + job_id;
+			job_comp.job_state = JOB_COMPLETE;
+			job_comp.nodes = node_name;
+			job_comp.start_time = now;
+			job_comp.submit_time = now;
+			_add_record(records, DBD_JOB_COMPLETE, &job_comp);
+		}
+	}
+}
+
+/* Read one record of a dbd.messages file, NULL at its end */
+static Buf _load_record(int fd)
+{
+	uint32_t magic, msg_size;
+	Buf buffer;
+
+	if (read(fd, &msg_size, sizeof(msg_size)) != sizeof(msg_size))
+		return NULL;
+	if (msg_size > MAX_DBD_MSG_LEN) {
+		error("Invalid record size %u", msg_size);
+		return NULL;
+	}
+	buffer = init_buf(msg_size);
+	if ((read(fd, get_buf_data(buffer), msg_size) != msg_size) ||
+	    (read(fd, &magic, sizeof(magic)) != sizeof(magic)) ||
+	    (magic != DBD_MAGIC)) {
+		error("Invalid record");
+		free_buf(buffer);
+		return NULL;
+	}
+	set_buf_offset(buffer, msg_size);
+
+	return buffer;
+}
+
+/* Load the records saved by a slurmctld in StateSaveLocation/dbd.messages,
+ * repacking them in the current protocol version if needed */
+static int _load_records(char *file_name, List records)
+{
+	slurmdbd_msg_t msg;
+	char *ver_str = NULL;
+	uint32_t ver_str_len;
+	uint16_t version;
+	Buf buffer;
+	int fd;
+
+	if ((fd = open(file_name, O_RDONLY)) < 0) {
+		error("Unable to open %s: %m", file_name);
+		return SLURM_ERROR;
+	}
+	if (!(buffer = _load_record(fd)))
+		goto unpack_error;
+	set_buf_offset(buffer, 0);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	free_buf(buffer);
+	buffer = NULL;
+	if (!ver_str || strncmp(ver_str, "VER", 3))
+		goto unpack_error;
+	version = strtoul(ver_str + 3, NULL, 10);
+	xfree(ver_str);
+
+	while ((buffer = _load_record(fd))) {
+		if (version != SLURM_PROTOCOL_VERSION) {
+			set_buf_offset(buffer, 0);
+			if (unpack_slurmdbd_msg(&msg, version, buffer)) {
+				error("Unable to unpack record %d",
+				      list_count(records));
+				free_buf(buffer);
+				continue;
+			}
+			free_buf(buffer);
+			buffer = pack_slurmdbd_msg(&msg,
+						   SLURM_PROTOCOL_VERSION);
+			slurmdbd_free_msg(&msg);
+		}
+		list_append(records, buffer);
+	}
+	close(fd);
+	info("Loaded %d records from %s", list_count(records), file_name);
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	error("%s is not a dbd.messages file", file_name);
+	free_buf(buffer);
+	xfree(ver_str);
+	close(fd);
+	return SLURM_ERROR;
+}
+
+/* Register as the cluster's slurmctld, its records are ignored otherwise */
+static int _register(slurm_persist_conn_t *conn)
+{
+	dbd_register_ctld_msg_t register_msg;
+	slurmdbd_msg_t req;
+	Buf buffer;
+	int rc;
+
+	memset(&register_msg, 0, sizeof(register_msg));
+	register_msg.dimensions = 1;
+	register_msg.plugin_id_select = NO_VAL;
+	register_msg.port = my_port;
+	req.msg_type = DBD_REGISTER_CTLD;
+	req.data = &register_msg;
+	buffer = pack_slurmdbd_msg(&req, conn->version);
+	rc = slurm_persist_send_msg(conn, buffer);
+	free_buf(buffer);
+	if ((rc != SLURM_SUCCESS) || !(buffer = slurm_persist_recv_msg(conn))) {
+		error("Unable to register cluster %s", cluster_name);
+		return SLURM_ERROR;
+	}
+	if ((rc = _rec_rc(conn->version, buffer)) != SLURM_SUCCESS)
+		error("Unable to register cluster %s: %s", cluster_name,
+		      slurm_strerror(rc));
+	free_buf(buffer);
+
+	return rc;
+}
+
+/* Return code of the response to one record. unpack_slurmdbd_msg() is
+ * not used, it needs the slurmdbd_agent's connection for PERSIST_RC. */
+static int _rec_rc(uint16_t version, Buf buffer)
+{
+	dbd_id_rc_msg_t *id_msg = NULL;
+	persist_rc_msg_t *rc_msg = NULL;
+	uint16_t msg_type;
+	int rc = SLURM_ERROR;
+
+	safe_unpack16(&msg_type, buffer);
+	if ((msg_type == DBD_ID_RC) &&
+	    (slurmdbd_unpack_id_rc_msg((void **) &id_msg, version, buffer)
+	     == SLURM_SUCCESS)) {
+		rc = id_msg->return_code;
+		slurmdbd_free_id_rc_msg(id_msg);
+	} else if ((msg_type == PERSIST_RC) &&
+		   (slurm_persist_unpack_rc_msg(&rc_msg, buffer, version)
+		    == SLURM_SUCCESS)) {
+		rc = rc_msg->rc;
+		slurm_persist_free_rc_msg(rc_msg);
+	}
+
+unpack_error:
+	return rc;
+}
+
+/* Count the leading records acknowledged by the response to a batch */
+static int _mult_rc(uint16_t version, Buf buffer, uint32_t *acked)
+{
+	dbd_list_msg_t *list_msg = NULL;
+	persist_rc_msg_t *rc_msg = NULL;
+	ListIterator itr;
+	uint16_t msg_type;
+	Buf rec_buf;
+	int rc = SLURM_ERROR;
+
+	*acked = 0;
+	safe_unpack16(&msg_type, buffer);
+	if (msg_type == PERSIST_RC) {
+		/* The whole batch failed */
+		if (slurm_persist_unpack_rc_msg(&rc_msg, buffer, version)
+		    == SLURM_SUCCESS) {
+			error("Batch failed: %s", rc_msg->comment);
+			slurm_persist_free_rc_msg(rc_msg);
+		}
+		return SLURM_ERROR;
+	} else if ((msg_type != DBD_GOT_MULT_MSG) ||
+		   (slurmdbd_unpack_list_msg(&list_msg, version,
+					     DBD_GOT_MULT_MSG, buffer)
+		    != SLURM_SUCCESS))
+		goto unpack_error;
+
+	rc = SLURM_SUCCESS;
+	itr = list_iterator_create(list_msg->my_list);
+	while ((rec_buf = list_next(itr))) {
+		if ((rc = _rec_rc(version, rec_buf)) != SLURM_SUCCESS) {
+			if (report_batches)
+				info("record failed: %s", slurm_strerror(rc));
+			break;
+		}
+		(*acked)++;
+	}
+	list_iterator_destroy(itr);
+	slurmdbd_free_list_msg(list_msg);
+
+	return rc;
+
+unpack_error:
+	error("Unable to unpack the SlurmDBD response");
+	return SLURM_ERROR;
+}
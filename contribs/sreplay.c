@@ -0,0 +1,579 @@
+/*****************************************************************************\
+ *  sreplay.c - Replay a job trace against a running Slurm cluster and
+ *  report scheduling throughput, utilization, wait times and the time
+ *  spent by slurmctld in its scheduling cycles.
+ *
+ *  The trace is read in the Standard Workload Format (SWF) used by the
+ *  Parallel Workloads Archive. See contribs/README for converting sacct
+ *  output to SWF.
+ *
+ *  Each job in the trace is submitted as a batch job that sleeps for its
+ *  recorded run time, at its recorded submit time relative to the first
+ *  job. Both times may be compressed by a speedup factor. The jobs are
+ *  scheduled by the real slurmctld, so pointing this at a test cluster
+ *  built with --enable-front-end or --enable-multiple-slurmd and a
+ *  synthetic node table exercises job_scheduler.c, the backfill plugin,
+ *  node_scheduler.c and the configured select plugin exactly as in
+ *  production. Rerun with different SchedulerParameters, priority weights
+ *  or select options to compare configurations, or against different
+ *  builds as a scheduler performance regression test.
+ *
+ *  Build with:
+ *    gcc -o sreplay sreplay.c -I<prefix>/include -L<prefix>/lib -lslurm
+ *  and execute as a user permitted to submit jobs to the partition used.
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <slurm/slurm.h>
+#include <slurm/slurm_errno.h>
+
+#ifndef MAX
+#  define MAX(x,y) (((x) > (y)) ? (x) : (y))
+#endif
+#ifndef MIN
+#  define MIN(x,y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#define POLL_INTERVAL	5	/* seconds between job state polls */
+#define SUBMIT_RETRIES	10	/* retries if slurmctld is busy */
+
+typedef struct trace_job {
+	uint32_t trace_id;	/* job number in the trace */
+	long     submit;	/* submit time in trace, seconds */
+	long     run_time;	/* run time in trace, seconds */
+	long     req_time;	/* requested time limit, seconds, 0 if none */
+	uint32_t cpus;		/* requested (or allocated) processors */
+	uint32_t job_id;	/* Slurm job ID, 0 if not submitted */
+	time_t   submit_time;	/* from slurmctld once complete */
+	time_t   start_time;
+	time_t   end_time;
+	uint32_t num_cpus;
+	uint32_t poll_cnt;	/* last poll which found the job */
+	bool     done;		/* job record from slurmctld is final */
+	bool     purged;	/* ended unseen, record already purged */
+} trace_job_t;
+
+static char    *partition = NULL;
+static double   speedup = 1.0;
+static uint32_t max_jobs = 0;
+static long     time_out = 0;
+static bool     use_limits = false;
+static bool     verbose = false;
+
+static int  _cmp_job_id(const void *a, const void *b);
+static int  _cmp_long(const void *a, const void *b);
+static uint32_t _get_total_cpus(void);
+static double _now_sec(void);
+static void _poll_jobs(trace_job_t **by_id, int submit_cnt, int *done_cnt);
+static int  _read_trace(char *file_name, trace_job_t **jobs_pptr);
+static void _report(trace_job_t *jobs, int job_cnt, time_t replay_start,
+		    stats_info_response_msg_t *stats);
+static int  _submit_job(trace_job_t *job);
+static void _usage(char *prog);
+
+int main(int argc, char **argv)
+{
+	trace_job_t *jobs = NULL, **by_id = NULL;
+	int job_cnt, done_cnt = 0, submit_cnt = 0, i, opt_char;
+	bool sorted = true;
+	stats_info_request_msg_t stats_req;
+	stats_info_response_msg_t *stats = NULL;
+	double start_sec, target_sec, now_sec, next_poll, end_sec;
+	long trace_len = 0;
+	time_t replay_start;
+
+	while ((opt_char = getopt(argc, argv, "hlm:p:s:t:v")) != -1) {
+		switch (opt_char) {
+		case 'l':
+			use_limits = true;
+			break;
+		case 'm':
+			max_jobs = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			partition = optarg;
+			break;
+		case 's':
+			speedup = strtod(optarg, NULL);
+			if (speedup <= 0.0) {
+				fprintf(stderr, "Invalid speedup: %s\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 't':
+			time_out = strtol(optarg, NULL, 10);
+			if (time_out <= 0) {
+				fprintf(stderr, "Invalid timeout: %s\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		case 'h':
+		default:
+			_usage(argv[0]);
+			exit(opt_char == 'h' ? 0 : 1);
+		}
+	}
+	if (optind != (argc - 1)) {
+		_usage(argv[0]);
+		exit(1);
+	}
+
+	job_cnt = _read_trace(argv[optind], &jobs);
+	if (job_cnt <= 0) {
+		fprintf(stderr, "No jobs found in trace %s\n", argv[optind]);
+		exit(1);
+	}
+	by_id = malloc(sizeof(trace_job_t *) * job_cnt);
+	if (!by_id) {
+		perror("malloc");
+		exit(1);
+	}
+	/* Unless given, allow twice the trace's length to replay it, plus
+	 * ten minutes for a queue which drains slower than the trace */
+	if (!time_out) {
+		for (i = 0; i < job_cnt; i++) {
+			trace_len = MAX(trace_len, jobs[i].submit -
+					jobs[0].submit + jobs[i].run_time);
+		}
+		time_out = (long) ((2 * trace_len) / speedup) + 600;
+	}
+	printf("Replaying %d jobs from %s, speedup %.2f, timeout %ld sec\n",
+	       job_cnt, argv[optind], speedup, time_out);
+
+	stats_req.command_id = STAT_COMMAND_RESET;
+	if (slurm_reset_statistics(&stats_req) != SLURM_SUCCESS)
+		slurm_perror("slurm_reset_statistics");
+
+	replay_start = time(NULL);
+	start_sec = _now_sec();
+	next_poll = start_sec + POLL_INTERVAL;
+	end_sec = start_sec + time_out;
+	/* Keep polling while submitting, so that jobs which end long before
+	 * the last submit are seen before slurmctld purges their records */
+	for (i = 0; i < job_cnt; i++) {
+		target_sec = start_sec +
+			     ((jobs[i].submit - jobs[0].submit) / speedup);
+		while ((now_sec = _now_sec()) < target_sec) {
+			if (now_sec >= next_poll) {
+				if (!sorted) {
+					qsort(by_id, submit_cnt,
+					      sizeof(trace_job_t *),
+					      _cmp_job_id);
+					sorted = true;
+				}
+				_poll_jobs(by_id, submit_cnt, &done_cnt);
+				next_poll = now_sec + POLL_INTERVAL;
+				continue;
+			}
+			usleep((useconds_t) ((MIN(target_sec, next_poll) -
+					      now_sec) * 1000000));
+		}
+		if (_submit_job(&jobs[i]) != SLURM_SUCCESS)
+			continue;
+		/* Job IDs normally grow with each submit, so the index
+		 * rarely needs sorting again */
+		if (submit_cnt &&
+		    (jobs[i].job_id < by_id[submit_cnt - 1]->job_id))
+			sorted = false;
+		by_id[submit_cnt++] = &jobs[i];
+	}
+	printf("Submitted %d of %d jobs, waiting for completion\n",
+	       submit_cnt, job_cnt);
+	if (!sorted)
+		qsort(by_id, submit_cnt, sizeof(trace_job_t *), _cmp_job_id);
+
+	while (done_cnt < submit_cnt) {
+		if (_now_sec() >= end_sec) {
+			fprintf(stderr, "Timed out after %ld sec with %d of "
+				"%d jobs complete\n",
+				time_out, done_cnt, submit_cnt);
+			break;
+		}
+		sleep(POLL_INTERVAL);
+		_poll_jobs(by_id, submit_cnt, &done_cnt);
+		if (verbose) {
+			printf("%d of %d jobs complete\n",
+			       done_cnt, submit_cnt);
+		}
+	}
+	free(by_id);
+
+	stats_req.command_id = STAT_COMMAND_GET;
+	if (slurm_get_statistics(&stats, &stats_req) != SLURM_SUCCESS) {
+		slurm_perror("slurm_get_statistics");
+		stats = NULL;
+	}
+	_report(jobs, job_cnt, replay_start, stats);
+	free(jobs);
+
+	exit(0);
+}
+
+static void _usage(char *prog)
+{
+	printf("Usage: %s [-l] [-m max_jobs] [-p partition] [-s speedup] "
+	       "[-t timeout] [-v] trace.swf\n", prog);
+	printf("  -l  Set job time limits from the trace's requested time\n");
+	printf("  -m  Replay no more than max_jobs jobs\n");
+	printf("  -p  Submit jobs to the specified partition\n");
+	printf("  -s  Divide trace submit and run times by speedup\n");
+	printf("  -t  Stop waiting for jobs after timeout seconds, by "
+	       "default twice\n      the replayed trace length plus "
+	       "600\n");
+	printf("  -v  Report progress while waiting for jobs\n");
+}
+
+/*
+ * Read an SWF trace. Fields used: 1 job number, 2 submit time, 4 run time,
+ * 5 allocated processors, 8 requested processors, 9 requested time.
+ * Lines starting with ';' are comments. Jobs without a valid run time or
+ * processor count are skipped.
+ * RET count of jobs read, jobs sorted by submit time
+ */
+static int _read_trace(char *file_name, trace_job_t **jobs_pptr)
+{
+	FILE *fp;
+	char in_line[1024];
+	trace_job_t *jobs = NULL;
+	int job_cnt = 0, job_size = 0;
+	long f[9];
+	int i;
+
+	fp = fopen(file_name, "r");
+	if (!fp) {
+		perror(file_name);
+		return -1;
+	}
+	while (fgets(in_line, sizeof(in_line), fp)) {
+		if ((in_line[0] == ';') || (in_line[0] == '\n'))
+			continue;
+		if (sscanf(in_line, "%ld %ld %ld %ld %ld %ld %ld %ld %ld",
+			   &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6],
+			   &f[7], &f[8]) != 9)
+			continue;
+		if ((f[3] < 0) || ((f[4] <= 0) && (f[7] <= 0)))
+			continue;
+		if (job_cnt >= job_size) {
+			job_size = job_size ? (job_size * 2) : 1024;
+			jobs = realloc(jobs, sizeof(trace_job_t) * job_size);
+			if (!jobs) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+		memset(&jobs[job_cnt], 0, sizeof(trace_job_t));
+		jobs[job_cnt].trace_id = f[0];
+		jobs[job_cnt].submit   = f[1];
+		jobs[job_cnt].run_time = f[3];
+		jobs[job_cnt].cpus     = (f[7] > 0) ? f[7] : f[4];
+		jobs[job_cnt].req_time = (f[8] > 0) ? f[8] : 0;
+		job_cnt++;
+		if (max_jobs && (job_cnt >= max_jobs))
+			break;
+	}
+	fclose(fp);
+
+	/* SWF traces are ordered by submit time, but verify */
+	for (i = 1; i < job_cnt; i++) {
+		if (jobs[i].submit < jobs[i - 1].submit) {
+			fprintf(stderr, "Trace not ordered by submit time at "
+				"job %u\n", jobs[i].trace_id);
+			free(jobs);
+			return -1;
+		}
+	}
+
+	*jobs_pptr = jobs;
+	return job_cnt;
+}
+
+static int _submit_job(trace_job_t *job)
+{
+	job_desc_msg_t job_desc;
+	submit_response_msg_t *resp = NULL;
+	char script[128], name[32], *env[] = { "SLURM_REPLAY=1", NULL };
+	long sleep_time, limit;
+	int i, rc = SLURM_ERROR;
+
+	sleep_time = (long) ((job->run_time / speedup) + 0.5);
+	snprintf(script, sizeof(script), "#!/bin/sh\nsleep %ld\n", sleep_time);
+	snprintf(name, sizeof(name), "replay_%u", job->trace_id);
+
+	slurm_init_job_desc_msg(&job_desc);
+	job_desc.name = name;
+	job_desc.script = script;
+	job_desc.partition = partition;
+	job_desc.min_cpus = job->cpus;
+	job_desc.num_tasks = job->cpus;
+	job_desc.user_id = getuid();
+	job_desc.group_id = getgid();
+	job_desc.work_dir = "/tmp";
+	job_desc.std_out = "/dev/null";
+	job_desc.environment = env;
+	job_desc.env_size = 1;
+	if (use_limits && job->req_time) {
+		/* Round up to minutes, but never below the run time */
+		limit = (long) ((MAX(job->req_time, job->run_time) / speedup)
+				+ 59) / 60;
+		job_desc.time_limit = MAX(limit, 1);
+	}
+
+	for (i = 0; i < SUBMIT_RETRIES; i++) {
+		rc = slurm_submit_batch_job(&job_desc, &resp);
+		if ((rc == SLURM_SUCCESS) || (errno != EAGAIN))
+			break;
+		sleep(1);
+	}
+	if (rc != SLURM_SUCCESS) {
+		fprintf(stderr, "Trace job %u submit failed: %s\n",
+			job->trace_id, slurm_strerror(errno));
+		job->done = true;
+		return rc;
+	}
+	job->job_id = resp->job_id;
+	if (verbose) {
+		printf("Trace job %u submitted as job %u\n",
+		       job->trace_id, job->job_id);
+	}
+	slurm_free_submit_response_response_msg(resp);
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Record the times of all newly finished jobs. Jobs no longer known to
+ * slurmctld ended and were purged (MinJobAge) between two polls, so they
+ * are done without any times.
+ * by_id IN - submitted jobs, ordered by job ID
+ */
+static void _poll_jobs(trace_job_t **by_id, int submit_cnt, int *done_cnt)
+{
+	static uint32_t poll_cnt = 0;
+	job_info_msg_t *job_info = NULL;
+	job_info_t *job_ptr;
+	trace_job_t key, *key_ptr = &key, **job_pptr, *job;
+	uint32_t i;
+
+	if (*done_cnt >= submit_cnt)
+		return;
+	if (slurm_load_jobs((time_t) 0, &job_info, SHOW_ALL) !=
+	    SLURM_SUCCESS) {
+		slurm_perror("slurm_load_jobs");
+		return;
+	}
+
+	poll_cnt++;
+	for (i = 0; i < job_info->record_count; i++) {
+		job_ptr = &job_info->job_array[i];
+		key.job_id = job_ptr->job_id;
+		job_pptr = bsearch(&key_ptr, by_id, submit_cnt,
+				   sizeof(trace_job_t *), _cmp_job_id);
+		if (!job_pptr || (*job_pptr)->done)
+			continue;
+		job = *job_pptr;
+		job->poll_cnt = poll_cnt;
+		if ((job_ptr->job_state & JOB_STATE_BASE) <= JOB_SUSPENDED)
+			continue;
+		job->done        = true;
+		job->submit_time = job_ptr->submit_time;
+		job->start_time  = job_ptr->start_time;
+		job->end_time    = job_ptr->end_time;
+		job->num_cpus    = job_ptr->num_cpus;
+		(*done_cnt)++;
+	}
+	slurm_free_job_info_msg(job_info);
+
+	for (i = 0; i < submit_cnt; i++) {
+		job = by_id[i];
+		if (job->done || (job->poll_cnt == poll_cnt))
+			continue;
+		job->done   = true;
+		job->purged = true;
+		(*done_cnt)++;
+		if (verbose) {
+			printf("Job %u ended unseen, its record was purged\n",
+			       job->job_id);
+		}
+	}
+}
+
+static double _now_sec(void)
+{
+	struct timeval now_tv;
+
+	gettimeofday(&now_tv, NULL);
+	return now_tv.tv_sec + (now_tv.tv_usec / 1000000.0);
+}
+
+static uint32_t _get_total_cpus(void)
+{
+	node_info_msg_t *node_info = NULL;
+	uint32_t i, total_cpus = 0;
+
+	if (slurm_load_node((time_t) 0, &node_info, SHOW_ALL) !=
+	    SLURM_SUCCESS) {
+		slurm_perror("slurm_load_node");
+		return 0;
+	}
+	for (i = 0; i < node_info->record_count; i++) {
+		if (node_info->node_array[i].name)
+			total_cpus += node_info->node_array[i].cpus;
+	}
+	slurm_free_node_info_msg(node_info);
+
+	return total_cpus;
+}
+
+static int _cmp_job_id(const void *a, const void *b)
+{
+	uint32_t x = (*(trace_job_t * const *) a)->job_id;
+	uint32_t y = (*(trace_job_t * const *) b)->job_id;
+
+	if (x < y)
+		return -1;
+	if (x > y)
+		return 1;
+	return 0;
+}
+
+static int _cmp_long(const void *a, const void *b)
+{
+	long x = *(const long *) a, y = *(const long *) b;
+
+	if (x < y)
+		return -1;
+	if (x > y)
+		return 1;
+	return 0;
+}
+
+static void _report(trace_job_t *jobs, int job_cnt, time_t replay_start,
+		    stats_info_response_msg_t *stats)
+{
+	long *waits, wait_sum = 0;
+	double cpu_secs = 0.0, makespan, util = 0.0;
+	time_t last_end = replay_start;
+	uint32_t total_cpus = _get_total_cpus();
+	int i, run_cnt = 0, submit_cnt = 0, purge_cnt = 0, left_cnt = 0;
+
+	waits = malloc(sizeof(long) * job_cnt);
+	if (!waits) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < job_cnt; i++) {
+		if (!jobs[i].job_id)
+			continue;	/* submit failed */
+		submit_cnt++;
+		if (jobs[i].purged)
+			purge_cnt++;
+		else if (!jobs[i].done)
+			left_cnt++;
+		if (!jobs[i].start_time)
+			continue;	/* cancelled before starting */
+		waits[run_cnt] = jobs[i].start_time - jobs[i].submit_time;
+		wait_sum += waits[run_cnt];
+		run_cnt++;
+		cpu_secs += (double) jobs[i].num_cpus *
+			    (jobs[i].end_time - jobs[i].start_time);
+		last_end = MAX(last_end, jobs[i].end_time);
+	}
+	qsort(waits, run_cnt, sizeof(long), _cmp_long);
+	makespan = MAX(last_end - replay_start, 1);
+	if (total_cpus)
+		util = (cpu_secs * 100.0) / (total_cpus * makespan);
+
+	printf("\n*******************************************************\n");
+	printf("Jobs run:                 %d of %d\n", run_cnt, job_cnt);
+	printf("Jobs submitted:           %d\n", submit_cnt);
+	if (purge_cnt) {
+		printf("Jobs purged unseen:       %d (raise MinJobAge)\n",
+		       purge_cnt);
+	}
+	if (left_cnt)
+		printf("Jobs unfinished:          %d\n", left_cnt);
+	printf("Makespan:                 %.0f sec (%.0f sec trace time)\n",
+	       makespan, makespan * speedup);
+	printf("Throughput:               %.2f jobs/hour "
+	       "(%.2f jobs/hour trace time)\n",
+	       (run_cnt * 3600.0) / makespan,
+	       (run_cnt * 3600.0) / (makespan * speedup));
+	printf("Utilization:              %.2f%% of %u CPUs\n",
+	       util, total_cpus);
+	if (run_cnt) {
+		printf("Wait time mean:           %.1f sec\n",
+		       (double) wait_sum / run_cnt);
+		printf("Wait time median:         %ld sec\n",
+		       waits[run_cnt / 2]);
+		printf("Wait time 90th pct:       %ld sec\n",
+		       waits[(run_cnt * 9) / 10]);
+		printf("Wait time max:            %ld sec\n",
+		       waits[run_cnt - 1]);
+	}
+	free(waits);
+
+	if (!stats)
+		return;
+	printf("\nMain schedule statistics (microseconds):\n");
+	printf("\tCycles:                 %u\n", stats->schedule_cycle_counter);
+	printf("\tMax cycle:              %u\n", stats->schedule_cycle_max);
+	if (stats->schedule_cycle_counter) {
+		printf("\tMean cycle:             %u\n",
+		       stats->schedule_cycle_sum /
+		       stats->schedule_cycle_counter);
+	}
+	printf("\tTotal time:             %u\n", stats->schedule_cycle_sum);
+	printf("\nBackfilling statistics (microseconds):\n");
+	printf("\tCycles:                 %u\n", stats->bf_cycle_counter);
+	printf("\tJobs backfilled:        %u\n", stats->bf_backfilled_jobs);
+	printf("\tMax cycle:              %u\n", stats->bf_cycle_max);
+	if (stats->bf_cycle_counter) {
+		printf("\tMean cycle:             %"PRIu64"\n",
+		       stats->bf_cycle_sum / stats->bf_cycle_counter);
+	}
+	printf("\tTotal time:             %"PRIu64"\n", stats->bf_cycle_sum);
+}
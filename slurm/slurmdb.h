@@ -177,6 +177,20 @@ enum cluster_fed_states {
 					    * the default */
 #define SLURMDB_PURGE_ARCHIVE 0x00080000   /* Archive before purge */
 
+/* Groups of job and step record fields returned by a job query,
+ * see slurmdb_job_cond_t->fields */
+#define JOBCOND_FIELD_BASE    0x00000001 /* ids, times, state, counts and
+					  * anything not in another group,
+					  * always returned */
+#define JOBCOND_FIELD_ASSOC   0x00000002 /* account, partition and wckey */
+#define JOBCOND_FIELD_NAME    0x00000004 /* job and step names */
+#define JOBCOND_FIELD_NODES   0x00000008 /* job and step node lists */
+#define JOBCOND_FIELD_TRES    0x00000010 /* TRES and GRES strings */
+#define JOBCOND_FIELD_STATS   0x00000020 /* step usage statistics */
+#define JOBCOND_FIELD_RESV    0x00000040 /* reservation name */
+#define JOBCOND_FIELD_COMMENT 0x00000080 /* comments and block id */
+#define JOBCOND_FIELD_ALL     0x000000ff
+
 /* Parent account should be used when calculating FairShare */
 #define SLURMDB_FS_USE_PARENT 0x7FFFFFFF
 
@@ -269,6 +283,8 @@ typedef struct {
 	uint32_t cpus_min;      /* number of cpus low range */
 	uint16_t duplicates;    /* report duplicate job entries */
 	int32_t exitcode;       /* exit code of job */
+	uint32_t fields;	/* JOBCOND_FIELD_* groups to return,
+				 * 0 for all of them */
 	List groupid_list;	/* list of char * */
 	List jobname_list;	/* list of char * */
 	uint32_t nodes_max;     /* number of nodes high range */
@@ -724,6 +740,7 @@ typedef struct {
 	time_t eligible;
 	time_t end;
 	uint32_t exitcode;
+	uint32_t fields; /* JOBCOND_FIELD_* groups set, 0 for all of them */
 	void *first_step_ptr;
 	uint32_t gid;
 	uint32_t jobid;
@@ -1076,7 +1093,7 @@ typedef struct {
 	uint16_t without_defaults;
 } slurmdb_user_cond_t;
 
-typedef struct {
+typedef struct slurmdb_user_rec {
 	uint16_t admin_level; /* really slurmdb_admin_level_t but for
 				 packing purposes needs to be uint16_t */
 	List assoc_list; /* list of slurmdb_association_rec_t *'s */
@@ -1086,6 +1103,13 @@ typedef struct {
 	char *name;
 	char *old_name;
 	uint32_t uid;
+	struct slurmdb_user_rec *user_next; /* next user with same hash
+					     * index based off the name
+					     * DOESN'T GET PACKED */
+	struct slurmdb_user_rec *user_next_uid; /* next user with same
+						 * hash index based off
+						 * the uid
+						 * DOESN'T GET PACKED */
 	List wckey_list; /* list of slurmdb_wckey_rec_t *'s */
 } slurmdb_user_rec_t;
 
@@ -1216,6 +1240,13 @@ typedef struct {
 	uint32_t *rpc_user_id;		/* User ID issuing RPC */
 	uint32_t *rpc_user_cnt;		/* count of RPCs processed */
 	uint64_t *rpc_user_time;	/* total usecs this user's RPCs */
+
+	uint32_t mult_cnt;		/* count of DBD_SEND_MULT_MSG batches */
+	uint64_t mult_rec_cnt;		/* records in those batches */
+	uint64_t mult_time;		/* total usecs processing batches */
+	uint64_t mult_max_time;		/* max usecs processing a batch */
+	uint64_t mult_commit_time;	/* total usecs committing batches */
+	uint32_t mult_fail_cnt;		/* batches rolled back */
 } slurmdb_stats_rec_t;
 
 
@@ -1501,6 +1532,17 @@ extern List slurmdb_events_get(void *db_conn,
  */
 extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond);
 
+/*
+ * get info from the storage a chunk of jobs at a time, so the whole
+ * answer to a large query is never held in memory
+ * IN:  callback - called with each List of slurmdb_job_rec_t *, which is
+ *      freed when it returns; return an error to stop the query
+ * RET: SLURM_SUCCESS on success SLURM_ERROR else
+ */
+extern int slurmdb_jobs_get_stream(void *db_conn, slurmdb_job_cond_t *job_cond,
+				   int (*callback)(List job_list, void *arg),
+				   void *arg);
+
 /*
  * get info from the storage
  * IN:  slurmdb_assoc_cond_t *
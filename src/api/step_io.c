@@ -77,6 +77,7 @@ static struct io_buf *_alloc_io_buf(void);
 static void	_init_stdio_eio_objs(slurm_step_io_fds_t fds,
 				     client_io_t *cio);
 static void	_handle_io_init_msg(int fd, client_io_t *cio);
+static void	_handle_forward_init(eio_obj_t *obj, struct io_buf *msg);
 static int      _read_io_init_msg(int fd, client_io_t *cio, char *host);
 static int      _wid(int n);
 static bool     _incoming_buf_free(client_io_t *cio);
@@ -112,6 +113,8 @@ struct server_io_info {
 	client_io_t *cio;
 	int node_id;
 	bool testing_connection;
+	bool tree_closed;	/* stop reading a connection that may carry
+				 * the I/O of several nodes */
 
 	/* incoming variables */
 	struct slurm_io_header header;
@@ -128,6 +131,9 @@ struct server_io_info {
 	bool out_eof;
 };
 
+static void	_send_forward_down(client_io_t *cio,
+				   struct server_io_info *server, int node_id);
+
 /**********************************************************************
  * File write declarations
  **********************************************************************/
@@ -226,6 +232,7 @@ _create_server_eio_obj(int fd, client_io_t *cio, int nodeid,
 	info->cio = cio;
 	info->node_id = nodeid;
 	info->testing_connection = false;
+	info->tree_closed = false;
 	info->in_msg = NULL;
 	info->in_remaining = 0;
 	info->in_eof = false;
@@ -241,6 +248,55 @@ _create_server_eio_obj(int fd, client_io_t *cio, int nodeid,
 	return eio;
 }
 
+/*
+ * A slurmstepd forwarding the I/O of another node (LAUNCH_IO_TREE) passes
+ * on the io init msg of that node, the node's I/O then shares the
+ * connection of the forwarding slurmstepd.
+ */
+static void
+_handle_forward_init(eio_obj_t *obj, struct io_buf *msg)
+{
+	struct server_io_info *s = (struct server_io_info *) obj->arg;
+	client_io_t *cio = s->cio;
+	struct slurm_io_init_msg init;
+	Buf packbuf;
+	int rc;
+
+	packbuf = create_buf(msg->data, msg->length);
+	rc = io_init_msg_unpack(&init, packbuf);
+	/* free the Buf packbuf, but not the memory to which it points */
+	packbuf->head = NULL;
+	free_buf(packbuf);
+	if ((rc != SLURM_SUCCESS) ||
+	    (io_init_msg_validate(&init, cio->io_key) < 0))
+		return;
+	if (init.nodeid >= cio->num_nodes) {
+		error("Invalid nodeid %u forwarded by node %d",
+		      init.nodeid, s->node_id);
+		return;
+	}
+	debug2("Validated IO connection of node rank %u forwarded by node "
+	       "rank %d", init.nodeid, s->node_id);
+
+	slurm_mutex_lock(&cio->ioservers_lock);
+	if (cio->ioserver[init.nodeid] != NULL) {
+		error("IO: Node %u already established stream!", init.nodeid);
+		slurm_mutex_unlock(&cio->ioservers_lock);
+		return;
+	} else if (bit_test(cio->ioservers_ready_bits, init.nodeid)) {
+		error("IO: Hey, you told me node %u was down!", init.nodeid);
+	}
+	cio->ioserver[init.nodeid] = obj;
+	s->remote_stdout_objs += init.stdout_objs;
+	s->remote_stderr_objs += init.stderr_objs;
+	bit_set(cio->ioservers_ready_bits, init.nodeid);
+	cio->ioservers_ready = bit_set_count(cio->ioservers_ready_bits);
+	slurm_mutex_unlock(&cio->ioservers_lock);
+
+	if (cio->sls)
+		step_launch_clear_questionable_state(cio->sls, init.nodeid);
+}
+
 static bool
 _server_readable(eio_obj_t *obj)
 {
@@ -265,6 +321,11 @@ _server_readable(eio_obj_t *obj)
 		return true;
 	}
 
+	/* Nodes forwarding I/O through this connection may connect after
+	 * the local tasks are done, read until the slurmstepd closes it */
+	if (s->cio->io_tree && !s->tree_closed)
+		return true;
+
 	if (obj->shutdown) {
 		if (obj->fd != -1) {
 			close(obj->fd);
@@ -345,8 +406,9 @@ _server_read(eio_obj_t *obj, List objs)
 			/* If all remote eios are gone, shutdown
 			 * the i/o channel with stepd.
 			 */
-			if (s->remote_stdout_objs == 0
-				&& s->remote_stderr_objs == 0) {
+			if (!s->cio->io_tree
+			    && s->remote_stdout_objs == 0
+			    && s->remote_stderr_objs == 0) {
 				obj->shutdown = true;
 			}
 			list_enqueue(s->cio->free_outgoing, s->in_msg);
@@ -406,6 +468,13 @@ _server_read(eio_obj_t *obj, List objs)
 		debug3("***** passing on eof message");
 	}
 
+	if (s->in_msg->header.type == SLURM_IO_FORWARD_INIT) {
+		_handle_forward_init(obj, s->in_msg);
+		list_enqueue(s->cio->free_outgoing, s->in_msg);
+		s->in_msg = NULL;
+		return SLURM_SUCCESS;
+	}
+
 	/*
 	 * Route the message to the proper output
 	 */
@@ -750,16 +819,20 @@ again:
 		int i;
 		struct server_io_info *server;
 		for (i = 0; i < info->cio->num_nodes; i++) {
-			msg->ref_count++;
-			if (info->cio->ioserver[i] == NULL)
+			if (info->cio->ioserver[i] == NULL) {
 				/* client_io_handler_abort() or
 				 * client_io_handler_downnodes() called */
 				verbose("ioserver stream of node %d not yet "
 					"initialized", i);
-			else {
-				server = info->cio->ioserver[i]->arg;
-				list_enqueue(server->msg_queue, msg);
+				continue;
 			}
+			server = info->cio->ioserver[i]->arg;
+			/* The slurmstepd of a shared connection passes the
+			 * message on to the nodes it forwards */
+			if (server->node_id != i)
+				continue;
+			msg->ref_count++;
+			list_enqueue(server->msg_queue, msg);
 		}
 	} else if (header.type == SLURM_IO_STDIN) {
 		uint32_t nodeid;
@@ -771,6 +844,10 @@ again:
 		if (nodeid == (uint32_t)-1) {
 			error("A valid node id must be specified"
 			      " for SLURM_IO_STDIN");
+		} else if (info->cio->ioserver[nodeid] == NULL) {
+			verbose("ioserver stream of node %d not yet "
+				"initialized", nodeid);
+			msg->ref_count = 0;
 		} else {
 			server = info->cio->ioserver[nodeid]->arg;
 			list_enqueue(server->msg_queue, msg);
@@ -778,6 +855,12 @@ again:
 	} else {
 		fatal("Unsupported header.type");
 	}
+	if (msg->ref_count == 0) {
+		/* No node left to send it to */
+		slurm_mutex_lock(&info->cio->ioservers_lock);
+		list_enqueue(info->cio->free_incoming, msg);
+		slurm_mutex_unlock(&info->cio->ioservers_lock);
+	}
 	msg = NULL;
 	return SLURM_SUCCESS;
 }
@@ -1257,9 +1340,10 @@ void
 client_io_handler_downnodes(client_io_t *cio,
 			    const int* node_ids, int num_node_ids)
 {
-	int i;
+	int i, j;
 	int node_id;
 	struct server_io_info *info;
+	eio_obj_t *obj;
 	void *tmp;
 
 	if (cio == NULL)
@@ -1272,8 +1356,23 @@ client_io_handler_downnodes(client_io_t *cio,
 			continue;
 		if (bit_test(cio->ioservers_ready_bits, node_id)
 		    && cio->ioserver[node_id] != NULL) {
-			tmp = cio->ioserver[node_id]->arg;
+			obj = cio->ioserver[node_id];
+			tmp = obj->arg;
 			info = (struct server_io_info *)tmp;
+			/* A node forwarding its I/O through another one is
+			 * done, the shared connection stays open */
+			if (info->node_id != node_id) {
+				_send_forward_down(cio, info, node_id);
+				cio->ioserver[node_id] = NULL;
+				continue;
+			}
+			/* Nodes forwarding their I/O through a down node
+			 * are done along with its connection */
+			for (j = 0; j < cio->num_nodes; j++) {
+				if ((j != node_id) && (cio->ioserver[j] == obj))
+					cio->ioserver[j] = NULL;
+			}
+			info->tree_closed = true;
 			info->remote_stdout_objs = 0;
 			info->remote_stderr_objs = 0;
 			info->testing_connection = false;
@@ -1289,6 +1388,40 @@ client_io_handler_downnodes(client_io_t *cio,
 	eio_signal_wakeup(cio->eio);
 }
 
+/*
+ * Tell the slurmstepds forwarding the I/O of a down node, so that the one
+ * holding its connection closes it rather than wait for it to close.
+ * Callers of this function should already have locked cio->ioservers_lock.
+ */
+static void
+_send_forward_down(client_io_t *cio, struct server_io_info *server,
+		   int node_id)
+{
+	struct io_buf *msg;
+	io_hdr_t header;
+	Buf packbuf;
+
+	if (server->out_eof || !_incoming_buf_free(cio))
+		return;
+
+	header.type = SLURM_IO_FORWARD_DOWN;
+	header.gtaskid = 0;  /* Unused */
+	header.ltaskid = 0;  /* Unused */
+	header.length = sizeof(uint32_t);
+
+	msg = list_dequeue(cio->free_incoming);
+	packbuf = create_buf(msg->data, io_hdr_packed_size() + header.length);
+	io_hdr_pack(&header, packbuf);
+	pack32((uint32_t) node_id, packbuf);
+	msg->length = get_buf_offset(packbuf);
+	msg->ref_count = 1;
+	msg->header = header;
+	/* free the Buf packbuf, but not the memory to which it points */
+	packbuf->head = NULL;
+	free_buf(packbuf);
+
+	list_enqueue(server->msg_queue, msg);
+}
 
 void
 client_io_handler_abort(client_io_t *cio)
@@ -1308,6 +1441,7 @@ client_io_handler_abort(client_io_t *cio)
 			io_info = (struct server_io_info *)cio->ioserver[i]->arg;
 			/* Trick the server eio_obj_t into closing its
 			 * connection. */
+			io_info->tree_closed = true;
 			io_info->remote_stdout_objs = 0;
 			io_info->remote_stderr_objs = 0;
 			io_info->testing_connection = false;
@@ -46,6 +46,8 @@ struct client_io {
 	bool label;
 	int label_width;
 	char *io_key;
+	bool io_tree;		/* slurmstepds may forward the I/O of other
+				 * nodes (LAUNCH_IO_TREE) */
 
 	/* internal variables */
 	pthread_t ioid;		/* stdio thread id 		  */
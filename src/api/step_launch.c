@@ -73,6 +73,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_defs.h"
 #include "src/common/slurm_time.h"
+#include "src/common/step_trace.h"
 #include "src/common/strlcpy.h"
 #include "src/common/uid.h"
 #include "src/common/xmalloc.h"
@@ -92,6 +93,7 @@ extern char **environ;
 static int _launch_tasks(slurm_step_ctx_t *ctx,
 			 launch_tasks_request_msg_t *launch_msg,
 			 uint32_t timeout, char *nodelist, int start_nodeid);
+static uint16_t _launch_tree_width(void);
 static char *_lookup_cwd(void);
 static void _print_launch_msg(launch_tasks_request_msg_t *msg,
 			      char *hostname, int nodeid);
@@ -187,8 +189,11 @@ int slurm_step_launch (slurm_step_ctx_t *ctx,
 	char **env = NULL;
 	char **mpi_env = NULL;
 	int rc = SLURM_SUCCESS;
+	uint16_t io_tree_width;
+	struct timeval start_tv;
 
 	debug("Entering slurm_step_launch");
+	gettimeofday(&start_tv, NULL);
 	memset(&launch, 0, sizeof(launch));
 
 	if (ctx == NULL || ctx->magic != STEP_CTX_MAGIC) {
@@ -321,6 +326,10 @@ int slurm_step_launch (slurm_step_ctx_t *ctx,
 			launch.flags	|= LAUNCH_BUFFERED_IO;
 		if (params->labelio)
 			launch.flags	|= LAUNCH_LABEL_IO;
+		io_tree_width = slurm_get_io_tree_width();
+		if (!params->pty && io_tree_width &&
+		    (launch.nnodes > io_tree_width))
+			launch.flags	|= LAUNCH_IO_TREE;
 		ctx->launch_state->io.normal =
 			client_io_handler_create(params->local_fds,
 						 ctx->step_req->num_tasks,
@@ -331,6 +340,8 @@ int slurm_step_launch (slurm_step_ctx_t *ctx,
 			rc = SLURM_ERROR;
 			goto fail1;
 		}
+		if (launch.flags & LAUNCH_IO_TREE)
+			ctx->launch_state->io.normal->io_tree = true;
 		/* The client_io_t gets a pointer back to the slurm_launch_state
 		   to notify it of I/O errors. */
 		ctx->launch_state->io.normal->sls = ctx->launch_state;
@@ -367,6 +378,8 @@ int slurm_step_launch (slurm_step_ctx_t *ctx,
 
 	rc = _launch_tasks(ctx, &launch, params->msg_timeout,
 			   launch.complete_nodelist, 0);
+	step_trace_span(ctx->job_id, ctx->step_resp->job_step_id,
+			"srun_step_launch", &start_tv, NULL);
 
 	/* clean up */
 	xfree(launch.resp_port);
@@ -553,7 +566,9 @@ int slurm_step_launch_wait_start(slurm_step_ctx_t *ctx)
 {
 	struct step_launch_state *sls = ctx->launch_state;
 	struct timespec ts;
+	struct timeval start_tv;
 
+	gettimeofday(&start_tv, NULL);
 	ts.tv_sec  = time(NULL);
 	ts.tv_nsec = 0;
 	ts.tv_sec += 600;	/* 10 min allowed for launch */
@@ -602,6 +617,10 @@ int slurm_step_launch_wait_start(slurm_step_ctx_t *ctx)
 	_cr_notify_step_launch(ctx);
 
 	slurm_mutex_unlock(&sls->lock);
+
+	step_trace_span(ctx->job_id, ctx->step_resp->job_step_id,
+			"srun_wait_start", &start_tv, NULL);
+	step_trace_dump(ctx->job_id, ctx->step_resp->job_step_id);
 	return SLURM_SUCCESS;
 }
 
@@ -1646,6 +1665,7 @@ static int _launch_tasks(slurm_step_ctx_t *ctx,
 	ret_data_info_t *ret_data = NULL;
 	int rc = SLURM_SUCCESS;
 	int tot_rc = SLURM_SUCCESS;
+	struct timeval start_tv;
 
 	debug("Entering _launch_tasks");
 	if (ctx->verbose_level) {
@@ -1672,7 +1692,11 @@ static int _launch_tasks(slurm_step_ctx_t *ctx,
 
 	if (ctx->step_resp->use_protocol_ver)
 		msg.protocol_version = ctx->step_resp->use_protocol_ver;
+	/* Carried in the message header, so every slurmd in the tree
+	 * forwards the launch request with the same width */
+	msg.forward.tree_width = _launch_tree_width();
 
+	gettimeofday(&start_tv, NULL);
 #ifdef HAVE_FRONT_END
 	slurm_cred_get_args(ctx->step_resp->cred, &cred_args);
 	//info("hostlist=%s", cred_args.step_hostlist);
@@ -1683,6 +1707,8 @@ static int _launch_tasks(slurm_step_ctx_t *ctx,
 	ret_list = slurm_send_recv_msgs(nodelist,
 					&msg, timeout, false);
 #endif
+	step_trace_span(ctx->job_id, ctx->step_resp->job_step_id,
+			"srun_launch_rpc", &start_tv, NULL);
 	if (ret_list == NULL) {
 		error("slurm_send_recv_msgs failed miserably: %m");
 		return SLURM_ERROR;
@@ -1723,6 +1749,35 @@ static int _launch_tasks(slurm_step_ctx_t *ctx,
 	return rc;
 }
 
+/*
+ * Return the fan-out used to send the launch request to the step's nodes,
+ * LaunchParameters=launch_tree_width=# if set, otherwise 0 (TreeWidth).
+ */
+static uint16_t _launch_tree_width(void)
+{
+	static int tree_width = -1;
+	char *launch_params, *tmp_ptr;
+	int i;
+
+	if (tree_width != -1)
+		return (uint16_t) tree_width;
+
+	tree_width = 0;
+	launch_params = slurm_get_launch_params();
+	if (launch_params &&
+	    (tmp_ptr = strstr(launch_params, "launch_tree_width="))) {
+		i = atoi(tmp_ptr + 18);
+		if ((i < 1) || (i >= NO_VAL16)) {
+			error("Invalid LaunchParameters launch_tree_width=%d",
+			      i);
+		} else
+			tree_width = i;
+	}
+	xfree(launch_params);
+
+	return (uint16_t) tree_width;
+}
+
 /* returns an xmalloc cwd string, or NULL if lookup failed. */
 static char *_lookup_cwd(void)
 {
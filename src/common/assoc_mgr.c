@@ -49,8 +49,10 @@
 #include "src/common/slurm_priority.h"
 #include "src/slurmdbd/read_config.h"
 
-#define ASSOC_HASH_SIZE 1000
+#define ASSOC_HASH_SIZE 10000
 #define ASSOC_HASH_ID_INX(_assoc_id)	(_assoc_id % ASSOC_HASH_SIZE)
+#define USER_HASH_SIZE 1000
+#define USER_HASH_UID_INX(_uid)	(_uid % USER_HASH_SIZE)
 
 slurmdb_assoc_rec_t *assoc_mgr_root_assoc = NULL;
 uint32_t g_qos_max_priority = 0;
@@ -73,33 +75,34 @@ static assoc_mgr_lock_flags_t assoc_mgr_locks;
 static assoc_init_args_t init_setup;
 static slurmdb_assoc_rec_t **assoc_hash_id = NULL;
 static slurmdb_assoc_rec_t **assoc_hash = NULL;
+static slurmdb_user_rec_t **user_hash_uid = NULL;
+static slurmdb_user_rec_t **user_hash = NULL;
+static slurmdb_qos_rec_t **qos_id_array = NULL;
+static uint32_t qos_id_array_size = 0;
 
 static pthread_mutex_t locks_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t locks_cond = PTHREAD_COND_INITIALIZER;
 
-static int _get_str_inx(char *name)
+/* Names are compared with xstrcasecmp() so hash them case insensitive */
+static uint32_t _get_str_inx(char *name)
 {
-	int j, index = 0;
+	uint32_t index = 0;
 
 	if (!name)
 		return 0;
 
-	for (j = 1; *name; name++, j++)
-		index += (int)tolower(*name) * j;
+	for (; *name; name++)
+		index = (index * 31) + (uint32_t)tolower((unsigned char)*name);
 
 	return index;
 }
 
 static int _assoc_hash_index(slurmdb_assoc_rec_t *assoc)
 {
-	int index;
+	uint32_t index;
 
 	xassert(assoc);
 
-	/* Multiply each character by its numerical position in the
-	 * name string to add a bit of entropy.
-	 */
-
 	index = assoc->uid;
 
 	/* only set on the slurmdbd */
@@ -112,12 +115,7 @@ static int _assoc_hash_index(slurmdb_assoc_rec_t *assoc)
 	if (assoc->partition)
 		index += _get_str_inx(assoc->partition);
 
-	index %= ASSOC_HASH_SIZE;
-	if (index < 0)
-		index += ASSOC_HASH_SIZE;
-
-	return index;
-
+	return index % ASSOC_HASH_SIZE;
 }
 
 static void _add_assoc_hash(slurmdb_assoc_rec_t *assoc)
@@ -309,6 +307,124 @@ static void _delete_assoc_hash(slurmdb_assoc_rec_t *assoc)
 		*assoc_pptr = assoc_ptr->assoc_next;
 }
 
+static void _add_user_hash(slurmdb_user_rec_t *user)
+{
+	slurmdb_user_rec_t **user_pptr;
+	int inx = _get_str_inx(user->name) % USER_HASH_SIZE;
+
+	if (!user_hash_uid)
+		user_hash_uid = xmalloc(USER_HASH_SIZE *
+					sizeof(slurmdb_user_rec_t *));
+	if (!user_hash)
+		user_hash = xmalloc(USER_HASH_SIZE *
+				    sizeof(slurmdb_user_rec_t *));
+
+	user->user_next = user_hash[inx];
+	user_hash[inx] = user;
+
+	/* Users without a uid can't be looked up by one */
+	user->user_next_uid = NULL;
+	if (user->uid == NO_VAL)
+		return;
+
+	/* Append so the first user in the list wins if more than one
+	 * user name maps to the same uid, the same as a list scan. */
+	user_pptr = &user_hash_uid[USER_HASH_UID_INX(user->uid)];
+	while (*user_pptr)
+		user_pptr = &(*user_pptr)->user_next_uid;
+	*user_pptr = user;
+}
+
+static void _delete_user_hash(slurmdb_user_rec_t *user)
+{
+	slurmdb_user_rec_t **user_pptr;
+
+	xassert(user);
+
+	if (!user_hash)
+		return;
+
+	user_pptr = &user_hash[_get_str_inx(user->name) % USER_HASH_SIZE];
+	while (*user_pptr && (*user_pptr != user))
+		user_pptr = &(*user_pptr)->user_next;
+
+	if (!*user_pptr) {
+		fatal("user hash error");
+		return;	/* Fix CLANG false positive error */
+	}
+	*user_pptr = user->user_next;
+	user->user_next = NULL;
+
+	if (user->uid == NO_VAL)
+		return;
+
+	user_pptr = &user_hash_uid[USER_HASH_UID_INX(user->uid)];
+	while (*user_pptr && (*user_pptr != user))
+		user_pptr = &(*user_pptr)->user_next_uid;
+
+	if (!*user_pptr) {
+		fatal("user uid hash error");
+		return;	/* Fix CLANG false positive error */
+	}
+	*user_pptr = user->user_next_uid;
+	user->user_next_uid = NULL;
+}
+
+/* locks should be put in place before calling this function USER_READ */
+static slurmdb_user_rec_t *_find_user_rec_uid(uint32_t uid)
+{
+	slurmdb_user_rec_t *user;
+
+	if (!user_hash_uid || (uid == NO_VAL))
+		return NULL;
+
+	user = user_hash_uid[USER_HASH_UID_INX(uid)];
+	while (user && (user->uid != uid))
+		user = user->user_next_uid;
+
+	return user;
+}
+
+/* locks should be put in place before calling this function USER_READ */
+static slurmdb_user_rec_t *_find_user_rec_name(char *name)
+{
+	slurmdb_user_rec_t *user;
+
+	if (!user_hash || !name)
+		return NULL;
+
+	user = user_hash[_get_str_inx(name) % USER_HASH_SIZE];
+	while (user && xstrcasecmp(user->name, name))
+		user = user->user_next;
+
+	return user;
+}
+
+/* locks should be put in place before calling this function QOS_WRITE */
+static void _add_qos_id_array(slurmdb_qos_rec_t *qos)
+{
+	if (qos->id >= qos_id_array_size) {
+		qos_id_array_size = qos->id + 1;
+		xrealloc(qos_id_array,
+			 qos_id_array_size * sizeof(slurmdb_qos_rec_t *));
+	}
+	qos_id_array[qos->id] = qos;
+}
+
+/* locks should be put in place before calling this function QOS_READ */
+static slurmdb_qos_rec_t *_find_qos_rec_id(uint32_t qos_id)
+{
+	if (qos_id >= qos_id_array_size)
+		return NULL;
+
+	return qos_id_array[qos_id];
+}
+
+static int _find_ptr(void *x, void *key)
+{
+	return (x == key);
+}
+
 
 static void _normalize_assoc_shares_fair_tree(
 	slurmdb_assoc_rec_t *assoc)
@@ -637,22 +753,15 @@ static void _set_user_default_acct(slurmdb_assoc_rec_t *assoc)
 
 	/* set up the default if this is it */
 	if ((assoc->is_def == 1) && (assoc->uid != NO_VAL)) {
-		slurmdb_user_rec_t *user = NULL;
-		ListIterator user_itr =
-			list_iterator_create(assoc_mgr_user_list);
-		while ((user = list_next(user_itr))) {
-			if (user->uid != assoc->uid)
-				continue;
-			if (!user->default_acct
-			    || xstrcmp(user->default_acct, assoc->acct)) {
-				xfree(user->default_acct);
-				user->default_acct = xstrdup(assoc->acct);
-				debug2("user %s default acct is %s",
-				       user->name, user->default_acct);
-			}
-			break;
+		slurmdb_user_rec_t *user = _find_user_rec_uid(assoc->uid);
+
+		if (user && (!user->default_acct
+			     || xstrcmp(user->default_acct, assoc->acct))) {
+			xfree(user->default_acct);
+			user->default_acct = xstrdup(assoc->acct);
+			debug2("user %s default acct is %s",
+			       user->name, user->default_acct);
 		}
-		list_iterator_destroy(user_itr);
 	}
 }
 
@@ -665,22 +774,15 @@ static void _set_user_default_wckey(slurmdb_wckey_rec_t *wckey)
 
 	/* set up the default if this is it */
 	if ((wckey->is_def == 1) && (wckey->uid != NO_VAL)) {
-		slurmdb_user_rec_t *user = NULL;
-		ListIterator user_itr =
-			list_iterator_create(assoc_mgr_user_list);
-		while ((user = list_next(user_itr))) {
-			if (user->uid != wckey->uid)
-				continue;
-			if (!user->default_wckey
-			    || xstrcmp(user->default_wckey, wckey->name)) {
-				xfree(user->default_wckey);
-				user->default_wckey = xstrdup(wckey->name);
-				debug2("user %s default wckey is %s",
-				       user->name, user->default_wckey);
-			}
-			break;
+		slurmdb_user_rec_t *user = _find_user_rec_uid(wckey->uid);
+
+		if (user && (!user->default_wckey
+			     || xstrcmp(user->default_wckey, wckey->name))) {
+			xfree(user->default_wckey);
+			user->default_wckey = xstrdup(wckey->name);
+			debug2("user %s default wckey is %s",
+			       user->name, user->default_wckey);
 		}
-		list_iterator_destroy(user_itr);
 	}
 }
 
@@ -807,7 +909,15 @@ static int _set_assoc_parent_and_user(slurmdb_assoc_rec_t *assoc,
 		g_user_assoc_count++;
 		if (assoc->uid == NO_VAL || assoc->uid == INFINITE ||
 				assoc->uid == 0) {
-			if (uid_from_string(assoc->user, &pw_uid) < 0)
+			/* Take the uid the user list got for the name,
+			 * even NO_VAL, rather than looking up names it
+			 * could not resolve again for each assoc.
+			 * assoc_mgr_set_missing_uids() retries those. */
+			slurmdb_user_rec_t *user =
+				_find_user_rec_name(assoc->user);
+			if (user && !xstrcmp(user->name, assoc->user))
+				assoc->uid = user->uid;
+			else if (uid_from_string(assoc->user, &pw_uid) < 0)
 				assoc->uid = NO_VAL;
 			else
 				assoc->uid = pw_uid;
@@ -981,6 +1091,25 @@ static int _post_user_list(List user_list)
 	return SLURM_SUCCESS;
 }
 
+/* rebuild the user hashes after assoc_mgr_user_list was replaced */
+/* locks should be put in place before calling this function USER_WRITE */
+static void _set_user_hash(void)
+{
+	slurmdb_user_rec_t *user = NULL;
+	ListIterator itr;
+
+	xfree(user_hash_uid);
+	xfree(user_hash);
+
+	if (!assoc_mgr_user_list)
+		return;
+
+	itr = list_iterator_create(assoc_mgr_user_list);
+	while ((user = list_next(itr)))
+		_add_user_hash(user);
+	list_iterator_destroy(itr);
+}
+
 static int _post_wckey_list(List wckey_list)
 {
 	slurmdb_wckey_rec_t *wckey = NULL;
@@ -1035,10 +1164,12 @@ static int _post_qos_list(List qos_list)
 	if (g_qos_count > 0)
 		g_qos_count++;
 
-	if (g_qos_max_priority) {
-		list_iterator_reset(itr);
-
-		while ((qos = list_next(itr)))
+	xfree(qos_id_array);
+	qos_id_array_size = 0;
+	list_iterator_reset(itr);
+	while ((qos = list_next(itr))) {
+		_add_qos_id_array(qos);
+		if (g_qos_max_priority)
 			_set_qos_norm_priority(qos);
 	}
 	list_iterator_destroy(itr);
@@ -1547,6 +1678,7 @@ static int _get_assoc_mgr_user_list(void *db_conn, int enforce)
 	}
 
 	_post_user_list(assoc_mgr_user_list);
+	_set_user_hash();
 
 	assoc_mgr_unlock(&locks);
 	return SLURM_SUCCESS;
@@ -1758,7 +1890,6 @@ static int _refresh_assoc_mgr_qos_list(void *db_conn, int enforce)
 		      "no new list given back keeping cached one.");
 		return SLURM_ERROR;
 	}
-	_post_qos_list(current_qos);
 
 	assoc_mgr_lock(&locks);
 
@@ -1766,6 +1897,8 @@ static int _refresh_assoc_mgr_qos_list(void *db_conn, int enforce)
 
 	assoc_mgr_qos_list = current_qos;
 
+	_post_qos_list(assoc_mgr_qos_list);
+
 	assoc_mgr_unlock(&locks);
 
 	return SLURM_SUCCESS;
@@ -1800,6 +1933,8 @@ static int _refresh_assoc_mgr_user_list(void *db_conn, int enforce)
 
 	assoc_mgr_user_list = current_users;
 
+	_set_user_hash();
+
 	assoc_mgr_unlock(&locks);
 
 	return SLURM_SUCCESS;
@@ -2036,6 +2171,10 @@ extern int assoc_mgr_fini(char *state_save_location)
 
 	xfree(assoc_hash_id);
 	xfree(assoc_hash);
+	xfree(user_hash_uid);
+	xfree(user_hash);
+	xfree(qos_id_array);
+	qos_id_array_size = 0;
 
 	assoc_mgr_unlock(&locks);
 
@@ -2484,7 +2623,6 @@ extern int assoc_mgr_fill_in_user(void *db_conn, slurmdb_user_rec_t *user,
 				  int enforce,
 				  slurmdb_user_rec_t **user_pptr)
 {
-	ListIterator itr = NULL;
 	slurmdb_user_rec_t * found_user = NULL;
 	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
 				   NO_LOCK, READ_LOCK, NO_LOCK };
@@ -2502,16 +2640,10 @@ extern int assoc_mgr_fill_in_user(void *db_conn, slurmdb_user_rec_t *user,
 		return SLURM_SUCCESS;
 	}
 
-	itr = list_iterator_create(assoc_mgr_user_list);
-	while ((found_user = list_next(itr))) {
-		if (user->uid != NO_VAL) {
-			if (user->uid == found_user->uid)
-				break;
-		} else if (user->name
-			   && !xstrcasecmp(user->name, found_user->name))
-			break;
-	}
-	list_iterator_destroy(itr);
+	if (user->uid != NO_VAL)
+		found_user = _find_user_rec_uid(user->uid);
+	else
+		found_user = _find_user_rec_name(user->name);
 
 	if (!found_user) {
 		assoc_mgr_unlock(&locks);
@@ -2588,14 +2720,14 @@ extern int assoc_mgr_fill_in_qos(void *db_conn, slurmdb_qos_rec_t *qos,
 		return SLURM_SUCCESS;
 	}
 
-	itr = list_iterator_create(assoc_mgr_qos_list);
-	while ((found_qos = list_next(itr))) {
-		if (qos->id == found_qos->id)
-			break;
-		else if (qos->name && !xstrcasecmp(qos->name, found_qos->name))
-			break;
+	if (!(found_qos = _find_qos_rec_id(qos->id)) && qos->name) {
+		itr = list_iterator_create(assoc_mgr_qos_list);
+		while ((found_qos = list_next(itr))) {
+			if (!xstrcasecmp(qos->name, found_qos->name))
+				break;
+		}
+		list_iterator_destroy(itr);
 	}
-	list_iterator_destroy(itr);
 
 	if (!found_qos) {
 		if (!locked)
@@ -2861,7 +2993,6 @@ extern int assoc_mgr_fill_in_wckey(void *db_conn, slurmdb_wckey_rec_t *wckey,
 extern slurmdb_admin_level_t assoc_mgr_get_admin_level(void *db_conn,
 						       uint32_t uid)
 {
-	ListIterator itr = NULL;
 	slurmdb_user_rec_t * found_user = NULL;
 	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
 				   NO_LOCK, READ_LOCK, NO_LOCK };
@@ -2876,12 +3007,7 @@ extern slurmdb_admin_level_t assoc_mgr_get_admin_level(void *db_conn,
 		return SLURMDB_ADMIN_NOTSET;
 	}
 
-	itr = list_iterator_create(assoc_mgr_user_list);
-	while ((found_user = list_next(itr))) {
-		if (uid == found_user->uid)
-			break;
-	}
-	list_iterator_destroy(itr);
+	found_user = _find_user_rec_uid(uid);
 	assoc_mgr_unlock(&locks);
 
 	if (found_user)
@@ -2913,12 +3039,7 @@ extern bool assoc_mgr_is_user_acct_coord(void *db_conn,
 		return false;
 	}
 
-	itr = list_iterator_create(assoc_mgr_user_list);
-	while ((found_user = list_next(itr))) {
-		if (uid == found_user->uid)
-			break;
-	}
-	list_iterator_destroy(itr);
+	found_user = _find_user_rec_uid(uid);
 
 	if (!found_user || !found_user->coord_accts) {
 		assoc_mgr_unlock(&locks);
@@ -4105,16 +4226,10 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 
 	itr = list_iterator_create(assoc_mgr_user_list);
 	while ((object = list_pop(update->objects))) {
-		list_iterator_reset(itr);
-		while ((rec = list_next(itr))) {
-			char *name;
-			if (object->old_name)
-				name = object->old_name;
-			else
-				name = object->name;
-			if (!xstrcasecmp(name, rec->name))
-				break;
-		}
+		if (object->old_name)
+			rec = _find_user_rec_name(object->old_name);
+		else
+			rec = _find_user_rec_name(object->name);
 
 		//info("%d user %s", update->type, object->name);
 		switch(update->type) {
@@ -4131,11 +4246,15 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 					      rec->name);
 					break;
 				}
+				/* Both the name and the uid change so
+				   take it out of the hash first. */
+				_delete_user_hash(rec);
 				xfree(rec->old_name);
 				rec->old_name = rec->name;
 				rec->name = object->name;
 				object->name = NULL;
 				rc = _change_user_name(rec);
+				_add_user_hash(rec);
 			}
 
 			if (object->default_acct) {
@@ -4166,6 +4285,7 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 			} else
 				object->uid = pw_uid;
 			list_append(assoc_mgr_user_list, object);
+			_add_user_hash(object);
 			object = NULL;
 			break;
 		case SLURMDB_REMOVE_USER:
@@ -4173,7 +4293,10 @@ extern int assoc_mgr_update_users(slurmdb_update_object_t *update, bool locked)
 				//rc = SLURM_ERROR;
 				break;
 			}
-			list_delete_item(itr);
+			_delete_user_hash(rec);
+			list_iterator_reset(itr);
+			if (list_find(itr, _find_ptr, rec))
+				list_delete_item(itr);
 			break;
 		case SLURMDB_ADD_COORD:
 			/* same as SLURMDB_REMOVE_COORD */
@@ -4232,12 +4355,7 @@ extern int assoc_mgr_update_qos(slurmdb_update_object_t *update, bool locked)
 	itr = list_iterator_create(assoc_mgr_qos_list);
 	while ((object = list_pop(update->objects))) {
 		bool update_jobs = false;
-		list_iterator_reset(itr);
-		while ((rec = list_next(itr))) {
-			if (object->id == rec->id) {
-				break;
-			}
-		}
+		rec = _find_qos_rec_id(object->id);
 
 		//info("%d qos %s", update->type, object->name);
 		switch(update->type) {
@@ -4254,6 +4372,7 @@ extern int assoc_mgr_update_qos(slurmdb_update_object_t *update, bool locked)
 			assoc_mgr_set_qos_tres_cnt(object);
 
 			list_append(assoc_mgr_qos_list, object);
+			_add_qos_id_array(object);
 /* 			char *tmp = get_qos_complete_str_bitstr( */
 /* 				assoc_mgr_qos_list, */
 /* 				object->preempt_bitstr); */
@@ -4522,6 +4641,9 @@ extern int assoc_mgr_update_qos(slurmdb_update_object_t *update, bool locked)
 			if (rec->priority == g_qos_max_priority)
 				redo_priority = 2;
 
+			qos_id_array[rec->id] = NULL;
+			list_iterator_reset(itr);
+			list_find(itr, _find_ptr, rec);
 			if (init_setup.remove_qos_notify) {
 				/* since there are some deadlock
 				   issues while inside our lock here
@@ -5345,11 +5467,9 @@ extern int dump_assoc_mgr_state(char *state_save_location)
 
 extern int load_assoc_usage(char *state_save_location)
 {
-	int data_allocated, data_read = 0, i;
-	uint32_t data_size = 0;
+	int i;
 	uint16_t ver = 0;
-	int state_fd;
-	char *data = NULL, *state_file, *tmp_str = NULL;
+	char *state_file, *tmp_str = NULL;
 	Buf buffer = NULL;
 	time_t buf_time;
 	assoc_mgr_lock_t locks = { WRITE_LOCK, READ_LOCK, NO_LOCK, NO_LOCK,
@@ -5363,36 +5483,14 @@ extern int load_assoc_usage(char *state_save_location)
 	xstrcat(state_file, "/assoc_usage");	/* Always ignore .old file */
 	//info("looking at the %s file", state_file);
 	assoc_mgr_lock(&locks);
-	state_fd = open(state_file, O_RDONLY);
-	if (state_fd < 0) {
+	buffer = create_mmap_buf(state_file);
+	if (!buffer) {
 		debug2("No Assoc usage file (%s) to recover", state_file);
+		xfree(state_file);
 		goto unpack_error;
-	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					 BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-					      state_file);
-					break;
-				}
-			} else if (data_read == 0)	/* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
-		close(state_fd);
 	}
 	xfree(state_file);
 
-	buffer = create_buf(data, data_size);
-
 	safe_unpack16(&ver, buffer);
 	debug3("Version in assoc_usage header is %u", ver);
 	if (ver > SLURM_PROTOCOL_VERSION || ver < SLURM_MIN_PROTOCOL_VERSION) {
@@ -5462,11 +5560,8 @@ unpack_error:
 
 extern int load_qos_usage(char *state_save_location)
 {
-	int data_allocated, data_read = 0;
-	uint32_t data_size = 0;
 	uint16_t ver = 0;
-	int state_fd;
-	char *data = NULL, *state_file, *tmp_str = NULL;
+	char *state_file, *tmp_str = NULL;
 	Buf buffer = NULL;
 	time_t buf_time;
 	ListIterator itr = NULL;
@@ -5481,36 +5576,14 @@ extern int load_qos_usage(char *state_save_location)
 	xstrcat(state_file, "/qos_usage");	/* Always ignore .old file */
 	//info("looking at the %s file", state_file);
 	assoc_mgr_lock(&locks);
-	state_fd = open(state_file, O_RDONLY);
-	if (state_fd < 0) {
+	buffer = create_mmap_buf(state_file);
+	if (!buffer) {
 		debug2("No Qos usage file (%s) to recover", state_file);
+		xfree(state_file);
 		goto unpack_error;
-	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					 BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-					      state_file);
-					break;
-				}
-			} else if (data_read == 0)	/* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
-		close(state_fd);
 	}
 	xfree(state_file);
 
-	buffer = create_buf(data, data_size);
-
 	safe_unpack16(&ver, buffer);
 	debug3("Version in qos_usage header is %u", ver);
 	if (ver > SLURM_PROTOCOL_VERSION || ver < SLURM_MIN_PROTOCOL_VERSION) {
@@ -5570,54 +5643,32 @@ unpack_error:
 
 extern int load_assoc_mgr_state(char *state_save_location)
 {
-	int data_allocated, data_read = 0, error_code = SLURM_SUCCESS;
-	uint32_t data_size = 0;
+	int error_code = SLURM_SUCCESS;
 	uint16_t type = 0;
 	uint16_t ver = 0;
-	int state_fd;
-	char *data = NULL, *state_file;
+	char *state_file;
 	Buf buffer = NULL;
 	time_t buf_time;
 	dbd_list_msg_t *msg = NULL;
 	assoc_mgr_lock_t locks = { WRITE_LOCK, READ_LOCK,
 				   WRITE_LOCK, WRITE_LOCK, WRITE_LOCK,
 				   WRITE_LOCK, WRITE_LOCK };
+	DEF_TIMERS;
 
+	START_TIMER;
 	/* read the file */
 	state_file = xstrdup(state_save_location);
 	xstrcat(state_file, "/assoc_mgr_state"); /* Always ignore .old file */
 	//info("looking at the %s file", state_file);
 	assoc_mgr_lock(&locks);
-	state_fd = open(state_file, O_RDONLY);
-	if (state_fd < 0) {
+	buffer = create_mmap_buf(state_file);
+	if (!buffer) {
 		debug2("No association state file (%s) to recover", state_file);
+		xfree(state_file);
 		goto unpack_error;
-	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					 BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-					      state_file);
-					break;
-				}
-			} else if (data_read == 0)	/* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
-		close(state_fd);
 	}
 	xfree(state_file);
 
-	buffer = create_buf(data, data_size);
-
 	safe_unpack16(&ver, buffer);
 	debug3("Version in assoc_mgr_state header is %u", ver);
 	if (ver > SLURM_PROTOCOL_VERSION || ver < SLURM_MIN_PROTOCOL_VERSION) {
@@ -5687,6 +5738,7 @@ extern int load_assoc_mgr_state(char *state_save_location)
 			FREE_NULL_LIST(assoc_mgr_user_list);
 			assoc_mgr_user_list = msg->my_list;
 			_post_user_list(assoc_mgr_user_list);
+			_set_user_hash();
 			debug("Recovered %u users",
 			      list_count(assoc_mgr_user_list));
 			msg->my_list = NULL;
@@ -5756,6 +5808,8 @@ extern int load_assoc_mgr_state(char *state_save_location)
 	running_cache = 1;
 	free_buf(buffer);
 	assoc_mgr_unlock(&locks);
+	END_TIMER2("load_assoc_mgr_state");
+	debug("%s: recovered state in %s", __func__, TIME_STR);
 	return SLURM_SUCCESS;
 
 unpack_error:
@@ -5876,8 +5930,13 @@ extern int assoc_mgr_set_missing_uids()
 					debug3("refresh user couldn't get "
 					       "a uid for user %s",
 					       object->name);
-				} else
+				} else {
+					/* Users without a uid aren't
+					   in the uid hash yet. */
+					_delete_user_hash(object);
 					object->uid = pw_uid;
+					_add_user_hash(object);
+				}
 			}
 		}
 		list_iterator_destroy(itr);
@@ -150,4 +150,12 @@ extern int wait_fd_readable(int fd, int time_limit);
 /* Wait for a file descriptor to be readable (up to time_limit seconds).
  * Return 0 when readable or -1 on error */
 
+extern void send_fd_over_pipe(int socket, int fd);
+/* Pass an open file descriptor (fd) to another process over a unix domain
+ * socket (socket) */
+
+extern int receive_fd_over_pipe(int socket);
+/* Receive a file descriptor sent with send_fd_over_pipe over a unix domain
+ * socket (socket). Return the file descriptor or -1 on error */
+
 #endif /* !_FD_H */
@@ -376,6 +376,8 @@ void *_fwd_tree_thread(void *arg)
 		}
 
 		send_msg.forward.timeout = fwd_tree->timeout;
+		send_msg.forward.tree_width =
+			fwd_tree->orig_msg->forward.tree_width;
 		if ((send_msg.forward.cnt = hostlist_count(fwd_tree->tree_hl))){
 			buf = hostlist_ranged_string_xmalloc(
 					fwd_tree->tree_hl);
@@ -592,6 +594,7 @@ static void _forward_msg_internal(hostlist_t hl, hostlist_t* sp_hl,
 
 		forward_init(&fwd_msg->header.forward, NULL);
 		fwd_msg->header.forward.nodelist = buf;
+		fwd_msg->header.forward.tree_width = header->forward.tree_width;
 		while (pthread_create(&thread_agent, &attr_agent,
 				     _forward_thread,
 				     (void *)fwd_msg)) {
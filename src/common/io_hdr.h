@@ -54,6 +54,14 @@
 #define SLURM_IO_STDERR 2
 #define SLURM_IO_ALLSTDIN 3
 #define SLURM_IO_CONNECTION_TEST 4
+/* Sent upstream by a slurmstepd forwarding the I/O of another slurmstepd
+ * (LAUNCH_IO_TREE), the body is the packed slurm_io_init_msg that the other
+ * slurmstepd sent it. */
+#define SLURM_IO_FORWARD_INIT 5
+/* Sent downstream by srun to a slurmstepd forwarding the I/O of other
+ * slurmstepds when the node of one of them is down, the body is its packed
+ * node rank. */
+#define SLURM_IO_FORWARD_DOWN 6
 
 struct slurm_io_init_msg {
 	uint16_t      version;
@@ -86,4 +94,11 @@ int io_init_msg_validate(struct slurm_io_init_msg *msg, const char *sig);
 int io_init_msg_write_to_fd(int fd, struct slurm_io_init_msg *msg);
 int io_init_msg_read_from_fd(int fd, struct slurm_io_init_msg *msg);
 
+/*
+ * Pack or unpack an io init msg, used for the body of SLURM_IO_FORWARD_INIT
+ */
+int io_init_msg_packed_size(void);
+void io_init_msg_pack(struct slurm_io_init_msg *hdr, Buf buffer);
+int io_init_msg_unpack(struct slurm_io_init_msg *hdr, Buf buffer);
+
 #endif /* !_HAVE_IO_HDR_H */
@@ -42,9 +42,13 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <netinet/in.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "slurm/slurm_errno.h"
 #include "slurm/slurm.h"
@@ -59,6 +63,7 @@
  * for details.
  */
 strong_alias(create_buf,	slurm_create_buf);
+strong_alias(create_mmap_buf,	slurm_create_mmap_buf);
 strong_alias(free_buf,		slurm_free_buf);
 strong_alias(grow_buf,		slurm_grow_buf);
 strong_alias(init_buf,		slurm_init_buf);
@@ -109,6 +114,63 @@ Buf create_buf(char *data, uint32_t size)
 	my_buf->size = size;
 	my_buf->processed = 0;
 	my_buf->head = data;
+	my_buf->mmaped = false;
+
+	return my_buf;
+}
+
+/*
+ * create_mmap_buf - create a buffer over the contents of a file mapped read
+ *	only, so a large file can be unpacked without reading it into memory.
+ *	Nothing may be packed into the buffer.
+ * IN file - path of the file
+ * RET buffer or NULL on failure, errno is set
+ */
+Buf create_mmap_buf(const char *file)
+{
+	Buf my_buf;
+	int fd;
+	struct stat f_stat;
+	void *data;
+
+	if ((fd = open(file, O_RDONLY | O_CLOEXEC)) < 0) {
+		debug("%s: Failed to open file `%s`, %m", __func__, file);
+		return NULL;
+	}
+
+	if (fstat(fd, &f_stat)) {
+		debug("%s: Failed to fstat file `%s`, %m", __func__, file);
+		close(fd);
+		return NULL;
+	}
+
+	if (f_stat.st_size > MAX_BUF_SIZE) {
+		error("%s: Buffer size limit exceeded (%"PRIu64" > %u)",
+		      __func__, (uint64_t) f_stat.st_size, MAX_BUF_SIZE);
+		close(fd);
+		errno = EFBIG;
+		return NULL;
+	}
+
+	if (!f_stat.st_size) {
+		/* mmap() refuses an empty mapping */
+		close(fd);
+		return create_buf(xmalloc(1), 0);
+	}
+
+	data = mmap(NULL, f_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		debug("%s: Failed to mmap file `%s`, %m", __func__, file);
+		return NULL;
+	}
+
+	my_buf = xmalloc_nz(sizeof(struct slurm_buf));
+	my_buf->magic = BUF_MAGIC;
+	my_buf->size = f_stat.st_size;
+	my_buf->processed = 0;
+	my_buf->head = data;
+	my_buf->mmaped = true;
 
 	return my_buf;
 }
@@ -119,7 +181,10 @@ void free_buf(Buf my_buf)
 	if (!my_buf)
 		return;
 	assert(my_buf->magic == BUF_MAGIC);
-	xfree(my_buf->head);
+	if (my_buf->mmaped)
+		munmap(my_buf->head, my_buf->size);
+	else
+		xfree(my_buf->head);
 	xfree(my_buf);
 }
 
@@ -153,6 +218,7 @@ Buf init_buf(uint32_t size)
 	my_buf->size = size;
 	my_buf->processed = 0;
 	my_buf->head = xmalloc(sizeof(char)*size);
+	my_buf->mmaped = false;
 	return my_buf;
 }
 
@@ -198,6 +198,10 @@ typedef struct slurm_acct_storage_ops {
 				    struct job_record *job_ptr);
 	List (*get_jobs_cond)      (void *db_conn, uint32_t uid,
 				    slurmdb_job_cond_t *job_cond);
+	int (*get_jobs_cond_stream)(void *db_conn, uint32_t uid,
+				    slurmdb_job_cond_t *job_cond,
+				    int (*callback)(List job_list, void *arg),
+				    void *arg);
 	int (*archive_dump)        (void *db_conn,
 				    slurmdb_archive_cond_t *arch_cond);
 	int (*archive_load)        (void *db_conn,
@@ -280,6 +284,7 @@ static const char *syms[] = {
 	"jobacct_storage_p_step_complete",
 	"jobacct_storage_p_suspend",
 	"jobacct_storage_p_get_jobs_cond",
+	"jobacct_storage_p_get_jobs_cond_stream",
 	"jobacct_storage_p_archive",
 	"jobacct_storage_p_archive_load",
 	"acct_storage_p_update_shares_used",
@@ -1001,6 +1006,21 @@ extern List jobacct_storage_g_get_jobs_cond(void *db_conn, uint32_t uid,
 	return (*(ops.get_jobs_cond))(db_conn, uid, job_cond);
 }
 
+/*
+ * get info from the storage a chunk of jobs at a time
+ * callback is called with each List of job_rec_t *, which is freed when
+ * it returns, and stops the query by returning an error
+ */
+extern int jobacct_storage_g_get_jobs_cond_stream(
+	void *db_conn, uint32_t uid, slurmdb_job_cond_t *job_cond,
+	int (*callback)(List job_list, void *arg), void *arg)
+{
+	if (slurm_acct_storage_init(NULL) < 0)
+		return SLURM_ERROR;
+	return (*(ops.get_jobs_cond_stream))(db_conn, uid, job_cond,
+					     callback, arg);
+}
+
 /*
  * expire old info from the storage
  */
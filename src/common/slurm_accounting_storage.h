@@ -630,6 +630,16 @@ extern int jobacct_storage_g_job_suspend(void *db_conn,
 extern List jobacct_storage_g_get_jobs_cond(void *db_conn, uint32_t uid,
 					    slurmdb_job_cond_t *job_cond);
 
+/*
+ * get info from the storage a chunk of jobs at a time
+ * callback is called with each List of jobacct_job_rec_t *, which is freed
+ * when it returns, and stops the query by returning an error
+ * RET SLURM_SUCCESS or error code
+ */
+extern int jobacct_storage_g_get_jobs_cond_stream(
+	void *db_conn, uint32_t uid, slurmdb_job_cond_t *job_cond,
+	int (*callback)(List job_list, void *arg), void *arg);
+
 /*
  * expire old info from the storage
  */
@@ -748,10 +748,11 @@ extern int slurm_persist_conn_writeable(slurm_persist_conn_t *persist_conn)
 		 * If not then exit out and notify the conn.  This
 		 * is here since a write doesn't always tell you the
 		 * socket is gone, but getting 0 back from a
-		 * nonblocking read means just that.
+		 * nonblocking read means just that. Peek so a
+		 * response already waiting is left to be read.
 		 */
 		if (ufds.revents & POLLHUP ||
-		    (recv(persist_conn->fd, &temp, 1, 0) == 0)) {
+		    (recv(persist_conn->fd, &temp, 1, MSG_PEEK) == 0)) {
 			debug2("persistant connection is closed");
 			if (persist_conn->trigger_callbacks.dbd_fail)
 				(persist_conn->trigger_callbacks.dbd_fail)();
@@ -2346,6 +2346,31 @@ char *slurm_get_launch_params(void)
 	return launch_params;
 }
 
+/* slurm_get_io_tree_width
+ * get the fan-out of the tree through which the slurmstepds forward step I/O
+ * to srun, LaunchParameters=io_tree_width=#
+ * RET uint16_t - io_tree_width, 0 if each slurmstepd connects to srun
+ */
+uint16_t slurm_get_io_tree_width(void)
+{
+	char *launch_params, *tmp_ptr;
+	uint16_t io_tree_width = 0;
+	int i;
+
+	launch_params = slurm_get_launch_params();
+	if (launch_params &&
+	    (tmp_ptr = strstr(launch_params, "io_tree_width="))) {
+		i = atoi(tmp_ptr + 14);
+		if ((i < 2) || (i >= NO_VAL16))
+			error("Invalid LaunchParameters io_tree_width=%d", i);
+		else
+			io_tree_width = i;
+	}
+	xfree(launch_params);
+
+	return io_tree_width;
+}
+
 /* slurm_get_launch_type
  * get launch_type from slurmctld_conf object
  * RET char *   - launch_type, MUST be xfreed by caller
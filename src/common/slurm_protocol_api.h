@@ -625,6 +625,13 @@ int slurm_set_accounting_storage_port(uint32_t storage_port);
  */
 char *slurm_get_launch_params(void);
 
+/* slurm_get_io_tree_width
+ * get the fan-out of the tree through which the slurmstepds forward step I/O
+ * to srun, LaunchParameters=io_tree_width=#
+ * RET uint16_t - io_tree_width, 0 if each slurmstepd connects to srun
+ */
+uint16_t slurm_get_io_tree_width(void);
+
 /* slurm_get_launch_type
  * get launch_type from slurmctld_conf object
  * RET char *   - launch_type, MUST be xfreed by caller
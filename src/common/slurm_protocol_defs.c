@@ -4015,6 +4015,7 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case REQUEST_JOB_STEP_STAT:
 	case REQUEST_JOB_STEP_PIDS:
 	case REQUEST_STEP_LAYOUT:
+	case REQUEST_STEP_IO_FORWARD:
 		slurm_free_job_step_id_msg(data);
 		break;
 	case RESPONSE_JOB_STEP_STAT:
@@ -4658,6 +4659,8 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_COMPLETE_PROLOG";
 	case RESPONSE_PROLOG_EXECUTING:				/* 6019 */
 		return "RESPONSE_PROLOG_EXECUTING";
+	case REQUEST_STEP_IO_FORWARD:				/* 6020 */
+		return "REQUEST_STEP_IO_FORWARD";
 
 	case SRUN_PING:						/* 7001 */
 		return "SRUN_PING";
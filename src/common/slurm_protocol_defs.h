@@ -364,6 +364,7 @@ typedef enum {
 	REQUEST_LAUNCH_PROLOG,
 	REQUEST_COMPLETE_PROLOG,
 	RESPONSE_PROLOG_EXECUTING,	/* 6019 */
+	REQUEST_STEP_IO_FORWARD,	/* 6020 */
 
 	REQUEST_PERSIST_INIT = 6500,
 
@@ -784,6 +785,7 @@ typedef struct job_step_create_response_msg {
 #define LAUNCH_BUFFERED_IO	0x00000008
 #define LAUNCH_LABEL_IO		0x00000010
 #define LAUNCH_USER_MANAGED_IO	0x00000020
+#define LAUNCH_IO_TREE		0x00000040
 
 typedef struct launch_tasks_request_msg {
 	uint32_t  job_id;
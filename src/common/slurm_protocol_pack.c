@@ -1141,6 +1141,7 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 	case REQUEST_STEP_LAYOUT:
 	case REQUEST_JOB_STEP_STAT:
 	case REQUEST_JOB_STEP_PIDS:
+	case REQUEST_STEP_IO_FORWARD:
 		_pack_job_step_id_msg((job_step_id_msg_t *)msg->data, buffer,
 				      msg->protocol_version);
 		break;
@@ -1831,6 +1832,7 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 	case REQUEST_STEP_LAYOUT:
 	case REQUEST_JOB_STEP_STAT:
 	case REQUEST_JOB_STEP_PIDS:
+	case REQUEST_STEP_IO_FORWARD:
 		_unpack_job_step_id_msg((job_step_id_msg_t **)&msg->data,
 					buffer,
 					msg->protocol_version);
@@ -12928,6 +12930,18 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 		safe_unpack32_array(&msg->rpc_user_id,   &uint32_tmp, buffer);
 		safe_unpack32_array(&msg->rpc_user_cnt,  &uint32_tmp, buffer);
 		safe_unpack64_array(&msg->rpc_user_time, &uint32_tmp, buffer);
+
+		if (msg->parts_packed) {
+			safe_unpack32(&msg->dbd_agent_queue_size, buffer);
+			safe_unpack32(&msg->dbd_agent_overflow_size, buffer);
+			safe_unpack32(&msg->dbd_agent_inflight_batches, buffer);
+			safe_unpack32(&msg->dbd_agent_inflight_recs, buffer);
+			safe_unpack32(&msg->dbd_agent_batch_size, buffer);
+			safe_unpack32(&msg->dbd_agent_rtt_last,	buffer);
+			safe_unpack32(&msg->dbd_agent_rtt_max,	buffer);
+			safe_unpack64(&msg->dbd_agent_rtt_sum,	buffer);
+			safe_unpack32(&msg->dbd_agent_rtt_cnt,	buffer);
+		}
 	} else {
 		error("_unpack_stats_response_msg: protocol_version "
 		      "%hu not supported", protocol_version);
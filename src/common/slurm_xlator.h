@@ -224,6 +224,7 @@
 
 /* pack.[ch] functions */
 #define	create_buf		slurm_create_buf
+#define	create_mmap_buf		slurm_create_mmap_buf
 #define	free_buf		slurm_free_buf
 #define grow_buf		slurm_grow_buf
 #define	init_buf		slurm_init_buf
@@ -141,6 +141,170 @@ unpack_error:
        	return SLURM_ERROR;
 }
 
+/* Steps are sent with their job, so only the groups of fields in the
+ * job's query are packed.  Anything but JOBCOND_FIELD_ALL is only used
+ * with SLURM_17_11_PROTOCOL_VERSION and later. */
+static void _pack_step_rec(slurmdb_step_rec_t *step, uint32_t fields,
+			   uint16_t protocol_version, Buf buffer)
+{
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		pack32(step->elapsed, buffer);
+		pack_time(step->end, buffer);
+		pack32((uint32_t)step->exitcode, buffer);
+		pack32(step->nnodes, buffer);
+		if (fields & JOBCOND_FIELD_NODES)
+			packstr(step->nodes, buffer);
+		pack32(step->ntasks, buffer);
+		pack32(step->packjobid, buffer);
+		pack32(step->packstepid, buffer);
+		pack32(step->req_cpufreq_min, buffer);
+		pack32(step->req_cpufreq_max, buffer);
+		pack32(step->req_cpufreq_gov, buffer);
+		pack32(step->requid, buffer);
+		if (fields & JOBCOND_FIELD_STATS)
+			_pack_slurmdb_stats(&step->stats, protocol_version,
+					    buffer);
+		pack_time(step->start, buffer);
+		pack16(step->state, buffer);
+		pack32(step->stepid, buffer);   /* job's step number */
+		if (fields & JOBCOND_FIELD_NAME)
+			packstr(step->stepname, buffer);
+		pack32(step->suspended, buffer);
+		pack32(step->sys_cpu_sec, buffer);
+		pack32(step->sys_cpu_usec, buffer);
+		pack32(step->task_dist, buffer);
+		pack32(step->tot_cpu_sec, buffer);
+		pack32(step->tot_cpu_usec, buffer);
+		if (fields & JOBCOND_FIELD_TRES)
+			packstr(step->tres_alloc_str, buffer);
+		pack32(step->user_cpu_sec, buffer);
+		pack32(step->user_cpu_usec, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		pack32(step->elapsed, buffer);
+		pack_time(step->end, buffer);
+		pack32((uint32_t)step->exitcode, buffer);
+		pack32(step->nnodes, buffer);
+		packstr(step->nodes, buffer);
+		pack32(step->ntasks, buffer);
+		pack32(step->req_cpufreq_min, buffer);
+		pack32(step->req_cpufreq_max, buffer);
+		pack32(step->req_cpufreq_gov, buffer);
+		pack32(step->requid, buffer);
+		_pack_slurmdb_stats(&step->stats, protocol_version, buffer);
+		pack_time(step->start, buffer);
+		pack16(step->state, buffer);
+		pack32(step->stepid, buffer);	/* job's step number */
+		packstr(step->stepname, buffer);
+		pack32(step->suspended, buffer);
+		pack32(step->sys_cpu_sec, buffer);
+		pack32(step->sys_cpu_usec, buffer);
+		pack32(step->task_dist, buffer);
+		pack32(step->tot_cpu_sec, buffer);
+		pack32(step->tot_cpu_usec, buffer);
+		packstr(step->tres_alloc_str, buffer);
+		pack32(step->user_cpu_sec, buffer);
+		pack32(step->user_cpu_usec, buffer);
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+	}
+}
+
+static int _unpack_step_rec(slurmdb_step_rec_t **step, uint32_t fields,
+			    uint16_t protocol_version, Buf buffer)
+{
+	uint32_t uint32_tmp;
+	uint16_t uint16_tmp;
+	slurmdb_step_rec_t *step_ptr = xmalloc(sizeof(slurmdb_step_rec_t));
+
+	*step = step_ptr;
+
+	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+		safe_unpack32(&step_ptr->elapsed, buffer);
+		safe_unpack_time(&step_ptr->end, buffer);
+		safe_unpack32(&uint32_tmp, buffer);
+		step_ptr->exitcode = (int32_t)uint32_tmp;
+		safe_unpack32(&step_ptr->nnodes, buffer);
+		if (fields & JOBCOND_FIELD_NODES)
+			safe_unpackstr_xmalloc(&step_ptr->nodes, &uint32_tmp,
+					       buffer);
+		safe_unpack32(&step_ptr->ntasks, buffer);
+		safe_unpack32(&step_ptr->packjobid, buffer);
+		safe_unpack32(&step_ptr->packstepid, buffer);
+		safe_unpack32(&step_ptr->req_cpufreq_min, buffer);
+		safe_unpack32(&step_ptr->req_cpufreq_max, buffer);
+		safe_unpack32(&step_ptr->req_cpufreq_gov, buffer);
+		safe_unpack32(&step_ptr->requid, buffer);
+		if (!(fields & JOBCOND_FIELD_STATS))
+			step_ptr->stats.cpu_min = NO_VAL;
+		else if (_unpack_slurmdb_stats(&step_ptr->stats,
+					       protocol_version, buffer)
+			 != SLURM_SUCCESS)
+			goto unpack_error;
+		safe_unpack_time(&step_ptr->start, buffer);
+		safe_unpack16(&uint16_tmp, buffer);
+		step_ptr->state = uint16_tmp;
+		safe_unpack32(&step_ptr->stepid, buffer);
+		if (fields & JOBCOND_FIELD_NAME)
+			safe_unpackstr_xmalloc(&step_ptr->stepname,
+					       &uint32_tmp, buffer);
+		safe_unpack32(&step_ptr->suspended, buffer);
+		safe_unpack32(&step_ptr->sys_cpu_sec, buffer);
+		safe_unpack32(&step_ptr->sys_cpu_usec, buffer);
+		safe_unpack32(&step_ptr->task_dist, buffer);
+		safe_unpack32(&step_ptr->tot_cpu_sec, buffer);
+		safe_unpack32(&step_ptr->tot_cpu_usec, buffer);
+		if (fields & JOBCOND_FIELD_TRES)
+			safe_unpackstr_xmalloc(&step_ptr->tres_alloc_str,
+					       &uint32_tmp, buffer);
+		safe_unpack32(&step_ptr->user_cpu_sec, buffer);
+		safe_unpack32(&step_ptr->user_cpu_usec, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		safe_unpack32(&step_ptr->elapsed, buffer);
+		safe_unpack_time(&step_ptr->end, buffer);
+		safe_unpack32(&uint32_tmp, buffer);
+		step_ptr->exitcode = (int32_t)uint32_tmp;
+		safe_unpack32(&step_ptr->nnodes, buffer);
+		safe_unpackstr_xmalloc(&step_ptr->nodes, &uint32_tmp, buffer);
+		safe_unpack32(&step_ptr->ntasks, buffer);
+		safe_unpack32(&step_ptr->req_cpufreq_min, buffer);
+		safe_unpack32(&step_ptr->req_cpufreq_max, buffer);
+		safe_unpack32(&step_ptr->req_cpufreq_gov, buffer);
+		safe_unpack32(&step_ptr->requid, buffer);
+		if (_unpack_slurmdb_stats(&step_ptr->stats, protocol_version,
+					  buffer)
+		    != SLURM_SUCCESS)
+			goto unpack_error;
+		safe_unpack_time(&step_ptr->start, buffer);
+		safe_unpack16(&uint16_tmp, buffer);
+		step_ptr->state = uint16_tmp;
+		safe_unpack32(&step_ptr->stepid, buffer);
+		safe_unpackstr_xmalloc(&step_ptr->stepname,
+				       &uint32_tmp, buffer);
+		safe_unpack32(&step_ptr->suspended, buffer);
+		safe_unpack32(&step_ptr->sys_cpu_sec, buffer);
+		safe_unpack32(&step_ptr->sys_cpu_usec, buffer);
+		safe_unpack32(&step_ptr->task_dist, buffer);
+		safe_unpack32(&step_ptr->tot_cpu_sec, buffer);
+		safe_unpack32(&step_ptr->tot_cpu_usec, buffer);
+		safe_unpackstr_xmalloc(&step_ptr->tres_alloc_str,
+				       &uint32_tmp, buffer);
+		safe_unpack32(&step_ptr->user_cpu_sec, buffer);
+		safe_unpack32(&step_ptr->user_cpu_usec, buffer);
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+		goto unpack_error;
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurmdb_destroy_step_rec(step_ptr);
+	*step = NULL;
+	return SLURM_ERROR;
+}
+
 
 extern void slurmdb_pack_user_rec(void *in, uint16_t protocol_version,
 				  Buf buffer)
@@ -3624,6 +3788,8 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t protocol_version,
 			pack32(NO_VAL, buffer);	/* count(wckey_list) */
 			pack16(0, buffer);	/* without_steps */
 			pack16(0, buffer);	/* without_usage_truncation */
+			if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION)
+				pack32(0, buffer);	/* fields */
 			return;
 		}
 
@@ -3813,6 +3979,8 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t protocol_version,
 
 		pack16(object->without_steps, buffer);
 		pack16(object->without_usage_truncation, buffer);
+		if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION)
+			pack32(object->fields, buffer);
 	}
 }
 
@@ -4030,6 +4198,8 @@ extern int slurmdb_unpack_job_cond(void **object, uint16_t protocol_version,
 
 		safe_unpack16(&object_ptr->without_steps, buffer);
 		safe_unpack16(&object_ptr->without_usage_truncation, buffer);
+		if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION)
+			safe_unpack32(&object_ptr->fields, buffer);
 	}
 
 	return SLURM_SUCCESS;
@@ -4087,7 +4257,99 @@ extern void slurmdb_pack_job_rec(void *object, uint16_t protocol_version,
 	slurmdb_step_rec_t *step = NULL;
 	uint32_t count = 0;
 
-	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		uint32_t fields = job->fields ? job->fields : JOBCOND_FIELD_ALL;
+
+		/* Only the groups of fields asked for in the query are sent */
+		pack32(fields, buffer);
+		if (fields & JOBCOND_FIELD_ASSOC)
+			packstr(job->account, buffer);
+		if (fields & JOBCOND_FIELD_COMMENT)
+			packstr(job->admin_comment, buffer);
+		if (fields & JOBCOND_FIELD_TRES)
+			packstr(job->alloc_gres, buffer);
+		pack32(job->alloc_nodes, buffer);
+		pack32(job->array_job_id, buffer);
+		pack32(job->array_max_tasks, buffer);
+		pack32(job->array_task_id, buffer);
+		packstr(job->array_task_str, buffer);
+
+		pack32(job->associd, buffer);
+		if (fields & JOBCOND_FIELD_COMMENT)
+			packstr(job->blockid, buffer);
+		packstr(job->cluster, buffer);
+		pack32((uint32_t)job->derived_ec, buffer);
+		if (fields & JOBCOND_FIELD_COMMENT)
+			packstr(job->derived_es, buffer);
+		pack32(job->elapsed, buffer);
+		pack_time(job->eligible, buffer);
+		pack_time(job->end, buffer);
+		pack32((uint32_t)job->exitcode, buffer);
+		/* the first_step_ptr
+		   is set up on the client side so does
+		   not need to be packed */
+		pack32(job->gid, buffer);
+		pack32(job->jobid, buffer);
+		if (fields & JOBCOND_FIELD_NAME)
+			packstr(job->jobname, buffer);
+		pack32(job->lft, buffer);
+		if (fields & JOBCOND_FIELD_NODES)
+			packstr(job->nodes, buffer);
+		if (fields & JOBCOND_FIELD_ASSOC)
+			packstr(job->partition, buffer);
+		pack32(job->priority, buffer);
+		pack32(job->qosid, buffer);
+		pack32(job->req_cpus, buffer);
+		if (fields & JOBCOND_FIELD_TRES)
+			packstr(job->req_gres, buffer);
+		pack64(job->req_mem, buffer);
+		pack32(job->requid, buffer);
+		if (fields & JOBCOND_FIELD_RESV)
+			packstr(job->resv_name, buffer);
+		pack32(job->resvid, buffer);
+		pack32(job->show_full, buffer);
+		pack_time(job->start, buffer);
+		pack32(job->state, buffer);
+		if (fields & JOBCOND_FIELD_STATS)
+			_pack_slurmdb_stats(&job->stats, protocol_version,
+					    buffer);
+
+		if (job->steps)
+			count = list_count(job->steps);
+		else
+			count = 0;
+
+		pack32(count, buffer);
+		if (count) {
+			itr = list_iterator_create(job->steps);
+			while ((step = list_next(itr))) {
+				_pack_step_rec(step, fields, protocol_version,
+					       buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+		pack_time(job->submit, buffer);
+		pack32(job->suspended, buffer);
+		pack32(job->sys_cpu_sec, buffer);
+		pack32(job->sys_cpu_usec, buffer);
+		pack32(job->timelimit, buffer);
+		pack32(job->tot_cpu_sec, buffer);
+		pack32(job->tot_cpu_usec, buffer);
+		pack16(job->track_steps, buffer);
+
+		if (fields & JOBCOND_FIELD_TRES) {
+			packstr(job->tres_alloc_str, buffer);
+			packstr(job->tres_req_str, buffer);
+		}
+
+		pack32(job->uid, buffer);
+		packstr(job->user, buffer);
+		pack32(job->user_cpu_sec, buffer);
+		pack32(job->user_cpu_usec, buffer);
+		if (fields & JOBCOND_FIELD_ASSOC)
+			packstr(job->wckey, buffer);
+		pack32(job->wckeyid, buffer);
+	} else if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		packstr(job->account, buffer);
 		packstr(job->admin_comment, buffer);
 		packstr(job->alloc_gres, buffer);
@@ -4251,7 +4513,113 @@ extern int slurmdb_unpack_job_rec(void **job, uint16_t protocol_version,
 
 	job_ptr->array_job_id = 0;
 	job_ptr->array_task_id = NO_VAL;
-	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		uint32_t fields;
+
+		safe_unpack32(&fields, buffer);
+		job_ptr->fields = fields;
+		if (fields & JOBCOND_FIELD_ASSOC)
+			safe_unpackstr_xmalloc(&job_ptr->account, &uint32_tmp,
+					       buffer);
+		if (fields & JOBCOND_FIELD_COMMENT)
+			safe_unpackstr_xmalloc(&job_ptr->admin_comment,
+					       &uint32_tmp, buffer);
+		if (fields & JOBCOND_FIELD_TRES)
+			safe_unpackstr_xmalloc(&job_ptr->alloc_gres,
+					       &uint32_tmp, buffer);
+		safe_unpack32(&job_ptr->alloc_nodes, buffer);
+		safe_unpack32(&job_ptr->array_job_id, buffer);
+		safe_unpack32(&job_ptr->array_max_tasks, buffer);
+		safe_unpack32(&job_ptr->array_task_id, buffer);
+		safe_unpackstr_xmalloc(&job_ptr->array_task_str,
+				       &uint32_tmp, buffer);
+		safe_unpack32(&job_ptr->associd, buffer);
+		if (fields & JOBCOND_FIELD_COMMENT)
+			safe_unpackstr_xmalloc(&job_ptr->blockid, &uint32_tmp,
+					       buffer);
+		safe_unpackstr_xmalloc(&job_ptr->cluster, &uint32_tmp, buffer);
+		safe_unpack32(&uint32_tmp, buffer);
+		job_ptr->derived_ec = (int32_t)uint32_tmp;
+		if (fields & JOBCOND_FIELD_COMMENT)
+			safe_unpackstr_xmalloc(&job_ptr->derived_es,
+					       &uint32_tmp, buffer);
+		safe_unpack32(&job_ptr->elapsed, buffer);
+		safe_unpack_time(&job_ptr->eligible, buffer);
+		safe_unpack_time(&job_ptr->end, buffer);
+		safe_unpack32(&uint32_tmp, buffer);
+		job_ptr->exitcode = (int32_t)uint32_tmp;
+		safe_unpack32(&job_ptr->gid, buffer);
+		safe_unpack32(&job_ptr->jobid, buffer);
+		if (fields & JOBCOND_FIELD_NAME)
+			safe_unpackstr_xmalloc(&job_ptr->jobname, &uint32_tmp,
+					       buffer);
+		safe_unpack32(&job_ptr->lft, buffer);
+		if (fields & JOBCOND_FIELD_NODES)
+			safe_unpackstr_xmalloc(&job_ptr->nodes, &uint32_tmp,
+					       buffer);
+		if (fields & JOBCOND_FIELD_ASSOC)
+			safe_unpackstr_xmalloc(&job_ptr->partition,
+					       &uint32_tmp, buffer);
+		safe_unpack32(&job_ptr->priority, buffer);
+		safe_unpack32(&job_ptr->qosid, buffer);
+		safe_unpack32(&job_ptr->req_cpus, buffer);
+		if (fields & JOBCOND_FIELD_TRES)
+			safe_unpackstr_xmalloc(&job_ptr->req_gres, &uint32_tmp,
+					       buffer);
+		safe_unpack64(&job_ptr->req_mem, buffer);
+		safe_unpack32(&job_ptr->requid, buffer);
+		if (fields & JOBCOND_FIELD_RESV)
+			safe_unpackstr_xmalloc(&job_ptr->resv_name,
+					       &uint32_tmp, buffer);
+		safe_unpack32(&job_ptr->resvid, buffer);
+		safe_unpack32(&job_ptr->show_full, buffer);
+		safe_unpack_time(&job_ptr->start, buffer);
+		safe_unpack32(&uint32_tmp, buffer);
+		job_ptr->state = uint32_tmp;
+		if (!(fields & JOBCOND_FIELD_STATS))
+			job_ptr->stats.cpu_min = NO_VAL;
+		else if (_unpack_slurmdb_stats(&job_ptr->stats,
+					       protocol_version, buffer)
+			 != SLURM_SUCCESS)
+			goto unpack_error;
+
+		safe_unpack32(&count, buffer);
+		job_ptr->steps = list_create(slurmdb_destroy_step_rec);
+		for (i=0; i<count; i++) {
+			if (_unpack_step_rec(&step, fields, protocol_version,
+					     buffer)
+			    == SLURM_ERROR)
+				goto unpack_error;
+
+			step->job_ptr = job_ptr;
+			if (!job_ptr->first_step_ptr)
+				job_ptr->first_step_ptr = step;
+			list_append(job_ptr->steps, step);
+		}
+
+		safe_unpack_time(&job_ptr->submit, buffer);
+		safe_unpack32(&job_ptr->suspended, buffer);
+		safe_unpack32(&job_ptr->sys_cpu_sec, buffer);
+		safe_unpack32(&job_ptr->sys_cpu_usec, buffer);
+		safe_unpack32(&job_ptr->timelimit, buffer);
+		safe_unpack32(&job_ptr->tot_cpu_sec, buffer);
+		safe_unpack32(&job_ptr->tot_cpu_usec, buffer);
+		safe_unpack16(&job_ptr->track_steps, buffer);
+		if (fields & JOBCOND_FIELD_TRES) {
+			safe_unpackstr_xmalloc(&job_ptr->tres_alloc_str,
+					       &uint32_tmp, buffer);
+			safe_unpackstr_xmalloc(&job_ptr->tres_req_str,
+					       &uint32_tmp, buffer);
+		}
+		safe_unpack32(&job_ptr->uid, buffer);
+		safe_unpackstr_xmalloc(&job_ptr->user, &uint32_tmp, buffer);
+		safe_unpack32(&job_ptr->user_cpu_sec, buffer);
+		safe_unpack32(&job_ptr->user_cpu_usec, buffer);
+		if (fields & JOBCOND_FIELD_ASSOC)
+			safe_unpackstr_xmalloc(&job_ptr->wckey, &uint32_tmp,
+					       buffer);
+		safe_unpack32(&job_ptr->wckeyid, buffer);
+	} else if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		safe_unpackstr_xmalloc(&job_ptr->account, &uint32_tmp, buffer);
 		safe_unpackstr_xmalloc(&job_ptr->admin_comment, &uint32_tmp,
 				       buffer);
@@ -4706,151 +5074,14 @@ unpack_error:
 extern void slurmdb_pack_step_rec(slurmdb_step_rec_t *step,
 				  uint16_t protocol_version, Buf buffer)
 {
-	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
-		pack32(step->elapsed, buffer);
-		pack_time(step->end, buffer);
-		pack32((uint32_t)step->exitcode, buffer);
-		pack32(step->nnodes, buffer);
-		packstr(step->nodes, buffer);
-		pack32(step->ntasks, buffer);
-		pack32(step->packjobid, buffer);
-		pack32(step->packstepid, buffer);
-		pack32(step->req_cpufreq_min, buffer);
-		pack32(step->req_cpufreq_max, buffer);
-		pack32(step->req_cpufreq_gov, buffer);
-		pack32(step->requid, buffer);
-		_pack_slurmdb_stats(&step->stats, protocol_version, buffer);
-		pack_time(step->start, buffer);
-		pack16(step->state, buffer);
-		pack32(step->stepid, buffer);   /* job's step number */
-		packstr(step->stepname, buffer);
-		pack32(step->suspended, buffer);
-		pack32(step->sys_cpu_sec, buffer);
-		pack32(step->sys_cpu_usec, buffer);
-		pack32(step->task_dist, buffer);
-		pack32(step->tot_cpu_sec, buffer);
-		pack32(step->tot_cpu_usec, buffer);
-		packstr(step->tres_alloc_str, buffer);
-		pack32(step->user_cpu_sec, buffer);
-		pack32(step->user_cpu_usec, buffer);
-	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
-		pack32(step->elapsed, buffer);
-		pack_time(step->end, buffer);
-		pack32((uint32_t)step->exitcode, buffer);
-		pack32(step->nnodes, buffer);
-		packstr(step->nodes, buffer);
-		pack32(step->ntasks, buffer);
-		pack32(step->req_cpufreq_min, buffer);
-		pack32(step->req_cpufreq_max, buffer);
-		pack32(step->req_cpufreq_gov, buffer);
-		pack32(step->requid, buffer);
-		_pack_slurmdb_stats(&step->stats, protocol_version, buffer);
-		pack_time(step->start, buffer);
-		pack16(step->state, buffer);
-		pack32(step->stepid, buffer);	/* job's step number */
-		packstr(step->stepname, buffer);
-		pack32(step->suspended, buffer);
-		pack32(step->sys_cpu_sec, buffer);
-		pack32(step->sys_cpu_usec, buffer);
-		pack32(step->task_dist, buffer);
-		pack32(step->tot_cpu_sec, buffer);
-		pack32(step->tot_cpu_usec, buffer);
-		packstr(step->tres_alloc_str, buffer);
-		pack32(step->user_cpu_sec, buffer);
-		pack32(step->user_cpu_usec, buffer);
-	} else {
-		error("%s: protocol_version %hu not supported",
-		      __func__, protocol_version);
-	}
+	_pack_step_rec(step, JOBCOND_FIELD_ALL, protocol_version, buffer);
 }
 
 extern int slurmdb_unpack_step_rec(slurmdb_step_rec_t **step,
 				   uint16_t protocol_version, Buf buffer)
 {
-	uint32_t uint32_tmp;
-	uint16_t uint16_tmp;
-	slurmdb_step_rec_t *step_ptr = xmalloc(sizeof(slurmdb_step_rec_t));
-
-	*step = step_ptr;
-
-	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
-		safe_unpack32(&step_ptr->elapsed, buffer);
-		safe_unpack_time(&step_ptr->end, buffer);
-		safe_unpack32(&uint32_tmp, buffer);
-		step_ptr->exitcode = (int32_t)uint32_tmp;
-		safe_unpack32(&step_ptr->nnodes, buffer);
-		safe_unpackstr_xmalloc(&step_ptr->nodes, &uint32_tmp, buffer);
-		safe_unpack32(&step_ptr->ntasks, buffer);
-		safe_unpack32(&step_ptr->packjobid, buffer);
-		safe_unpack32(&step_ptr->packstepid, buffer);
-		safe_unpack32(&step_ptr->req_cpufreq_min, buffer);
-		safe_unpack32(&step_ptr->req_cpufreq_max, buffer);
-		safe_unpack32(&step_ptr->req_cpufreq_gov, buffer);
-		safe_unpack32(&step_ptr->requid, buffer);
-		if (_unpack_slurmdb_stats(&step_ptr->stats, protocol_version,
-					  buffer)
-		    != SLURM_SUCCESS)
-			goto unpack_error;
-		safe_unpack_time(&step_ptr->start, buffer);
-		safe_unpack16(&uint16_tmp, buffer);
-		step_ptr->state = uint16_tmp;
-		safe_unpack32(&step_ptr->stepid, buffer);
-		safe_unpackstr_xmalloc(&step_ptr->stepname,
-				       &uint32_tmp, buffer);
-		safe_unpack32(&step_ptr->suspended, buffer);
-		safe_unpack32(&step_ptr->sys_cpu_sec, buffer);
-		safe_unpack32(&step_ptr->sys_cpu_usec, buffer);
-		safe_unpack32(&step_ptr->task_dist, buffer);
-		safe_unpack32(&step_ptr->tot_cpu_sec, buffer);
-		safe_unpack32(&step_ptr->tot_cpu_usec, buffer);
-		safe_unpackstr_xmalloc(&step_ptr->tres_alloc_str,
-				       &uint32_tmp, buffer);
-		safe_unpack32(&step_ptr->user_cpu_sec, buffer);
-		safe_unpack32(&step_ptr->user_cpu_usec, buffer);
-	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
-		safe_unpack32(&step_ptr->elapsed, buffer);
-		safe_unpack_time(&step_ptr->end, buffer);
-		safe_unpack32(&uint32_tmp, buffer);
-		step_ptr->exitcode = (int32_t)uint32_tmp;
-		safe_unpack32(&step_ptr->nnodes, buffer);
-		safe_unpackstr_xmalloc(&step_ptr->nodes, &uint32_tmp, buffer);
-		safe_unpack32(&step_ptr->ntasks, buffer);
-		safe_unpack32(&step_ptr->req_cpufreq_min, buffer);
-		safe_unpack32(&step_ptr->req_cpufreq_max, buffer);
-		safe_unpack32(&step_ptr->req_cpufreq_gov, buffer);
-		safe_unpack32(&step_ptr->requid, buffer);
-		if (_unpack_slurmdb_stats(&step_ptr->stats, protocol_version,
-					  buffer)
-		    != SLURM_SUCCESS)
-			goto unpack_error;
-		safe_unpack_time(&step_ptr->start, buffer);
-		safe_unpack16(&uint16_tmp, buffer);
-		step_ptr->state = uint16_tmp;
-		safe_unpack32(&step_ptr->stepid, buffer);
-		safe_unpackstr_xmalloc(&step_ptr->stepname,
-				       &uint32_tmp, buffer);
-		safe_unpack32(&step_ptr->suspended, buffer);
-		safe_unpack32(&step_ptr->sys_cpu_sec, buffer);
-		safe_unpack32(&step_ptr->sys_cpu_usec, buffer);
-		safe_unpack32(&step_ptr->task_dist, buffer);
-		safe_unpack32(&step_ptr->tot_cpu_sec, buffer);
-		safe_unpack32(&step_ptr->tot_cpu_usec, buffer);
-		safe_unpackstr_xmalloc(&step_ptr->tres_alloc_str,
-				       &uint32_tmp, buffer);
-		safe_unpack32(&step_ptr->user_cpu_sec, buffer);
-		safe_unpack32(&step_ptr->user_cpu_usec, buffer);
-	} else {
-		error("%s: protocol_version %hu not supported",
-		      __func__, protocol_version);
-		goto unpack_error;
-	}
-
-	return SLURM_SUCCESS;
-
-unpack_error:
-	slurmdb_destroy_step_rec(step_ptr);
-	*step = NULL;
-	return SLURM_ERROR;
+	return _unpack_step_rec(step, JOBCOND_FIELD_ALL, protocol_version,
+				buffer);
 }
 
 static uint32_t _list_count_null(List l)
@@ -5620,6 +5851,14 @@ extern void slurmdb_pack_stats_msg(void *object, uint16_t protocol_version,
 		pack32_array(stats_ptr->rpc_user_id,   i, buffer);
 		pack32_array(stats_ptr->rpc_user_cnt,  i, buffer);
 		pack64_array(stats_ptr->rpc_user_time, i, buffer);
+
+		/* DBD_SEND_MULT_MSG batch statistics */
+		pack32(stats_ptr->mult_cnt, buffer);
+		pack64(stats_ptr->mult_rec_cnt, buffer);
+		pack64(stats_ptr->mult_time, buffer);
+		pack64(stats_ptr->mult_max_time, buffer);
+		pack64(stats_ptr->mult_commit_time, buffer);
+		pack32(stats_ptr->mult_fail_cnt, buffer);
 	} else {
 		error("%s: protocol_version %hu not supported",
 		      __func__, protocol_version);
@@ -5681,6 +5920,13 @@ extern int slurmdb_unpack_stats_msg(void **object, uint16_t protocol_version,
 				    buffer);
 		if (uint32_tmp != stats_ptr->user_cnt)
 			goto unpack_error;
+
+		safe_unpack32(&stats_ptr->mult_cnt, buffer);
+		safe_unpack64(&stats_ptr->mult_rec_cnt, buffer);
+		safe_unpack64(&stats_ptr->mult_time, buffer);
+		safe_unpack64(&stats_ptr->mult_max_time, buffer);
+		safe_unpack64(&stats_ptr->mult_commit_time, buffer);
+		safe_unpack32(&stats_ptr->mult_fail_cnt, buffer);
 	} else {
 		error("%s: protocol_version %hu not supported",
 		      __func__, protocol_version);
@@ -79,6 +79,17 @@ strong_alias(slurmdbd_free_id_rc_msg,	slurmdb_slurmdbd_free_id_rc_msg);
 #define MAX_DBD_MSG_LEN		16384
 #define SLURMDBD_TIMEOUT	900	/* Seconds SlurmDBD for response */
 
+/* Batches of queued RPCs sent to the SlurmDBD without waiting for the
+ * response to the previous one. The SlurmDBD answers the requests on a
+ * connection in the order they are sent, so the position of a response
+ * identifies the batch it acknowledges. */
+#define DBD_AGENT_WINDOW	4
+#define DBD_BATCH_MIN		100
+#define DBD_BATCH_MAX		5000
+#define DBD_BATCH_INIT		1000
+#define DBD_BATCH_FAST_USEC	1000000	/* grow batches served faster */
+#define DBD_BATCH_SLOW_USEC	5000000	/* shrink batches served slower */
+
 uint16_t running_cache = 0;
 pthread_mutex_t assoc_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t assoc_cache_cond = PTHREAD_COND_INITIALIZER;
@@ -88,6 +99,26 @@ static pthread_cond_t  agent_cond = PTHREAD_COND_INITIALIZER;
 static List      agent_list     = (List) NULL;
 static pthread_t agent_tid      = 0;
 
+typedef struct {
+	List recs;		/* records sent, in agent_list order */
+	bool mult;		/* sent as DBD_SEND_MULT_MSG */
+	struct timeval sent;
+} agent_batch_t;
+
+/* Protected by agent_lock */
+static uint32_t  agent_batch_size    = DBD_BATCH_INIT;
+static uint32_t  agent_inflight_cnt  = 0;	/* batches awaiting response */
+static uint32_t  agent_inflight_recs = 0;	/* head records in batches */
+static int       overflow_wfd        = -1;	/* records beyond queue limit */
+static int       overflow_rfd        = -1;
+static off_t     overflow_wsize      = 0;
+static uint32_t  overflow_wcnt       = 0;	/* records written to file */
+static uint32_t  overflow_cnt        = 0;	/* records not read back yet */
+static uint32_t  agent_rtt_last      = 0;	/* usec to batch response */
+static uint32_t  agent_rtt_max       = 0;
+static uint64_t  agent_rtt_sum       = 0;
+static uint32_t  agent_rtt_cnt       = 0;
+
 static pthread_mutex_t slurmdbd_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
 static slurm_persist_conn_t *slurmdbd_conn = NULL;
@@ -102,8 +133,11 @@ static time_t    slurmdbd_shutdown   = 0;
 
 static void * _agent(void *x);
 static void   _create_agent(void);
+static int    _max_agent_queue(void);
+static bool   _overflow_full(uint16_t msg_type, int max_agent_queue);
+static int    _overflow_save(Buf buffer);
+static void   _overflow_close(void);
 static int _unpack_config_name(char **object, uint16_t rpc_version, Buf buffer);
-static int    _get_return_code(void);
 static Buf    _load_dbd_rec(int fd);
 static void   _load_dbd_state(void);
 static void   _open_slurmdbd_conn(bool db_needed);
@@ -243,6 +277,36 @@ extern int slurm_send_slurmdbd_recv_rc_msg(uint16_t rpc_version,
 	return rc;
 }
 
+/* Send an RPC to the SlurmDBD, opening the connection if needed.
+ * Call with slurmdbd_lock locked */
+static int _send_msg_locked(uint16_t rpc_version, slurmdbd_msg_t *req)
+{
+	int rc;
+	Buf buffer;
+
+	if (!slurmdbd_conn || (slurmdbd_conn->fd < 0)) {
+		/* Either slurm_open_slurmdbd_conn() was not executed or
+		 * the connection to Slurm DBD has been closed */
+		if (req->msg_type == DBD_GET_CONFIG)
+			_open_slurmdbd_conn(0);
+		else
+			_open_slurmdbd_conn(1);
+		if (!slurmdbd_conn || (slurmdbd_conn->fd < 0))
+			return SLURM_ERROR;
+	}
+
+	if (!(buffer = pack_slurmdbd_msg(req, rpc_version)))
+		return SLURM_ERROR;
+
+	rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
+	free_buf(buffer);
+	if (rc != SLURM_SUCCESS)
+		error("slurmdbd: Sending message type %s: %d: %m",
+		      rpc_num2string(req->msg_type), rc);
+
+	return rc;
+}
+
 /* Send an RPC to the SlurmDBD and wait for an arbitrary reply message.
  * The RPC will not be queued if an error occurs.
  * The "resp" message must be freed by the caller.
@@ -264,31 +328,8 @@ extern int slurm_send_recv_slurmdbd_msg(uint16_t rpc_version,
 	halt_agent = 1;
 	slurm_mutex_lock(&slurmdbd_lock);
 	halt_agent = 0;
-	if (!slurmdbd_conn || (slurmdbd_conn->fd < 0)) {
-		/* Either slurm_open_slurmdbd_conn() was not executed or
-		 * the connection to Slurm DBD has been closed */
-		if (req->msg_type == DBD_GET_CONFIG)
-			_open_slurmdbd_conn(0);
-		else
-			_open_slurmdbd_conn(1);
-		if (!slurmdbd_conn || (slurmdbd_conn->fd < 0)) {
-			rc = SLURM_ERROR;
-			goto end_it;
-		}
-	}
-
-	if (!(buffer = pack_slurmdbd_msg(req, rpc_version))) {
-		rc = SLURM_ERROR;
-		goto end_it;
-	}
-
-	rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
-	free_buf(buffer);
-	if (rc != SLURM_SUCCESS) {
-		error("slurmdbd: Sending message type %s: %d: %m",
-		      rpc_num2string(req->msg_type), rc);
+	if ((rc = _send_msg_locked(rpc_version, req)) != SLURM_SUCCESS)
 		goto end_it;
-	}
 
 	buffer = slurm_persist_recv_msg(slurmdbd_conn);
 	if (buffer == NULL) {
@@ -311,6 +352,75 @@ end_it:
 	return rc;
 }
 
+/* Send an RPC to the SlurmDBD and pass each reply message to callback
+ * until a PERSIST_RC ends the reply. The callback must free the message,
+ * once it fails the rest of the reply is discarded.
+ * The RPC will not be queued if an error occurs.
+ * Returns SLURM_SUCCESS or an error code, errno is set to the PERSIST_RC's */
+extern int slurm_send_recv_slurmdbd_msgs(uint16_t rpc_version,
+					 slurmdbd_msg_t *req,
+					 int (*callback)(slurmdbd_msg_t *resp,
+							 void *arg),
+					 void *arg)
+{
+	int rc, cb_rc = SLURM_SUCCESS;
+	slurmdbd_msg_t resp;
+	persist_rc_msg_t *rc_msg;
+	Buf buffer;
+
+	xassert(req);
+	xassert(callback);
+
+	halt_agent = 1;
+	slurm_mutex_lock(&slurmdbd_lock);
+	halt_agent = 0;
+	if ((rc = _send_msg_locked(rpc_version, req)) != SLURM_SUCCESS)
+		goto end_it;
+
+	while (1) {
+		if (!(buffer = slurm_persist_recv_msg(slurmdbd_conn))) {
+			error("slurmdbd: Getting response to message type %u",
+			      req->msg_type);
+			rc = SLURM_ERROR;
+			break;
+		}
+		memset(&resp, 0, sizeof(slurmdbd_msg_t));
+		rc = unpack_slurmdbd_msg(&resp, rpc_version, buffer);
+		free_buf(buffer);
+		if (rc != SLURM_SUCCESS) {
+			/* The rest of the reply would be taken as the reply
+			 * to the next RPC, start over on a new connection */
+			slurm_persist_conn_close(slurmdbd_conn);
+			break;
+		}
+		if (resp.msg_type == PERSIST_RC) {
+			rc_msg = resp.data;
+			rc = rc_msg->rc;
+			if (rc != SLURM_SUCCESS) {
+				debug("slurmdbd: %s(%u): %s",
+				      slurmdbd_msg_type_2_str(req->msg_type,
+							      1),
+				      req->msg_type, rc_msg->comment ?
+				      rc_msg->comment : slurm_strerror(rc));
+				slurm_seterrno(rc);
+			}
+			slurm_persist_free_rc_msg(rc_msg);
+			break;
+		}
+		if (cb_rc == SLURM_SUCCESS)
+			cb_rc = (callback)(&resp, arg);
+		else
+			slurmdbd_free_msg(&resp);
+	}
+	if (rc == SLURM_SUCCESS)
+		rc = cb_rc;
+end_it:
+	slurm_cond_signal(&slurmdbd_cond);
+	slurm_mutex_unlock(&slurmdbd_lock);
+
+	return rc;
+}
+
 /* Send an RPC to the SlurmDBD. Do not wait for the reply. The RPC
  * will be queued and processed later if the SlurmDBD is not responding.
  * NOTE: slurm_open_slurmdbd_conn() must have been called with callbacks set
@@ -321,15 +431,7 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 	Buf buffer;
 	int cnt, rc = SLURM_SUCCESS;
 	static time_t syslog_time = 0;
-	static int max_agent_queue = 0;
-
-	/* Whatever our max job count is times that by 2 or
-	 * MAX_AGENT_QUEUE which ever is bigger */
-	if (!max_agent_queue)
-		max_agent_queue =
-			MAX(MAX_AGENT_QUEUE,
-			    ((slurmctld_conf.max_job_cnt * 2) +
-			     (node_record_count * 4)));
+	int max_agent_queue = _max_agent_queue();
 
 	buffer = slurm_persist_msg_pack(
 		slurmdbd_conn, (persist_msg_t *)req);
@@ -355,25 +457,75 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 		if (slurmdbd_conn->trigger_callbacks.dbd_fail)
 			(slurmdbd_conn->trigger_callbacks.dbd_fail)();
 	}
-	if (cnt == (max_agent_queue - 1))
+	/* Once records go to the overflow file, later ones follow them
+	 * there until the agent has read them all back */
+	if (!overflow_cnt && (cnt < max_agent_queue)) {
+		if (list_enqueue(agent_list, buffer) == NULL)
+			fatal("list_enqueue: memory allocation failure");
+		goto end_it;
+	}
+	/* Records can't go around a full overflow file to the queue */
+	if (_overflow_full(req->msg_type, max_agent_queue))
+		goto discard;
+	if (_overflow_save(buffer) == SLURM_SUCCESS) {
+		free_buf(buffer);
+		goto end_it;
+	}
+
+	if (cnt >= (max_agent_queue - 1))
 		cnt -= _purge_step_req();
-	if (cnt == (max_agent_queue - 1))
+	if (cnt >= (max_agent_queue - 1))
 		cnt -= _purge_job_start_req();
 	if (cnt < max_agent_queue) {
 		if (list_enqueue(agent_list, buffer) == NULL)
 			fatal("list_enqueue: memory allocation failure");
-	} else {
-		error("slurmdbd: agent queue is full, discarding request");
-		if (slurmdbd_conn->trigger_callbacks.acct_full)
-			(slurmdbd_conn->trigger_callbacks.acct_full)();
-		rc = SLURM_ERROR;
+		goto end_it;
 	}
 
+discard:
+	error("slurmdbd: agent queue is full, discarding request");
+	if (slurmdbd_conn->trigger_callbacks.acct_full)
+		(slurmdbd_conn->trigger_callbacks.acct_full)();
+	free_buf(buffer);
+	rc = SLURM_ERROR;
+
+end_it:
 	slurm_cond_broadcast(&agent_cond);
 	slurm_mutex_unlock(&agent_lock);
 	return rc;
 }
 
+/* Report the state of the agent, all zero if it is not running */
+extern void slurmdbd_agent_get_stats(slurmdbd_agent_stats_t *stats)
+{
+	memset(stats, 0, sizeof(slurmdbd_agent_stats_t));
+
+	slurm_mutex_lock(&agent_lock);
+	if (agent_tid && agent_list) {
+		stats->queue_size       = list_count(agent_list);
+		stats->overflow_size    = overflow_cnt;
+		stats->inflight_batches = agent_inflight_cnt;
+		stats->inflight_recs    = agent_inflight_recs;
+		stats->batch_size       = agent_batch_size;
+		stats->rtt_last         = agent_rtt_last;
+		stats->rtt_max          = agent_rtt_max;
+		stats->rtt_sum          = agent_rtt_sum;
+		stats->rtt_cnt          = agent_rtt_cnt;
+	}
+	slurm_mutex_unlock(&agent_lock);
+}
+
+/* Clear the response time statistics of the agent */
+extern void slurmdbd_agent_reset_stats(void)
+{
+	slurm_mutex_lock(&agent_lock);
+	agent_rtt_last = 0;
+	agent_rtt_max  = 0;
+	agent_rtt_sum  = 0;
+	agent_rtt_cnt  = 0;
+	slurm_mutex_unlock(&agent_lock);
+}
+
 extern void slurmdbd_defs_init(char *auth_info)
 {
 	slurm_mutex_lock(&slurmdbd_lock);
@@ -565,6 +717,7 @@ extern Buf pack_slurmdbd_msg(slurmdbd_msg_t *req, uint16_t rpc_version)
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_STREAM:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
 	case DBD_GET_RESVS:
@@ -772,6 +925,7 @@ extern int unpack_slurmdbd_msg(slurmdbd_msg_t *resp,
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_STREAM:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
 	case DBD_GET_RESVS:
@@ -1033,6 +1187,8 @@ extern slurmdbd_msg_type_t str_2_slurmdbd_msg_type(char *msg_type)
 		return DBD_STEP_START;
 	} else if (!xstrcasecmp(msg_type, "Get Jobs Conditional")) {
 		return DBD_GET_JOBS_COND;
+	} else if (!xstrcasecmp(msg_type, "Get Jobs Stream")) {
+		return DBD_GET_JOBS_STREAM;
 	} else if (!xstrcasecmp(msg_type, "Get Transactions")) {
 		return DBD_GET_TXN;
 	} else if (!xstrcasecmp(msg_type, "Got Transactions")) {
@@ -1473,6 +1629,12 @@ extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type, int get_enum)
 		} else
 			return "Get Jobs Conditional";
 		break;
+	case DBD_GET_JOBS_STREAM:
+		if (get_enum) {
+			return "DBD_GET_JOBS_STREAM";
+		} else
+			return "Get Jobs Stream";
+		break;
 	case DBD_GET_TXN:
 		if (get_enum) {
 			return "DBD_GET_TXN";
@@ -1747,20 +1909,12 @@ unpack_error:
 }
 
 
-static int _get_return_code(void)
-{
-	int rc = SLURM_ERROR;
-	Buf buffer = slurm_persist_recv_msg(slurmdbd_conn);
-	if (buffer == NULL)
-		return rc;
-
-	rc = _unpack_return_code(slurmdbd_conn->version, buffer);
-
-	free_buf(buffer);
-	return rc;
-}
-
-static int _handle_mult_rc_ret(void)
+/* Read the response to a batch sent by the agent
+ * OUT acked - count of leading records in the batch the SlurmDBD processed
+ * OUT conn_lost - set if no response could be read
+ * RET SLURM_SUCCESS if all records were processed or an error code */
+static int _handle_mult_rc_ret(agent_batch_t *batch, uint32_t *acked,
+			       bool *conn_lost)
 {
 	Buf buffer;
 	uint16_t msg_type;
@@ -1768,10 +1922,22 @@ static int _handle_mult_rc_ret(void)
 	dbd_list_msg_t *list_msg = NULL;
 	int rc = SLURM_ERROR;
 	Buf out_buf = NULL;
+	ListIterator itr;
 
+	*acked = 0;
 	buffer = slurm_persist_recv_msg(slurmdbd_conn);
-	if (buffer == NULL)
+	if (buffer == NULL) {
+		*conn_lost = true;
 		return rc;
+	}
+
+	if (!batch->mult) {
+		rc = _unpack_return_code(slurmdbd_conn->version, buffer);
+		if (rc == SLURM_SUCCESS)
+			*acked = 1;
+		free_buf(buffer);
+		return rc;
+	}
 
 	safe_unpack16(&msg_type, buffer);
 	switch(msg_type) {
@@ -1784,27 +1950,20 @@ static int _handle_mult_rc_ret(void)
 			break;
 		}
 
-		slurm_mutex_lock(&agent_lock);
-		if (agent_list) {
-			ListIterator itr =
-				list_iterator_create(list_msg->my_list);
-			while ((out_buf = list_next(itr))) {
-				Buf b;
-				if ((rc = _unpack_return_code(
-					    slurmdbd_conn->version, out_buf))
-				    != SLURM_SUCCESS)
-					break;
-
-				if ((b = list_dequeue(agent_list))) {
-					free_buf(b);
-				} else {
-					error("slurmdbd: DBD_GOT_MULT_MSG "
-					      "unpack message error");
-				}
-			}
-			list_iterator_destroy(itr);
+		itr = list_iterator_create(list_msg->my_list);
+		while ((out_buf = list_next(itr))) {
+			if ((rc = _unpack_return_code(
+				    slurmdbd_conn->version, out_buf))
+			    != SLURM_SUCCESS)
+				break;
+			(*acked)++;
+		}
+		list_iterator_destroy(itr);
+		if (*acked > list_count(batch->recs)) {
+			error("slurmdbd: DBD_GOT_MULT_MSG "
+			      "unpack message error");
+			*acked = list_count(batch->recs);
 		}
-		slurm_mutex_unlock(&agent_lock);
 		slurmdbd_free_list_msg(list_msg);
 		break;
 	case PERSIST_RC:
@@ -1915,19 +2074,307 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* Whatever our max job count is times that by 2 or
+ * MAX_AGENT_QUEUE which ever is bigger */
+static int _max_agent_queue(void)
+{
+	static int max_agent_queue = 0;
+
+	if (!max_agent_queue)
+		max_agent_queue =
+			MAX(MAX_AGENT_QUEUE,
+			    ((slurmctld_conf.max_job_cnt * 2) +
+			     (node_record_count * 4)));
+	return max_agent_queue;
+}
+
+static char *_overflow_fname(void)
+{
+	char *fname = slurm_get_state_save_location();
+
+	xstrcat(fname, "/dbd.overflow");
+	return fname;
+}
+
+/* Close and remove the overflow file, called with agent_lock locked */
+static void _overflow_close(void)
+{
+	char *fname;
+
+	if (overflow_wfd < 0)
+		return;
+
+	(void) close(overflow_wfd);
+	if (overflow_rfd >= 0)
+		(void) close(overflow_rfd);
+	overflow_wfd = overflow_rfd = -1;
+	overflow_wsize = 0;
+	overflow_wcnt = 0;
+	overflow_cnt = 0;
+
+	fname = _overflow_fname();
+	(void) unlink(fname);
+	xfree(fname);
+}
+
+/* Return true if the overflow file has no room for a record of msg_type,
+ * called with agent_lock locked. The file takes no more than
+ * max_agent_queue records until it has been read back and removed. Like
+ * _purge_step_req() and _purge_job_start_req() for the queue in memory,
+ * step records are refused first, once it is half full, then job start
+ * records, once it is three quarters full. */
+static bool _overflow_full(uint16_t msg_type, int max_agent_queue)
+{
+	uint32_t limit = max_agent_queue;
+
+	if ((msg_type == DBD_STEP_START) || (msg_type == DBD_STEP_COMPLETE))
+		limit /= 2;
+	else if (msg_type == DBD_JOB_START)
+		limit -= limit / 4;
+
+	return (overflow_wcnt >= limit);
+}
+
+/* Append a record to the overflow file, called with agent_lock locked
+ * RET SLURM_SUCCESS or SLURM_ERROR if the record must stay in memory */
+static int _overflow_save(Buf buffer)
+{
+	char *fname;
+
+	if (get_buf_offset(buffer) > MAX_DBD_MSG_LEN)
+		return SLURM_ERROR;
+
+	if (overflow_wfd < 0) {
+		fname = _overflow_fname();
+		overflow_wfd = open(fname, O_WRONLY | O_CREAT | O_TRUNC |
+				    O_APPEND | O_CLOEXEC, 0600);
+		if (overflow_wfd >= 0)
+			overflow_rfd = open(fname, O_RDONLY | O_CLOEXEC);
+		if (overflow_rfd < 0) {
+			error("slurmdbd: Creating overflow file %s: %m",
+			      fname);
+			_overflow_close();
+			xfree(fname);
+			return SLURM_ERROR;
+		}
+		info("slurmdbd: agent queue is full, saving requests in %s",
+		     fname);
+		xfree(fname);
+	}
+
+	if (_save_dbd_rec(overflow_wfd, buffer) != SLURM_SUCCESS) {
+		/* Drop the partial record so the rest can be read back */
+		if (ftruncate(overflow_wfd, overflow_wsize) < 0)
+			error("slurmdbd: overflow file truncate: %m");
+		return SLURM_ERROR;
+	}
+	overflow_wsize += get_buf_offset(buffer) + (2 * sizeof(uint32_t));
+	overflow_wcnt++;
+	overflow_cnt++;
+
+	return SLURM_SUCCESS;
+}
+
+/* Move records from the overflow file back to agent_list once half of the
+ * queue has drained. Only the agent thread reads or removes the file, so it
+ * is read without agent_lock and RPCs can still be queued meanwhile. */
+static void _overflow_load(void)
+{
+	List recs;
+	Buf buffer;
+	uint32_t cnt = 0, want;
+	int fd, max_agent_queue = _max_agent_queue();
+
+	slurm_mutex_lock(&agent_lock);
+	if (!overflow_cnt || !agent_list ||
+	    (list_count(agent_list) > (max_agent_queue / 2))) {
+		slurm_mutex_unlock(&agent_lock);
+		return;
+	}
+	want = MIN(overflow_cnt, max_agent_queue - list_count(agent_list));
+	fd = overflow_rfd;
+	slurm_mutex_unlock(&agent_lock);
+
+	recs = list_create(NULL);
+	while ((cnt < want) && (buffer = _load_dbd_rec(fd))) {
+		list_enqueue(recs, buffer);
+		cnt++;
+	}
+
+	slurm_mutex_lock(&agent_lock);
+	list_transfer(agent_list, recs);
+	overflow_cnt -= cnt;
+	if (cnt < want) {
+		error("slurmdbd: discarding %u requests from unreadable "
+		      "overflow file", overflow_cnt);
+		overflow_cnt = 0;
+	}
+	if (!overflow_cnt)
+		_overflow_close();
+	debug("slurmdbd: moved %u requests from overflow file to agent "
+	      "queue, %u left", cnt, overflow_cnt);
+	slurm_mutex_unlock(&agent_lock);
+	FREE_NULL_LIST(recs);
+}
+
+/* Return true if a response from the SlurmDBD can be read now */
+static bool _agent_resp_ready(void)
+{
+	struct pollfd ufds;
+
+	ufds.fd     = slurmdbd_conn->fd;
+	ufds.events = POLLIN;
+	return (poll(&ufds, 1, 0) > 0);
+}
+
+/* Send the queued records which follow those already in flight as one
+ * batch, called with slurmdbd_lock locked
+ * OUT rc - SLURM_SUCCESS or the error sending the batch
+ * RET the batch sent, NULL if there was nothing to send or on error */
+static agent_batch_t *_agent_send_batch(int *rc)
+{
+	agent_batch_t *batch;
+	ListIterator itr;
+	Buf buffer;
+	slurmdbd_msg_t list_req;
+	dbd_list_msg_t list_msg;
+	uint32_t cnt = 0, skip = 0;
+
+	*rc = SLURM_SUCCESS;
+	slurm_mutex_lock(&agent_lock);
+	if (!agent_list ||
+	    (list_count(agent_list) <= agent_inflight_recs)) {
+		slurm_mutex_unlock(&agent_lock);
+		return NULL;
+	}
+
+	/* Leave items on the queue until their response arrives */
+	batch = xmalloc(sizeof(agent_batch_t));
+	batch->recs = list_create(NULL);
+	itr = list_iterator_create(agent_list);
+	while ((buffer = list_next(itr))) {
+		if (skip++ < agent_inflight_recs)
+			continue;
+		list_enqueue(batch->recs, buffer);
+		if (++cnt >= agent_batch_size)
+			break;
+	}
+	list_iterator_destroy(itr);
+
+	if (cnt > 1) {
+		memset(&list_msg, 0, sizeof(dbd_list_msg_t));
+		list_msg.my_list = batch->recs;
+		list_req.msg_type = DBD_SEND_MULT_MSG;
+		list_req.data = &list_msg;
+		buffer = pack_slurmdbd_msg(&list_req, SLURM_PROTOCOL_VERSION);
+		batch->mult = true;
+	} else
+		buffer = (Buf) list_peek(batch->recs);
+	agent_inflight_recs += cnt;
+	agent_inflight_cnt++;
+	slurm_mutex_unlock(&agent_lock);
+
+	/* NOTE: agent_lock is clear here, so we can add more
+	 * requests to the queue while sending */
+	gettimeofday(&batch->sent, NULL);
+	*rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
+	if (batch->mult)
+		free_buf(buffer);
+	if (*rc == SLURM_SUCCESS)
+		return batch;
+
+	slurm_mutex_lock(&agent_lock);
+	agent_inflight_recs -= cnt;
+	agent_inflight_cnt--;
+	slurm_mutex_unlock(&agent_lock);
+	FREE_NULL_LIST(batch->recs);
+	xfree(batch);
+	return NULL;
+}
+
+/* Remove the records acknowledged by the response to a batch from the
+ * agent queue, resize later batches from the time the SlurmDBD took to
+ * serve it and free the batch.
+ * IN acked - count of leading records in the batch processed
+ * IN rc - return code of the response
+ * IN/OUT last_resp - time of the previous response, NULL if abandoned */
+static void _agent_ack(agent_batch_t *batch, uint32_t acked, int rc,
+		       struct timeval *last_resp)
+{
+	ListIterator itr, rec_itr;
+	Buf buffer, next;
+	struct timeval now, *start;
+	uint32_t rtt, serve, cnt = list_count(batch->recs);
+
+	slurm_mutex_lock(&agent_lock);
+	if (acked && agent_list) {
+		/* Records of one batch are in order in agent_list, but
+		 * may follow unacknowledged ones of an earlier batch */
+		itr = list_iterator_create(agent_list);
+		rec_itr = list_iterator_create(batch->recs);
+		next = list_next(rec_itr);
+		while (next && (buffer = list_next(itr))) {
+			if (buffer != next)
+				continue;
+			list_delete_item(itr);
+			agent_inflight_recs--;
+			if (--acked == 0)
+				break;
+			next = list_next(rec_itr);
+		}
+		list_iterator_destroy(rec_itr);
+		list_iterator_destroy(itr);
+	}
+	agent_inflight_cnt--;
+
+	if (last_resp) {
+		gettimeofday(&now, NULL);
+		rtt = ((now.tv_sec - batch->sent.tv_sec) * 1000000) +
+		      (now.tv_usec - batch->sent.tv_usec);
+		agent_rtt_last = rtt;
+		agent_rtt_max = MAX(agent_rtt_max, rtt);
+		agent_rtt_sum += rtt;
+		agent_rtt_cnt++;
+
+		/* The SlurmDBD serves batches one at a time, so this one
+		 * was not started before the previous response */
+		start = &batch->sent;
+		if (timercmp(last_resp, start, >))
+			start = last_resp;
+		serve = ((now.tv_sec - start->tv_sec) * 1000000) +
+			(now.tv_usec - start->tv_usec);
+		*last_resp = now;
+
+		if ((rc != SLURM_SUCCESS) || (serve > DBD_BATCH_SLOW_USEC)) {
+			agent_batch_size = MAX(agent_batch_size / 2,
+					       DBD_BATCH_MIN);
+		} else if (batch->mult && (cnt >= agent_batch_size) &&
+			   (serve < DBD_BATCH_FAST_USEC)) {
+			agent_batch_size = MIN(agent_batch_size +
+					       (agent_batch_size / 4),
+					       DBD_BATCH_MAX);
+		}
+	}
+	slurm_mutex_unlock(&agent_lock);
+
+	FREE_NULL_LIST(batch->recs);
+	xfree(batch);
+}
+
 static void *_agent(void *x)
 {
 	int cnt, rc;
-	Buf buffer;
 	struct timespec abs_time;
 	static time_t fail_time = 0;
 	int sigarray[] = {SIGUSR1, 0};
-	slurmdbd_msg_t list_req;
-	dbd_list_msg_t list_msg;
-
-	list_req.msg_type = DBD_SEND_MULT_MSG;
-	list_req.data = &list_msg;
-	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
+	List inflight;
+	agent_batch_t *batch;
+	struct timeval last_resp;
+	uint32_t acked;
+	uint16_t reconnect;
+	bool conn_lost, failed, idle, lost_resp;
+
+	inflight = list_create(NULL);
 	/* DEF_TIMERS; */
 
 	/* Prepare to catch SIGUSR1 to interrupt pending
@@ -1949,6 +2396,8 @@ static void *_agent(void *x)
 				fail_time = time(NULL);
 		}
 
+		_overflow_load();
+
 		slurm_mutex_lock(&agent_lock);
 		if (agent_list && slurmdbd_conn->fd)
 			cnt = list_count(agent_list);
@@ -1965,102 +2414,87 @@ static void *_agent(void *x)
 			continue;
 		} else if ((cnt > 0) && ((cnt % 100) == 0))
 			info("slurmdbd: agent queue size %u", cnt);
-		/* Leave item on the queue until processing complete */
-		if (agent_list) {
-			int handle_agent_count = 1000;
-			if (cnt > handle_agent_count) {
-				int agent_count = 0;
-				ListIterator agent_itr =
-					list_iterator_create(agent_list);
-				list_msg.my_list = list_create(NULL);
-				while ((buffer = list_next(agent_itr))) {
-					list_enqueue(list_msg.my_list, buffer);
-					agent_count++;
-					if (agent_count > handle_agent_count)
-						break;
-				}
-				list_iterator_destroy(agent_itr);
-				buffer = pack_slurmdbd_msg(
-					&list_req, SLURM_PROTOCOL_VERSION);
-			} else if (cnt > 1) {
-				list_msg.my_list = agent_list;
-				buffer = pack_slurmdbd_msg(
-					&list_req, SLURM_PROTOCOL_VERSION);
-			} else
-				buffer = (Buf) list_peek(agent_list);
-		} else
-			buffer = NULL;
 		slurm_mutex_unlock(&agent_lock);
-		if (buffer == NULL) {
-			slurm_mutex_unlock(&slurmdbd_lock);
 
-			slurm_mutex_lock(&assoc_cache_mutex);
-			if (slurmdbd_conn->fd >= 0 && running_cache)
-				slurm_cond_signal(&assoc_cache_cond);
-			slurm_mutex_unlock(&assoc_cache_mutex);
-
-			continue;
-		}
+		/*
+		 * Keep up to DBD_AGENT_WINDOW batches in flight, reading
+		 * responses as they arrive so the SlurmDBD never blocks
+		 * writing them. A send or receive which fails reopens the
+		 * connection, so later responses would be paired with the
+		 * wrong batches. Only permit that with a single batch in
+		 * flight and otherwise drop the rest and close it.
+		 */
+		reconnect = slurmdbd_conn->flags & PERSIST_FLAG_RECONNECT;
+		conn_lost = failed = idle = lost_resp = false;
+		timerclear(&last_resp);
+		while (1) {
+			if (!conn_lost && !failed && !idle && !halt_agent &&
+			    !(*slurmdbd_conn->shutdown) &&
+			    (list_count(inflight) < DBD_AGENT_WINDOW) &&
+			    (!list_count(inflight) || !_agent_resp_ready())) {
+				if (list_count(inflight))
+					slurmdbd_conn->flags &=
+						~PERSIST_FLAG_RECONNECT;
+				else
+					slurmdbd_conn->flags |= reconnect;
+				if ((batch = _agent_send_batch(&rc))) {
+					list_enqueue(inflight, batch);
+					continue;
+				}
+				if (rc == SLURM_SUCCESS) {
+					idle = true;
+				} else {
+					if (!(*slurmdbd_conn->shutdown))
+						error("slurmdbd: Failure "
+						      "sending message: %d: %m",
+						      rc);
+					conn_lost = true;
+					failed = true;
+				}
+			}
 
-		/* NOTE: agent_lock is clear here, so we can add more
-		 * requests to the queue while waiting for this RPC to
-		 * complete. */
-		rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
-		if (rc != SLURM_SUCCESS) {
-			if (*slurmdbd_conn->shutdown) {
-				slurm_mutex_unlock(&slurmdbd_lock);
+			if (!(batch = list_dequeue(inflight)))
 				break;
+			if (conn_lost) {
+				/* Response will never be read */
+				lost_resp = true;
+				_agent_ack(batch, 0, SLURM_ERROR, NULL);
+				continue;
 			}
-			error("slurmdbd: Failure sending message: %d: %m", rc);
-		} else if (list_msg.my_list) {
-			rc = _handle_mult_rc_ret();
-		} else {
-			rc = _get_return_code();
-			if (rc == EAGAIN) {
-				if (*slurmdbd_conn->shutdown) {
-					slurm_mutex_unlock(&slurmdbd_lock);
-					break;
-				}
+			if (list_count(inflight))
+				slurmdbd_conn->flags &= ~PERSIST_FLAG_RECONNECT;
+			else
+				slurmdbd_conn->flags |= reconnect;
+			rc = _handle_mult_rc_ret(batch, &acked, &conn_lost);
+			if ((rc == EAGAIN) && !batch->mult &&
+			    !(*slurmdbd_conn->shutdown))
 				error("slurmdbd: Failure with "
 				      "message need to resend: %d: %m", rc);
-			}
+			_agent_ack(batch, acked, rc,
+				   conn_lost ? NULL : &last_resp);
+			if (rc != SLURM_SUCCESS)
+				failed = true;
+			idle = false;
 		}
+		slurmdbd_conn->flags |= reconnect;
+		if (lost_resp)
+			slurm_persist_conn_close(slurmdbd_conn);
+
+		slurm_mutex_lock(&agent_lock);
+		agent_inflight_recs = 0;
+		agent_inflight_cnt = 0;
+		slurm_mutex_unlock(&agent_lock);
+
 		slurm_mutex_unlock(&slurmdbd_lock);
 		slurm_mutex_lock(&assoc_cache_mutex);
 		if (slurmdbd_conn->fd >= 0 && running_cache)
 			slurm_cond_signal(&assoc_cache_cond);
 		slurm_mutex_unlock(&assoc_cache_mutex);
 
-		slurm_mutex_lock(&agent_lock);
-		if (agent_list && (rc == SLURM_SUCCESS)) {
-			/* If we sent a mult_msg we just need to free
-			   buffer, we don't need to requeue, just mark
-			   list_msg.my_list as NULL as that is the
-			   sign we sent a mult_msg.
-			*/
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					FREE_NULL_LIST(list_msg.my_list);
-				list_msg.my_list = NULL;
-			} else
-				buffer = (Buf) list_dequeue(agent_list);
-
-			free_buf(buffer);
-			fail_time = 0;
-		} else {
-			/* We still need to free a mult_msg even if we
-			   got a failure.
-			*/
-			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					FREE_NULL_LIST(list_msg.my_list);
-				list_msg.my_list = NULL;
-				free_buf(buffer);
-			}
-
+		if (failed)
 			fail_time = time(NULL);
-		}
-		slurm_mutex_unlock(&agent_lock);
+		else
+			fail_time = 0;
 		/* END_TIMER; */
 		/* info("at the end with %s", TIME_STR); */
 		if (need_to_register) {
@@ -2074,6 +2508,7 @@ static void *_agent(void *x)
 		}
 	}
 
+	FREE_NULL_LIST(inflight);
 	slurm_mutex_lock(&agent_lock);
 	_save_dbd_state();
 	FREE_NULL_LIST(agent_list);
@@ -2095,8 +2530,15 @@ static void _save_dbd_state(void)
 	fd = open(dbd_fname, O_WRONLY | O_CREAT | O_TRUNC, 0600);
 	if (fd < 0) {
 		error("slurmdbd: Creating state save file %s", dbd_fname);
-	} else if (agent_list && list_count(agent_list)) {
+	} else if (agent_list && (list_count(agent_list) || overflow_cnt)) {
 		char curr_ver_str[10];
+
+		/* Records in the overflow file follow the queued ones */
+		while (overflow_cnt && (buffer = _load_dbd_rec(overflow_rfd))) {
+			list_enqueue(agent_list, buffer);
+			overflow_cnt--;
+		}
+
 		snprintf(curr_ver_str, sizeof(curr_ver_str),
 			 "VER%d", SLURM_PROTOCOL_VERSION);
 		buffer = init_buf(strlen(curr_ver_str));
@@ -2135,6 +2577,7 @@ static void _save_dbd_state(void)
 	}
 
 end_it:
+	_overflow_close();
 	if (fd >= 0) {
 		verbose("slurmdbd: saved %d pending RPCs", wrote);
 		(void) close(fd);
@@ -2322,11 +2765,16 @@ static int _purge_step_req(void)
 	int purged = 0;
 	ListIterator iter;
 	uint16_t msg_type;
-	uint32_t offset;
+	uint32_t offset, skip = 0;
 	Buf buffer;
 
 	iter = list_iterator_create(agent_list);
 	while ((buffer = list_next(iter))) {
+		/* Records in flight are removed by their response */
+		if (skip < agent_inflight_recs) {
+			skip++;
+			continue;
+		}
 		offset = get_buf_offset(buffer);
 		if (offset < 2)
 			continue;
@@ -2335,7 +2783,7 @@ static int _purge_step_req(void)
 		set_buf_offset(buffer, offset);
 		if ((msg_type == DBD_STEP_START) ||
 		    (msg_type == DBD_STEP_COMPLETE)) {
-			list_remove(iter);
+			list_delete_item(iter);
 			purged++;
 		}
 	}
@@ -2351,11 +2799,16 @@ static int _purge_job_start_req(void)
 	int purged = 0;
 	ListIterator iter;
 	uint16_t msg_type;
-	uint32_t offset;
+	uint32_t offset, skip = 0;
 	Buf buffer;
 
 	iter = list_iterator_create(agent_list);
 	while ((buffer = list_next(iter))) {
+		/* Records in flight are removed by their response */
+		if (skip < agent_inflight_recs) {
+			skip++;
+			continue;
+		}
 		offset = get_buf_offset(buffer);
 		if (offset < 2)
 			continue;
@@ -2363,7 +2816,7 @@ static int _purge_job_start_req(void)
 		unpack16(&msg_type, buffer);
 		set_buf_offset(buffer, offset);
 		if (msg_type == DBD_JOB_START) {
-			list_remove(iter);
+			list_delete_item(iter);
 			purged++;
 		}
 	}
@@ -2446,6 +2899,7 @@ extern void slurmdbd_free_msg(slurmdbd_msg_t *msg)
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_STREAM:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
 	case DBD_GET_RESVS:
@@ -2584,6 +3038,7 @@ extern void slurmdbd_free_cond_msg(dbd_cond_msg_t *msg,
 			my_destroy = slurmdb_destroy_federation_cond;
 			break;
 		case DBD_GET_JOBS_COND:
+		case DBD_GET_JOBS_STREAM:
 			my_destroy = slurmdb_destroy_job_cond;
 			break;
 		case DBD_GET_QOS:
@@ -2982,6 +3437,7 @@ extern void slurmdbd_pack_cond_msg(dbd_cond_msg_t *msg,
 		my_function = slurmdb_pack_federation_cond;
 		break;
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_STREAM:
 		my_function = slurmdb_pack_job_cond;
 		break;
 	case DBD_GET_QOS:
@@ -3049,6 +3505,7 @@ extern int slurmdbd_unpack_cond_msg(dbd_cond_msg_t **msg,
 		my_function = slurmdb_unpack_federation_cond;
 		break;
 	case DBD_GET_JOBS_COND:
+	case DBD_GET_JOBS_STREAM:
 		my_function = slurmdb_unpack_job_cond;
 		break;
 	case DBD_GET_QOS:
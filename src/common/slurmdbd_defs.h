@@ -155,6 +155,9 @@ typedef enum {
 	DBD_GOT_FEDERATIONS,	/* Response to DBD_GET_FEDERATIONS 	*/
 	DBD_MODIFY_FEDERATIONS, /* Modify existing federation 		*/
 	DBD_REMOVE_FEDERATIONS, /* Removing existing federation 	*/
+	DBD_GET_JOBS_STREAM,	/* Get job information with a condition,
+				 * sent back in DBD_GOT_JOBS messages of
+				 * some jobs each, then a PERSIST_RC */
 
 	SLURM_PERSIST_INIT = 6500, /* So we don't use the
 				    * REQUEST_PERSIST_INIT also used here.
@@ -382,6 +385,19 @@ typedef struct dbd_step_start_msg {
 	char *tres_alloc_str;   /* Simple comma separated list of TRES */
 } dbd_step_start_msg_t;
 
+/* State of the agent sending queued RPCs to the SlurmDBD */
+typedef struct {
+	uint32_t queue_size;	/* RPCs queued in memory */
+	uint32_t overflow_size;	/* RPCs queued in StateSaveLocation */
+	uint32_t inflight_batches; /* batches sent, awaiting response */
+	uint32_t inflight_recs;	/* RPCs in those batches */
+	uint32_t batch_size;	/* most RPCs sent in one batch */
+	uint32_t rtt_last;	/* usec from sending a batch to response */
+	uint32_t rtt_max;
+	uint64_t rtt_sum;
+	uint32_t rtt_cnt;
+} slurmdbd_agent_stats_t;
+
 /* flag to let us know if we are running on cache or from the actual
  * database */
 extern uint16_t running_cache;
@@ -423,6 +439,17 @@ extern int slurm_send_recv_slurmdbd_msg(uint16_t rpc_version,
 					slurmdbd_msg_t *req,
 					slurmdbd_msg_t *resp);
 
+/* Send an RPC to the SlurmDBD and pass each reply message to callback
+ * until a PERSIST_RC ends the reply. The callback must free the message,
+ * once it fails the rest of the reply is discarded.
+ * The RPC will not be queued if an error occurs.
+ * Returns SLURM_SUCCESS or an error code, errno is set to the PERSIST_RC's */
+extern int slurm_send_recv_slurmdbd_msgs(uint16_t rpc_version,
+					 slurmdbd_msg_t *req,
+					 int (*callback)(slurmdbd_msg_t *resp,
+							 void *arg),
+					 void *arg);
+
 /* Send an RPC to the SlurmDBD and wait for the return code reply.
  * The RPC will not be queued if an error occurs.
  * Returns SLURM_SUCCESS or an error code */
@@ -430,6 +457,12 @@ extern int slurm_send_slurmdbd_recv_rc_msg(uint16_t rpc_version,
 					   slurmdbd_msg_t *req,
 					   int *rc);
 
+/* Report the state of the agent, all zero if it is not running */
+extern void slurmdbd_agent_get_stats(slurmdbd_agent_stats_t *stats);
+
+/* Clear the response time statistics of the agent */
+extern void slurmdbd_agent_reset_stats(void);
+
 extern Buf pack_slurmdbd_msg(slurmdbd_msg_t *req, uint16_t rpc_version);
 extern int unpack_slurmdbd_msg(slurmdbd_msg_t *resp,
 			       uint16_t rpc_version, Buf buffer);
@@ -0,0 +1,225 @@
+/*****************************************************************************\
+ *  step_trace.c - Record timestamped spans of job step launch activity
+ *  into a per-process ring buffer and dump them to a file per step.
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/step_trace.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+/* Spans held per process, the oldest are overwritten when full */
+#define STEP_TRACE_RING_SIZE 4096
+/* Files tried for one dump if the first names exist already */
+#define STEP_TRACE_MAX_FILES 10
+
+typedef struct {
+	uint32_t job_id;
+	uint32_t step_id;
+	const char *name;
+	struct timeval start;
+	long usec;		/* duration, 0 if dumped */
+} step_span_t;
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int trace_enabled = -1;	/* -1 until configuration is read */
+static char *trace_dir = NULL;
+static step_span_t *trace_ring = NULL;
+static int trace_next = 0;	/* next ring slot to use */
+
+/* Read LaunchParameters, called with trace_mutex locked. The ring buffer is
+ * kept across reconfiguration so spans of steps being launched survive. */
+static void _trace_init(void)
+{
+	char *launch_params, *tmp_ptr, *sep;
+
+	trace_enabled = 0;
+	launch_params = slurm_get_launch_params();
+	if (launch_params &&
+	    (tmp_ptr = strstr(launch_params, "step_trace_dir="))) {
+		trace_dir = xstrdup(tmp_ptr + 15);
+		if ((sep = strchr(trace_dir, ',')))
+			sep[0] = '\0';
+		if (trace_dir[0] == '/') {
+			if (!trace_ring)
+				trace_ring = xmalloc(sizeof(step_span_t) *
+						     STEP_TRACE_RING_SIZE);
+			trace_enabled = 1;
+		} else {
+			error("LaunchParameters step_trace_dir must be an "
+			      "absolute path");
+			xfree(trace_dir);
+		}
+	}
+	xfree(launch_params);
+}
+
+extern bool step_trace_enabled(void)
+{
+	if (trace_enabled == -1) {
+		slurm_mutex_lock(&trace_mutex);
+		if (trace_enabled == -1)
+			_trace_init();
+		slurm_mutex_unlock(&trace_mutex);
+	}
+
+	return (trace_enabled == 1);
+}
+
+extern void step_trace_span(uint32_t job_id, uint32_t step_id,
+			    const char *name, struct timeval *start,
+			    struct timeval *end)
+{
+	struct timeval now;
+	step_span_t *span;
+
+	if (!step_trace_enabled())
+		return;
+
+	if (end)
+		now = *end;
+	else
+		gettimeofday(&now, NULL);
+	slurm_mutex_lock(&trace_mutex);
+	if (!trace_ring) {	/* step_trace_fini() called */
+		slurm_mutex_unlock(&trace_mutex);
+		return;
+	}
+	span = &trace_ring[trace_next];
+	trace_next = (trace_next + 1) % STEP_TRACE_RING_SIZE;
+	span->job_id  = job_id;
+	span->step_id = step_id;
+	span->name    = name;
+	span->start   = *start;
+	span->usec    = ((now.tv_sec - start->tv_sec) * 1000000) +
+			(now.tv_usec - start->tv_usec);
+	if (span->usec <= 0)
+		span->usec = 1;
+	slurm_mutex_unlock(&trace_mutex);
+}
+
+extern void step_trace_dump(uint32_t job_id, uint32_t step_id)
+{
+	char host[64], *dir = NULL, *path = NULL, *out = NULL, *prog;
+	step_span_t *span;
+	int fd = -1, i, len;
+	pid_t pid = getpid();
+
+	if (!step_trace_enabled())
+		return;
+
+	if (gethostname(host, sizeof(host)) < 0)
+		strcpy(host, "unknown");
+	host[sizeof(host) - 1] = '\0';
+	prog = slurm_prog_name ? slurm_prog_name : "unknown";
+	if (strrchr(prog, '/'))
+		prog = strrchr(prog, '/') + 1;
+
+	/* Oldest first, the ring is in time order from trace_next */
+	slurm_mutex_lock(&trace_mutex);
+	for (i = 0; trace_ring && (i < STEP_TRACE_RING_SIZE); i++) {
+		span = &trace_ring[(trace_next + i) % STEP_TRACE_RING_SIZE];
+		if (!span->usec || (span->job_id != job_id) ||
+		    (span->step_id != step_id))
+			continue;
+		xstrfmtcat(out, "%u.%u %s %s %d %s %"PRId64" %ld\n",
+			   job_id, step_id, host, prog, (int) pid, span->name,
+			   ((int64_t) span->start.tv_sec * 1000000) +
+			   span->start.tv_usec, span->usec);
+		span->usec = 0;
+	}
+	dir = xstrdup(trace_dir);
+	slurm_mutex_unlock(&trace_mutex);
+	if (!out || !dir) {
+		xfree(dir);
+		xfree(out);
+		return;
+	}
+
+	/*
+	 * The directory may be world writable and shared by all nodes, and
+	 * this may run as root. Always create a new file, named after the
+	 * host and process, and never follow a link or open an existing
+	 * file. Should the same process dump a step twice, a numbered file
+	 * is used.
+	 */
+	for (i = 0; i < STEP_TRACE_MAX_FILES; i++) {
+		xfree(path);
+		xstrfmtcat(path, "%s/%u.%u.%s.%s.%d", dir, job_id, step_id,
+			   host, prog, (int) pid);
+		if (i)
+			xstrfmtcat(path, ".%d", i);
+		xstrcat(path, ".trace");
+		fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW |
+			  O_CLOEXEC, 0644);
+		if ((fd >= 0) || (errno != EEXIST))
+			break;
+	}
+	if (fd < 0) {
+		error("%s: open(%s): %m", __func__, path);
+	} else {
+		len = strlen(out);
+		if (write(fd, out, len) != len)
+			error("%s: write(%s): %m", __func__, path);
+		(void) close(fd);
+	}
+	xfree(dir);
+	xfree(path);
+	xfree(out);
+}
+
+extern void step_trace_reconfig(void)
+{
+	slurm_mutex_lock(&trace_mutex);
+	xfree(trace_dir);
+	trace_enabled = -1;
+	slurm_mutex_unlock(&trace_mutex);
+}
+
+extern void step_trace_fini(void)
+{
+	slurm_mutex_lock(&trace_mutex);
+	xfree(trace_dir);
+	xfree(trace_ring);
+	trace_next = 0;
+	trace_enabled = -1;
+	slurm_mutex_unlock(&trace_mutex);
+}
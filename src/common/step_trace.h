@@ -0,0 +1,80 @@
+/*****************************************************************************\
+ *  step_trace.h - Record timestamped spans of job step launch activity
+ *  into a per-process ring buffer and dump them to a file per step.
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _STEP_TRACE_H
+#define _STEP_TRACE_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
+/*
+ * Tracing is enabled by LaunchParameters=step_trace_dir=<path>. A job step
+ * is identified by its job and step ID in every process (srun, slurmctld,
+ * slurmd and slurmstepd), so spans recorded in each can be merged by step.
+ * Times are wall clock, so merging spans across nodes relies on their
+ * clocks being synchronized.
+ */
+
+/* Return true if step tracing is configured, reading the configuration on
+ * first use */
+extern bool step_trace_enabled(void);
+
+/*
+ * Record a span of launch activity for a job step.
+ * IN job_id, step_id - job step the activity belongs to
+ * IN name - name of the span, must be a string constant
+ * IN start - when the activity started
+ * IN end - when the activity ended, or NULL for now
+ */
+extern void step_trace_span(uint32_t job_id, uint32_t step_id,
+			    const char *name, struct timeval *start,
+			    struct timeval *end);
+
+/*
+ * Write the spans recorded by this process for a job step to a new file
+ * <step_trace_dir>/<job_id>.<step_id>.<host>.<program>.<pid>.trace and
+ * remove them from the ring buffer. Each line holds: job.step host program
+ * pid span start_usec duration_usec
+ * This does file I/O, do not call it with locks held.
+ */
+extern void step_trace_dump(uint32_t job_id, uint32_t step_id);
+
+/* Read LaunchParameters again on next use, call on reconfiguration */
+extern void step_trace_reconfig(void);
+
+/* Free memory used for tracing */
+extern void step_trace_fini(void);
+
+#endif
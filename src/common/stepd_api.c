@@ -764,6 +764,22 @@ rwfail:
 	return SLURM_ERROR;
 }
 
+extern int stepd_io_forward(int fd, uint16_t protocol_version, int io_fd)
+{
+	int req = REQUEST_IO_FORWARD;
+	int rc;
+
+	safe_write(fd, &req, sizeof(int));
+	send_fd_over_pipe(fd, io_fd);
+
+	/* Receive the return code */
+	safe_read(fd, &rc, sizeof(int));
+
+	return rc;
+rwfail:
+	return SLURM_ERROR;
+}
+
 /*
  * Return the process ID of the slurmstepd.
  */
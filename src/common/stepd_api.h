@@ -70,7 +70,8 @@ typedef enum {
 	REQUEST_STEP_MEM_LIMITS,
 	REQUEST_STEP_UID,
 	REQUEST_STEP_NODEID,
-	REQUEST_ADD_EXTERN_PID
+	REQUEST_ADD_EXTERN_PID,
+	REQUEST_IO_FORWARD
 } step_msg_t;
 
 typedef enum {
@@ -214,6 +215,15 @@ bool stepd_pid_in_container(int fd, uint16_t protocol_version, pid_t pid);
  */
 extern int stepd_add_extern_pid(int fd, uint16_t protocol_version, pid_t pid);
 
+/*
+ * Pass the I/O connection of a slurmstepd on another node of the step to
+ * this slurmstepd, which forwards its I/O to srun.  Only root or SlurmUser
+ * is authorized to use this call.
+ *
+ * Returns SLURM_SUCCESS if the slurmstepd took the connection.
+ */
+extern int stepd_io_forward(int fd, uint16_t protocol_version, int io_fd);
+
 /*
  * Return the process ID of the slurmstepd.
  */
@@ -40,6 +40,8 @@
 
 #include "config.h"
 
+#include <ctype.h>
+
 #include "mysql_common.h"
 #include "src/common/log.h"
 #include "src/common/xstring.h"
@@ -50,6 +52,10 @@
 
 static char *table_defs_table = "table_defs_table";
 
+/* Queued queries are sent once either limit is reached */
+#define MAX_BATCH_ROWS		1000
+#define MAX_BATCH_SIZE		(1024 * 1024)
+
 typedef struct {
 	char *name;
 	char *columns;
@@ -132,8 +138,9 @@ static MYSQL_RES *_get_last_result(MYSQL *db_conn)
 }
 
 /* NOTE: Insure that mysql_conn->lock is set on function entry */
-static int _mysql_query_internal(MYSQL *db_conn, char *query)
+static int _mysql_query_internal(mysql_conn_t *mysql_conn, char *query)
 {
+	MYSQL *db_conn = mysql_conn->db_conn;
 	int rc = SLURM_SUCCESS;
 
 	if (!db_conn)
@@ -152,7 +159,11 @@ static int _mysql_query_internal(MYSQL *db_conn, char *query)
 			goto end_it;
 		}
 		error("mysql_query failed: %d %s\n%s", errno, err_str, query);
-		if (errno == ER_LOCK_WAIT_TIMEOUT) {
+		if ((errno == ER_LOCK_WAIT_TIMEOUT) && mysql_conn->lock_wait) {
+			/* Only the query was rolled back, the rest of the
+			 * transaction must not be committed without it */
+			mysql_conn->batch_failed = true;
+		} else if (errno == ER_LOCK_WAIT_TIMEOUT) {
 			/* FIXME: If we get ER_LOCK_WAIT_TIMEOUT here we need
 			 * to restart the connections, but it appears restarting
 			 * the calling program is the only way to handle this.
@@ -163,6 +174,11 @@ static int _mysql_query_internal(MYSQL *db_conn, char *query)
 			fatal("mysql gave ER_LOCK_WAIT_TIMEOUT as an error. "
 			      "The only way to fix this is restart the "
 			      "calling program");
+		} else if ((errno == ER_LOCK_DEADLOCK) && mysql_conn->rollback) {
+			/* The whole transaction was rolled back, what runs
+			 * next on the connection must not be committed as if
+			 * it followed it */
+			mysql_conn->batch_failed = true;
 		} else if (errno == ER_HOST_IS_BLOCKED) {
 			fatal("MySQL gave ER_HOST_IS_BLOCKED as an error. "
 			      "You will need to call 'mysqladmin flush-hosts' "
@@ -174,6 +190,69 @@ end_it:
 	return rc;
 }
 
+/* Free queued queries without sending them, mysql_conn->lock must be set */
+static void _discard_batch(mysql_conn_t *mysql_conn)
+{
+	xfree(mysql_conn->batch_insert);
+	xfree(mysql_conn->batch_query);
+	xfree(mysql_conn->batch_update);
+	mysql_conn->batch_rows = 0;
+}
+
+/* Terminate the multi-row insert open at the end of the batch, if any */
+static void _close_batch_insert(mysql_conn_t *mysql_conn)
+{
+	if (!mysql_conn->batch_insert)
+		return;
+
+	if (mysql_conn->batch_update)
+		xstrfmtcat(mysql_conn->batch_query, " %s;",
+			   mysql_conn->batch_update);
+	else
+		xstrcat(mysql_conn->batch_query, ";");
+	xfree(mysql_conn->batch_insert);
+	xfree(mysql_conn->batch_update);
+}
+
+/*
+ * Send all queued queries in one round trip, mysql_conn->lock must be set.
+ * MySQL skips the queries after one that fails, so on failure the queries
+ * are freed and the transaction is marked as needing a rollback.
+ */
+static int _flush_batch(mysql_conn_t *mysql_conn)
+{
+	int rc;
+	DEF_TIMERS;
+
+	if (!mysql_conn->batch_query)
+		return SLURM_SUCCESS;
+
+	_close_batch_insert(mysql_conn);
+	START_TIMER;
+	if ((rc = _mysql_query_internal(mysql_conn,
+					mysql_conn->batch_query)) == SLURM_SUCCESS)
+		rc = _clear_results(mysql_conn->db_conn);
+	END_TIMER2("mysql_db_flush_batch");
+	debug4("%d(%s:%d) sent %u queued queries in %s",
+	       mysql_conn->conn, THIS_FILE, __LINE__,
+	       mysql_conn->batch_rows, TIME_STR);
+	if (rc != SLURM_SUCCESS)
+		mysql_conn->batch_failed = true;
+	_discard_batch(mysql_conn);
+
+	return rc;
+}
+
+/* Count a queued query or row, sending the batch if it is full */
+static int _batch_added(mysql_conn_t *mysql_conn)
+{
+	if ((++mysql_conn->batch_rows >= MAX_BATCH_ROWS) ||
+	    (strlen(mysql_conn->batch_query) >= MAX_BATCH_SIZE))
+		return _flush_batch(mysql_conn);
+
+	return SLURM_SUCCESS;
+}
+
 /* NOTE: Insure that mysql_conn->lock is NOT set on function entry */
 static int _mysql_make_table_current(mysql_conn_t *mysql_conn, char *table_name,
 				     storage_field_t *fields, char *ending)
@@ -728,9 +807,19 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 					mysql_autocommit(
 						mysql_conn->db_conn, 0);
 				rc = _mysql_query_internal(
-					mysql_conn->db_conn,
+					mysql_conn,
 					"SET session sql_mode='ANSI_QUOTES,"
 					"NO_ENGINE_SUBSTITUTION';");
+				if ((rc == SLURM_SUCCESS) &&
+				    mysql_conn->lock_wait) {
+					char *query = xstrdup_printf(
+						"SET session "
+						"innodb_lock_wait_timeout=%u;",
+						mysql_conn->lock_wait);
+					rc = _mysql_query_internal(mysql_conn,
+								   query);
+					xfree(query);
+				}
 			}
 		}
 	}
@@ -742,6 +831,12 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 extern int mysql_db_close_db_connection(mysql_conn_t *mysql_conn)
 {
 	slurm_mutex_lock(&mysql_conn->lock);
+	if (mysql_conn->batch_query) {
+		error("%s: discarding %u queued queries", __func__,
+		      mysql_conn->batch_rows);
+		mysql_conn->batch_failed = true;
+		_discard_batch(mysql_conn);
+	}
 	if (mysql_conn && mysql_conn->db_conn) {
 		if (mysql_thread_safe())
 			mysql_thread_end();
@@ -774,7 +869,8 @@ extern int mysql_db_query(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
-	rc = _mysql_query_internal(mysql_conn->db_conn, query);
+	if ((rc = _flush_batch(mysql_conn)) == SLURM_SUCCESS)
+		rc = _mysql_query_internal(mysql_conn, query);
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
 }
@@ -792,7 +888,9 @@ extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
-	if (!(rc = _mysql_query_internal(mysql_conn->db_conn, query)))
+	if ((rc = _flush_batch(mysql_conn)) != SLURM_SUCCESS)
+		rc = -1;
+	else if (!(rc = _mysql_query_internal(mysql_conn, query)))
 		rc = mysql_affected_rows(mysql_conn->db_conn);
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
@@ -821,6 +919,12 @@ extern int mysql_db_commit(mysql_conn_t *mysql_conn)
 		return SLURM_ERROR;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	if ((_flush_batch(mysql_conn) != SLURM_SUCCESS) ||
+	    mysql_conn->batch_failed) {
+		/* Leave it to the caller to roll back */
+		slurm_mutex_unlock(&mysql_conn->lock);
+		return SLURM_ERROR;
+	}
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
 	if (mysql_commit(mysql_conn->db_conn)) {
@@ -842,6 +946,8 @@ extern int mysql_db_rollback(mysql_conn_t *mysql_conn)
 		return SLURM_ERROR;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	_discard_batch(mysql_conn);
+	mysql_conn->batch_failed = false;
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
 	if (mysql_rollback(mysql_conn->db_conn)) {
@@ -862,7 +968,9 @@ extern MYSQL_RES *mysql_db_query_ret(mysql_conn_t *mysql_conn,
 	MYSQL_RES *result = NULL;
 
 	slurm_mutex_lock(&mysql_conn->lock);
-	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
+	if (_flush_batch(mysql_conn) != SLURM_SUCCESS)
+		goto fini;
+	if (_mysql_query_internal(mysql_conn, query) != SLURM_ERROR)  {
 		if (mysql_errno(mysql_conn->db_conn) == ER_NO_SUCH_TABLE)
 			goto fini;
 		else if (last)
@@ -886,8 +994,9 @@ extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query)
 	int rc = SLURM_SUCCESS;
 
 	slurm_mutex_lock(&mysql_conn->lock);
-	if ((rc = _mysql_query_internal(
-		     mysql_conn->db_conn, query)) != SLURM_ERROR)
+	if (((rc = _flush_batch(mysql_conn)) == SLURM_SUCCESS) &&
+	    ((rc = _mysql_query_internal(
+		      mysql_conn, query)) != SLURM_ERROR))
 		rc = _clear_results(mysql_conn->db_conn);
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
@@ -898,7 +1007,8 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 	uint64_t new_id = 0;
 
 	slurm_mutex_lock(&mysql_conn->lock);
-	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
+	if ((_flush_batch(mysql_conn) == SLURM_SUCCESS) &&
+	    (_mysql_query_internal(mysql_conn, query) != SLURM_ERROR)) {
 		new_id = mysql_insert_id(mysql_conn->db_conn);
 		if (!new_id) {
 			/* should have new id */
@@ -911,6 +1021,68 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 
 }
 
+extern int mysql_db_query_batch(mysql_conn_t *mysql_conn, char *query)
+{
+	int len, rc;
+
+	if (!mysql_conn->batch)
+		return mysql_db_query(mysql_conn, query);
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	_close_batch_insert(mysql_conn);
+	xstrcat(mysql_conn->batch_query, query);
+	len = strlen(query);
+	while ((len > 0) && isspace((int) query[len - 1]))
+		len--;
+	if (!len || (query[len - 1] != ';'))
+		xstrcat(mysql_conn->batch_query, ";");
+	rc = _batch_added(mysql_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+
+	return rc;
+}
+
+extern int mysql_db_insert_batch(mysql_conn_t *mysql_conn, char *insert,
+				 char *row, char *update)
+{
+	int rc;
+
+	if (!mysql_conn->batch) {
+		char *query = xstrdup_printf("%s %s %s;", insert, row,
+					     update ? update : "");
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		return rc;
+	}
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	if (mysql_conn->batch_insert &&
+	    !xstrcmp(mysql_conn->batch_insert, insert) &&
+	    !xstrcmp(mysql_conn->batch_update, update)) {
+		xstrfmtcat(mysql_conn->batch_query, ", %s", row);
+	} else {
+		_close_batch_insert(mysql_conn);
+		xstrfmtcat(mysql_conn->batch_query, "%s %s", insert, row);
+		mysql_conn->batch_insert = xstrdup(insert);
+		mysql_conn->batch_update = xstrdup(update);
+	}
+	rc = _batch_added(mysql_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+
+	return rc;
+}
+
+extern int mysql_db_flush_batch(mysql_conn_t *mysql_conn)
+{
+	int rc;
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	rc = _flush_batch(mysql_conn);
+	slurm_mutex_unlock(&mysql_conn->lock);
+
+	return rc;
+}
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending)
 {
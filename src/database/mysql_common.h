@@ -59,12 +59,26 @@ typedef enum {
 } slurm_mysql_plugin_type_t;
 
 typedef struct {
+	bool batch;		/* queue queries given to
+				 * mysql_db_query_batch() */
+	bool batch_failed;	/* queued queries or the transaction
+				 * were lost, only a rollback clears this */
+	char *batch_insert;	/* insert open in batch_query, see
+				 * mysql_db_insert_batch() */
+	char *batch_query;	/* queries waiting to be sent */
+	uint32_t batch_rows;	/* rows and queries in batch_query */
+	char *batch_update;	/* update clause of batch_insert */
 	bool cluster_deleted;
 	char *cluster_name;
 	MYSQL *db_conn;
 	pthread_mutex_t lock;
+	uint32_t lock_wait;	/* innodb_lock_wait_timeout of the session
+				 * if set, giving up on a lock then fails
+				 * the transaction instead of being fatal */
 	char *pre_commit_query;
 	bool rollback;
+	time_t rollup_reset;	/* usage is to be rolled up again from
+				 * this time once committed */
 	List update_list;
 	int conn;
 } mysql_conn_t;
@@ -104,6 +118,29 @@ extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query);
 
 extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query);
 
+/*
+ * Queue a query whose result is not needed. On a connection with batch
+ * set, queued queries are sent together in one round trip ahead of the next
+ * query run on the connection, by mysql_db_flush_batch() or by
+ * mysql_db_commit(), so an error may be reported by any of those instead.
+ * Once queued queries fail, mysql_db_commit() fails until the transaction
+ * is rolled back, as the queries sent with them may be those of earlier
+ * requests. Without batch the query is run right away.
+ */
+extern int mysql_db_query_batch(mysql_conn_t *mysql_conn, char *query);
+
+/*
+ * Queue "<insert> <row> <update>" as with mysql_db_query_batch(). Rows
+ * queued one after the other with the same insert and update are sent as
+ * one multi-row statement, so update must refer to the new values with
+ * VALUES(column) rather than repeat them.
+ */
+extern int mysql_db_insert_batch(mysql_conn_t *mysql_conn, char *insert,
+				 char *row, char *update);
+
+/* Send any queued queries, returns SLURM_SUCCESS if all of them succeed */
+extern int mysql_db_flush_batch(mysql_conn_t *mysql_conn);
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending);
 
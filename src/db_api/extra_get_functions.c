@@ -84,6 +84,20 @@ extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond)
 	return jobacct_storage_g_get_jobs_cond(db_conn, getuid(), job_cond);
 }
 
+/*
+ * get info from the storage a chunk of jobs at a time
+ * callback is called with each List of slurmdb_job_rec_t *, which is freed
+ * when it returns, and stops the query by returning an error
+ * RET: SLURM_SUCCESS on success SLURM_ERROR else
+ */
+extern int slurmdb_jobs_get_stream(void *db_conn, slurmdb_job_cond_t *job_cond,
+				   int (*callback)(List job_list, void *arg),
+				   void *arg)
+{
+	return jobacct_storage_g_get_jobs_cond_stream(db_conn, getuid(),
+						      job_cond, callback, arg);
+}
+
 /*
  * get info from the storage
  * IN:  slurmdb_assoc_cond_t *
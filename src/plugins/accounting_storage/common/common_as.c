@@ -36,6 +36,7 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <arpa/inet.h>
 #include <fcntl.h>
 #include <string.h>
 #include <sys/types.h>
@@ -62,6 +63,8 @@ extern char *wckey_day_table;
 extern char *wckey_hour_table;
 extern char *wckey_month_table;
 
+static pthread_mutex_t archive_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * We want SLURMDB_MODIFY_ASSOC always to be the last
  */
@@ -860,68 +863,118 @@ static char *_make_archive_name(time_t period_start, time_t period_end,
 			      start_char, end_char);
 }
 
-extern int archive_write_file(Buf buffer, char *cluster_name,
-			      time_t period_start, time_t period_end,
-			      char *arch_dir, char *arch_type,
-			      uint32_t archive_period)
+static int _write_archive(int fd, char *data, uint32_t size, char *file)
 {
-	int fd = 0;
-	int rc = SLURM_SUCCESS;
-	char *old_file = NULL, *new_file = NULL, *reg_file = NULL;
-	static int high_buffer_size = (1024 * 1024);
-	static pthread_mutex_t local_file_lock = PTHREAD_MUTEX_INITIALIZER;
+	uint32_t pos = 0;
+	ssize_t amount;
+
+	while (pos < size) {
+		amount = write(fd, &data[pos], size - pos);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			error("Error writing file %s, %m", file);
+			return SLURM_ERROR;
+		}
+		pos += amount;
+	}
 
-	xassert(buffer);
+	return SLURM_SUCCESS;
+}
 
-	slurm_mutex_lock(&local_file_lock);
+extern archive_file_t *archive_file_open(Buf header, uint32_t rec_cnt_offset,
+					 char *cluster_name,
+					 time_t period_start, time_t period_end,
+					 char *arch_dir, char *arch_type,
+					 uint32_t archive_period)
+{
+	archive_file_t *arch_file;
+	char *old_file = NULL, *reg_file = NULL;
+	int fd;
+
+	xassert(header);
+	xassert(rec_cnt_offset + 4 <= get_buf_offset(header));
+
+	slurm_mutex_lock(&archive_file_lock);
 
-	/* write the buffer to file */
 	reg_file = _make_archive_name(period_start, period_end,
 				      cluster_name, arch_dir,
 				      arch_type, archive_period);
 
 	debug("Storing %s archive for %s at %s",
 	      arch_type, cluster_name, reg_file);
+
+	/* keep the last archive of this period */
 	old_file = xstrdup_printf("%s.old", reg_file);
-	new_file = xstrdup_printf("%s.new", reg_file);
+	(void) unlink(old_file);
+	if (link(reg_file, old_file))
+		debug4("Link(%s, %s): %m", reg_file, old_file);
+	(void) unlink(reg_file);
+	xfree(old_file);
+
+	fd = open(reg_file, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	slurm_mutex_unlock(&archive_file_lock);
 
-	fd = creat(new_file, 0600);
 	if (fd < 0) {
-		error("Can't save archive, create file %s error %m", new_file);
-		rc = SLURM_ERROR;
-	} else {
-		int pos = 0, nwrite = get_buf_offset(buffer), amount;
-		char *data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				rc = SLURM_ERROR;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-		fsync(fd);
-		close(fd);
+		error("Can't save archive, create file %s error %m", reg_file);
+		xfree(reg_file);
+		return NULL;
 	}
 
-	if (rc)
-		(void) unlink(new_file);
-	else {			/* file shuffle */
-		(void) unlink(old_file);
-		if (link(reg_file, old_file))
-			debug4("Link(%s, %s): %m", reg_file, old_file);
+	if (_write_archive(fd, get_buf_data(header), get_buf_offset(header),
+			   reg_file) != SLURM_SUCCESS) {
+		close(fd);
 		(void) unlink(reg_file);
-		if (link(new_file, reg_file))
-			debug4("Link(%s, %s): %m", new_file, reg_file);
-		(void) unlink(new_file);
+		xfree(reg_file);
+		return NULL;
 	}
-	xfree(old_file);
-	xfree(reg_file);
-	xfree(new_file);
-	slurm_mutex_unlock(&local_file_lock);
 
-	return rc;
+	arch_file = xmalloc(sizeof(archive_file_t));
+	arch_file->fd = fd;
+	arch_file->file = reg_file;
+	arch_file->rec_cnt_offset = rec_cnt_offset;
+
+	return arch_file;
+}
+
+extern int archive_file_append(archive_file_t *arch_file, Buf buffer,
+			       uint32_t rec_cnt)
+{
+	uint32_t net_cnt;
+
+	xassert(arch_file);
+
+	/* The records must be on disk before the header counts them, and
+	 * both before the caller purges them from the database. */
+	if ((_write_archive(arch_file->fd, get_buf_data(buffer),
+			    get_buf_offset(buffer), arch_file->file)
+	     != SLURM_SUCCESS) || fsync(arch_file->fd)) {
+		error("Couldn't add %u records to %s: %m",
+		      rec_cnt, arch_file->file);
+		return SLURM_ERROR;
+	}
+
+	net_cnt = htonl(arch_file->rec_cnt + rec_cnt);
+	if ((pwrite(arch_file->fd, &net_cnt, sizeof(net_cnt),
+		    arch_file->rec_cnt_offset) != sizeof(net_cnt)) ||
+	    fsync(arch_file->fd)) {
+		error("Couldn't update the record count of %s: %m",
+		      arch_file->file);
+		return SLURM_ERROR;
+	}
+	arch_file->rec_cnt += rec_cnt;
+
+	return SLURM_SUCCESS;
+}
+
+extern void archive_file_close(archive_file_t *arch_file)
+{
+	if (!arch_file)
+		return;
+
+	close(arch_file->fd);
+	if (!arch_file->rec_cnt)
+		(void) unlink(arch_file->file);
+	xfree(arch_file->file);
+	xfree(arch_file);
 }
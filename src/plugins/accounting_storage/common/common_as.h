@@ -80,9 +80,38 @@ extern char* acct_get_db_name(void);
 extern time_t archive_setup_end_time(time_t last_submit, uint32_t purge);
 extern int archive_run_script(slurmdb_archive_cond_t *arch_cond,
 			      char *cluster_name, time_t last_submit);
-extern int archive_write_file(Buf buffer, char *cluster_name,
-			      time_t period_start, time_t period_end,
-			      char *arch_dir, char *arch_type,
-			      uint32_t archive_period);
+
+/* An archive file written a chunk of records at a time */
+typedef struct {
+	int fd;
+	char *file;
+	uint32_t rec_cnt;	/* records written so far */
+	uint32_t rec_cnt_offset;/* where the record count is in the header */
+} archive_file_t;
+
+/*
+ * archive_file_open - start an archive file with the header packed in
+ *	header, the last archive of the same name is kept as <name>.old
+ * IN rec_cnt_offset - offset of the packed record count in the header,
+ *	updated by archive_file_append()
+ * RET the open file or NULL on error, close with archive_file_close()
+ */
+extern archive_file_t *archive_file_open(Buf header, uint32_t rec_cnt_offset,
+					 char *cluster_name,
+					 time_t period_start, time_t period_end,
+					 char *arch_dir, char *arch_type,
+					 uint32_t archive_period);
+
+/*
+ * archive_file_append - add rec_cnt packed records to an archive file and
+ *	sync them, so they may then be purged from the database
+ * RET SLURM_SUCCESS or SLURM_ERROR, the file is still valid with the
+ *	records of earlier calls
+ */
+extern int archive_file_append(archive_file_t *arch_file, Buf buffer,
+			       uint32_t rec_cnt);
+
+/* archive_file_close - close an archive file, removing it if it is empty */
+extern void archive_file_close(archive_file_t *arch_file);
 
 #endif
@@ -1044,6 +1044,25 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return filetxt_jobacct_process_get_jobs(job_cond);
 }
 
+/*
+ * get info from the storage a chunk of jobs at a time
+ * The file is read whole, so all jobs come in one chunk.
+ */
+extern int jobacct_storage_p_get_jobs_cond_stream(
+	void *db_conn, uid_t uid, slurmdb_job_cond_t *job_cond,
+	int (*callback)(List job_list, void *arg), void *arg)
+{
+	List job_list;
+	int rc;
+
+	if (!(job_list = filetxt_jobacct_process_get_jobs(job_cond)))
+		return SLURM_ERROR;
+	rc = (callback)(job_list, arg);
+	FREE_NULL_LIST(job_list);
+
+	return rc;
+}
+
 /*
  * expire old info from the storage
  */
@@ -117,6 +117,10 @@ static mysql_db_info_t *mysql_db_info = NULL;
 static char *mysql_db_name = NULL;
 
 #define DELETE_SEC_BACK 86400
+/* Seconds a query waits for a lock with StorageWriters. The connections
+ * the records of a batch are written on only commit once all of them are
+ * done, so one waiting for a lock another holds has to give up. */
+#define WRITERS_LOCK_WAIT 5
 
 char *acct_coord_table = "acct_coord_table";
 char *acct_table = "acct_table";
@@ -1149,6 +1153,149 @@ extern int create_cluster_assoc_table(
 	return SLURM_SUCCESS;
 }
 
+static bool _partition_job_table(void)
+{
+	return (slurmdbd_conf && slurmdbd_conf->partition_job_table);
+}
+
+/* Return the start of the month "months" months after the one "when" is in */
+static time_t _month_start(time_t when, int months)
+{
+	struct tm tm;
+
+	if (!slurm_localtime_r(&when, &tm)) {
+		error("Couldn't get localtime from %ld", (long)when);
+		return 0;
+	}
+	tm.tm_sec = 0;
+	tm.tm_min = 0;
+	tm.tm_hour = 0;
+	tm.tm_mday = 1;
+	tm.tm_mon += months;
+	tm.tm_isdst = -1;
+
+	return slurm_mktime(&tm);
+}
+
+/* Add a partition holding the jobs submitted in the month before "bound" */
+static void _add_job_partition(char **query, time_t bound)
+{
+	struct tm tm;
+	time_t month = bound - 1;
+	char name[16];
+
+	slurm_localtime_r(&month, &tm);
+	strftime(name, sizeof(name), "p%Y%m", &tm);
+	xstrfmtcat(*query, "partition %s values less than (%ld), ",
+		   name, (long)bound);
+}
+
+/*
+ * Return the highest time_submit bound of the cluster's job table partitions,
+ * 0 if the table isn't partitioned (or doesn't exist yet), -1 on error.
+ */
+static time_t _get_job_partition_bound(mysql_conn_t *mysql_conn,
+				       char *cluster_name)
+{
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	time_t bound = 0, row_bound;
+	char *query = xstrdup_printf(
+		"select partition_description from "
+		"information_schema.partitions where "
+		"table_schema=database() && table_name='%s_%s' && "
+		"partition_name is not null",
+		cluster_name, job_table);
+
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+		xfree(query);
+		return -1;
+	}
+	xfree(query);
+
+	while ((row = mysql_fetch_row(result))) {
+		/* The last partition is MAXVALUE, report it as partitioned */
+		if (!row[0] || !xstrcasecmp(row[0], "MAXVALUE"))
+			row_bound = 1;
+		else
+			row_bound = slurm_atoul(row[0]);
+		if (row_bound > bound)
+			bound = row_bound;
+	}
+	mysql_free_result(result);
+
+	return bound;
+}
+
+/*
+ * Make sure the cluster's job table is partitioned by month of time_submit
+ * through next month, so new jobs never end up in the MAXVALUE partition.
+ */
+extern int as_mysql_job_partition_check(mysql_conn_t *mysql_conn,
+					char *cluster_name)
+{
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	time_t now = time(NULL), last_bound, bound, end;
+	char *query = NULL;
+	int rc;
+
+	if (!(end = _month_start(now, 2)))
+		return SLURM_ERROR;
+
+	if ((last_bound = _get_job_partition_bound(
+		     mysql_conn, cluster_name)) < 0)
+		return SLURM_ERROR;
+
+	if (!last_bound) {
+		/* Start with the month of the oldest job in the table */
+		time_t oldest = now;
+
+		query = xstrdup_printf("select min(time_submit) from \"%s_%s\" "
+				       "where time_submit > 0",
+				       cluster_name, job_table);
+		if (debug_flags & DEBUG_FLAG_DB_QUERY)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+			xfree(query);
+			return SLURM_ERROR;
+		}
+		xfree(query);
+		if ((row = mysql_fetch_row(result)) && row[0])
+			oldest = slurm_atoul(row[0]);
+		mysql_free_result(result);
+
+		info("Partitioning %s_%s by month of submission, this may take "
+		     "a while", cluster_name, job_table);
+		query = xstrdup_printf("alter table \"%s_%s\" partition by "
+				       "range (time_submit) (",
+				       cluster_name, job_table);
+		bound = _month_start(oldest, 1);
+	} else if (last_bound < end) {
+		query = xstrdup_printf("alter table \"%s_%s\" reorganize "
+				       "partition pmax into (",
+				       cluster_name, job_table);
+		bound = _month_start(last_bound, 1);
+	} else
+		return SLURM_SUCCESS;
+
+	for (; bound && (bound <= end); bound = _month_start(bound, 1))
+		_add_job_partition(&query, bound);
+	xstrcat(query, "partition pmax values less than maxvalue)");
+
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+	if (rc != SLURM_SUCCESS)
+		error("Couldn't add partitions to %s_%s",
+		      cluster_name, job_table);
+
+	return rc;
+}
+
 extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 {
 	storage_field_t cluster_usage_table_fields[] = {
@@ -1332,6 +1479,8 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 	};
 
 	char table_name[200];
+	char *job_key = "primary key (job_db_inx)", *job_ending;
+	int rc;
 
 	if (create_cluster_assoc_table(mysql_conn, cluster_name)
 	    == SLURM_ERROR)
@@ -1402,25 +1551,51 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 
 	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
 		 cluster_name, job_table);
+	/*
+	 * A partitioned table needs the partitioning column in every unique
+	 * key, so time_submit is added to the primary key when partitioning.
+	 */
+	if (_partition_job_table())
+		job_key = "primary key (job_db_inx, time_submit)";
+	else if (_get_job_partition_bound(mysql_conn, cluster_name) > 0) {
+		char *query = xstrdup_printf(
+			"alter table %s remove partitioning", table_name);
+
+		info("Removing partitioning from %s", table_name);
+		if (debug_flags & DEBUG_FLAG_DB_QUERY)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS)
+			return SLURM_ERROR;
+	}
+
 	/* sacct_def is the index for query's with state as time_tart is used in
 	 * these queries. sacct_def2 is for plain sacct queries. */
-	if (mysql_db_create_table(mysql_conn, table_name, job_table_fields,
-				  ", primary key (job_db_inx), "
-				  "unique index (id_job, "
-				  "id_assoc, time_submit), "
-				  "key rollup (time_eligible, time_end), "
-				  "key rollup2 (time_end, time_eligible), "
-				  "key nodes_alloc (nodes_alloc), "
-				  "key wckey (id_wckey), "
-				  "key qos (id_qos), "
-				  "key association (id_assoc), "
-				  "key array_job (id_array_job), "
-				  "key reserv (id_resv), "
-				  "key sacct_def (id_user, time_start, "
-				  "time_end), "
-				  "key sacct_def2 (id_user, time_end, "
-				  "time_eligible))")
-	    == SLURM_ERROR)
+	job_ending = xstrdup_printf(", %s, "
+				    "unique index (id_job, "
+				    "id_assoc, time_submit), "
+				    "key rollup (time_eligible, time_end), "
+				    "key rollup2 (time_end, time_eligible), "
+				    "key nodes_alloc (nodes_alloc), "
+				    "key wckey (id_wckey), "
+				    "key qos (id_qos), "
+				    "key association (id_assoc), "
+				    "key array_job (id_array_job), "
+				    "key reserv (id_resv), "
+				    "key sacct_def (id_user, time_start, "
+				    "time_end), "
+				    "key sacct_def2 (id_user, time_end, "
+				    "time_eligible))", job_key);
+	rc = mysql_db_create_table(mysql_conn, table_name, job_table_fields,
+				   job_ending);
+	xfree(job_ending);
+	if (rc == SLURM_ERROR)
+		return SLURM_ERROR;
+
+	if (_partition_job_table() &&
+	    (as_mysql_job_partition_check(mysql_conn, cluster_name)
+	     != SLURM_SUCCESS))
 		return SLURM_ERROR;
 
 	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
@@ -2460,6 +2635,15 @@ extern void *acct_storage_p_get_connection(const slurm_trigger_callbacks_t *cb,
 		fatal("couldn't get a mysql_conn");
 		return NULL;	/* Fix CLANG false positive error */
 	}
+	/*
+	 * Queued queries are only known to be written once committed, so only
+	 * queue them when the slurmdbd commits after each message. With
+	 * CommitDelay the transaction holds messages already acknowledged.
+	 */
+	mysql_conn->batch = rollback && slurmdbd_conf &&
+		!slurmdbd_conf->commit_delay;
+	if (mysql_conn->batch && (slurmdbd_conf->storage_writers > 1))
+		mysql_conn->lock_wait = WRITERS_LOCK_WAIT;
 
 	errno = SLURM_SUCCESS;
 	mysql_db_get_db_connection(mysql_conn, mysql_db_name, mysql_db_info);
@@ -2487,6 +2671,7 @@ extern int acct_storage_p_close_connection(mysql_conn_t **mysql_conn)
 extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 {
 	int rc = check_connection(mysql_conn);
+	int commit_rc = SLURM_SUCCESS;
 
 	/* always reset this here */
 	if (mysql_conn)
@@ -2503,13 +2688,17 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 				error("rollback failed");
 		} else {
 			int rc = SLURM_SUCCESS;
+			if (mysql_conn->rollup_reset)
+				rc = as_mysql_update_last_ran(
+					mysql_conn, mysql_conn->rollup_reset);
 			/* Handle anything here we were unable to do
 			   because of rollback issues.  i.e. Since any
 			   use of altering a tables
 			   AUTO_INCREMENT will make it so you can't
 			   rollback, save it until right at the end.
 			*/
-			if (mysql_conn->pre_commit_query) {
+			if ((rc == SLURM_SUCCESS) &&
+			    mysql_conn->pre_commit_query) {
 				if (debug_flags & DEBUG_FLAG_DB_ASSOC)
 					DB_DEBUG(mysql_conn->conn, "query\n%s",
 						 mysql_conn->pre_commit_query);
@@ -2518,16 +2707,31 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 					mysql_conn->pre_commit_query);
 			}
 
+			/* This also sends any queued queries, if one of
+			 * them failed nothing was written so the caller
+			 * has to try again */
+			if ((rc == SLURM_SUCCESS) &&
+			    mysql_db_commit(mysql_conn)) {
+				error("commit failed");
+				rc = SLURM_ERROR;
+			}
 			if (rc != SLURM_SUCCESS) {
 				if (mysql_db_rollback(mysql_conn))
 					error("rollback failed");
-			} else {
-				if (mysql_db_commit(mysql_conn))
-					error("commit failed");
+				commit = 0;
+				commit_rc = SLURM_ERROR;
 			}
 		}
 	}
 
+	if (commit && mysql_conn->rollup_reset) {
+		slurm_mutex_lock(&rollup_lock);
+		global_last_rollup = MIN(global_last_rollup,
+					 mysql_conn->rollup_reset);
+		slurm_mutex_unlock(&rollup_lock);
+	}
+	mysql_conn->rollup_reset = 0;
+
 	if (commit && list_count(mysql_conn->update_list)) {
 		char *query = NULL;
 		MYSQL_RES *result = NULL;
@@ -2595,7 +2799,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	xfree(mysql_conn->pre_commit_query);
 	list_flush(mysql_conn->update_list);
 
-	return SLURM_SUCCESS;
+	return commit_rc;
 }
 
 extern int acct_storage_p_add_users(mysql_conn_t *mysql_conn, uint32_t uid,
@@ -3111,6 +3315,21 @@ extern List jobacct_storage_p_get_jobs_cond(mysql_conn_t *mysql_conn,
 	return job_list;
 }
 
+/*
+ * get info from the storage a chunk of jobs at a time
+ */
+extern int jobacct_storage_p_get_jobs_cond_stream(
+	mysql_conn_t *mysql_conn, uid_t uid, slurmdb_job_cond_t *job_cond,
+	int (*callback)(List job_list, void *arg), void *arg)
+{
+	if (check_connection(mysql_conn) != SLURM_SUCCESS)
+		return ESLURM_DB_CONNECTION;
+
+	return as_mysql_jobacct_process_get_jobs_stream(mysql_conn, uid,
+							job_cond, callback,
+							arg);
+}
+
 /*
  * expire old info from the storage
  */
@@ -123,6 +123,8 @@ extern void reset_mysql_conn(mysql_conn_t *mysql_conn);
 extern int create_cluster_assoc_table(
 	mysql_conn_t *mysql_conn, char *cluster_name);
 extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name);
+extern int as_mysql_job_partition_check(mysql_conn_t *mysql_conn,
+					char *cluster_name);
 extern int remove_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name);
 extern int setup_assoc_limits(slurmdb_assoc_rec_t *assoc,
 				    char **cols, char **vals,
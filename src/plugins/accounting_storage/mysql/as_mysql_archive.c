@@ -59,8 +59,13 @@
 #define SLURMDBD_2_6_VERSION   12	/* slurm version 2.6 */
 #define SLURMDBD_2_5_VERSION   11	/* slurm version 2.5 */
 
-#define MAX_PURGE_LIMIT 50000 /* Number of records that are purged at a time
-				 so that locks can be periodically released. */
+#define MAX_PURGE_LIMIT 10000 /* Number of records that are archived and
+				 purged at a time so that locks can be
+				 periodically released. */
+#define PURGE_PAUSE_USEC 100000 /* Pause between purge batches so the inserts
+				   waiting on their locks get through. */
+#define MAX_ARCHIVE_LOAD_LIMIT 10000 /* Number of records loaded from an
+					archive file per query */
 #define MAX_ARCHIVE_AGE (60 * 60 * 24 * 60) /* If archive data is older than
 					       this then archive by month to
 					       handle large datasets. */
@@ -543,11 +548,6 @@ typedef enum {
 
 static void _init_local_job(local_job_t *);
 
-static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
-			       char *cluster_name, time_t period_end,
-			       char *arch_dir, uint32_t archive_period,
-			       char *sql_table, uint32_t usage_info);
-
 static int high_buffer_size = (1024 * 1024);
 
 static void _pack_local_event(local_event_t *object,
@@ -1797,25 +1797,12 @@ static char *_get_archive_columns(purge_type_t type)
 }
 
 
-static Buf _pack_archive_events(MYSQL_RES *result, char *cluster_name,
-				uint32_t cnt, uint32_t usage_info,
-				time_t *period_start)
+static void _pack_archive_events(MYSQL_RES *result, Buf buffer)
 {
 	MYSQL_ROW row;
-	Buf buffer;
 	local_event_t event;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_EVENTS, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
-
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[EVENT_REQ_START]);
-
 		memset(&event, 0, sizeof(local_event_t));
 
 		event.cluster_nodes = row[EVENT_REQ_CNODES];
@@ -1829,8 +1816,6 @@ static Buf _pack_archive_events(MYSQL_RES *result, char *cluster_name,
 
 		_pack_local_event(&event, SLURM_PROTOCOL_VERSION, buffer);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -1885,25 +1870,12 @@ _load_events(uint16_t rpc_version, Buf buffer, char *cluster_name,
 	return insert;
 }
 
-static Buf _pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
-			      uint32_t cnt, uint32_t usage_info,
-			      time_t *period_start)
+static void _pack_archive_jobs(MYSQL_RES *result, Buf buffer)
 {
 	MYSQL_ROW row;
-	Buf buffer;
 	local_job_t job;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_JOBS, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
-
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[JOB_REQ_SUBMIT]);
-
 		memset(&job, 0, sizeof(local_job_t));
 
 		job.account = row[JOB_REQ_ACCOUNT];
@@ -1945,8 +1917,6 @@ static Buf _pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
 
 		_pack_local_job(&job, SLURM_PROTOCOL_VERSION, buffer);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -2041,25 +2011,12 @@ _init_local_job(local_job_t *job)
 	xstrcat(job->array_taskid, "4294967294");
 }
 
-static Buf _pack_archive_resvs(MYSQL_RES *result, char *cluster_name,
-			       uint32_t cnt, uint32_t usage_info,
-			       time_t *period_start)
+static void _pack_archive_resvs(MYSQL_RES *result, Buf buffer)
 {
 	MYSQL_ROW row;
-	Buf buffer;
 	local_resv_t resv;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_RESVS, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
-
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[RESV_REQ_START]);
-
 		memset(&resv, 0, sizeof(local_resv_t));
 
 		resv.assocs = row[RESV_REQ_ASSOCS];
@@ -2074,8 +2031,6 @@ static Buf _pack_archive_resvs(MYSQL_RES *result, char *cluster_name,
 
 		_pack_local_resv(&resv, SLURM_PROTOCOL_VERSION, buffer);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -2129,25 +2084,12 @@ static char *_load_resvs(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_steps(MYSQL_RES *result, char *cluster_name,
-			       uint32_t cnt, uint32_t usage_info,
-			       time_t *period_start)
+static void _pack_archive_steps(MYSQL_RES *result, Buf buffer)
 {
 	MYSQL_ROW row;
-	Buf buffer;
 	local_step_t step;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_STEP_START, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
-
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[STEP_REQ_START]);
-
 		memset(&step, 0, sizeof(local_step_t));
 
 		step.ave_cpu = row[STEP_REQ_AVE_CPU];
@@ -2201,8 +2143,6 @@ static Buf _pack_archive_steps(MYSQL_RES *result, char *cluster_name,
 
 		_pack_local_step(&step, SLURM_PROTOCOL_VERSION, buffer);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -2295,25 +2235,12 @@ static char *_load_steps(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_suspends(MYSQL_RES *result, char *cluster_name,
-				  uint32_t cnt, uint32_t usage_info,
-				  time_t *period_start)
+static void _pack_archive_suspends(MYSQL_RES *result, Buf buffer)
 {
 	MYSQL_ROW row;
-	Buf buffer;
 	local_suspend_t suspend;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_JOB_SUSPEND, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
-
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[SUSPEND_REQ_START]);
-
 		memset(&suspend, 0, sizeof(local_suspend_t));
 
 		suspend.job_db_inx = row[SUSPEND_REQ_DB_INX];
@@ -2323,8 +2250,6 @@ static Buf _pack_archive_suspends(MYSQL_RES *result, char *cluster_name,
 
 		_pack_local_suspend(&suspend, SLURM_PROTOCOL_VERSION, buffer);
 	}
-
-	return buffer;
 }
 
 
@@ -2371,25 +2296,12 @@ static char *_load_suspend(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_txns(MYSQL_RES *result, char *cluster_name,
-			      uint32_t cnt, uint32_t usage_info,
-			      time_t *period_start)
+static void _pack_archive_txns(MYSQL_RES *result, Buf buffer)
 {
 	MYSQL_ROW row;
-	Buf buffer;
 	local_txn_t txn;
 
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_TXN, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
-
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[TXN_REQ_TS]);
-
 		memset(&txn, 0, sizeof(local_txn_t));
 
 		txn.id = row[TXN_REQ_ID];
@@ -2402,8 +2314,6 @@ static Buf _pack_archive_txns(MYSQL_RES *result, char *cluster_name,
 
 		_pack_local_txn(&txn, SLURM_PROTOCOL_VERSION, buffer);
 	}
-
-	return buffer;
 }
 
 
@@ -2457,28 +2367,12 @@ static char *_load_txn(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_usage(MYSQL_RES *result, char *cluster_name,
-			       uint32_t cnt, uint32_t usage_info,
-			       time_t *period_start)
+static void _pack_archive_usage(MYSQL_RES *result, Buf buffer)
 {
 	MYSQL_ROW row;
-	Buf buffer;
 	local_usage_t usage;
-	uint16_t type = usage_info & 0x0000ffff;
-	uint16_t period = usage_info >> 16;
-
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(type, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
-	pack16(period, buffer);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[USAGE_START]);
-
 		memset(&usage, 0, sizeof(local_usage_t));
 
 		usage.id = row[USAGE_ID];
@@ -2488,8 +2382,6 @@ static Buf _pack_archive_usage(MYSQL_RES *result, char *cluster_name,
 
 		_pack_local_usage(&usage, SLURM_PROTOCOL_VERSION, buffer);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -2577,27 +2469,12 @@ static char *_load_usage(uint16_t rpc_version, Buf buffer,
 	return insert;
 }
 
-static Buf _pack_archive_cluster_usage(MYSQL_RES *result, char *cluster_name,
-				       uint32_t cnt, uint32_t usage_info,
-				       time_t *period_start)
+static void _pack_archive_cluster_usage(MYSQL_RES *result, Buf buffer)
 {
 	MYSQL_ROW row;
-	Buf buffer;
 	local_cluster_usage_t usage;
-	uint16_t period = usage_info >> 16;
-
-	buffer = init_buf(high_buffer_size);
-	pack16(SLURM_PROTOCOL_VERSION, buffer);
-	pack_time(time(NULL), buffer);
-	pack16(DBD_GOT_CLUSTER_USAGE, buffer);
-	packstr(cluster_name, buffer);
-	pack32(cnt, buffer);
-	pack16(period, buffer);
 
 	while ((row = mysql_fetch_row(result))) {
-		if (period_start && !*period_start)
-			*period_start = slurm_atoul(row[CLUSTER_START]);
-
 		memset(&usage, 0, sizeof(local_cluster_usage_t));
 
 		usage.tres_id = row[CLUSTER_TRES];
@@ -2613,8 +2490,6 @@ static Buf _pack_archive_cluster_usage(MYSQL_RES *result, char *cluster_name,
 		_pack_local_cluster_usage(
 			&usage, SLURM_PROTOCOL_VERSION, buffer);
 	}
-
-	return buffer;
 }
 
 /* returns sql statement from archived data or NULL on error */
@@ -2683,114 +2558,262 @@ static char *_load_cluster_usage(uint16_t rpc_version, Buf buffer,
 }
 
 /* returns count of events archived or SLURM_ERROR on error */
+/* Name of the table of a purge type, the txn table is shared by clusters */
+static char *_purge_table_name(purge_type_t type, char *cluster_name,
+			       char *sql_table)
+{
+	if (type == PURGE_TXN)
+		return xstrdup_printf("\"%s\"", sql_table);
+	return xstrdup_printf("\"%s_%s\"", cluster_name, sql_table);
+}
+
+/* Condition on the records of a table that can be purged up to end */
+static char *_purge_cond(purge_type_t type, char *cluster_name,
+			 char *col_name, time_t end)
+{
+	switch (type) {
+	case PURGE_TXN:
+		return xstrdup_printf("%s <= %ld && cluster='%s'",
+				      col_name, end, cluster_name);
+	case PURGE_USAGE:
+	case PURGE_CLUSTER_USAGE:
+		return xstrdup_printf("%s <= %ld", col_name, end);
+	default:
+		return xstrdup_printf("%s <= %ld && time_end != 0",
+				      col_name, end);
+	}
+}
+
+/* Pack the header of an archive file.  Returns the offset of the record
+ * count, which is updated as records are added to the file. */
+static uint32_t _pack_archive_header(uint16_t type, char *cluster_name,
+				     uint32_t usage_info, Buf buffer)
+{
+	uint32_t rec_cnt_offset;
+
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	pack_time(time(NULL), buffer);
+	pack16(type, buffer);
+	packstr(cluster_name, buffer);
+	rec_cnt_offset = get_buf_offset(buffer);
+	pack32(0, buffer);
+	if ((type == DBD_GOT_ASSOC_USAGE) || (type == DBD_GOT_WCKEY_USAGE) ||
+	    (type == DBD_GOT_CLUSTER_USAGE))
+		pack16(usage_info >> 16, buffer);
+
+	return rec_cnt_offset;
+}
+
+static void _purge_pause(void)
+{
+	usleep(PURGE_PAUSE_USEC);
+}
+
+/* Archive the records of a table up to period_end into one file and purge
+ * them, about MAX_PURGE_LIMIT records at a time.  Each chunk is selected
+ * for update, added to the file and deleted in one transaction, so neither
+ * the whole period nor its locks are held at once and a record is only
+ * purged once it is in the file.
+ *
+ * Returns the number of records archived or SLURM_ERROR.
+ */
 static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
-			       char *cluster_name, time_t period_end,
+			       char *cluster_name, char *col_name,
+			       time_t period_start, time_t period_end,
 			       char *arch_dir, uint32_t archive_period,
 			       char *sql_table, uint32_t usage_info)
 {
 	MYSQL_RES *result = NULL;
-	char *cols = NULL, *query = NULL;
-	time_t period_start = 0;
-	uint32_t cnt = 0;
+	MYSQL_ROW row;
+	char *cols = NULL, *cond = NULL, *query = NULL, *table = NULL;
+	time_t chunk_end;
+	uint32_t cnt = 0, total_cnt = 0, rec_cnt_offset;
+	uint16_t dbd_type;
 	Buf buffer;
-	int error_code = 0;
-	Buf (*pack_func)(MYSQL_RES *result, char *cluster_name,
-			 uint32_t cnt, uint32_t usage_info,
-			 time_t *period_start);
-
-	cols = _get_archive_columns(type);
+	archive_file_t *arch_file = NULL;
+	int rc = SLURM_SUCCESS;
+	void (*pack_func)(MYSQL_RES *result, Buf buffer);
 
 	switch (type) {
 	case PURGE_EVENT:
 		pack_func = &_pack_archive_events;
+		dbd_type = DBD_GOT_EVENTS;
 		break;
 	case PURGE_SUSPEND:
 		pack_func = &_pack_archive_suspends;
+		dbd_type = DBD_JOB_SUSPEND;
 		break;
 	case PURGE_RESV:
 		pack_func = &_pack_archive_resvs;
+		dbd_type = DBD_GOT_RESVS;
 		break;
 	case PURGE_JOB:
 		pack_func = &_pack_archive_jobs;
+		dbd_type = DBD_GOT_JOBS;
 		break;
 	case PURGE_STEP:
 		pack_func = &_pack_archive_steps;
+		dbd_type = DBD_STEP_START;
 		break;
 	case PURGE_TXN:
 		pack_func = &_pack_archive_txns;
+		dbd_type = DBD_GOT_TXN;
 		break;
 	case PURGE_USAGE:
 		pack_func = &_pack_archive_usage;
+		dbd_type = usage_info & 0x0000ffff;
 		break;
 	case PURGE_CLUSTER_USAGE:
 		pack_func = &_pack_archive_cluster_usage;
+		dbd_type = DBD_GOT_CLUSTER_USAGE;
 		break;
 	default:
 		fatal("Unknown purge type: %d", type);
 		return SLURM_ERROR;
 	}
 
-	switch (type) {
-	case PURGE_TXN:
-		query = xstrdup_printf("select %s from \"%s\" where "
-				       "timestamp <= %ld && cluster='%s' "
-				       "order by timestamp asc for update",
-				       cols, sql_table,
-				       period_end, cluster_name);
-		break;
-	case PURGE_USAGE:
-	case PURGE_CLUSTER_USAGE:
-		query = xstrdup_printf("select %s from \"%s_%s\" where "
-				       "time_start <= %ld "
-				       "order by time_start asc for update",
-				       cols, cluster_name, sql_table,
-				       period_end);
-		break;
-	case PURGE_JOB:
-		query = xstrdup_printf("select %s from \"%s_%s\" where "
-				       "time_submit < %ld && time_end != 0 "
-				       "order by time_submit asc for update",
-				       cols, cluster_name, job_table,
-				       period_end);
-		break;
-	default:
-		query = xstrdup_printf("select %s from \"%s_%s\" where "
-				       "time_start <= %ld && time_end != 0 "
-				       "order by time_start asc for update",
-				       cols, cluster_name, sql_table,
-				       period_end);
-		break;
-	}
+	cols = _get_archive_columns(type);
+	table = _purge_table_name(type, cluster_name, sql_table);
+
+	do {
+		/* Find where the next chunk ends.  Records of the same time
+		 * go in the same chunk, so it can be a little bigger than
+		 * MAX_PURGE_LIMIT. */
+		chunk_end = period_end;
+		cond = _purge_cond(type, cluster_name, col_name, period_end);
+		query = xstrdup_printf("select %s from %s where %s "
+				       "order by %s asc LIMIT 1 OFFSET %d",
+				       col_name, table, cond, col_name,
+				       MAX_PURGE_LIMIT - 1);
+		xfree(cond);
+		if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+			rc = SLURM_ERROR;
+			break;
+		}
+		xfree(query);
+		if ((row = mysql_fetch_row(result)))
+			chunk_end = slurm_atoul(row[0]);
+		mysql_free_result(result);
+
+		cond = _purge_cond(type, cluster_name, col_name, chunk_end);
+		query = xstrdup_printf("select %s from %s where %s "
+				       "order by %s asc for update",
+				       cols, table, cond, col_name);
+		if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+			rc = SLURM_ERROR;
+			break;
+		}
+		xfree(query);
+
+		if (!(cnt = mysql_num_rows(result))) {
+			mysql_free_result(result);
+			break;
+		}
+
+		buffer = init_buf(high_buffer_size);
+		if (!arch_file) {
+			rec_cnt_offset = _pack_archive_header(
+				dbd_type, cluster_name, usage_info, buffer);
+			arch_file = archive_file_open(buffer, rec_cnt_offset,
+						      cluster_name,
+						      period_start, period_end,
+						      arch_dir, sql_table,
+						      archive_period);
+			set_buf_offset(buffer, 0);
+		}
+		if (arch_file) {
+			(*pack_func)(result, buffer);
+			high_buffer_size = MAX(get_buf_offset(buffer),
+					       high_buffer_size);
+			rc = archive_file_append(arch_file, buffer, cnt);
+		} else
+			rc = SLURM_ERROR;
+		mysql_free_result(result);
+		free_buf(buffer);
+		if (rc != SLURM_SUCCESS)
+			break;
+
+		query = xstrdup_printf("delete from %s where %s", table, cond);
+		xfree(cond);
+		if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("Couldn't remove old data from %s table",
+			      sql_table);
+			break;
+		}
+		if (mysql_db_commit(mysql_conn)) {
+			error("Couldn't commit cluster (%s) purge",
+			      cluster_name);
+			rc = SLURM_ERROR;
+			break;
+		}
+		total_cnt += cnt;
+
+		if (chunk_end < period_end)
+			_purge_pause();
+	} while (chunk_end < period_end);
 
+	archive_file_close(arch_file);
+	xfree(cond);
+	xfree(query);
+	xfree(table);
 	xfree(cols);
 
+	if (rc != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	return total_cnt;
+}
+
+/* Purge the records of a table up to end without archiving them */
+static int _purge_table(purge_type_t type, mysql_conn_t *mysql_conn,
+			char *cluster_name, char *col_name, time_t end,
+			char *sql_table)
+{
+	char *cond, *query, *table;
+	int rc;
+
+	table = _purge_table_name(type, cluster_name, sql_table);
+	cond = _purge_cond(type, cluster_name, col_name, end);
+	query = xstrdup_printf("delete from %s where %s LIMIT %d",
+			       table, cond, MAX_PURGE_LIMIT);
+	xfree(cond);
+	xfree(table);
+
 	if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
 		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
-		xfree(query);
-		return SLURM_ERROR;
+
+	while ((rc = mysql_db_delete_affected_rows(
+			mysql_conn, query)) > 0) {
+		/* Commit here every time since this could create a huge
+		 * transaction.
+		 */
+		if (mysql_db_commit(mysql_conn)) {
+			error("Couldn't commit cluster (%s) purge",
+			      cluster_name);
+			break;
+		}
+		if (rc == MAX_PURGE_LIMIT)
+			_purge_pause();
 	}
 	xfree(query);
 
-	if (!(cnt = mysql_num_rows(result))) {
-		mysql_free_result(result);
-		return 0;
+	if (rc != SLURM_SUCCESS) {
+		error("Couldn't remove old data from %s table", sql_table);
+		return SLURM_ERROR;
+	} else if (mysql_db_commit(mysql_conn)) {
+		error("Couldn't commit cluster (%s) purge", cluster_name);
+		return SLURM_ERROR;
 	}
 
-	buffer = (*pack_func)(result, cluster_name, cnt, usage_info,
-			      &period_start);
-	mysql_free_result(result);
-
-	error_code = archive_write_file(buffer, cluster_name,
-					period_start, period_end,
-					arch_dir, sql_table,
-					archive_period);
-	free_buf(buffer);
-
-	if (error_code != SLURM_SUCCESS)
-		return error_code;
-
-	return cnt;
+	return SLURM_SUCCESS;
 }
 
 uint32_t _get_begin_next_month(time_t start)
@@ -2819,41 +2842,25 @@ uint32_t _get_begin_next_month(time_t start)
  * 1 found purgeable record.
  */
 static int _get_oldest_record(mysql_conn_t *mysql_conn, char *cluster,
-			      char *table, purge_type_t type, char *col_name,
-			      time_t period_end, time_t *record_start)
+			      char *sql_table, purge_type_t type,
+			      char *col_name, time_t period_end,
+			      time_t *record_start)
 {
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
-	char *query = NULL;
+	char *cond, *query = NULL, *table;
 
 	if (record_start == NULL)
 		return SLURM_ERROR;
 
 	/* get oldest record */
-	switch (type) {
-	case PURGE_TXN:
-		query = xstrdup_printf(
-			"select %s from \"%s\" where %s <= %ld "
-			"&& cluster='%s' order by %s asc LIMIT 1",
-			col_name, table, col_name, period_end, cluster,
-			col_name);
-		break;
-	case PURGE_USAGE:
-	case PURGE_CLUSTER_USAGE:
-		query = xstrdup_printf(
-			"select %s from \"%s_%s\" where %s <= %ld "
-			"order by %s asc LIMIT 1",
-			col_name, cluster, table, col_name, period_end,
-			col_name);
-		break;
-	default:
-		query = xstrdup_printf(
-			"select %s from \"%s_%s\" where %s <= %ld "
-			"&& time_end != 0 order by %s asc LIMIT 1",
-			col_name, cluster, table, col_name, period_end,
-			col_name);
-		break;
-	}
+	cond = _purge_cond(type, cluster, col_name, period_end);
+	table = _purge_table_name(type, cluster, sql_table);
+	query = xstrdup_printf("select %s from %s where %s "
+			       "order by %s asc LIMIT 1",
+			       col_name, table, cond, col_name);
+	xfree(cond);
+	xfree(table);
 
 	if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
 		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
@@ -2887,8 +2894,7 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 	uint16_t type, period;
 	time_t   last_submit = time(NULL);
 	time_t   curr_end    = 0, tmp_end = 0, record_start = 0;
-	char    *query = NULL, *sql_table = NULL,
-		*col_name = NULL;
+	char    *sql_table = NULL, *col_name = NULL;
 	uint32_t tmp_archive_period;
 
 	switch (purge_type) {
@@ -3026,66 +3032,19 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 			      cluster_name, sql_table, tmp_end);
 
 		if (SLURMDB_PURGE_ARCHIVE_SET(purge_attr)) {
+			/* purges what it archives */
 			rc = _archive_table(purge_type, mysql_conn,
-					    cluster_name, tmp_end,
+					    cluster_name, col_name,
+					    record_start, tmp_end,
 					    arch_cond->archive_dir,
 					    tmp_archive_period,
 					    sql_table, usage_info);
-			if (!rc) /* no records archived */
-				continue;
-			else if (rc == SLURM_ERROR)
+			if (rc == SLURM_ERROR)
 				return rc;
-		}
-
-		switch (purge_type) {
-		case PURGE_TXN:
-			query = xstrdup_printf(
-				"delete from \"%s\" where "
-				"%s <= %ld && cluster='%s' LIMIT %d",
-				sql_table, col_name,
-				tmp_end, cluster_name, MAX_PURGE_LIMIT);
-			break;
-		case PURGE_USAGE:
-		case PURGE_CLUSTER_USAGE:
-			query = xstrdup_printf(
-				"delete from \"%s_%s\" where "
-				"%s <= %ld LIMIT %d",
-				cluster_name, sql_table, col_name,
-				tmp_end, MAX_PURGE_LIMIT);
-			break;
-		default:
-			query = xstrdup_printf(
-				"delete from \"%s_%s\" where "
-				"%s <= %ld && time_end != 0 LIMIT %d",
-				cluster_name, sql_table, col_name,
-				tmp_end, MAX_PURGE_LIMIT);
-			break;
-		}
-		if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
-			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-
-		while ((rc = mysql_db_delete_affected_rows(
-				mysql_conn, query)) > 0) {
-			/* Commit here every time since this could create a huge
-			 * transaction.
-			 */
-			if (mysql_db_commit(mysql_conn)) {
-				error("Couldn't commit cluster (%s) purge",
-				      cluster_name);
-				break;
-			}
-		}
-
-		xfree(query);
-		if (rc != SLURM_SUCCESS) {
-			error("Couldn't remove old data from %s table",
-			      sql_table);
+		} else if (_purge_table(purge_type, mysql_conn, cluster_name,
+					col_name, tmp_end, sql_table)
+			   != SLURM_SUCCESS)
 			return SLURM_ERROR;
-		} else if (mysql_db_commit(mysql_conn)) {
-			error("Couldn't commit cluster (%s) purge",
-			      cluster_name);
-			break;
-		}
 	} while (tmp_end < curr_end);
 
 	return SLURM_SUCCESS;
@@ -3215,6 +3174,57 @@ extern int as_mysql_jobacct_process_archive(mysql_conn_t *mysql_conn,
 	return rc;
 }
 
+/* returns sql statement loading the next rec_cnt records of buffer or NULL
+ * on error */
+static char *_load_archive_recs(uint16_t rpc_version, Buf buffer,
+				char *cluster_name, uint16_t type,
+				uint16_t period, uint32_t rec_cnt)
+{
+	switch (type) {
+	case DBD_GOT_EVENTS:
+		return _load_events(rpc_version, buffer, cluster_name, rec_cnt);
+	case DBD_GOT_JOBS:
+		return _load_jobs(rpc_version, buffer, cluster_name, rec_cnt);
+	case DBD_GOT_RESVS:
+		return _load_resvs(rpc_version, buffer, cluster_name, rec_cnt);
+	case DBD_STEP_START:
+		return _load_steps(rpc_version, buffer, cluster_name, rec_cnt);
+	case DBD_JOB_SUSPEND:
+		return _load_suspend(rpc_version, buffer, cluster_name,
+				     rec_cnt);
+	case DBD_GOT_TXN:
+		return _load_txn(rpc_version, buffer, cluster_name, rec_cnt);
+	case DBD_GOT_ASSOC_USAGE:
+	case DBD_GOT_WCKEY_USAGE:
+		return _load_usage(rpc_version, buffer, cluster_name, type,
+				   period, rec_cnt);
+	case DBD_GOT_CLUSTER_USAGE:
+		return _load_cluster_usage(rpc_version, buffer, cluster_name,
+					   period, rec_cnt);
+	default:
+		error("Unknown type '%u' to load from archive", type);
+		return NULL;
+	}
+}
+
+/* this is the old version of an archive file where the file was straight
+ * sql. */
+static bool _is_old_sql(Buf buffer)
+{
+	char *data = get_buf_data(buffer);
+	uint32_t size = size_buf(buffer);
+
+	if ((size >= 12) && (!strncmp("insert into ", data, 12) ||
+			     !strncmp("delete from ", data, 12)))
+		return true;
+	if ((size >= 11) && !strncmp("drop table ", data, 11))
+		return true;
+	if ((size >= 15) && !strncmp("truncate table ", data, 15))
+		return true;
+
+	return false;
+}
+
 extern int as_mysql_jobacct_process_archive_load(
 	mysql_conn_t *mysql_conn, slurmdb_archive_rec_t *arch_rec)
 {
@@ -3223,7 +3233,7 @@ extern int as_mysql_jobacct_process_archive_load(
 	Buf buffer = NULL;
 	time_t buf_time;
 	uint16_t type = 0, ver = 0, period = 0;
-	uint32_t data_size = 0, rec_cnt = 0, tmp32 = 0;
+	uint32_t load_cnt, rec_cnt = 0, tmp32 = 0;
 
 	if (!arch_rec) {
 		error("We need a slurmdb_archive_rec to load anything.");
@@ -3232,68 +3242,43 @@ extern int as_mysql_jobacct_process_archive_load(
 
 	if (arch_rec->insert) {
 		data = xstrdup(arch_rec->insert);
+		buffer = create_buf(data, strlen(data));
+		data = NULL;	/* Moved to "buffer" */
 	} else if (arch_rec->archive_file) {
-		int data_allocated, data_read = 0;
-		int state_fd = open(arch_rec->archive_file, O_RDONLY);
-		if (state_fd < 0) {
+		/* The file is mapped rather than read, only the records
+		 * being loaded need to be in memory. */
+		if (!(buffer = create_mmap_buf(arch_rec->archive_file))) {
 			info("No archive file (%s) to recover",
 			     arch_rec->archive_file);
-			error_code = ENOENT;
-		} else {
-			data_allocated = BUF_SIZE + 1;
-			data = xmalloc_nz(data_allocated);
-			while (1) {
-				data_read = read(state_fd, &data[data_size],
-						 BUF_SIZE);
-				if (data_read < 0) {
-					data[data_size] = '\0';
-					if (errno == EINTR)
-						continue;
-					else {
-						error("Read error on %s: %m",
-						      arch_rec->archive_file);
-						break;
-					}
-				}
-				data[data_size + data_read] = '\0';
-				if (data_read == 0)	/* eof */
-					break;
-				data_size      += data_read;
-				data_allocated += data_read;
-				xrealloc_nz(data, data_allocated);
-			}
-			close(state_fd);
-		}
-		if (error_code != SLURM_SUCCESS) {
-			xfree(data);
-			return error_code;
+			return ENOENT;
 		}
 	} else {
 		error("Nothing was set in your "
 		      "slurmdb_archive_rec so I am unable to process.");
-		xfree(data);
 		return SLURM_ERROR;
 	}
 
-	if (!data) {
+	if (!size_buf(buffer)) {
 		error("It doesn't appear we have anything to load.");
+		FREE_NULL_BUFFER(buffer);
 		return SLURM_ERROR;
 	}
 
-	/* this is the old version of an archive file where the file
-	   was straight sql. */
-	if ((strlen(data) >= 12)
-	    && (!xstrncmp("insert into ", data, 12)
-		|| !xstrncmp("delete from ", data, 12)
-		|| !xstrncmp("drop table ", data, 11)
-		|| !xstrncmp("truncate table ", data, 15))) {
+	if (_is_old_sql(buffer)) {
+		data = xstrndup(get_buf_data(buffer), size_buf(buffer));
+		FREE_NULL_BUFFER(buffer);
 		_process_old_sql(&data);
-		goto got_sql;
+		if (!data) {
+			error("No data to load");
+			return SLURM_ERROR;
+		}
+		if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", data);
+		error_code = mysql_db_query_check_after(mysql_conn, data);
+		xfree(data);
+		goto end_it;
 	}
 
-	buffer = create_buf(data, data_size);
-	data = NULL;	/* Moved to "buffer" */
-
 	safe_unpack16(&ver, buffer);
 	if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
 		DB_DEBUG(mysql_conn->conn,
@@ -3321,60 +3306,44 @@ extern int as_mysql_jobacct_process_archive_load(
 		error("we didn't get any records from this file of type '%s'",
 		      slurmdbd_msg_type_2_str(type, 0));
 		FREE_NULL_BUFFER(buffer);
-		goto got_sql;
+		error("No data to load");
+		return SLURM_ERROR;
 	}
 
-	switch (type) {
-	case DBD_GOT_EVENTS:
-		data = _load_events(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_GOT_JOBS:
-		data = _load_jobs(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_GOT_RESVS:
-		data = _load_resvs(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_STEP_START:
-		data = _load_steps(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_JOB_SUSPEND:
-		data = _load_suspend(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_GOT_TXN:
-		data = _load_txn(ver, buffer, cluster_name, rec_cnt);
-		break;
-	case DBD_GOT_ASSOC_USAGE:
-	case DBD_GOT_WCKEY_USAGE:
-		safe_unpack16(&period, buffer);
-		data = _load_usage(ver, buffer, cluster_name, type, period,
-				   rec_cnt);
-		break;
-	case DBD_GOT_CLUSTER_USAGE:
+	if ((type == DBD_GOT_ASSOC_USAGE) || (type == DBD_GOT_WCKEY_USAGE) ||
+	    (type == DBD_GOT_CLUSTER_USAGE))
 		safe_unpack16(&period, buffer);
-		data = _load_cluster_usage(ver, buffer, cluster_name, period,
-					   rec_cnt);
-		break;
-	default:
-		error("Unknown type '%u' to load from archive", type);
-		break;
+
+	/* Insert the records MAX_ARCHIVE_LOAD_LIMIT at a time instead of
+	 * building one query for the whole file. */
+	while (rec_cnt) {
+		load_cnt = MIN(rec_cnt, MAX_ARCHIVE_LOAD_LIMIT);
+		if (!(data = _load_archive_recs(ver, buffer, cluster_name,
+						type, period, load_cnt))) {
+			error("No data to load");
+			error_code = SLURM_ERROR;
+			break;
+		}
+		if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", data);
+		error_code = mysql_db_query_check_after(mysql_conn, data);
+		xfree(data);
+		if (error_code != SLURM_SUCCESS)
+			break;
+		rec_cnt -= load_cnt;
 	}
 	FREE_NULL_BUFFER(buffer);
 
-got_sql:
-	if (!data) {
-		error("No data to load");
-		return SLURM_ERROR;
-	}
-	if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
-		DB_DEBUG(mysql_conn->conn, "query\n%s", data);
-	error_code = mysql_db_query_check_after(mysql_conn, data);
-	xfree(data);
+end_it:
 	if (error_code != SLURM_SUCCESS) {
-unpack_error:
 		error("Couldn't load old data");
-		FREE_NULL_BUFFER(buffer);
 		return SLURM_ERROR;
 	}
 
 	return SLURM_SUCCESS;
+
+unpack_error:
+	error("Couldn't load old data");
+	FREE_NULL_BUFFER(buffer);
+	return SLURM_ERROR;
 }
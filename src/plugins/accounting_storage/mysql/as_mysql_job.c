@@ -49,6 +49,31 @@
 
 #define BUFFER_SIZE 4096
 
+static char *step_start_update =
+	"on duplicate key update "
+	"nodes_alloc=VALUES(nodes_alloc), task_cnt=VALUES(task_cnt), "
+	"time_end=0, state=VALUES(state), nodelist=VALUES(nodelist), "
+	"node_inx=VALUES(node_inx), task_dist=VALUES(task_dist), "
+	"req_cpufreq=VALUES(req_cpufreq), "
+	"req_cpufreq_min=VALUES(req_cpufreq_min), "
+	"req_cpufreq_gov=VALUES(req_cpufreq_gov), "
+	"tres_alloc=VALUES(tres_alloc)";
+
+/* With PartitionJobTable the job table's primary key is (job_db_inx,
+ * time_submit), so add the time_submit of the job's record to updates by
+ * job_db_inx to have them read one partition rather than each of them.
+ * Only done when it is known to be the one the record was added with,
+ * those of resized jobs are their resize times.
+ */
+static void _add_submit_cond(char **query, struct job_record *job_ptr)
+{
+	if (slurmdbd_conf && slurmdbd_conf->partition_job_table &&
+	    !job_ptr->resize_time && job_ptr->details &&
+	    job_ptr->details->submit_time)
+		xstrfmtcat(*query, " && time_submit=%ld",
+			   job_ptr->details->submit_time);
+}
+
 /* Used in job functions for getting the database index based off the
  * submit time, job and assoc id.  0 is returned if none is found
  */
@@ -379,24 +404,9 @@ extern int as_mysql_job_start(mysql_conn_t *mysql_conn,
 			      slurm_ctime2(&check_time),
 			      job_ptr->job_id, mysql_conn->cluster_name);
 
-		global_last_rollup = check_time;
 		slurm_mutex_unlock(&rollup_lock);
 
-		/* If the times here are later than the daily_rollup
-		   or monthly rollup it isn't a big deal since they
-		   are always shrunk down to the beginning of each
-		   time period.
-		*/
-		query = xstrdup_printf("update \"%s_%s\" set "
-				       "hourly_rollup=%ld, "
-				       "daily_rollup=%ld, monthly_rollup=%ld",
-				       mysql_conn->cluster_name,
-				       last_ran_table, check_time,
-				       check_time, check_time);
-		if (debug_flags & DEBUG_FLAG_DB_JOB)
-			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-		rc = mysql_db_query(mysql_conn, query);
-		xfree(query);
+		rc = as_mysql_reset_rollup(mysql_conn, check_time);
 	} else
 		slurm_mutex_unlock(&rollup_lock);
 
@@ -662,10 +672,11 @@ no_rollup_change:
 			   job_ptr->array_job_id,
 			   array_task_id,
 			   begin_time, job_ptr->db_index);
+		_add_submit_cond(&query, job_ptr);
 
 		if (debug_flags & DEBUG_FLAG_DB_JOB)
 			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-		rc = mysql_db_query(mysql_conn, query);
+		rc = mysql_db_query_batch(mysql_conn, query);
 	}
 
 	xfree(block_id);
@@ -759,7 +770,8 @@ extern List as_mysql_modify_job(mysql_conn_t *mysql_conn, uint32_t uid,
 
 		slurm_make_time_str(&time_submit, tmp_char, sizeof(tmp_char));
 
-		xstrfmtcat(cond_char, "job_db_inx=%s", row[0]);
+		xstrfmtcat(cond_char, "job_db_inx=%s && time_submit=%s",
+			   row[0], row[2]);
 		object = xstrdup_printf("%s submitted at %s", row[1], tmp_char);
 
 		ret_list = list_create(slurm_destroy_char);
@@ -850,19 +862,9 @@ extern int as_mysql_job_complete(mysql_conn_t *mysql_conn,
 
 	slurm_mutex_lock(&rollup_lock);
 	if (end_time < global_last_rollup) {
-		global_last_rollup = job_ptr->end_time;
 		slurm_mutex_unlock(&rollup_lock);
 
-		query = xstrdup_printf("update \"%s_%s\" set "
-				       "hourly_rollup=%ld, "
-				       "daily_rollup=%ld, monthly_rollup=%ld",
-				       mysql_conn->cluster_name,
-				       last_ran_table, end_time,
-				       end_time, end_time);
-		if (debug_flags & DEBUG_FLAG_DB_JOB)
-			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-		(void) mysql_db_query(mysql_conn, query);
-		xfree(query);
+		(void) as_mysql_reset_rollup(mysql_conn, end_time);
 	} else
 		slurm_mutex_unlock(&rollup_lock);
 
@@ -927,13 +929,14 @@ extern int as_mysql_job_complete(mysql_conn_t *mysql_conn,
 	}
 
 	xstrfmtcat(query,
-		   ", exit_code=%d, kill_requid=%d where job_db_inx=%"PRIu64";",
+		   ", exit_code=%d, kill_requid=%d where job_db_inx=%"PRIu64,
 		   exit_code, job_ptr->requid,
 		   job_ptr->db_index);
+	_add_submit_cond(&query, job_ptr);
 
 	if (debug_flags & DEBUG_FLAG_DB_JOB)
 		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+	rc = mysql_db_query_batch(mysql_conn, query);
 	xfree(query);
 
 	return rc;
@@ -948,7 +951,7 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 	char node_list[BUFFER_SIZE];
 	char *node_inx = NULL, *step_name = NULL;
 	time_t start_time, submit_time;
-	char *query = NULL;
+	char *query = NULL, *row = NULL;
 
 	if (!step_ptr->job_ptr->db_index
 	    && ((!step_ptr->job_ptr->details
@@ -1068,35 +1071,31 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 
 	step_name = slurm_add_slash_to_quotes(step_ptr->name);
 
-	/* we want to print a -1 for the requid so leave it a
-	   %d */
 	/* The stepid could be -2 so use %d not %u */
-	query = xstrdup_printf(
-		"insert into \"%s_%s\" (job_db_inx, id_step, time_start, "
-		"step_name, state, tres_alloc, "
-		"nodes_alloc, task_cnt, nodelist, node_inx, "
-		"task_dist, req_cpufreq, req_cpufreq_min, req_cpufreq_gov) "
-		"values (%"PRIu64", %d, %d, '%s', %d, '%s', %d, %d, "
-		"'%s', '%s', %d, %u, %u, %u) "
-		"on duplicate key update "
-		"nodes_alloc=%d, task_cnt=%d, time_end=0, state=%d, "
-		"nodelist='%s', node_inx='%s', task_dist=%d, "
-		"req_cpufreq=%u, req_cpufreq_min=%u, req_cpufreq_gov=%u,"
-		"tres_alloc='%s';",
-		mysql_conn->cluster_name, step_table,
+	row = xstrdup_printf(
+		"(%"PRIu64", %d, %d, '%s', %d, '%s', %d, %d, "
+		"'%s', '%s', %d, %u, %u, %u)",
 		step_ptr->job_ptr->db_index,
 		step_ptr->step_id,
 		(int)start_time, step_name,
 		JOB_RUNNING, step_ptr->tres_alloc_str,
 		nodes, tasks, node_list, node_inx, task_dist,
 		step_ptr->cpu_freq_max, step_ptr->cpu_freq_min,
-		step_ptr->cpu_freq_gov, nodes, tasks, JOB_RUNNING,
-		node_list, node_inx, task_dist, step_ptr->cpu_freq_max,
-		step_ptr->cpu_freq_min, step_ptr->cpu_freq_gov,
-		step_ptr->tres_alloc_str);
+		step_ptr->cpu_freq_gov);
+	/* Steps started together are inserted with one statement, so the
+	 * update has to take its values from the row being inserted */
+	query = xstrdup_printf(
+		"insert into \"%s_%s\" (job_db_inx, id_step, time_start, "
+		"step_name, state, tres_alloc, "
+		"nodes_alloc, task_cnt, nodelist, node_inx, "
+		"task_dist, req_cpufreq, req_cpufreq_min, req_cpufreq_gov) "
+		"values",
+		mysql_conn->cluster_name, step_table);
 	if (debug_flags & DEBUG_FLAG_DB_STEP)
-		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+		DB_DEBUG(mysql_conn->conn, "query\n%s %s %s",
+			 query, row, step_start_update);
+	rc = mysql_db_insert_batch(mysql_conn, query, row, step_start_update);
+	xfree(row);
 	xfree(query);
 	xfree(step_name);
 
@@ -1295,7 +1294,7 @@ extern int as_mysql_step_complete(mysql_conn_t *mysql_conn,
 		   step_ptr->job_ptr->db_index, step_ptr->step_id);
 	if (debug_flags & DEBUG_FLAG_DB_STEP)
 		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+	rc = mysql_db_query_batch(mysql_conn, query);
 	xfree(query);
 
 	return rc;
@@ -1358,11 +1357,13 @@ extern int as_mysql_suspend(mysql_conn_t *mysql_conn,
 	*/
 	xstrfmtcat(query,
 		   "update \"%s_%s\" set time_suspended=%d-time_suspended, "
-		   "state=%d where job_db_inx=%"PRIu64";",
+		   "state=%d where job_db_inx=%"PRIu64,
 		   mysql_conn->cluster_name, job_table,
 		   (int)job_ptr->suspend_time,
 		   job_ptr->job_state & JOB_STATE_BASE,
 		   job_db_inx);
+	_add_submit_cond(&query, job_ptr);
+	xstrcat(query, ";");
 	if (IS_JOB_SUSPENDED(job_ptr))
 		xstrfmtcat(query,
 			   "insert into \"%s_%s\" (job_db_inx, id_assoc, "
@@ -1406,8 +1407,8 @@ extern int as_mysql_flush_jobs_on_cluster(
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
 	char *query = NULL;
-	char *id_char = NULL;
-	char *suspended_char = NULL;
+	char *id_char = NULL, *job_id_char = NULL;
+	char *suspended_char = NULL, *job_suspended_char = NULL;
 
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
@@ -1416,8 +1417,8 @@ extern int as_mysql_flush_jobs_on_cluster(
 	 * the suspend table and the step table
 	 */
 	query = xstrdup_printf(
-		"select distinct t1.job_db_inx, t1.state from \"%s_%s\" "
-		"as t1 where t1.time_end=0;",
+		"select distinct t1.job_db_inx, t1.state, t1.time_submit "
+		"from \"%s_%s\" as t1 where t1.time_end=0;",
 		mysql_conn->cluster_name, job_table);
 	if (debug_flags & DEBUG_FLAG_DB_JOB)
 		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
@@ -1437,12 +1438,20 @@ extern int as_mysql_flush_jobs_on_cluster(
 			else
 				xstrfmtcat(suspended_char, "job_db_inx=%s",
 					   row[0]);
+			/* Keys of the job table records, see
+			 * _add_submit_cond() */
+			xstrfmtcat(job_suspended_char,
+				   "%s(job_db_inx=%s && time_submit=%s)",
+				   job_suspended_char ? " || " : "",
+				   row[0], row[2]);
 		}
 
 		if (id_char)
 			xstrfmtcat(id_char, " || job_db_inx=%s", row[0]);
 		else
 			xstrfmtcat(id_char, "job_db_inx=%s", row[0]);
+		xstrfmtcat(job_id_char, "%s(job_db_inx=%s && time_submit=%s)",
+			   job_id_char ? " || " : "", row[0], row[2]);
 	}
 	mysql_free_result(result);
 
@@ -1452,7 +1461,7 @@ extern int as_mysql_flush_jobs_on_cluster(
 			   "time_suspended=%ld-time_suspended "
 			   "where %s;",
 			   mysql_conn->cluster_name, job_table,
-			   event_time, suspended_char);
+			   event_time, job_suspended_char);
 		xstrfmtcat(query,
 			   "update \"%s_%s\" set "
 			   "time_suspended=%ld-time_suspended "
@@ -1465,19 +1474,21 @@ extern int as_mysql_flush_jobs_on_cluster(
 			   mysql_conn->cluster_name, suspend_table,
 			   event_time, suspended_char);
 		xfree(suspended_char);
+		xfree(job_suspended_char);
 	}
 	if (id_char) {
 		xstrfmtcat(query,
 			   "update \"%s_%s\" set state=%d, "
 			   "time_end=%ld where %s;",
 			   mysql_conn->cluster_name, job_table,
-			   JOB_CANCELLED, event_time, id_char);
+			   JOB_CANCELLED, event_time, job_id_char);
 		xstrfmtcat(query,
 			   "update \"%s_%s\" set state=%d, "
 			   "time_end=%ld where %s;",
 			   mysql_conn->cluster_name, step_table,
 			   JOB_CANCELLED, event_time, id_char);
 		xfree(id_char);
+		xfree(job_id_char);
 	}
 
 	if (query) {
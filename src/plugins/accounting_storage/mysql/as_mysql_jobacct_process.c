@@ -44,6 +44,9 @@
 
 #include "as_mysql_jobacct_process.h"
 
+/* Rows of jobs fetched at a time when streaming them */
+#define JOB_STREAM_CHUNK 1000
+
 typedef struct {
 	hostlist_t hl;
 	time_t start;
@@ -253,6 +256,102 @@ enum {
 	STEP_REQ_COUNT
 };
 
+/* Only used to select node_inx when jobs are filtered by used_nodes */
+#define REQ_FIELD_NODE_INX 0x80000000
+
+/* Columns above that are only selected when their JOBCOND_FIELD_* group
+ * is asked for, otherwise '' is selected in their place so the row
+ * indexes stay the same.  The job and step names and allocated TRES are
+ * always selected since track_steps is figured out from them. */
+typedef struct {
+	int inx;
+	uint32_t field;
+} req_field_t;
+
+static req_field_t job_req_fields[] = {
+	{ JOB_REQ_ACCOUNT1, JOBCOND_FIELD_ASSOC },
+	{ JOB_REQ_ADMIN_COMMENT, JOBCOND_FIELD_COMMENT },
+	{ JOB_REQ_DERIVED_ES, JOBCOND_FIELD_COMMENT },
+	{ JOB_REQ_BLOCKID, JOBCOND_FIELD_COMMENT },
+	{ JOB_REQ_RESV_NAME, JOBCOND_FIELD_RESV },
+	{ JOB_REQ_NODE_INX, REQ_FIELD_NODE_INX },
+	{ JOB_REQ_NODELIST, JOBCOND_FIELD_NODES },
+	{ JOB_REQ_PARTITION, JOBCOND_FIELD_ASSOC },
+	{ JOB_REQ_WCKEY, JOBCOND_FIELD_ASSOC },
+	{ JOB_REQ_GRES_ALLOC, JOBCOND_FIELD_TRES },
+	{ JOB_REQ_GRES_REQ, JOBCOND_FIELD_TRES },
+	{ JOB_REQ_GRES_USED, JOBCOND_FIELD_TRES },
+	{ JOB_REQ_TRESR, JOBCOND_FIELD_TRES },
+	{ JOB_REQ_ACCOUNT, JOBCOND_FIELD_ASSOC },
+	{ -1, 0 }
+};
+
+static req_field_t step_req_fields[] = {
+	{ STEP_REQ_NODELIST, JOBCOND_FIELD_NODES },
+	{ STEP_REQ_NODE_INX, REQ_FIELD_NODE_INX },
+	{ STEP_REQ_MAX_DISK_READ, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_DISK_READ_TASK, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_DISK_READ_NODE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_AVE_DISK_READ, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_DISK_WRITE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_DISK_WRITE_TASK, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_DISK_WRITE_NODE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_AVE_DISK_WRITE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_VSIZE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_VSIZE_TASK, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_VSIZE_NODE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_AVE_VSIZE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_RSS, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_RSS_TASK, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_RSS_NODE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_AVE_RSS, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_PAGES, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_PAGES_TASK, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MAX_PAGES_NODE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_AVE_PAGES, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MIN_CPU_TASK, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_MIN_CPU_NODE, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_AVE_CPU, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_ACT_CPUFREQ, JOBCOND_FIELD_STATS },
+	{ STEP_REQ_CONSUMED_ENERGY, JOBCOND_FIELD_STATS },
+	{ -1, 0 }
+};
+
+/* Return the JOBCOND_FIELD_* groups of columns to select for job_cond */
+static uint32_t _get_req_fields(slurmdb_job_cond_t *job_cond)
+{
+	uint32_t fields = JOBCOND_FIELD_ALL;
+
+	if (job_cond && job_cond->fields)
+		fields = job_cond->fields;
+	if (job_cond && job_cond->used_nodes)
+		fields |= REQ_FIELD_NODE_INX;
+
+	return fields;
+}
+
+/* Return an xmalloc'ed list of the columns to select, caller must xfree */
+static char *_make_req_str(char **req_inx, int count,
+			   req_field_t *req_fields, uint32_t fields)
+{
+	char *req_str = NULL, *col;
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		col = req_inx[i];
+		for (j = 0; req_fields[j].field; j++) {
+			if (req_fields[j].inx != i)
+				continue;
+			if (!(req_fields[j].field & fields))
+				col = "''";
+			break;
+		}
+		xstrfmtcat(req_str, "%s%s", i ? ", " : "", col);
+	}
+
+	return req_str;
+}
+
 static void _state_time_string(char **extra, char *cluster_name, uint32_t state,
 			       uint32_t start, uint32_t end)
 {
@@ -370,9 +469,12 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			     char *cluster_name,
 			     char *job_fields, char *step_fields,
 			     char *sent_extra,
-			     bool is_admin, int only_pending, List sent_list)
+			     bool is_admin, int only_pending, List sent_list,
+			     assoc_mgr_lock_t *locks,
+			     int (*callback)(List job_list, void *arg),
+			     void *arg)
 {
-	char *query = NULL;
+	char *query = NULL, *base_query = NULL;
 	char *extra = xstrdup(sent_extra);
 	uint16_t private_data = slurm_get_private_data();
 	slurmdb_selected_step_t *selected_step = NULL;
@@ -388,6 +490,9 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	char *prefix="t2";
 	int rc = SLURM_SUCCESS;
 	int last_id = -1, curr_id = -1;
+	uint32_t chunk_size = JOB_STREAM_CHUNK, first_id = 0, stop_id = 0;
+	bool has_where = false;
+	uint32_t fields = _get_req_fields(job_cond);
 	local_cluster_t *curr_cluster = NULL;
 
 	/* This is here to make sure we are looking at only this user
@@ -457,32 +562,44 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	setup_job_cluster_cond_limits(mysql_conn, job_cond,
 				      cluster_name, &extra);
 
-	query = xstrdup_printf("select %s from \"%s_%s\" as t1 "
-			       "left join \"%s_%s\" as t2 "
-			       "on t1.id_assoc=t2.id_assoc "
-			       "left join \"%s_%s\" as t3 "
-			       "on t1.id_resv=t3.id_resv && "
-			       "((t1.time_start && "
-			       "(t3.time_start < t1.time_start && "
-			       "(t3.time_end >= t1.time_start || "
-			       "t3.time_end = 0))) || "
-			       "((t3.time_start < t1.time_submit && "
-			       "(t3.time_end >= t1.time_submit || "
-			       "t3.time_end = 0)) || "
-			       "(t3.time_start > t1.time_submit)))",
-			       job_fields, cluster_name, job_table,
-			       cluster_name, assoc_table,
-			       cluster_name, resv_table);
+	base_query = xstrdup_printf("select %s from \"%s_%s\" as t1 "
+				    "left join \"%s_%s\" as t2 "
+				    "on t1.id_assoc=t2.id_assoc",
+				    job_fields, cluster_name, job_table,
+				    cluster_name, assoc_table);
+	/* The reservation is only joined for its name */
+	if (fields & JOBCOND_FIELD_RESV)
+		xstrfmtcat(base_query, " left join \"%s_%s\" as t3 "
+			   "on t1.id_resv=t3.id_resv && "
+			   "((t1.time_start && "
+			   "(t3.time_start < t1.time_start && "
+			   "(t3.time_end >= t1.time_start || "
+			   "t3.time_end = 0))) || "
+			   "((t3.time_start < t1.time_submit && "
+			   "(t3.time_end >= t1.time_submit || "
+			   "t3.time_end = 0)) || "
+			   "(t3.time_start > t1.time_submit)))",
+			   cluster_name, resv_table);
 	if (extra) {
-		xstrcat(query, extra);
+		xstrcat(base_query, extra);
 		xfree(extra);
+		has_where = true;
 	}
 
+next_chunk:
 	/* Here we want to order them this way in such a way so it is
 	   easy to look for duplicates, it is also easy to sort the
 	   resized jobs.
 	*/
-	xstrcat(query, " group by id_job, time_submit desc");
+	if (callback)
+		query = xstrdup_printf("%s %s t1.id_job>=%u "
+				       "group by id_job, time_submit desc "
+				       "limit %u", base_query,
+				       has_where ? "&&" : "where",
+				       first_id, chunk_size);
+	else
+		query = xstrdup_printf("%s group by id_job, time_submit desc",
+				       base_query);
 
 	if (debug_flags & DEBUG_FLAG_DB_JOB)
 		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
@@ -493,6 +610,26 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	}
 	xfree(query);
 
+	/* When streaming, a full chunk may end partway through the rows of
+	   its last job ID, so stop before that job ID and start the next
+	   chunk with it.
+	*/
+	stop_id = 0;
+	if (callback && (mysql_num_rows(result) >= chunk_size)) {
+		row = mysql_fetch_row(result);
+		curr_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		mysql_data_seek(result, mysql_num_rows(result) - 1);
+		row = mysql_fetch_row(result);
+		stop_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		mysql_data_seek(result, 0);
+		if (stop_id == curr_id) {
+			/* One job ID fills the chunk */
+			mysql_free_result(result);
+			chunk_size *= 2;
+			goto next_chunk;
+		}
+	}
+
 
 	/* Here we set up environment to check used nodes of jobs.
 	   Since we store the bitmap of the entire cluster we can use
@@ -500,7 +637,7 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	   things work.  This should go before the setup of conds
 	   since we could update the start/end time.
 	*/
-	if (job_cond && job_cond->used_nodes) {
+	if (job_cond && job_cond->used_nodes && !local_cluster_list) {
 		local_cluster_list = setup_cluster_list_with_inx(
 			mysql_conn, job_cond, (void **)&curr_cluster);
 		if (!local_cluster_list) {
@@ -516,6 +653,8 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 		int start = slurm_atoul(row[JOB_REQ_START]);
 
 		curr_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		if (stop_id && (curr_id == stop_id))
+			break;
 
 		if (job_cond && !job_cond->duplicates
 		    && (curr_id == last_id)
@@ -534,6 +673,8 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 		}
 
 		job = slurmdb_create_job_rec();
+		if (job_cond)
+			job->fields = job_cond->fields;
 		job->state = slurm_atoul(row[JOB_REQ_STATE]);
 		if (curr_id == last_id)
 			/* put in reverse so we order by the submit getting
@@ -642,8 +783,8 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 				if (!(result2 = mysql_db_query_ret(
 					      mysql_conn,
 					      query, 0))) {
-					FREE_NULL_LIST(job_list);
-					job_list = NULL;
+					xfree(query);
+					rc = SLURM_ERROR;
 					break;
 				}
 				xfree(query);
@@ -976,13 +1117,28 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	}
 	mysql_free_result(result);
 
+	if (callback && (rc == SLURM_SUCCESS)) {
+		/* Don't hold the assoc_mgr locks while the chunk is sent */
+		if (list_count(job_list)) {
+			assoc_mgr_unlock(locks);
+			rc = (callback)(job_list, arg);
+			assoc_mgr_lock(locks);
+		}
+		list_flush(job_list);
+		if (stop_id && (rc == SLURM_SUCCESS)) {
+			first_id = stop_id;
+			goto next_chunk;
+		}
+	}
+
 end_it:
 	if (itr2)
 		list_iterator_destroy(itr2);
 
 	FREE_NULL_LIST(local_cluster_list);
+	xfree(base_query);
 
-	if (rc == SLURM_SUCCESS)
+	if ((rc == SLURM_SUCCESS) && sent_list)
 		list_transfer(sent_list, job_list);
 
 	FREE_NULL_LIST(job_list);
@@ -1516,6 +1672,21 @@ extern int setup_job_cond_limits(slurmdb_job_cond_t *job_cond,
 		}
 	}
 
+	/*
+	 * Every time condition above (and the state ones added per cluster)
+	 * needs the job to be eligible, started or ended before usage_end,
+	 * so it was submitted before then too.  Saying so lets MySQL skip
+	 * the partitions of newer jobs when PartitionJobTable is set.
+	 */
+	if (job_cond->usage_end) {
+		if (*extra)
+			xstrcat(*extra, " && (");
+		else
+			xstrcat(*extra, " where (");
+		xstrfmtcat(*extra, "t1.time_submit <= %ld)",
+			   job_cond->usage_end);
+	}
+
 	if (job_cond->wckey_list && list_count(job_cond->wckey_list)) {
 		set = 0;
 		if (*extra)
@@ -1536,20 +1707,22 @@ extern int setup_job_cond_limits(slurmdb_job_cond_t *job_cond,
 	return set;
 }
 
-extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
-					      uid_t uid,
-					      slurmdb_job_cond_t *job_cond)
+/* Get jobs into job_list, or pass them to callback a chunk at a time */
+static int _get_jobs(mysql_conn_t *mysql_conn, uid_t uid,
+		     slurmdb_job_cond_t *job_cond, List job_list,
+		     int (*callback)(List job_list, void *arg), void *arg)
 {
 	char *extra = NULL;
 	char *tmp = NULL, *tmp2 = NULL;
 	ListIterator itr = NULL;
 	int is_admin=1;
-	int i;
-	List job_list = NULL;
+	int rc = SLURM_SUCCESS;
 	uint16_t private_data = 0;
+	uint32_t fields;
 	slurmdb_user_rec_t user;
 	int only_pending = 0;
 	List use_cluster_list = as_mysql_cluster_list;
+	bool new_cluster_list = false;
 	char *cluster_name;
 	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
 				   READ_LOCK, NO_LOCK, NO_LOCK };
@@ -1570,7 +1743,7 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 		if (!is_admin && !user.name) {
 			debug("User %u has no associations, and is not admin, "
 			      "so not returning any jobs.", user.uid);
-			return NULL;
+			return SLURM_SUCCESS;
 		}
 	}
 
@@ -1581,47 +1754,79 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 	setup_job_cond_limits(job_cond, &extra);
 
-	xfree(tmp);
-	xstrfmtcat(tmp, "%s", job_req_inx[0]);
-	for(i=1; i<JOB_REQ_COUNT; i++) {
-		xstrfmtcat(tmp, ", %s", job_req_inx[i]);
-	}
-
-	xfree(tmp2);
-	xstrfmtcat(tmp2, "%s", step_req_inx[0]);
-	for(i=1; i<STEP_REQ_COUNT; i++) {
-		xstrfmtcat(tmp2, ", %s", step_req_inx[i]);
-	}
+	/* Only select the columns of the fields asked for */
+	fields = _get_req_fields(job_cond);
+	tmp = _make_req_str(job_req_inx, JOB_REQ_COUNT, job_req_fields,
+			    fields);
+	tmp2 = _make_req_str(step_req_inx, STEP_REQ_COUNT, step_req_fields,
+			     fields);
 
 	if (job_cond
 	    && job_cond->cluster_list && list_count(job_cond->cluster_list))
 		use_cluster_list = job_cond->cluster_list;
-	else
+	else {
+		/* Streaming sends each chunk while the clusters are still
+		 * being read, so don't keep the as_mysql_cluster_list_lock
+		 * locked the whole time, just copy the list and work off
+		 * that.
+		 */
+		new_cluster_list = true;
+		use_cluster_list = list_create(slurm_destroy_char);
 		slurm_mutex_lock(&as_mysql_cluster_list_lock);
+		itr = list_iterator_create(as_mysql_cluster_list);
+		while ((cluster_name = list_next(itr)))
+			list_append(use_cluster_list, xstrdup(cluster_name));
+		list_iterator_destroy(itr);
+		slurm_mutex_unlock(&as_mysql_cluster_list_lock);
+	}
 
+	/* When streaming, _cluster_get_jobs() releases these locks while
+	 * each chunk is handed to the callback */
 	assoc_mgr_lock(&locks);
 
-	job_list = list_create(slurmdb_destroy_job_rec);
 	itr = list_iterator_create(use_cluster_list);
 	while ((cluster_name = list_next(itr))) {
-		int rc;
 		if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
 					    cluster_name, tmp, tmp2, extra,
-					    is_admin, only_pending, job_list))
-		    != SLURM_SUCCESS)
+					    is_admin, only_pending, job_list,
+					    &locks, callback, arg))
+		    != SLURM_SUCCESS) {
 			error("Problem getting jobs for cluster %s",
 			      cluster_name);
+			/* Jobs already streamed can not be taken back */
+			if (callback)
+				break;
+			rc = SLURM_SUCCESS;
+		}
 	}
 	list_iterator_destroy(itr);
 
 	assoc_mgr_unlock(&locks);
 
-	if (use_cluster_list == as_mysql_cluster_list)
-		slurm_mutex_unlock(&as_mysql_cluster_list_lock);
+	if (new_cluster_list)
+		FREE_NULL_LIST(use_cluster_list);
 
 	xfree(tmp);
 	xfree(tmp2);
 	xfree(extra);
 
+	return rc;
+}
+
+extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
+					      uid_t uid,
+					      slurmdb_job_cond_t *job_cond)
+{
+	List job_list = list_create(slurmdb_destroy_job_rec);
+
+	(void) _get_jobs(mysql_conn, uid, job_cond, job_list, NULL, NULL);
+
 	return job_list;
 }
+
+extern int as_mysql_jobacct_process_get_jobs_stream(
+	mysql_conn_t *mysql_conn, uid_t uid, slurmdb_job_cond_t *job_cond,
+	int (*callback)(List job_list, void *arg), void *arg)
+{
+	return _get_jobs(mysql_conn, uid, job_cond, NULL, callback, arg);
+}
@@ -55,6 +55,11 @@ enum {
 	WCKEY_TABLES
 };
 
+/* Index the assoc and wckey usage of an hour by id, a cluster can have
+ * far too many of them to search a list for each job. */
+#define ID_USAGE_HASH_SIZE 1000
+#define ID_USAGE_HASH_INX(_id) (_id % ID_USAGE_HASH_SIZE)
+
 typedef struct {
 	uint64_t count;
 	uint32_t id;
@@ -67,9 +72,11 @@ typedef struct {
 	uint64_t total_time;
 } local_tres_usage_t;
 
-typedef struct {
+typedef struct local_id_usage {
 	int id;
 	List loc_tres;
+	struct local_id_usage *next_id; /* next usage in the same id hash
+					 * bucket, see _add_id_usage() */
 } local_id_usage_t;
 
 typedef struct {
@@ -79,6 +86,14 @@ typedef struct {
 	time_t start;
 } local_cluster_usage_t;
 
+typedef struct {
+	char *cluster_name;
+	time_t end;
+	mysql_conn_t *mysql_conn;
+	int rc;
+	time_t start;
+} local_hour_rollup_t;
+
 typedef struct {
 	time_t end;
 	int id;
@@ -134,14 +149,34 @@ static int _find_loc_tres(void *x, void *key)
 	return 0;
 }
 
-static int _find_id_usage(void *x, void *key)
+static local_id_usage_t *_find_id_usage(local_id_usage_t **id_hash,
+					 uint32_t id)
 {
-	local_id_usage_t *loc = (local_id_usage_t *)x;
-	uint32_t id = *(uint32_t *)key;
+	local_id_usage_t *id_usage = id_hash[ID_USAGE_HASH_INX(id)];
 
-	if (loc->id == id)
-		return 1;
-	return 0;
+	while (id_usage) {
+		if (id_usage->id == id)
+			break;
+		id_usage = id_usage->next_id;
+	}
+
+	return id_usage;
+}
+
+/* The usage is owned by usage_list, id_hash only points to it */
+static local_id_usage_t *_add_id_usage(List usage_list,
+				       local_id_usage_t **id_hash,
+				       uint32_t id)
+{
+	local_id_usage_t *id_usage = xmalloc(sizeof(local_id_usage_t));
+	int inx = ID_USAGE_HASH_INX(id);
+
+	id_usage->id = id;
+	id_usage->next_id = id_hash[inx];
+	id_hash[inx] = id_usage;
+	list_append(usage_list, id_usage);
+
+	return id_usage;
 }
 
 static void _remove_job_tres_time_from_cluster(List c_tres, List j_tres,
@@ -885,10 +920,9 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 	return c_usage;
 }
 
-extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
-				  char *cluster_name,
-				  time_t start, time_t end,
-				  uint16_t archive_data)
+/* Roll up the hours from start to end, the caller commits */
+static int _hourly_rollup(mysql_conn_t *mysql_conn, char *cluster_name,
+			  time_t start, time_t end)
 {
 	int rc = SLURM_SUCCESS;
 	int add_sec = 3600;
@@ -907,6 +941,10 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 	List cluster_down_list = list_create(_destroy_local_cluster_usage);
 	List wckey_usage_list = list_create(_destroy_local_id_usage);
 	List resv_usage_list = list_create(_destroy_local_resv_usage);
+	local_id_usage_t **assoc_hash =
+		xmalloc(sizeof(local_id_usage_t *) * ID_USAGE_HASH_SIZE);
+	local_id_usage_t **wckey_hash =
+		xmalloc(sizeof(local_id_usage_t *) * ID_USAGE_HASH_SIZE);
 	uint16_t track_wckey = slurm_get_track_wckey();
 	local_cluster_usage_t *loc_c_usage = NULL;
 	local_cluster_usage_t *c_usage = NULL;
@@ -1234,9 +1272,11 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 			}
 
 			if (last_id != assoc_id) {
-				a_usage = xmalloc(sizeof(local_id_usage_t));
-				a_usage->id = assoc_id;
-				list_append(assoc_usage_list, a_usage);
+				if (!(a_usage = _find_id_usage(assoc_hash,
+							       assoc_id)))
+					a_usage = _add_id_usage(
+						assoc_usage_list, assoc_hash,
+						assoc_id);
 				last_id = assoc_id;
 				/* a_usage->loc_tres is made later,
 				   don't do it here.
@@ -1249,17 +1289,11 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 
 			/* do the wckey calculation */
 			if (last_wckeyid != wckey_id) {
-				list_iterator_reset(w_itr);
-				while ((w_usage = list_next(w_itr)))
-					if (w_usage->id == wckey_id)
-						break;
-
-				if (!w_usage) {
-					w_usage = xmalloc(
-						sizeof(local_id_usage_t));
-					w_usage->id = wckey_id;
-					list_append(wckey_usage_list,
-						    w_usage);
+				if (!(w_usage = _find_id_usage(wckey_hash,
+							       wckey_id))) {
+					w_usage = _add_id_usage(
+						wckey_usage_list, wckey_hash,
+						wckey_id);
 					w_usage->loc_tres = list_create(
 						_destroy_local_tres_usage);
 				}
@@ -1483,20 +1517,14 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 					r_usage->local_assocs);
 				while ((assoc = list_next(tmp_itr))) {
 					uint32_t associd = slurm_atoul(assoc);
-					if ((last_id != associd) &&
-					    !(a_usage = list_find_first(
-						      assoc_usage_list,
-						      _find_id_usage,
-						      &associd))) {
-						a_usage = xmalloc(
-							sizeof(local_id_usage_t));
-						a_usage->id = associd;
-						list_append(assoc_usage_list,
-							    a_usage);
-						last_id = associd;
+					if (!(a_usage = _find_id_usage(
+						      assoc_hash, associd)))
+						a_usage = _add_id_usage(
+							assoc_usage_list,
+							assoc_hash, associd);
+					if (!a_usage->loc_tres)
 						a_usage->loc_tres = list_create(
 							_destroy_local_tres_usage);
-					}
 
 					_add_time_tres(a_usage->loc_tres,
 						       TIME_ALLOC, loc_tres->id,
@@ -1580,6 +1608,10 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 		list_flush(cluster_down_list);
 		list_flush(wckey_usage_list);
 		list_flush(resv_usage_list);
+		memset(assoc_hash, 0,
+		       sizeof(local_id_usage_t *) * ID_USAGE_HASH_SIZE);
+		memset(wckey_hash, 0,
+		       sizeof(local_id_usage_t *) * ID_USAGE_HASH_SIZE);
 		curr_start = curr_end;
 		curr_end = curr_start + add_sec;
 	}
@@ -1605,21 +1637,133 @@ end_it:
 	FREE_NULL_LIST(cluster_down_list);
 	FREE_NULL_LIST(wckey_usage_list);
 	FREE_NULL_LIST(resv_usage_list);
+	xfree(assoc_hash);
+	xfree(wckey_hash);
 
 /* 	info("stop start %s", slurm_ctime2(&curr_start)); */
 /* 	info("stop end %s", slurm_ctime2(&curr_end)); */
 
+	return rc;
+}
+
+static int _commit_hourly_rollup(mysql_conn_t *mysql_conn,
+				 char *cluster_name,
+				 time_t start, time_t end)
+{
+	char start_char[25], end_char[25];
+
+	if (!mysql_db_commit(mysql_conn))
+		return SLURM_SUCCESS;
+
+	error("Couldn't commit cluster (%s) hour rollup for %s - %s",
+	      cluster_name, slurm_ctime2_r(&start, start_char),
+	      slurm_ctime2_r(&end, end_char));
+	return SLURM_ERROR;
+}
+
+static void *_hourly_rollup_worker(void *arg)
+{
+	local_hour_rollup_t *hour_rollup = (local_hour_rollup_t *)arg;
+	mysql_conn_t mysql_conn;
+	int rc;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = hour_rollup->mysql_conn->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	/* Each worker needs it's own connection so its hours can be
+	 * committed on their own. */
+	if ((rc = check_connection(&mysql_conn)) == SLURM_SUCCESS)
+		rc = _hourly_rollup(&mysql_conn, hour_rollup->cluster_name,
+				    hour_rollup->start, hour_rollup->end);
+
+	if (rc == SLURM_SUCCESS)
+		rc = _commit_hourly_rollup(&mysql_conn,
+					   hour_rollup->cluster_name,
+					   hour_rollup->start,
+					   hour_rollup->end);
+	else if (mysql_db_rollback(&mysql_conn))
+		error("rollback failed");
+
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+	hour_rollup->rc = rc;
+
+	return NULL;
+}
+
+extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
+				  char *cluster_name,
+				  time_t start, time_t end,
+				  uint16_t archive_data)
+{
+	int rc = SLURM_SUCCESS;
+	int i, hours, worker_cnt = 1;
+	local_hour_rollup_t *hour_rollups;
+	pthread_t *worker_threads;
+	pthread_attr_t attr;
+
+	/* Hours do not depend on each other, so when catching up on
+	 * more than one hour split them between RollupWorkers
+	 * connections.  The first share is done on our own connection
+	 * and committed below like a single hour would be. */
+	hours = (end - start) / 3600;
+	if (slurmdbd_conf)
+		worker_cnt = MIN(slurmdbd_conf->rollup_workers, hours);
+
+	if (worker_cnt <= 1) {
+		rc = _hourly_rollup(mysql_conn, cluster_name, start, end);
+		goto commit;
+	}
+
+	if (debug_flags & DEBUG_FLAG_DB_USAGE)
+		DB_DEBUG(mysql_conn->conn,
+			 "%s rolling up %d hours on %d connections",
+			 cluster_name, hours, worker_cnt);
+
+	hour_rollups = xmalloc(sizeof(local_hour_rollup_t) * worker_cnt);
+	worker_threads = xmalloc(sizeof(pthread_t) * worker_cnt);
+	for (i = 0; i < worker_cnt; i++) {
+		hour_rollups[i].cluster_name = cluster_name;
+		hour_rollups[i].mysql_conn = mysql_conn;
+		hour_rollups[i].start = start + (time_t)3600 *
+			((hours * i) / worker_cnt);
+		hour_rollups[i].end = start + (time_t)3600 *
+			((hours * (i + 1)) / worker_cnt);
+	}
+	hour_rollups[worker_cnt - 1].end = end;
+
+	slurm_attr_init(&attr);
+	for (i = 1; i < worker_cnt; i++) {
+		if (pthread_create(&worker_threads[i], &attr,
+				   _hourly_rollup_worker, &hour_rollups[i])) {
+			error("%s: pthread_create: %m", __func__);
+			_hourly_rollup_worker(&hour_rollups[i]);
+			worker_threads[i] = 0;
+		}
+	}
+	slurm_attr_destroy(&attr);
+
+	rc = _hourly_rollup(mysql_conn, cluster_name,
+			    hour_rollups[0].start, hour_rollups[0].end);
+	for (i = 1; i < worker_cnt; i++) {
+		if (worker_threads[i])
+			pthread_join(worker_threads[i], NULL);
+		if (hour_rollups[i].rc != SLURM_SUCCESS)
+			rc = hour_rollups[i].rc;
+	}
+	end = hour_rollups[0].end;
+	xfree(hour_rollups);
+	xfree(worker_threads);
+
+commit:
 	/* go check to see if we archive and purge */
 
 	if (rc == SLURM_SUCCESS) {
-		if (mysql_db_commit(mysql_conn)) {
-			char start[25], end[25];
-			error("Couldn't commit cluster (%s) "
-			      "hour rollup for %s - %s",
-			      cluster_name, slurm_ctime2_r(&curr_start, start),
-			      slurm_ctime2_r(&curr_end, end));
-			rc = SLURM_ERROR;
-		} else
+		rc = _commit_hourly_rollup(mysql_conn, cluster_name,
+					   start, end);
+		if (rc == SLURM_SUCCESS)
 			rc = _process_purge(mysql_conn, cluster_name,
 					    archive_data, SLURMDB_PURGE_HOURS);
 	}
@@ -103,6 +103,16 @@ static void *_cluster_rollup_usage(void *arg)
 	if (rc != SLURM_SUCCESS)
 		goto end_it;
 
+	/*
+	 * Add next month's job table partition well before it is needed.
+	 * This is DDL so it has to happen before the rollup's transaction
+	 * starts.  A failure only means new jobs go in the MAXVALUE partition
+	 * for a while, so don't hold up the rollup for it.
+	 */
+	if (slurmdbd_conf && slurmdbd_conf->partition_job_table)
+		as_mysql_job_partition_check(&mysql_conn,
+					     local_rollup->cluster_name);
+
 	if (!local_rollup->sent_start) {
 		char *tmp = NULL, *sep = "";
 		for (i = 0; i < ROLLUP_COUNT; i++) {
@@ -1001,3 +1011,53 @@ extern int as_mysql_roll_usage(mysql_conn_t *mysql_conn, time_t sent_start,
 
 	return rc;
 }
+
+/* Lower the times usage of the connection's cluster was rolled up to */
+extern int as_mysql_update_last_ran(mysql_conn_t *mysql_conn,
+				    time_t reset_time)
+{
+	char *query;
+	int rc;
+
+	query = xstrdup_printf("update \"%s_%s\" set "
+			       "hourly_rollup=least(hourly_rollup, %ld), "
+			       "daily_rollup=least(daily_rollup, %ld), "
+			       "monthly_rollup=least(monthly_rollup, %ld)",
+			       mysql_conn->cluster_name, last_ran_table,
+			       reset_time, reset_time, reset_time);
+	if (debug_flags & DEBUG_FLAG_DB_USAGE)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+
+	return rc;
+}
+
+/*
+ * Have the usage of the connection's cluster rolled up again from
+ * reset_time. On a connection committed by the slurmdbd last_ran_table is
+ * only updated by acct_storage_p_commit() right before the commit, so the
+ * connections writing the records of one batch in parallel don't wait on
+ * each other for its single row, and a batch rolled back leaves it and
+ * global_last_rollup alone.
+ */
+extern int as_mysql_reset_rollup(mysql_conn_t *mysql_conn, time_t reset_time)
+{
+	int rc;
+
+	if (mysql_conn->rollback) {
+		if (!mysql_conn->rollup_reset ||
+		    (reset_time < mysql_conn->rollup_reset))
+			mysql_conn->rollup_reset = reset_time;
+		return SLURM_SUCCESS;
+	}
+
+	if ((rc = as_mysql_update_last_ran(mysql_conn, reset_time))
+	    == SLURM_SUCCESS) {
+		slurm_mutex_lock(&rollup_lock);
+		global_last_rollup = MIN(global_last_rollup, reset_time);
+		slurm_mutex_unlock(&rollup_lock);
+	}
+
+	return rc;
+}
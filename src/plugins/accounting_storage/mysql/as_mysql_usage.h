@@ -55,5 +55,8 @@ extern int as_mysql_get_usage(mysql_conn_t *mysql_conn, uid_t uid,
 extern int as_mysql_roll_usage(mysql_conn_t *mysql_conn,
 			  time_t sent_start, time_t sent_end,
 			  uint16_t archive_data, rollup_stats_t *rollup_stats);
+extern int as_mysql_update_last_ran(mysql_conn_t *mysql_conn,
+				    time_t reset_time);
+extern int as_mysql_reset_rollup(mysql_conn_t *mysql_conn, time_t reset_time);
 
 #endif
@@ -501,6 +501,16 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return NULL;
 }
 
+/*
+ * get info from the storage a chunk of jobs at a time
+ */
+extern int jobacct_storage_p_get_jobs_cond_stream(
+	void *db_conn, uid_t uid, void *job_cond,
+	int (*callback)(List job_list, void *arg), void *arg)
+{
+	return SLURM_SUCCESS;
+}
+
 /*
  * expire old info from the storage
  */
@@ -60,6 +60,12 @@
 
 #define BUFFER_SIZE 4096
 
+typedef struct {
+	int (*callback)(List job_list, void *arg);
+	void *arg;
+	bool got_jobs;		/* a DBD_GOT_JOBS was passed on */
+} job_stream_t;
+
 /* These are defined here so when we link with something other than
  * the slurmctld we will have these symbols defined.  They will get
  * overwritten when linking with the slurmctld.
@@ -2898,6 +2904,70 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return my_job_list;
 }
 
+/* Pass one DBD_GOT_JOBS message of a DBD_GET_JOBS_STREAM reply on */
+static int _got_jobs_chunk(slurmdbd_msg_t *resp, void *arg)
+{
+	job_stream_t *stream = arg;
+	dbd_list_msg_t *got_msg;
+	int rc;
+
+	if (resp->msg_type != DBD_GOT_JOBS) {
+		error("slurmdbd: response type not DBD_GOT_JOBS: %u",
+		      resp->msg_type);
+		slurmdbd_free_msg(resp);
+		return SLURM_ERROR;
+	}
+
+	got_msg = (dbd_list_msg_t *) resp->data;
+	stream->got_jobs = true;
+	rc = (stream->callback)(got_msg->my_list, stream->arg);
+	slurmdbd_free_list_msg(got_msg);
+
+	return rc;
+}
+
+/*
+ * get info from the storage a chunk of jobs at a time
+ */
+extern int jobacct_storage_p_get_jobs_cond_stream(
+	void *db_conn, uid_t uid, slurmdb_job_cond_t *job_cond,
+	int (*callback)(List job_list, void *arg), void *arg)
+{
+	slurmdbd_msg_t req;
+	dbd_cond_msg_t get_msg;
+	job_stream_t stream;
+	List my_job_list;
+	int rc;
+
+	memset(&get_msg, 0, sizeof(dbd_cond_msg_t));
+	get_msg.cond = job_cond;
+	memset(&stream, 0, sizeof(job_stream_t));
+	stream.callback = callback;
+	stream.arg = arg;
+
+	req.msg_type = DBD_GET_JOBS_STREAM;
+	req.data = &get_msg;
+	rc = slurm_send_recv_slurmdbd_msgs(SLURM_PROTOCOL_VERSION, &req,
+					   _got_jobs_chunk, &stream);
+	if ((rc == SLURM_SUCCESS) || stream.got_jobs) {
+		if (rc != SLURM_SUCCESS)
+			error("slurmdbd: DBD_GET_JOBS_STREAM failure: %m");
+		return rc;
+	}
+
+	/* A SlurmDBD older than DBD_GET_JOBS_STREAM fails to unpack it,
+	 * get all jobs in one message instead. This also reports the error
+	 * if the query itself failed. */
+	debug("slurmdbd: DBD_GET_JOBS_STREAM failed, trying DBD_GET_JOBS_COND");
+	if (!(my_job_list = jobacct_storage_p_get_jobs_cond(db_conn, uid,
+							    job_cond)))
+		return SLURM_ERROR;
+	rc = (callback)(my_job_list, arg);
+	FREE_NULL_LIST(my_job_list);
+
+	return rc;
+}
+
 /*
  * Expire old info from the storage
  * Not applicable for any database
@@ -45,6 +45,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_defs.h"
 #include "src/common/slurm_acct_gather_energy.h"
+#include "src/common/slurm_acct_gather_profile.h"
 #include "src/common/xstring.h"
 #include "src/slurmd/common/proctrack.h"
 #include "src/slurmd/common/xcpuinfo.h"
@@ -96,20 +97,25 @@ const char plugin_name[] = "Job accounting gather cgroup plugin";
 const char plugin_type[] = "jobacct_gather/cgroup";
 const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 
+/* Cgroups of a task, loaded once for reading its counters */
+typedef struct {
+	uint32_t taskid;
+	xcgroup_t cpuacct_cg;
+	xcgroup_t memory_cg;
+} task_cg_info_t;
+
 /* Other useful declarations */
 static slurm_cgroup_conf_t slurm_cgroup_conf;
+static List task_cg_list = NULL;
 
-static void _prec_extra(jag_prec_t *prec)
+static void _read_cg_counters(jag_prec_t *prec, xcgroup_t *cpuacct_cg,
+			      xcgroup_t *memory_cg)
 {
 	unsigned long utime, stime, total_rss, total_pgpgin;
 	char *cpu_time = NULL, *memory_stat = NULL, *ptr;
 	size_t cpu_time_size = 0, memory_stat_size = 0;
 
-	//DEF_TIMERS;
-	//START_TIMER;
-	/* info("before"); */
-	/* print_jag_prec(prec); */
-	xcgroup_get_param(&task_cpuacct_cg, "cpuacct.stat",
+	xcgroup_get_param(cpuacct_cg, "cpuacct.stat",
 			  &cpu_time, &cpu_time_size);
 	if (cpu_time == NULL) {
 		debug2("%s: failed to collect cpuacct.stat pid %d ppid %d",
@@ -120,7 +126,7 @@ static void _prec_extra(jag_prec_t *prec)
 		prec->ssec = stime;
 	}
 
-	xcgroup_get_param(&task_memory_cg, "memory.stat",
+	xcgroup_get_param(memory_cg, "memory.stat",
 			  &memory_stat, &memory_stat_size);
 	if (memory_stat == NULL) {
 		debug2("%s: failed to collect memory.stat  pid %d ppid %d",
@@ -131,9 +137,11 @@ static void _prec_extra(jag_prec_t *prec)
 		   different than what proc presents, but is probably more
 		   accurate on what the user is actually using.
 		*/
-		ptr = strstr(memory_stat, "total_rss");
-		sscanf(ptr, "total_rss %lu", &total_rss);
-		prec->rss = total_rss / 1024; /* convert from bytes to KB */
+		if ((ptr = strstr(memory_stat, "total_rss"))) {
+			sscanf(ptr, "total_rss %lu", &total_rss);
+			/* convert from bytes to KB */
+			prec->rss = total_rss / 1024;
+		}
 
 		/* total_pgmajfault is what is reported in proc, so we use
 		 * the same thing here. */
@@ -174,13 +182,110 @@ static void _prec_extra(jag_prec_t *prec)
 	/* } */
 	/* prec->disk_read = (double)tot_read / (double)1048576; */
 	/* prec->disk_write = (double)tot_write / (double)1048576; */
+}
 
-	/* info("after %d %d", total_rss); */
-	/* print_jag_prec(prec); */
-	//END_TIMER;
-	//info("took %s", TIME_STR);
-	return;
+static void _prec_extra(jag_prec_t *prec)
+{
+	_read_cg_counters(prec, &task_cpuacct_cg, &task_memory_cg);
+}
+
+static void _task_cg_free(void *x)
+{
+	task_cg_info_t *task_cg = (task_cg_info_t *) x;
 
+	if (task_cg) {
+		xcgroup_destroy(&task_cg->cpuacct_cg);
+		xcgroup_destroy(&task_cg->memory_cg);
+		xfree(task_cg);
+	}
+}
+
+static int _find_task_cg(void *x, void *key)
+{
+	task_cg_info_t *task_cg = (task_cg_info_t *) x;
+	uint32_t *taskid = (uint32_t *) key;
+
+	if (task_cg->taskid == *taskid)
+		return 1;
+
+	return 0;
+}
+
+static task_cg_info_t *_get_task_cg(uint32_t taskid)
+{
+	task_cg_info_t *task_cg;
+
+	if (!task_cg_list)
+		task_cg_list = list_create(_task_cg_free);
+
+	if ((task_cg = list_find_first(task_cg_list, _find_task_cg, &taskid)))
+		return task_cg;
+
+	task_cg = xmalloc(sizeof(task_cg_info_t));
+	task_cg->taskid = taskid;
+	if ((jobacct_gather_cgroup_cpuacct_task_load(
+		     taskid, &task_cg->cpuacct_cg) != SLURM_SUCCESS) ||
+	    (jobacct_gather_cgroup_memory_task_load(
+		     taskid, &task_cg->memory_cg) != SLURM_SUCCESS)) {
+		_task_cg_free(task_cg);
+		return NULL;
+	}
+	list_append(task_cg_list, task_cg);
+
+	return task_cg;
+}
+
+/* Return true if every task has its cgroups, loading them as needed */
+static bool _task_cgs_loaded(List task_list)
+{
+	ListIterator itr;
+	struct jobacctinfo *jobacct;
+	bool loaded = true;
+
+	if (!task_list)
+		return false;
+
+	itr = list_iterator_create(task_list);
+	while ((jobacct = list_next(itr))) {
+		if (!_get_task_cg(jobacct->id.taskid)) {
+			debug2("%s: no cgroups for task %u, using /proc",
+			       __func__, jobacct->id.taskid);
+			loaded = false;
+			break;
+		}
+	}
+	list_iterator_destroy(itr);
+
+	return loaded;
+}
+
+/*
+ * Build one process record per task from the counters of its cgroups,
+ * which include all of the processes of the task. Virtual memory size and
+ * disk I/O are not available from the cgroups and are left zero.
+ */
+static List _get_precs_cgroup(List task_list, bool pgid_plugin,
+			      uint64_t cont_id, jag_callbacks_t *callbacks)
+{
+	List prec_list = list_create(destroy_jag_prec);
+	ListIterator itr;
+	struct jobacctinfo *jobacct;
+	task_cg_info_t *task_cg;
+	jag_prec_t *prec;
+
+	itr = list_iterator_create(task_list);
+	while ((jobacct = list_next(itr))) {
+		if (!(task_cg = _get_task_cg(jobacct->id.taskid)))
+			continue;
+		prec = xmalloc(sizeof(jag_prec_t));
+		prec->pid = jobacct->pid;
+		_read_cg_counters(prec, &task_cg->cpuacct_cg,
+				  &task_cg->memory_cg);
+		list_append(prec_list, prec);
+	}
+	list_iterator_destroy(itr);
+
+	return prec_list;
 }
 
 static bool _run_in_daemon(void)
@@ -286,21 +391,43 @@ extern void jobacct_gather_p_poll_data(
 {
 	static jag_callbacks_t callbacks;
 	static bool first = 1;
+	static bool use_counters = false;
+	DEF_TIMERS;
 
 	if (first) {
+		char *acct_params = slurm_get_jobacct_gather_params();
+		if (acct_params && strstr(acct_params, "UseCgroupCounters"))
+			use_counters = true;
+		xfree(acct_params);
 		memset(&callbacks, 0, sizeof(jag_callbacks_t));
 		first = 0;
 		callbacks.prec_extra = _prec_extra;
 	}
 
+	/* Per process detail is needed for task profiling, scan /proc then */
+	START_TIMER;
+	if (use_counters &&
+	    !(profile &&
+	      acct_gather_profile_g_is_active(ACCT_GATHER_PROFILE_TASK)) &&
+	    _task_cgs_loaded(task_list))
+		callbacks.get_precs = _get_precs_cgroup;
+	else
+		callbacks.get_precs = NULL;
+
 	jag_common_poll_data(task_list, pgid_plugin, cont_id, &callbacks,
 			     profile);
+	END_TIMER;
+	debug2("%s: %d tasks from %s took %s", __func__,
+	       task_list ? list_count(task_list) : 0,
+	       callbacks.get_precs == _get_precs_cgroup ? "cgroups" : "/proc",
+	       TIME_STR);
 
 	return;
 }
 
 extern int jobacct_gather_p_endpoll(void)
 {
+	FREE_NULL_LIST(task_cg_list);
 	jag_common_fini();
 
 	return SLURM_SUCCESS;
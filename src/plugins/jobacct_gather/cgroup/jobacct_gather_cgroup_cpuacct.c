@@ -384,3 +384,21 @@ error:
 	xcgroup_destroy(&cpuacct_cg);
 	return fstatus;
 }
+
+extern int
+jobacct_gather_cgroup_cpuacct_task_load(uint32_t taskid, xcgroup_t *cg)
+{
+	char path[PATH_MAX];
+
+	if ((jobstep_cgroup_path[0] == '\0') || (taskid > max_task_id))
+		return SLURM_ERROR;
+
+	if (snprintf(path, PATH_MAX, "%s/task_%u",
+		     jobstep_cgroup_path, taskid) >= PATH_MAX)
+		return SLURM_ERROR;
+
+	if (xcgroup_load(&cpuacct_ns, cg, path) != XCGROUP_SUCCESS)
+		return SLURM_ERROR;
+
+	return SLURM_SUCCESS;
+}
@@ -43,6 +43,7 @@
 #include <signal.h>
 #include <time.h>
 #include <ctype.h>
+#include <sys/resource.h>
 
 #include "src/common/slurm_xlator.h"
 #include "src/common/slurm_jobacct_gather.h"
@@ -229,6 +230,26 @@ static int _get_sys_interface_freq_line(uint32_t cpu, char *filename,
 	return 0;
 }
 
+/* Open /proc files of a process in the container, kept between polls */
+typedef struct jag_proc {
+	pid_t pid;
+	bool lwp;		/* thread of another process, not accounted */
+	int stat_fd;
+	int statm_fd;		/* only opened with NoShare */
+	int io_fd;
+	uint32_t poll_cnt;	/* last poll the process was found in */
+	struct jag_proc *next_hash;
+} jag_proc_t;
+
+#define PROC_HASH_SIZE 1024
+#define PROC_HASH_INX(_pid) ((_pid) % PROC_HASH_SIZE)
+static jag_proc_t *proc_hash[PROC_HASH_SIZE];
+static int proc_cnt = 0;
+static int max_proc_cnt = 0;
+static uint32_t poll_cnt = 0;
+static int no_share_data = -1;
+static int use_pss = -1;
+
 static int _is_a_lwp(uint32_t pid) {
 
 	FILE		*status_fp = NULL;
@@ -272,9 +293,145 @@ static int _is_a_lwp(uint32_t pid) {
 
 }
 
-/* _get_process_data_line() - get line of data from /proc/<pid>/stat
+/* Read a /proc file from its start, return the number of bytes read */
+static int _read_proc_file(int fd, char *sbuf, size_t size)
+{
+	ssize_t num_read;
+
+	if (fd < 0)
+		return 0;
+
+	do {
+		num_read = pread(fd, sbuf, size - 1, 0);
+	} while ((num_read < 0) && (errno == EINTR));
+	if (num_read <= 0)
+		return 0;
+	sbuf[num_read] = '\0';
+
+	return num_read;
+}
+
+static int _open_proc_file(pid_t pid, char *name)
+{
+	char proc_file[256];	/* Allow ~20x extra length */
+
+	/* Close the file on exec() of user tasks */
+	snprintf(proc_file, sizeof(proc_file), "/proc/%d/%s", (int) pid, name);
+	return open(proc_file, O_RDONLY | O_CLOEXEC);
+}
+
+static void _proc_close(jag_proc_t *proc)
+{
+	if (proc->stat_fd >= 0)
+		(void) close(proc->stat_fd);
+	if (proc->statm_fd >= 0)
+		(void) close(proc->statm_fd);
+	if (proc->io_fd >= 0)
+		(void) close(proc->io_fd);
+	proc->stat_fd = proc->statm_fd = proc->io_fd = -1;
+}
+
+static void _proc_free(void *x)
+{
+	jag_proc_t *proc = (jag_proc_t *) x;
+
+	if (proc) {
+		_proc_close(proc);
+		xfree(proc);
+	}
+}
+
+/* Open the files of a process, return SLURM_ERROR if it went away */
+static int _proc_open(jag_proc_t *proc)
+{
+	proc->stat_fd = proc->statm_fd = proc->io_fd = -1;
+
+	/* If the pid corresponds to a Light Weight Process (Thread POSIX)
+	 * skip it, we will only account the original process (pid==tgid) */
+	if ((proc->lwp = (_is_a_lwp(proc->pid) > 0)))
+		return SLURM_SUCCESS;
+
+	if ((proc->stat_fd = _open_proc_file(proc->pid, "stat")) < 0)
+		return SLURM_ERROR;
+	if (no_share_data)
+		proc->statm_fd = _open_proc_file(proc->pid, "statm");
+	proc->io_fd = _open_proc_file(proc->pid, "io");
+
+	return SLURM_SUCCESS;
+}
+
+static jag_proc_t *_find_proc(pid_t pid)
+{
+	jag_proc_t *proc = proc_hash[PROC_HASH_INX(pid)];
+
+	while (proc && (proc->pid != pid))
+		proc = proc->next_hash;
+
+	return proc;
+}
+
+static void _add_proc(jag_proc_t *proc)
+{
+	int inx = PROC_HASH_INX(proc->pid);
+
+	proc->next_hash = proc_hash[inx];
+	proc_hash[inx] = proc;
+	proc_cnt++;
+}
+
+/* Close the files of processes not found in this poll, or of all */
+static void _purge_procs(bool all)
+{
+	jag_proc_t *proc, **proc_pptr;
+	int i;
+
+	for (i = 0; proc_cnt && (i < PROC_HASH_SIZE); i++) {
+		proc_pptr = &proc_hash[i];
+		while ((proc = *proc_pptr)) {
+			if (!all && (proc->poll_cnt == poll_cnt)) {
+				proc_pptr = &proc->next_hash;
+				continue;
+			}
+			*proc_pptr = proc->next_hash;
+			_proc_free(proc);
+			proc_cnt--;
+		}
+	}
+}
+
+/* _get_num() - parse the next decimal field of a /proc file
+ *
+ * IN/OUT: ptr - position in the line, moved past the field
+ * OUT:	val - value of the field
+ *
+ * RETVAL:	==0 - no number found
+ * 		!=0 - number is valid
+ */
+static int _get_num(char **ptr, long long *val)
+{
+	char *p = *ptr;
+	unsigned long long num = 0;
+	bool neg = false;
+
+	while (*p == ' ')
+		p++;
+	if (*p == '-') {
+		neg = true;
+		p++;
+	}
+	if ((*p < '0') || (*p > '9'))
+		return 0;
+	while ((*p >= '0') && (*p <= '9'))
+		num = (num * 10) + (*p++ - '0');
+
+	*val = neg ? -(long long) num : (long long) num;
+	*ptr = p;
+	return 1;
+}
+
+/* _get_process_data_line() - parse the content of /proc/<pid>/stat
  *
- * IN:	in - input file descriptor
+ * IN:	sbuf - content of the file
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -282,69 +439,42 @@ static int _is_a_lwp(uint32_t pid) {
  *
  * Based upon stat2proc() from the ps command. It can handle arbitrary
  * executable file basenames for `cmd', i.e. those with embedded whitespace or
- * embedded ')'s. Such names confuse %s (see scanf(3)), so the string is split
- * and %39c is used instead. (except for embedded ')' "(%[^)]c)" would work.
+ * embedded ')'s, by starting after the last ')'. The fields are numbered as
+ * in proc(5), the state is field 3 and the last one used is the processor
+ * the process last ran on, field 39.
  */
-static int _get_process_data_line(int in, jag_prec_t *prec) {
-	char sbuf[256], *tmp;
-	int num_read, nvals;
-	char cmd[40], state[1];
-	int ppid, pgrp, session, tty_nr, tpgid;
-	long unsigned flags, minflt, cminflt, majflt, cmajflt;
-	long unsigned utime, stime, starttime, vsize;
-	long int cutime, cstime, priority, nice, timeout, itrealvalue, rss;
-	long unsigned f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13;
-	int exit_signal, last_cpu;
-
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
-		return 0;
-	sbuf[num_read] = '\0';
+static int _get_process_data_line(char *sbuf, jag_prec_t *prec)
+{
+	long long val[40];
+	char *ptr;
+	int i;
 
-	tmp = strrchr(sbuf, ')');	/* split into "PID (cmd" and "<rest>" */
-	*tmp = '\0';			/* replace trailing ')' with NUL */
-	/* parse these two strings separately, skipping the leading "(". */
-	nvals = sscanf(sbuf, "%d (%39c", &prec->pid, cmd);
-	if (nvals < 2)
+	if (!(ptr = strrchr(sbuf, ')')) || (ptr[1] != ' ') || !ptr[2])
 		return 0;
+	ptr += 3;	/* skip ") " and the state */
 
-	nvals = sscanf(tmp + 2,	 /* skip space after ')' too */
-		       "%c %d %d %d %d %d "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %ld %ld %ld %ld "
-		       "%ld %ld %lu %lu %ld "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %lu %d %d ",
-		       state, &ppid, &pgrp, &session, &tty_nr, &tpgid,
-		       &flags, &minflt, &cminflt, &majflt, &cmajflt,
-		       &utime, &stime, &cutime, &cstime, &priority, &nice,
-		       &timeout, &itrealvalue, &starttime, &vsize, &rss,
-		       &f1, &f2, &f3, &f4, &f5 ,&f6, &f7, &f8, &f9, &f10, &f11,
-		       &f12, &f13, &exit_signal, &last_cpu);
+	for (i = 4; i < 40; i++) {
+		if (!_get_num(&ptr, &val[i]))
+			return 0;
+	}
 	/* There are some additional fields, which we do not scan or use */
-	if ((nvals < 37) || (rss < 0))
-		return 0;
-
-	/* If current pid corresponds to a Light Weight Process (Thread POSIX) */
-	/* skip it, we will only account the original process (pid==tgid) */
-	if (_is_a_lwp(prec->pid) > 0)
+	if (val[24] < 0)
 		return 0;
 
 	/* Copy the values that slurm records into our data structure */
-	prec->ppid  = ppid;
-	prec->pages = majflt;
-	prec->usec  = utime;
-	prec->ssec  = stime;
-	prec->vsize = vsize / 1024; /* convert from bytes to KB */
-	prec->rss   = rss * my_pagesize;/* convert from pages to KB */
-	prec->last_cpu = last_cpu;
+	prec->ppid  = val[4];
+	prec->pages = val[12];
+	prec->usec  = val[14];
+	prec->ssec  = val[15];
+	prec->vsize = val[23] / 1024; /* convert from bytes to KB */
+	prec->rss   = val[24] * my_pagesize;/* convert from pages to KB */
+	prec->last_cpu = val[39];
 	return 1;
 }
 
-/* _get_process_memory_line() - get line of data from /proc/<pid>/statm
+/* _get_process_memory_line() - parse the content of /proc/<pid>/statm
  *
- * IN:	in - input file descriptor
+ * IN:	sbuf - content of the file
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -355,17 +485,11 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
  * and return the updated struct.
  *
  */
-static int _get_process_memory_line(int in, jag_prec_t *prec)
+static int _get_process_memory_line(char *sbuf, jag_prec_t *prec)
 {
-	char sbuf[256];
-	int num_read, nvals;
+	int nvals;
 	long int size, rss, share, text, lib, data, dt;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
-		return 0;
-	sbuf[num_read] = '\0';
-
 	nvals = sscanf(sbuf,
 		       "%ld %ld %ld %ld %ld %ld %ld",
 		       &size, &rss, &share, &text, &lib, &data, &dt);
@@ -384,26 +508,9 @@ static int _get_process_memory_line(int in, jag_prec_t *prec)
 	return 1;
 }
 
-static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
-{
-	FILE *statm_fp = NULL;
-	char proc_statm_file[256];	/* Allow ~20x extra length */
-	int rc = 0, fd;
-
-	snprintf(proc_statm_file, sizeof(proc_statm_file), "%sm",
-		 proc_stat_file);
-	if (!(statm_fp = fopen(proc_statm_file, "r")))
-		return rc;  /* Assume the process went away */
-	fd = fileno(statm_fp);
-	fcntl(fd, F_SETFD, FD_CLOEXEC);
-	rc = _get_process_memory_line(fd, prec);
-	fclose(statm_fp);
-	return rc;
-}
-
-/* _get_process_io_data_line() - get line of data from /proc/<pid>/io
+/* _get_process_io_data_line() - parse the content of /proc/<pid>/io
  *
- * IN:	in - input file descriptor
+ * IN:	sbuf - content of the file
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -414,25 +521,16 @@ static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
  * wrchar: <# of characters written>
  *   . . .
  */
-static int _get_process_io_data_line(int in, jag_prec_t *prec) {
-	char sbuf[256];
+static int _get_process_io_data_line(char *sbuf, jag_prec_t *prec) {
 	char f1[7], f3[7];
-	int num_read, nvals;
+	int nvals;
 	uint64_t rchar, wchar;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
-		return 0;
-	sbuf[num_read] = '\0';
-
-	nvals = sscanf(sbuf, "%s %"PRIu64" %s %"PRIu64"",
+	nvals = sscanf(sbuf, "%6s %"PRIu64" %6s %"PRIu64"",
 		       f1, &rchar, f3, &wchar);
 	if (nvals < 4)
 		return 0;
 
-	if (_is_a_lwp(prec->pid) > 0)
-		return 0;
-
 	/* Copy the values that slurm records into our data structure */
 	prec->disk_read = (double)rchar / (double)1048576;
 	prec->disk_write = (double)wchar / (double)1048576;
@@ -440,15 +538,18 @@ static int _get_process_io_data_line(int in, jag_prec_t *prec) {
 	return 1;
 }
 
-static void _handle_stats(List prec_list, char *proc_stat_file, char *proc_io_file,
-			  char *proc_smaps_file, jag_callbacks_t *callbacks)
+/*
+ * Read the statistics of a process into a new record of prec_list.
+ * With cache set, its files are kept open in proc_hash for the next poll,
+ * otherwise they are closed on return.
+ */
+static void _handle_stats(List prec_list, pid_t pid, bool cache,
+			  jag_callbacks_t *callbacks)
 {
-	static int no_share_data = -1;
-	static int use_pss = -1;
-	FILE *stat_fp = NULL;
-	FILE *io_fp = NULL;
-	int fd, fd2;
+	char sbuf[512], proc_smaps_file[256];
+	jag_proc_t *proc = NULL, tmp_proc;
 	jag_prec_t *prec = NULL;
+	bool reopened = false;
 
 	if (no_share_data == -1) {
 		char *acct_params = slurm_get_jobacct_gather_params();
@@ -464,67 +565,86 @@ static void _handle_stats(List prec_list, char *proc_stat_file, char *proc_io_fi
 		xfree(acct_params);
 	}
 
-	if (!(stat_fp = fopen(proc_stat_file, "r")))
-		return;  /* Assume the process went away */
-	/*
-	 * Close the file on exec() of user tasks.
-	 *
-	 * NOTE: If we fork() slurmstepd after the
-	 * fopen() above and before the fcntl() below,
-	 * then the user task may have this extra file
-	 * open, which can cause problems for
-	 * checkpoint/restart, but this should be a very rare
-	 * problem in practice.
-	 */
-	fd = fileno(stat_fp);
-	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	if (cache) {
+		proc = _find_proc(pid);
+		if (!proc && (proc_cnt < max_proc_cnt)) {
+			/* New process, forked since the last poll */
+			proc = xmalloc(sizeof(jag_proc_t));
+			proc->pid = pid;
+			if (_proc_open(proc) != SLURM_SUCCESS) {
+				_proc_free(proc);
+				return;  /* Assume the process went away */
+			}
+			_add_proc(proc);
+		}
+		if (proc)
+			proc->poll_cnt = poll_cnt;
+	}
+	if (!proc) {
+		proc = &tmp_proc;
+		proc->pid = pid;
+		if (_proc_open(proc) != SLURM_SUCCESS)
+			goto fini;  /* Assume the process went away */
+	}
+	if (proc->lwp)
+		goto fini;
 
 	prec = try_xmalloc(sizeof(jag_prec_t));
-	if (prec == NULL) {	/* Avoid killing slurmstepd on malloc failure */
-		fclose(stat_fp);
-		return;
+	if (prec == NULL)	/* Avoid killing slurmstepd on malloc failure */
+		goto fini;
+	prec->pid = pid;
+
+	while (!_read_proc_file(proc->stat_fd, sbuf, sizeof(sbuf))) {
+		/* The process exited since its files were opened, its pid may
+		 * have been reused by a new process since */
+		_proc_close(proc);
+		if (reopened || (_proc_open(proc) != SLURM_SUCCESS) ||
+		    proc->lwp) {
+			xfree(prec);
+			goto fini;
+		}
+		reopened = true;
 	}
-	if (!_get_process_data_line(fd, prec)) {
+	if (!_get_process_data_line(sbuf, prec)) {
 		xfree(prec);
-		fclose(stat_fp);
-		return;
+		goto fini;
 	}
-	fclose(stat_fp);
 
 	/* Remove shared data from rss */
-	if (no_share_data)
-		_remove_share_data(proc_stat_file, prec);
+	if (no_share_data &&
+	    _read_proc_file(proc->statm_fd, sbuf, sizeof(sbuf)))
+		_get_process_memory_line(sbuf, prec);
 
 	/* Use PSS instead if RSS */
 	if (use_pss) {
+		snprintf(proc_smaps_file, sizeof(proc_smaps_file),
+			 "/proc/%d/smaps", (int) pid);
 		if (_get_pss(proc_smaps_file, prec) == -1) {
 			xfree(prec);
-			return;
+			goto fini;
 		}
 	}
 
 	list_append(prec_list, prec);
 
-	if ((io_fp = fopen(proc_io_file, "r"))) {
-		fd2 = fileno(io_fp);
-		fcntl(fd2, F_SETFD, FD_CLOEXEC);
-		_get_process_io_data_line(fd2, prec);
-		fclose(io_fp);
-	}
+	if (_read_proc_file(proc->io_fd, sbuf, sizeof(sbuf)))
+		_get_process_io_data_line(sbuf, prec);
 	if (callbacks->prec_extra)
 		(*(callbacks->prec_extra))(prec);
+
+fini:
+	if (proc == &tmp_proc)
+		_proc_close(proc);
 }
 
 static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 		       jag_callbacks_t *callbacks)
 {
 	List prec_list = list_create(destroy_jag_prec);
-	char	proc_stat_file[256];	/* Allow ~20x extra length */
-	char	proc_io_file[256];	/* Allow ~20x extra length */
-	char	proc_smaps_file[256];	/* Allow ~20x extra length */
 	static	int	slash_proc_open = 0;
 	int i;
 
+	poll_cnt++;
 	if (!pgid_plugin) {
 		pid_t *pids = NULL;
 		int npids = 0;
@@ -544,17 +664,13 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			debug4("no pids in this container %"PRIu64"", cont_id);
 			goto finished;
 		}
-		for (i = 0; i < npids; i++) {
-			snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
-			snprintf(proc_io_file, 256, "/proc/%d/io", pids[i]);
-			snprintf(proc_smaps_file, 256, "/proc/%d/smaps", pids[i]);
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks);
-		}
+		for (i = 0; i < npids; i++)
+			_handle_stats(prec_list, pids[i], true, callbacks);
 		xfree(pids);
 	} else {
 		struct dirent *slash_proc_entry;
-		char  *iptr = NULL, *optr = NULL, *optr2 = NULL;
+		char *iptr;
+		pid_t pid;
 
 		if (slash_proc_open) {
 			rewinddir(slash_proc);
@@ -566,83 +682,29 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			}
 			slash_proc_open=1;
 		}
-		strcpy(proc_stat_file, "/proc/");
-		strcpy(proc_io_file, "/proc/");
-		strcpy(proc_smaps_file, "/proc/");
 
 		while ((slash_proc_entry = readdir(slash_proc))) {
-
-			/* Save a few cyles by simulating
-			 * strcat(statFileName, slash_proc_entry->d_name);
-			 * strcat(statFileName, "/stat");
-			 * while checking for a numeric filename (which really
-			 * should be a pid). Then do the same for the
-			 * /proc/<pid>/io file name.
-			 */
-			optr = proc_stat_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-
-			if (i == -1)
-				continue;
-			iptr = (char*)"/stat";
-
-			do {
-				*optr++ = *iptr++;
-			} while (*iptr);
-			*optr = 0;
-
-			optr2 = proc_io_file + sizeof("/proc");
+			/* Only numeric filenames (which really should be a
+			 * pid), the files of every process on the node are
+			 * not kept open */
 			iptr = slash_proc_entry->d_name;
-			i = 0;
+			pid = 0;
 			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
+				if ((*iptr < '0') || (*iptr > '9')) {
+					pid = 0;
 					break;
 				}
+				pid = (pid * 10) + (*iptr++ - '0');
 			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/io";
 
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			optr2 = proc_smaps_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/smaps";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file,callbacks);
+			if (pid)
+				_handle_stats(prec_list, pid, false, callbacks);
 		}
 	}
 
 finished:
+	/* Close the files of processes which exited since the last poll */
+	_purge_procs(false);
 
 	return prec_list;
 }
@@ -742,6 +804,7 @@ static void _record_profile(struct jobacctinfo *jobacct)
 extern void jag_common_init(long in_hertz)
 {
 	uint32_t profile_opt;
+	struct rlimit rlim;
 
 	debug_flags = slurm_get_debug_flags();
 
@@ -766,12 +829,21 @@ extern void jag_common_init(long in_hertz)
 	}
 
 	my_pagesize = getpagesize() / 1024;
+
+	/* Keep the files of processes open within a fraction of the limit,
+	 * each process uses up to three */
+	if (!getrlimit(RLIMIT_NOFILE, &rlim) &&
+	    (rlim.rlim_cur != RLIM_INFINITY))
+		max_proc_cnt = rlim.rlim_cur / 12;
+	else
+		max_proc_cnt = 1024;
 }
 
 extern void jag_common_fini(void)
 {
 	if (slash_proc)
 		(void) closedir(slash_proc);
+	_purge_procs(true);
 }
 
 extern void destroy_jag_prec(void *object)
@@ -93,6 +93,7 @@
 \*****************************************************************************/
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <time.h>
 
 #include "dist_tasks.h"
@@ -102,6 +103,9 @@
 /* Enables module specific debugging */
 #define _DEBUG 0
 
+/* Minimum number of nodes evaluated by each thread in _get_res_usage() */
+#define MIN_EVAL_NODES_PER_THREAD 512
+
 static uint16_t _allocate_sc(struct job_record *job_ptr, bitstr_t *core_map,
 			     bitstr_t *part_core_map, const uint32_t node_i,
 			     int *cpu_alloc_size, bool entire_sockets_only);
@@ -139,6 +143,9 @@ static int _eval_nodes_topo(struct job_record *job_ptr, bitstr_t *node_map,
 			uint32_t min_nodes, uint32_t max_nodes,
 			uint32_t req_nodes, uint32_t cr_node_cnt,
 			uint16_t *cpu_cnt, uint16_t cr_type);
+static void _set_switch_cpu_cnt(bitstr_t **switches_bitmap,
+				int *switches_node_cnt, int *switches_cpu_cnt,
+				uint16_t *cpu_cnt);
 static uint32_t _gres_sock_job_test(List job_gres_list, List node_gres_list,
 				    bool use_total_gres, bitstr_t *cpu_bitmap,
 				    int cpu_start_bit, int cpu_end_bit,
@@ -779,14 +786,17 @@ static int _verify_node_state(struct part_res_record *cr_part_ptr,
 			      uint16_t cr_type,
 			      struct node_use_record *node_usage,
 			      enum node_cr_state job_node_req,
-			      bitstr_t *exc_core_bitmap, bool qos_preemptor)
+			      bitstr_t *exc_core_bitmap, bool qos_preemptor,
+			      uint16_t min_free_cpus)
 {
 	struct node_record *node_ptr;
 	uint32_t i, j, gres_cpus, gres_cores;
 	uint64_t free_mem, min_mem;
 	int core_start_bit, core_end_bit, cpus_per_core;
+	int free_cores, min_free_cores;
 	List gres_list;
 	int i_first, i_last;
+	bool busy;
 
 	if (job_ptr->details->pn_min_memory & MEM_PER_CPU) {
 		uint16_t min_cpus;
@@ -838,6 +848,23 @@ static int _verify_node_state(struct part_res_record *cr_part_ptr,
 			}
 		}
 
+		/* node-level free core check, using the node summary
+		 * maintained by cr_update_alloc_cores() rather than the
+		 * partition row bitmaps. Each core offers at most vpus CPUs */
+		if (min_free_cpus) {
+			free_cores = (core_end_bit - core_start_bit + 1) -
+				     node_usage[i].alloc_cores;
+			min_free_cores = (min_free_cpus +
+					  select_node_record[i].vpus - 1) /
+					 select_node_record[i].vpus;
+			if (free_cores < min_free_cores) {
+				debug3("cons_res: _vns: node %s no cores %d < %d",
+				       select_node_record[i].node_ptr->name,
+				       free_cores, min_free_cores);
+				goto clear_bit;
+			}
+		}
+
 		/* Exclude nodes with reserved cores */
 		if ((job_ptr->details->whole_node == 1) && exc_core_bitmap) {
 			for (j = core_start_bit; j <= core_end_bit; j++) {
@@ -893,9 +920,16 @@ static int _verify_node_state(struct part_res_record *cr_part_ptr,
 		/* node is NODE_CR_AVAILABLE - check job request */
 		} else {
 			if (job_node_req == NODE_CR_RESERVED) {
-				if (_is_node_busy(cr_part_ptr, i, 0,
-						  job_ptr->part_ptr,
-						  qos_preemptor)) {
+				/* The node summary covers all rows, which
+				 * matches unless the QOS preemption row
+				 * must be skipped */
+				if (preempt_by_qos && !qos_preemptor) {
+					busy = _is_node_busy(cr_part_ptr, i, 0,
+							job_ptr->part_ptr,
+							qos_preemptor);
+				} else
+					busy = (node_usage[i].alloc_cores != 0);
+				if (busy) {
 					debug3("cons_res: _vns: node %s busy",
 					       node_ptr->name);
 					goto clear_bit;
@@ -1161,6 +1195,38 @@ static uint32_t _socks_per_node(struct job_record *job_ptr)
 	return s_p_n;
 }
 
+/* Arguments for evaluating a range of nodes in _get_res_usage() */
+typedef struct {
+	struct job_record *job_ptr;
+	bitstr_t *node_map;
+	bitstr_t *core_map;		/* Private copy, except first range */
+	uint32_t node_begin;		/* First node index to evaluate */
+	uint32_t node_end;		/* Last node index to evaluate + 1 */
+	uint32_t s_p_n;
+	struct node_use_record *node_usage;
+	uint16_t cr_type;
+	bool test_only;
+	bitstr_t *part_core_map;
+	uint16_t *cpu_cnt;		/* Shared, indexed by node */
+} res_usage_args_t;
+
+static void *_get_res_usage_range(void *arg)
+{
+	res_usage_args_t *args = (res_usage_args_t *) arg;
+	uint32_t n;
+
+	for (n = args->node_begin; n < args->node_end; n++) {
+		if (!bit_test(args->node_map, n))
+			continue;
+		args->cpu_cnt[n] = _can_job_run_on_node(args->job_ptr,
+						args->core_map, n, args->s_p_n,
+						args->node_usage, args->cr_type,
+						args->test_only,
+						args->part_core_map);
+	}
+	return NULL;
+}
+
 /* Compute resource usage for the given job on all available resources
  *
  * IN: job_ptr     - pointer to the job requesting resources
@@ -1170,6 +1236,11 @@ static uint32_t _socks_per_node(struct job_record *job_ptr)
  * IN: cr_type     - resource type
  * OUT: cpu_cnt    - number of cpus that can be used by this job
  * IN: test_only   - ignore allocated memory check
+ *
+ * NOTE: With SchedulerParameters=select_eval_threads=# the node range is
+ *	split between that many threads. _can_job_run_on_node() only clears
+ *	bits of the node being evaluated, so each additional thread works on
+ *	a private copy of core_map which is then ANDed into the result.
  */
 static void _get_res_usage(struct job_record *job_ptr, bitstr_t *node_map,
 			   bitstr_t *core_map, uint32_t cr_node_cnt,
@@ -1178,17 +1249,78 @@ static void _get_res_usage(struct job_record *job_ptr, bitstr_t *node_map,
 			   bool test_only, bitstr_t *part_core_map)
 {
 	uint16_t *cpu_cnt;
-	uint32_t n;
+	uint32_t node_inx, nodes_per_thread;
 	uint32_t s_p_n = _socks_per_node(job_ptr);
+	int i, thread_cnt = 1;
+	res_usage_args_t *args;
+	pthread_t *threads;
+	pthread_attr_t attr;
+	bool *thread_started;
 
 	cpu_cnt = xmalloc(cr_node_cnt * sizeof(uint16_t));
-	for (n = 0; n < cr_node_cnt; n++) {
-		if (!bit_test(node_map, n))
-			continue;
-		cpu_cnt[n] = _can_job_run_on_node(job_ptr, core_map, n, s_p_n,
-						  node_usage, cr_type,
-						  test_only, part_core_map);
+	if (select_eval_threads > 1) {
+		thread_cnt = bit_set_count(node_map) /
+			     MIN_EVAL_NODES_PER_THREAD;
+		thread_cnt = MIN(thread_cnt, select_eval_threads);
+	}
+	if (thread_cnt < 2) {
+		for (node_inx = 0; node_inx < cr_node_cnt; node_inx++) {
+			if (!bit_test(node_map, node_inx))
+				continue;
+			cpu_cnt[node_inx] = _can_job_run_on_node(job_ptr,
+						core_map, node_inx, s_p_n,
+						node_usage, cr_type,
+						test_only, part_core_map);
+		}
+		*cpu_cnt_ptr = cpu_cnt;
+		return;
 	}
+
+	args = xmalloc(sizeof(res_usage_args_t) * thread_cnt);
+	threads = xmalloc(sizeof(pthread_t) * thread_cnt);
+	thread_started = xmalloc(sizeof(bool) * thread_cnt);
+	nodes_per_thread = (cr_node_cnt + thread_cnt - 1) / thread_cnt;
+	for (i = 0, node_inx = 0; i < thread_cnt; i++) {
+		args[i].job_ptr       = job_ptr;
+		args[i].node_map      = node_map;
+		args[i].s_p_n         = s_p_n;
+		args[i].node_usage    = node_usage;
+		args[i].cr_type       = cr_type;
+		args[i].test_only     = test_only;
+		args[i].part_core_map = part_core_map;
+		args[i].cpu_cnt       = cpu_cnt;
+		args[i].node_begin    = node_inx;
+		node_inx = MIN(node_inx + nodes_per_thread, cr_node_cnt);
+		args[i].node_end      = node_inx;
+		if (i == 0)
+			args[i].core_map = core_map;
+		else
+			args[i].core_map = bit_copy(core_map);
+	}
+
+	/* The calling thread evaluates the first range itself */
+	for (i = 1; i < thread_cnt; i++) {
+		slurm_attr_init(&attr);
+		if (pthread_create(&threads[i], &attr, _get_res_usage_range,
+				   &args[i])) {
+			error("%s: pthread_create error %m", __func__);
+		} else
+			thread_started[i] = true;
+		slurm_attr_destroy(&attr);
+	}
+	(void) _get_res_usage_range(&args[0]);
+	for (i = 1; i < thread_cnt; i++) {
+		if (thread_started[i])
+			pthread_join(threads[i], NULL);
+		else	/* Thread creation failure, evaluate here */
+			(void) _get_res_usage_range(&args[i]);
+		bit_and(core_map, args[i].core_map);
+		FREE_NULL_BITMAP(args[i].core_map);
+	}
+	xfree(thread_started);
+	xfree(threads);
+	xfree(args);
+
 	*cpu_cnt_ptr = cpu_cnt;
 }
 
@@ -1999,6 +2131,60 @@ static int _eval_nodes_serial(struct job_record *job_ptr, bitstr_t *node_map,
 fini:	return error_code;
 }
 
+/*
+ * Compute the count of CPUs available to the job on each switch.
+ * Leaf switches are summed from their nodes. Higher level switches are
+ * summed from their child switches, walking the tree from the leafs up,
+ * so that their (much larger) node bitmaps need not be rescanned at each
+ * level. If child switches share nodes, the node counts will not add up
+ * and the switch's own node bitmap is scanned instead.
+ *
+ * IN switches_bitmap - nodes available to the job on each switch
+ * IN switches_node_cnt - count of bits set in switches_bitmap
+ * OUT switches_cpu_cnt - CPUs available to the job on each switch
+ * IN cpu_cnt - CPUs available to the job on each node
+ */
+static void _set_switch_cpu_cnt(bitstr_t **switches_bitmap,
+				int *switches_node_cnt, int *switches_cpu_cnt,
+				uint16_t *cpu_cnt)
+{
+	struct switch_record *switch_ptr;
+	int child_nodes, child_cpus, level;
+	int i, j, k, first, last;
+
+	for (level = 0; level <= switch_levels; level++) {
+		for (j = 0; j < switch_record_cnt; j++) {
+			switch_ptr = &switch_record_table[j];
+			if (switch_ptr->level != level)
+				continue;
+			switches_cpu_cnt[j] = 0;
+			if (switches_node_cnt[j] == 0)
+				continue;
+			if ((level > 0) && switch_ptr->switch_index) {
+				child_nodes = child_cpus = 0;
+				for (k = 0; k < switch_ptr->num_switches; k++) {
+					i = switch_ptr->switch_index[k];
+					child_nodes += switches_node_cnt[i];
+					child_cpus  += switches_cpu_cnt[i];
+				}
+				if (child_nodes == switches_node_cnt[j]) {
+					switches_cpu_cnt[j] = child_cpus;
+					continue;
+				}
+			}
+			first = bit_ffs(switches_bitmap[j]);
+			if (first < 0)
+				continue;
+			last  = bit_fls(switches_bitmap[j]);
+			for (i = first; i <= last; i++) {
+				if (!bit_test(switches_bitmap[j], i))
+					continue;
+				switches_cpu_cnt[j] += cpu_cnt[i];
+			}
+		}
+	}
+}
+
 /*
  * A network topology aware version of _eval_nodes().
  * NOTE: The logic here is almost identical to that of _job_test_topo()
@@ -2165,36 +2351,15 @@ static int _eval_nodes_topo(struct job_record *job_ptr, bitstr_t *bitmap,
 		for (j=0; j<switch_record_cnt; j++) {
 			if (switches_node_cnt[j] == 0)
 				continue;
-			first = bit_ffs(switches_bitmap[j]);
-			if (first < 0)
-				continue;
-			last  = bit_fls(switches_bitmap[j]);
-			for (i=first; i<=last; i++) {
-				if (!bit_test(switches_bitmap[j], i))
-					continue;
-				if (!bit_test(avail_nodes_bitmap, i)) {
-					/* cleared from lower level */
-					bit_clear(switches_bitmap[j], i);
-					switches_node_cnt[j]--;
-				} else {
-					switches_cpu_cnt[j] += cpu_cnt[i];
-				}
-			}
-		}
-	} else {
-		/* No specific required nodes, calculate CPU counts */
-		for (j=0; j<switch_record_cnt; j++) {
-			first = bit_ffs(switches_bitmap[j]);
-			if (first < 0)
-				continue;
-			last  = bit_fls(switches_bitmap[j]);
-			for (i=first; i<=last; i++) {
-				if (!bit_test(switches_bitmap[j], i))
-					continue;
-				switches_cpu_cnt[j] += cpu_cnt[i];
-			}
+			/* clear nodes cleared from lower level */
+			bit_and(switches_bitmap[j], avail_nodes_bitmap);
+			switches_node_cnt[j] =
+				bit_set_count(switches_bitmap[j]);
 		}
 	}
+	/* Calculate CPU counts, from the leaf switches up */
+	_set_switch_cpu_cnt(switches_bitmap, switches_node_cnt,
+			    switches_cpu_cnt, cpu_cnt);
 
 	/* Determine lowest level switch satisfying request with best fit
 	 * in respect of the specific required nodes if specified
@@ -2624,36 +2789,15 @@ static int _eval_nodes_dfly(struct job_record *job_ptr, bitstr_t *bitmap,
 		for (j = 0; j < switch_record_cnt; j++) {
 			if (switches_node_cnt[j] == 0)
 				continue;
-			first = bit_ffs(switches_bitmap[j]);
-			if (first < 0)
-				continue;
-			last  = bit_fls(switches_bitmap[j]);
-			for (i = first; i <= last; i++) {
-				if (!bit_test(switches_bitmap[j], i))
-					continue;
-				if (!bit_test(avail_nodes_bitmap, i)) {
-					/* cleared from lower level */
-					bit_clear(switches_bitmap[j], i);
-					switches_node_cnt[j]--;
-				} else {
-					switches_cpu_cnt[j] += cpu_cnt[i];
-				}
-			}
-		}
-	} else {
-		/* No specific required nodes, calculate CPU counts */
-		for (j = 0; j < switch_record_cnt; j++) {
-			first = bit_ffs(switches_bitmap[j]);
-			if (first < 0)
-				continue;
-			last  = bit_fls(switches_bitmap[j]);
-			for (i = first; i <= last; i++) {
-				if (!bit_test(switches_bitmap[j], i))
-					continue;
-				switches_cpu_cnt[j] += cpu_cnt[i];
-			}
+			/* clear nodes cleared from lower level */
+			bit_and(switches_bitmap[j], avail_nodes_bitmap);
+			switches_node_cnt[j] =
+				bit_set_count(switches_bitmap[j]);
 		}
 	}
+	/* Calculate CPU counts, from the leaf switches up */
+	_set_switch_cpu_cnt(switches_bitmap, switches_node_cnt,
+			    switches_cpu_cnt, cpu_cnt);
 
 	/* Determine lowest level switch satisfying request with best fit 
 	 * in respect of the specific required nodes if specified
@@ -3126,7 +3270,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 	job_resources_t *job_res;
 	struct job_details *details_ptr;
 	struct part_res_record *p_ptr, *jp_ptr;
-	uint16_t *cpu_count;
+	uint16_t *cpu_count, min_free_cpus = 0;
 	int i, first, last;
 
 	if (gang_mode == -1) {
@@ -3145,12 +3289,20 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 	else	/* SELECT_MODE_RUN_NOW || SELECT_MODE_WILL_RUN  */
 		test_only = false;
 
+	/* A job which can not share CPUs is only ever placed on idle cores
+	 * (test 1 below), so nodes lacking enough idle cores can be pruned
+	 * before any core bitmaps are built */
+	if ((gang_mode == 0) && (job_node_req == NODE_CR_ONE_ROW) &&
+	    (cr_type != CR_MEMORY))
+		min_free_cpus = MAX(details_ptr->pn_min_cpus, 1);
+
 	/* check node_state and update the node_bitmap as necessary */
 	if (!test_only) {
 		error_code = _verify_node_state(cr_part_ptr, job_ptr,
 						node_bitmap, cr_type,
 						node_usage, job_node_req,
-						exc_core_bitmap, qos_preemptor);
+						exc_core_bitmap, qos_preemptor,
+						min_free_cpus);
 		if (error_code != SLURM_SUCCESS) {
 			return error_code;
 		}
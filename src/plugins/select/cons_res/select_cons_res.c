@@ -108,6 +108,7 @@
 #include "job_test.h"
 
 #define NODEINFO_MAGIC 0x82aa
+#define MAX_EVAL_THREADS 64	/* select_eval_threads upper limit */
 
 /* These are defined here so when we link with something other than
  * the slurmctld we will have these symbols defined.  They will get
@@ -183,6 +184,7 @@ bool     preempt_by_part      = false;
 bool     preempt_by_qos       = false;
 uint16_t priority_flags       = 0;
 uint64_t select_debug_flags   = 0;
+uint16_t select_eval_threads  = 1;
 uint16_t select_fast_schedule = 0;
 bool     spec_cores_first     = false;
 bool     topo_optional        = false;
@@ -380,6 +382,7 @@ static struct node_use_record *_dup_node_usage(struct node_use_record *orig_ptr)
 
 	for (i = 0; i < select_node_cnt; i++) {
 		new_ptr[i].node_state   = orig_ptr[i].node_state;
+		new_ptr[i].alloc_cores  = orig_ptr[i].alloc_cores;
 		new_ptr[i].alloc_memory = orig_ptr[i].alloc_memory;
 		if (orig_ptr[i].gres_list)
 			gres_list = orig_ptr[i].gres_list;
@@ -571,6 +574,45 @@ extern void cr_sort_part_rows(struct part_res_record *p_ptr)
 	return;
 }
 
+/*
+ * cr_update_alloc_cores - Recount the cores of one node which are allocated
+ *	to jobs in any row of any partition. Called whenever a job's cores are
+ *	added to or removed from the partition rows, so that cr_job_test()
+ *	can prune nodes without enough free cores before building any core
+ *	bitmaps.
+ * IN part_record_ptr - partition records to evaluate
+ * IN/OUT node_usage - node usage records to update
+ * IN node_inx - index of the node to update
+ */
+extern void cr_update_alloc_cores(struct part_res_record *part_record_ptr,
+				  struct node_use_record *node_usage,
+				  uint32_t node_inx)
+{
+	struct part_res_record *p_ptr;
+	uint32_t c, core_begin, core_end;
+	uint16_t alloc_cores = 0;
+	int r;
+
+	core_begin = cr_get_coremap_offset(node_inx);
+	core_end   = cr_get_coremap_offset(node_inx + 1);
+	for (c = core_begin; c < core_end; c++) {
+		for (p_ptr = part_record_ptr; p_ptr; p_ptr = p_ptr->next) {
+			if (!p_ptr->row)
+				continue;
+			for (r = 0; r < p_ptr->num_rows; r++) {
+				if (p_ptr->row[r].row_bitmap &&
+				    bit_test(p_ptr->row[r].row_bitmap, c))
+					break;
+			}
+			if (r < p_ptr->num_rows)
+				break;
+		}
+		if (p_ptr)
+			alloc_cores++;
+	}
+	node_usage[node_inx].alloc_cores = alloc_cores;
+}
+
 
 /*
  * _build_row_bitmaps: A job has been removed from the given partition,
@@ -911,6 +953,8 @@ static int _add_job_to_res(struct job_record *job_ptr, int action)
 					continue;  /* node lost by job resize */
 				select_node_usage[i].node_state +=
 					job->node_req;
+				cr_update_alloc_cores(select_part_record,
+						      select_node_usage, i);
 			}
 		}
 		if (select_debug_flags & DEBUG_FLAG_SELECT_TYPE) {
@@ -1300,6 +1344,8 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 					node_usage[i].node_state =
 						NODE_CR_AVAILABLE;
 				}
+				cr_update_alloc_cores(part_record_ptr,
+						      node_usage, i);
 			}
 		}
 	}
@@ -1425,6 +1471,7 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 		error("cons_res:_rm_job_from_one_node: node_state miscount");
 		node_usage[node_inx].node_state = NODE_CR_AVAILABLE;
 	}
+	cr_update_alloc_cores(part_record_ptr, node_usage, node_inx);
 
 	return SLURM_SUCCESS;
 }
@@ -2132,6 +2179,16 @@ extern int select_p_node_init(struct node_record *node_ptr, int node_cnt)
 		backfill_busy_nodes = true;
 	else
 		backfill_busy_nodes = false;
+	select_eval_threads = 1;
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "select_eval_threads="))) {
+		i = atoi(tmp_ptr + 20);
+		if ((i < 1) || (i > MAX_EVAL_THREADS)) {
+			error("Invalid SchedulerParameters "
+			      "select_eval_threads: %d", i);
+		} else
+			select_eval_threads = i;
+	}
 	xfree(sched_params);
 
 	preempt_type = slurm_get_preempt_type();
@@ -97,6 +97,9 @@ struct node_res_record {
 
 /* per-node resource usage record */
 struct node_use_record {
+	uint16_t alloc_cores;		/* count of cores allocated to jobs in
+					 * any partition row, see
+					 * cr_update_alloc_cores() */
 	uint64_t alloc_memory;		/* real memory reserved by already
 					 * scheduled jobs */
 	List gres_list;			/* list of gres state info managed by 
@@ -110,6 +113,7 @@ extern bool     pack_serial_at_end;
 extern bool     preempt_by_part;
 extern bool     preempt_by_qos;
 extern uint64_t select_debug_flags;
+extern uint16_t select_eval_threads;
 extern uint16_t select_fast_schedule;
 extern bool     spec_cores_first;
 extern bool     topo_optional;
@@ -119,6 +123,9 @@ extern struct node_res_record *select_node_record;
 extern struct node_use_record *select_node_usage;
 
 extern void cr_sort_part_rows(struct part_res_record *p_ptr);
+extern void cr_update_alloc_cores(struct part_res_record *part_record_ptr,
+				  struct node_use_record *node_usage,
+				  uint32_t node_inx);
 extern uint32_t cr_get_coremap_offset(uint32_t node_index);
 extern int cr_cpus_per_core(struct job_details *details, int node_inx);
 
@@ -427,25 +427,15 @@ void _init_params()
 	params.units = NO_VAL;
 }
 
-int get_data(void)
+/* Aggregate and print one chunk of jobs as it comes from the database */
+static int _list_jobs(List job_list, void *arg)
 {
 	slurmdb_job_rec_t *job = NULL;
 	slurmdb_step_rec_t *step = NULL;
 	ListIterator itr = NULL;
 	ListIterator itr_step = NULL;
-	slurmdb_job_cond_t *job_cond = params.job_cond;
-
-	if (params.opt_completion) {
-		jobs = g_slurm_jobcomp_get_jobs(job_cond);
-		return SLURM_SUCCESS;
-	} else {
-		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
-	}
-
-	if (!jobs)
-		return SLURM_ERROR;
 
-	itr = list_iterator_create(jobs);
+	itr = list_iterator_create(job_list);
 	while((job = list_next(itr))) {
 		if (job->user) {
 			struct	passwd *pw = NULL;
@@ -480,6 +470,108 @@ int get_data(void)
 	}
 	list_iterator_destroy(itr);
 
+	do_list(job_list);
+
+	return SLURM_SUCCESS;
+}
+
+/* Return the JOBCOND_FIELD_* groups the fields to print are made from,
+ * so only those are sent from the accounting storage */
+static uint32_t _get_job_fields(void)
+{
+	print_field_t *field = NULL;
+	uint32_t fields = JOBCOND_FIELD_BASE;
+
+	list_iterator_reset(print_fields_itr);
+	while ((field = list_next(print_fields_itr))) {
+		switch (field->type) {
+		case PRINT_ACCOUNT:
+		case PRINT_PARTITION:
+		case PRINT_WCKEY:
+			fields |= JOBCOND_FIELD_ASSOC;
+			break;
+		case PRINT_ADMIN_COMMENT:
+		case PRINT_BLOCKID:
+		case PRINT_COMMENT:
+			fields |= JOBCOND_FIELD_COMMENT;
+			break;
+		case PRINT_JOBNAME:
+			fields |= JOBCOND_FIELD_NAME;
+			break;
+		case PRINT_NODELIST:
+			fields |= JOBCOND_FIELD_NODES;
+			break;
+		case PRINT_RESERVATION:
+			fields |= JOBCOND_FIELD_RESV;
+			break;
+		case PRINT_ALLOC_CPUS:
+		case PRINT_ALLOC_GRES:
+		case PRINT_ALLOC_NODES:
+		case PRINT_CPU_TIME:
+		case PRINT_CPU_TIME_RAW:
+		case PRINT_NNODES:
+		case PRINT_NTASKS:
+		case PRINT_REQ_CPUS:
+		case PRINT_REQ_GRES:
+		case PRINT_REQ_NODES:
+		case PRINT_TRESA:
+		case PRINT_TRESR:
+			fields |= JOBCOND_FIELD_TRES;
+			break;
+		case PRINT_MAXDISKREADNODE:
+		case PRINT_MAXDISKWRITENODE:
+		case PRINT_MAXPAGESNODE:
+		case PRINT_MAXRSSNODE:
+		case PRINT_MAXVSIZENODE:
+		case PRINT_MINCPUNODE:
+			fields |= JOBCOND_FIELD_NODES;
+			/* fall through */
+		case PRINT_ACT_CPUFREQ:
+		case PRINT_AVECPU:
+		case PRINT_AVEDISKREAD:
+		case PRINT_AVEDISKWRITE:
+		case PRINT_AVEPAGES:
+		case PRINT_AVERSS:
+		case PRINT_AVEVSIZE:
+		case PRINT_CONSUMED_ENERGY:
+		case PRINT_CONSUMED_ENERGY_RAW:
+		case PRINT_MAXDISKREAD:
+		case PRINT_MAXDISKREADTASK:
+		case PRINT_MAXDISKWRITE:
+		case PRINT_MAXDISKWRITETASK:
+		case PRINT_MAXPAGES:
+		case PRINT_MAXPAGESTASK:
+		case PRINT_MAXRSS:
+		case PRINT_MAXRSSTASK:
+		case PRINT_MAXVSIZE:
+		case PRINT_MAXVSIZETASK:
+		case PRINT_MINCPU:
+		case PRINT_MINCPUTASK:
+			fields |= JOBCOND_FIELD_STATS;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return fields;
+}
+
+/* Jobs from the accounting storage are printed here as they arrive,
+ * job completion records are left in jobs for do_list_completion() */
+int get_data(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+
+	if (params.opt_completion) {
+		jobs = g_slurm_jobcomp_get_jobs(job_cond);
+		return SLURM_SUCCESS;
+	}
+
+	if (slurmdb_jobs_get_stream(acct_db_conn, job_cond, _list_jobs, NULL)
+	    != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
 	return SLURM_SUCCESS;
 }
 
@@ -1096,6 +1188,7 @@ void parse_command_line(int argc, char **argv)
 		start = end + 1;
 	}
 	field_count = list_count(print_fields_list);
+	job_cond->fields = _get_job_fields();
 
 	if (optind < argc) {
 		debug2("Error: Unknown arguments:");
@@ -1127,23 +1220,20 @@ void do_help(void)
 
 /* do_list() -- List the assembled data
  *
- * In:	Nothing explicit.
+ * In:	job_list - jobs to print
  * Out:	void.
  *
  * At this point, we have already selected the desired data,
  * so we just need to print it for the user.
  */
-void do_list(void)
+void do_list(List job_list)
 {
 	ListIterator itr = NULL;
 	ListIterator itr_step = NULL;
 	slurmdb_job_rec_t *job = NULL;
 	slurmdb_step_rec_t *step = NULL;
 
-	if (!jobs)
-		return;
-
-	itr = list_iterator_create(jobs);
+	itr = list_iterator_create(job_list);
 	while((job = list_next(itr))) {
 		if (list_count(job->steps)) {
 			int cnt = list_count(job->steps);
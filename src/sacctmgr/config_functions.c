@@ -196,6 +196,17 @@ extern int sacctmgr_list_stats(int argc, char **argv)
 		       buf->rollup_max_time[i], buf->rollup_time[i]);
 	}
 
+	printf("\nBatch statistics (DBD_SEND_MULT_MSG)\n");
+	roll_ave = buf->mult_time;
+	if (buf->mult_cnt > 1)
+		roll_ave /= buf->mult_cnt;
+	printf("\tcount:%-6u records:%-10"PRIu64" ave_time:%-6"PRIu64
+	       " max_time:%-12"PRIu64" total_time:%-12"PRIu64"\n",
+	       buf->mult_cnt, buf->mult_rec_cnt, roll_ave,
+	       buf->mult_max_time, buf->mult_time);
+	printf("\tcommit_time:%-12"PRIu64" failed_commits:%u\n",
+	       buf->mult_commit_time, buf->mult_fail_cnt);
+
 	if (argc) {
 		if (!strncasecmp(argv[0], "ave_time", 2))
 			sort_by_ave_time = true;
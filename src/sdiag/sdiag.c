@@ -170,6 +170,23 @@ static int _print_stats(void)
 		       buf->bf_queue_len_sum / buf->bf_cycle_counter);
 	}
 
+	if (buf->dbd_agent_batch_size) {
+		printf("\nSlurmDBD agent stats (microseconds)\n");
+		printf("\tQueue size:    %u\n", buf->dbd_agent_queue_size);
+		printf("\tOverflow size: %u\n", buf->dbd_agent_overflow_size);
+		printf("\tIn flight batches: %u (%u records)\n",
+		       buf->dbd_agent_inflight_batches,
+		       buf->dbd_agent_inflight_recs);
+		printf("\tBatch size: %u\n", buf->dbd_agent_batch_size);
+		printf("\tLast RTT:   %u\n", buf->dbd_agent_rtt_last);
+		printf("\tMax RTT:    %u\n", buf->dbd_agent_rtt_max);
+		if (buf->dbd_agent_rtt_cnt > 0) {
+			printf("\tMean RTT:   %"PRIu64"\n",
+			       buf->dbd_agent_rtt_sum /
+			       buf->dbd_agent_rtt_cnt);
+		}
+	}
+
 	printf("\nRemote Procedure Call statistics by message type\n");
 	for (i = 0; i < buf->rpc_type_size; i++) {
 		printf("\t%-40s(%5u) count:%-6u "
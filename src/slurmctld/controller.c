@@ -84,6 +84,7 @@
 #include "src/common/slurm_protocol_interface.h"
 #include "src/common/slurm_route.h"
 #include "src/common/slurm_topology.h"
+#include "src/common/step_trace.h"
 #include "src/common/switch.h"
 #include "src/common/timers.h"
 #include "src/common/uid.h"
@@ -99,6 +100,7 @@
 #include "src/slurmctld/job_submit.h"
 #include "src/slurmctld/licenses.h"
 #include "src/slurmctld/locks.h"
+#include "src/slurmctld/node_scheduler.h"
 #include "src/slurmctld/ping_nodes.h"
 #include "src/slurmctld/port_mgr.h"
 #include "src/slurmctld/power_save.h"
@@ -684,6 +686,7 @@ int main(int argc, char **argv)
 	slurm_sched_fini();	/* Stop all scheduling */
 
 	/* Purge our local data structures */
+	node_set_cache_purge();
 	job_fini();
 	part_fini();	/* part_fini() must precede node_fini() */
 	node_fini();
@@ -710,6 +713,7 @@ int main(int argc, char **argv)
 	slurm_auth_fini();
 	switch_fini();
 	route_fini();
+	step_trace_fini();
 
 	/* purge remaining data structures */
 	license_free();
@@ -834,6 +838,7 @@ static void _reconfigure_slurm(void)
 	acct_storage_g_reconfig(acct_db_conn, 0);
 	start_power_mgr(&slurmctld_config.thread_id_power);
 	trigger_reconfig();
+	step_trace_reconfig();
 	priority_g_reconfig(true);	/* notify priority plugin too */
 	save_all_state();		/* Has own locking */
 	queue_job_scheduler();
@@ -72,6 +72,7 @@
 #include "src/slurmctld/agent.h"
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/locks.h"
+#include "src/slurmctld/node_scheduler.h"
 #include "src/slurmctld/ping_nodes.h"
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/read_config.h"
@@ -1749,6 +1750,7 @@ static int _update_node_weight(char *node_names, uint32_t weight)
 	}
 	list_iterator_destroy(config_iterator);
 	FREE_NULL_BITMAP(node_bitmap);
+	node_set_cache_purge();
 
 	info("_update_node_weight: nodes %s weight set to: %u",
 		node_names, weight);
@@ -2171,6 +2173,7 @@ static void _split_node_config(struct node_record *node_ptr,
 	}
 	config_ptr->cores = reg_msg->cores;
 	config_ptr->sockets = reg_msg->sockets;
+	node_set_cache_purge();
 }
 
 /*
@@ -66,6 +66,7 @@
 #include "src/common/slurm_topology.h"
 #include "src/common/uid.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -86,6 +87,7 @@
 #include "src/slurmctld/slurmctld_plugstack.h"
 
 #define MAX_FEATURES  32	/* max exclusive features "[fs1|fs2]"=2 */
+#define MAX_NODE_SET_CACHE 256	/* max node_set_cache records, then purge */
 
 struct node_set {		/* set of nodes with same configuration */
 	uint16_t cpus_per_node;	/* NOTE: This is the minimum count,
@@ -101,6 +103,26 @@ struct node_set {		/* set of nodes with same configuration */
 	bitstr_t *my_bitmap;		/* node bitmap */
 };
 
+/* Node sets for a given partition, feature expression and per-node resource
+ * requirement, before job-specific reservation and exclusion filtering.
+ * Records are purged on any change to partitions, configuration records or
+ * node features. Protected by the slurmctld node write lock held by all
+ * callers of select_nodes(). See _node_set_cache_get() */
+typedef struct node_set_cache {
+	char *key;			/* partition|features|requirements */
+	char *err_msg;			/* reason for any filtered configs */
+	bitstr_t *feature_bitmap;	/* nodes satisfying AND/OR features,
+					 * NULL if no features or counts */
+	bool have_count;		/* feature counts, check per job */
+	bool has_xor;			/* XOR or XAND features */
+	bool *check_node_config;	/* filter nodes in set on each use */
+	struct node_set *node_set_ptr;	/* base node sets */
+	int node_set_size;
+} node_set_cache_t;
+
+static xhash_t *node_set_cache = NULL;
+static time_t node_set_cache_part_update = (time_t) 0;
+
 static int  _build_node_list(struct job_record *job_ptr,
 			     struct node_set **node_set_pptr,
 			     int *node_set_size, char **err_msg,
@@ -3093,6 +3115,294 @@ static int _no_reg_nodes(void)
 	return node_count;
 }
 
+static void _node_set_cache_free(void *x)
+{
+	node_set_cache_t *cache_ptr = (node_set_cache_t *) x;
+	int i;
+
+	if (!cache_ptr)
+		return;
+	for (i = 0; i < cache_ptr->node_set_size; i++) {
+		xfree(cache_ptr->node_set_ptr[i].features);
+		FREE_NULL_BITMAP(cache_ptr->node_set_ptr[i].feature_bits);
+		FREE_NULL_BITMAP(cache_ptr->node_set_ptr[i].my_bitmap);
+	}
+	xfree(cache_ptr->node_set_ptr);
+	xfree(cache_ptr->check_node_config);
+	FREE_NULL_BITMAP(cache_ptr->feature_bitmap);
+	xfree(cache_ptr->err_msg);
+	xfree(cache_ptr->key);
+	xfree(cache_ptr);
+}
+
+static const char *_node_set_cache_id(void *x)
+{
+	return ((node_set_cache_t *) x)->key;
+}
+
+/*
+ * node_set_cache_purge - Purge all cached node set records. Call on any
+ *	change to node configuration records or node features.
+ */
+extern void node_set_cache_purge(void)
+{
+	if (node_set_cache)
+		xhash_free(node_set_cache);
+}
+
+/* Build a string identifying everything the cached node sets depend upon
+ * other than the configuration, partition and feature records themselves */
+static char *_node_set_cache_key(struct job_record *job_ptr, bool can_reboot)
+{
+	struct job_details *detail_ptr = job_ptr->details;
+	multi_core_data_t *mc_ptr = detail_ptr->mc_ptr;
+	char *key = NULL;
+
+	xstrfmtcat(key, "%s|%s|%u|%"PRIu64"|%u|%u|",
+		   job_ptr->part_ptr->name,
+		   detail_ptr->features ? detail_ptr->features : "",
+		   detail_ptr->pn_min_cpus, detail_ptr->pn_min_memory,
+		   detail_ptr->pn_min_tmp_disk,
+		   _get_ntasks_per_core(detail_ptr));
+	if (mc_ptr) {
+		xstrfmtcat(key, "%u:%u:%u", mc_ptr->sockets_per_node,
+			   mc_ptr->cores_per_socket, mc_ptr->threads_per_core);
+	}
+	xstrfmtcat(key, "|%d", (int) can_reboot);
+
+	return key;
+}
+
+/*
+ * _build_feature_bitmap - identify nodes satisfying a job's AND/OR feature
+ *	expression. Evaluating the expression against all nodes and masking
+ *	the result afterwards is equivalent to _valid_feature_counts() as
+ *	long as no feature counts are specified.
+ * IN job_ptr - job being scheduled
+ * IN can_reboot - use available rather than active features
+ * OUT has_xor - set if job has XOR or XAND features
+ * OUT have_count - set if job has feature counts (bitmap not built)
+ * RET bitmap of usable nodes, NULL if no constraints or counts present
+ */
+static bitstr_t *_build_feature_bitmap(struct job_record *job_ptr,
+				       bool can_reboot, bool *has_xor,
+				       bool *have_count)
+{
+	struct job_details *detail_ptr = job_ptr->details;
+	List feature_list;
+	ListIterator job_feat_iter;
+	job_feature_t *job_feat_ptr;
+	node_feature_t *node_feat_ptr;
+	int last_op = FEATURE_OP_AND;
+	bitstr_t *feature_bitmap;
+
+	*has_xor = false;
+	*have_count = false;
+	if (detail_ptr->feature_list == NULL)	/* no constraints */
+		return NULL;
+
+	if (can_reboot)
+		feature_list = avail_feature_list;
+	else
+		feature_list = active_feature_list;
+
+	feature_bitmap = bit_alloc(node_record_count);
+	bit_nset(feature_bitmap, 0, (node_record_count - 1));
+	job_feat_iter = list_iterator_create(detail_ptr->feature_list);
+	while ((job_feat_ptr = (job_feature_t *) list_next(job_feat_iter))) {
+		node_feat_ptr = list_find_first(feature_list,
+					list_find_feature,
+					(void *) job_feat_ptr->name);
+		if (node_feat_ptr) {
+			if (last_op == FEATURE_OP_AND) {
+				bit_and(feature_bitmap,
+					node_feat_ptr->node_bitmap);
+			} else if (last_op == FEATURE_OP_OR) {
+				bit_or(feature_bitmap,
+				       node_feat_ptr->node_bitmap);
+			} else {	/* FEATURE_OP_XOR or FEATURE_OP_XAND */
+				*has_xor = true;
+				bit_or(feature_bitmap,
+				       node_feat_ptr->node_bitmap);
+			}
+		} else {	/* feature not found */
+			if (last_op == FEATURE_OP_AND) {
+				bit_nclear(feature_bitmap, 0,
+					   (node_record_count - 1));
+			}
+		}
+		last_op = job_feat_ptr->op_code;
+		if (job_feat_ptr->count)
+			*have_count = true;
+	}
+	list_iterator_destroy(job_feat_iter);
+
+	if (*have_count)
+		FREE_NULL_BITMAP(feature_bitmap);
+
+	return feature_bitmap;
+}
+
+/*
+ * _node_set_cache_build - build the node sets for a job's partition,
+ *	features and per-node resource requirements, independent of any
+ *	reservation, excluded nodes or node power state
+ */
+static node_set_cache_t *_node_set_cache_build(struct job_record *job_ptr,
+					       bool can_reboot, char *key)
+{
+	node_set_cache_t *cache_ptr;
+	struct node_set *node_set_ptr;
+	struct config_record *config_ptr;
+	struct part_record *part_ptr = job_ptr->part_ptr;
+	struct job_details *detail_ptr = job_ptr->details;
+	multi_core_data_t *mc_ptr = detail_ptr->mc_ptr;
+	ListIterator config_iterator;
+	bitstr_t *tmp_feature;
+	int adj_cpus, node_set_len;
+
+	cache_ptr = xmalloc(sizeof(node_set_cache_t));
+	cache_ptr->key = key;
+	cache_ptr->feature_bitmap = _build_feature_bitmap(job_ptr, can_reboot,
+							  &cache_ptr->has_xor,
+							  &cache_ptr->have_count);
+
+	node_set_len = list_count(config_list);
+	cache_ptr->node_set_ptr = xmalloc(sizeof(struct node_set) *
+					  (node_set_len + 1));
+	cache_ptr->check_node_config = xmalloc(sizeof(bool) *
+					       (node_set_len + 1));
+	config_iterator = list_iterator_create(config_list);
+	while ((config_ptr = (struct config_record *)
+			list_next(config_iterator))) {
+		bool cpus_ok = false, mem_ok = false, disk_ok = false;
+		bool job_mc_ok = false, config_filter = false;
+		bool check_node_config;
+
+		if (cache_ptr->node_set_size >= node_set_len) {
+			error("%s: node_set buffer filled", __func__);
+			break;
+		}
+		adj_cpus = adjust_cpus_nppcu(_get_ntasks_per_core(detail_ptr),
+					     config_ptr->threads,
+					     config_ptr->cpus);
+		if (detail_ptr->pn_min_cpus <= adj_cpus)
+			cpus_ok = true;
+		if ((detail_ptr->pn_min_memory & (~MEM_PER_CPU)) <=
+		    config_ptr->real_memory)
+			mem_ok = true;
+		if (detail_ptr->pn_min_tmp_disk <= config_ptr->tmp_disk)
+			disk_ok = true;
+		if (!mc_ptr)
+			job_mc_ok = true;
+		if (mc_ptr &&
+		    (((mc_ptr->sockets_per_node <= config_ptr->sockets) ||
+		      (mc_ptr->sockets_per_node == (uint16_t) NO_VAL))  &&
+		     ((mc_ptr->cores_per_socket <= config_ptr->cores)   ||
+		      (mc_ptr->cores_per_socket == (uint16_t) NO_VAL))  &&
+		     ((mc_ptr->threads_per_core <= config_ptr->threads) ||
+		      (mc_ptr->threads_per_core == (uint16_t) NO_VAL))))
+			job_mc_ok = true;
+		config_filter = !(cpus_ok && mem_ok && disk_ok && job_mc_ok);
+
+		/* since nodes can register with more resources than defined */
+		/* in the configuration, we want to use those higher values */
+		/* for scheduling, but only as needed (slower) */
+		if (slurmctld_conf.fast_schedule) {
+			if (config_filter) {
+				_set_err_msg(cpus_ok, mem_ok, disk_ok,
+					     job_mc_ok, &cache_ptr->err_msg);
+				continue;
+			}
+			check_node_config = false;
+		} else if (config_filter) {
+			check_node_config = true;
+		} else
+			check_node_config = false;
+
+		node_set_ptr = cache_ptr->node_set_ptr +
+			       cache_ptr->node_set_size;
+		node_set_ptr->my_bitmap = bit_copy(config_ptr->node_bitmap);
+		bit_and(node_set_ptr->my_bitmap, part_ptr->node_bitmap);
+		node_set_ptr->nodes = bit_set_count(node_set_ptr->my_bitmap);
+		if (node_set_ptr->nodes == 0) {
+			FREE_NULL_BITMAP(node_set_ptr->my_bitmap);
+			continue;
+		}
+
+		if (cache_ptr->has_xor) {
+			tmp_feature = _valid_features(job_ptr, config_ptr,
+						      can_reboot);
+			if (tmp_feature == NULL) {
+				FREE_NULL_BITMAP(node_set_ptr->my_bitmap);
+				continue;
+			}
+		} else {
+			/* We've already filtered for AND/OR features */
+			tmp_feature = bit_alloc(MAX_FEATURES);
+			bit_set(tmp_feature, 0);
+		}
+
+		node_set_ptr->cpus_per_node = config_ptr->cpus;
+		node_set_ptr->real_memory = config_ptr->real_memory;
+		node_set_ptr->weight = config_ptr->weight;
+		node_set_ptr->features = xstrdup(config_ptr->feature);
+		node_set_ptr->feature_bits = tmp_feature;
+		cache_ptr->check_node_config[cache_ptr->node_set_size] =
+			check_node_config;
+		cache_ptr->node_set_size++;
+	}
+	list_iterator_destroy(config_iterator);
+
+	return cache_ptr;
+}
+
+/*
+ * _node_set_cache_get - return the node sets which could be used by a job
+ *	in its partition given its features and per-node requirements,
+ *	building and caching them as needed. Most jobs share a handful of
+ *	partition and feature combinations, so this avoids rebuilding the
+ *	same bitmaps and re-evaluating the feature expression on each call.
+ *	Reservation, excluded node and node power state filtering are left
+ *	to the caller.
+ * IN job_ptr - job being scheduled
+ * IN can_reboot - if true node can use any available feature,
+ *	else job can use only active features
+ * RET cached record, do not free
+ */
+static node_set_cache_t *_node_set_cache_get(struct job_record *job_ptr,
+					     bool can_reboot)
+{
+	node_set_cache_t *cache_ptr;
+	char *key;
+
+	/* Partition or slurm.conf change. Timestamps have a resolution of one
+	 * second, so do not trust the cache within the second of a change */
+	if ((node_set_cache_part_update != last_part_update) ||
+	    (last_part_update >= time(NULL))) {
+		node_set_cache_purge();
+		node_set_cache_part_update = last_part_update;
+	}
+	if (!node_set_cache) {
+		node_set_cache = xhash_init(_node_set_cache_id,
+					    _node_set_cache_free, NULL, 0);
+	} else if (xhash_count(node_set_cache) >= MAX_NODE_SET_CACHE) {
+		xhash_clear(node_set_cache);
+	}
+
+	key = _node_set_cache_key(job_ptr, can_reboot);
+	cache_ptr = xhash_get(node_set_cache, key);
+	if (cache_ptr) {
+		xfree(key);
+		return cache_ptr;
+	}
+
+	cache_ptr = _node_set_cache_build(job_ptr, can_reboot, key);
+	xhash_add(node_set_cache, cache_ptr);
+
+	return cache_ptr;
+}
+
 /*
  * _build_node_list - identify which nodes could be allocated to a job
  *	based upon node features, memory, processors, etc. Note that a
@@ -3112,17 +3422,12 @@ static int _build_node_list(struct job_record *job_ptr,
 			    int *node_set_size, char **err_msg, bool test_only,
 			    bool can_reboot)
 {
-	int adj_cpus, i, node_set_inx, node_set_len, power_cnt, rc;
-	struct node_set *node_set_ptr, *prev_node_set_ptr;
-	struct config_record *config_ptr;
-	struct part_record *part_ptr = job_ptr->part_ptr;
-	ListIterator config_iterator;
-	int check_node_config;
+	int i, node_set_inx, node_set_len, power_cnt, rc;
+	struct node_set *node_set_ptr, *prev_node_set_ptr, *base_set_ptr;
+	node_set_cache_t *cache_ptr;
 	struct job_details *detail_ptr = job_ptr->details;
 	bitstr_t *usable_node_mask = NULL;
 	bitstr_t *inactive_bitmap = NULL;
-	multi_core_data_t *mc_ptr = detail_ptr->mc_ptr;
-	bitstr_t *tmp_feature;
 	bool has_xor = false;
 	bool resv_overlap = false;
 
@@ -3183,75 +3488,41 @@ static int _build_node_list(struct job_record *job_ptr,
 		bit_nset(usable_node_mask, 0, (node_record_count - 1));
 	}
 
-	if (!_valid_feature_counts(job_ptr, usable_node_mask, &has_xor)) {
-		info("No job %u feature requirements can not be met",
-		     job_ptr->job_id);
-		FREE_NULL_BITMAP(usable_node_mask);
-		if (err_msg) {
-			xfree(*err_msg);
-			*err_msg = xstrdup("Node feature requirements can not "
-					   "be specified");
+	cache_ptr = _node_set_cache_get(job_ptr, can_reboot);
+	if (cache_ptr->have_count) {
+		if (!_valid_feature_counts(job_ptr, usable_node_mask,
+					   &has_xor)) {
+			info("No job %u feature requirements can not be met",
+			     job_ptr->job_id);
+			FREE_NULL_BITMAP(usable_node_mask);
+			if (err_msg) {
+				xfree(*err_msg);
+				*err_msg = xstrdup("Node feature requirements "
+						   "can not be specified");
+			}
+			return ESLURM_REQUESTED_NODE_CONFIG_UNAVAILABLE;
 		}
-		return ESLURM_REQUESTED_NODE_CONFIG_UNAVAILABLE;
+	} else if (cache_ptr->feature_bitmap) {
+		bit_and(usable_node_mask, cache_ptr->feature_bitmap);
+	}
+	if (err_msg && cache_ptr->err_msg) {
+		xfree(*err_msg);
+		*err_msg = xstrdup(cache_ptr->err_msg);
 	}
 
 	node_set_inx = 0;
-	node_set_len = list_count(config_list) * 4 + 1;
+	node_set_len = cache_ptr->node_set_size * 4 + 1;
 	node_set_ptr = (struct node_set *)
 			xmalloc(sizeof(struct node_set) * node_set_len);
-	config_iterator = list_iterator_create(config_list);
-	while ((config_ptr = (struct config_record *)
-			list_next(config_iterator))) {
-		bool cpus_ok = false, mem_ok = false, disk_ok = false;
-		bool job_mc_ok = false, config_filter = false;
-		adj_cpus = adjust_cpus_nppcu(_get_ntasks_per_core(detail_ptr),
-					     config_ptr->threads,
-					     config_ptr->cpus);
-		if (detail_ptr->pn_min_cpus <= adj_cpus)
-			cpus_ok = true;
-		if ((detail_ptr->pn_min_memory & (~MEM_PER_CPU)) <=
-		    config_ptr->real_memory)
-			mem_ok = true;
-		if (detail_ptr->pn_min_tmp_disk <= config_ptr->tmp_disk)
-			disk_ok = true;
-		if (!mc_ptr)
-			job_mc_ok = true;
-		if (mc_ptr &&
-		    (((mc_ptr->sockets_per_node <= config_ptr->sockets) ||
-		      (mc_ptr->sockets_per_node == (uint16_t) NO_VAL))  &&
-		     ((mc_ptr->cores_per_socket <= config_ptr->cores)   ||
-		      (mc_ptr->cores_per_socket == (uint16_t) NO_VAL))  &&
-		     ((mc_ptr->threads_per_core <= config_ptr->threads) ||
-		      (mc_ptr->threads_per_core == (uint16_t) NO_VAL))))
-			job_mc_ok = true;
-		config_filter = !(cpus_ok && mem_ok && disk_ok && job_mc_ok);
-
-		/* since nodes can register with more resources than defined */
-		/* in the configuration, we want to use those higher values */
-		/* for scheduling, but only as needed (slower) */
-		if (slurmctld_conf.fast_schedule) {
-			if (config_filter) {
-				_set_err_msg(cpus_ok, mem_ok, disk_ok,
-					     job_mc_ok, err_msg);
-				continue;
-			}
-			check_node_config = 0;
-		} else if (config_filter) {
-			check_node_config = 1;
-		} else
-			check_node_config = 0;
-
+	for (i = 0; i < cache_ptr->node_set_size; i++) {
+		base_set_ptr = cache_ptr->node_set_ptr + i;
 		node_set_ptr[node_set_inx].my_bitmap =
-			bit_copy(config_ptr->node_bitmap);
+			bit_copy(base_set_ptr->my_bitmap);
 		bit_and(node_set_ptr[node_set_inx].my_bitmap,
-			part_ptr->node_bitmap);
-		if (usable_node_mask) {
-			bit_and(node_set_ptr[node_set_inx].my_bitmap,
-				usable_node_mask);
-		}
+			usable_node_mask);
 		node_set_ptr[node_set_inx].nodes =
 			bit_set_count(node_set_ptr[node_set_inx].my_bitmap);
-		if (check_node_config &&
+		if (cache_ptr->check_node_config[i] &&
 		    (node_set_ptr[node_set_inx].nodes != 0)) {
 			_filter_nodes_in_set(&node_set_ptr[node_set_inx],
 					     detail_ptr, err_msg);
@@ -3261,31 +3532,18 @@ static int _build_node_list(struct job_record *job_ptr,
 			continue;
 		}
 
-		if (has_xor) {
-			tmp_feature = _valid_features(job_ptr, config_ptr,
-						      can_reboot);
-			if (tmp_feature == NULL) {
-				FREE_NULL_BITMAP(node_set_ptr[node_set_inx].
-						 my_bitmap);
-				continue;
-			}
-		} else {
-			/* We've already filtered for AND/OR features */
-			tmp_feature = bit_alloc(MAX_FEATURES);
-			bit_set(tmp_feature, 0);
-		}
-		/* NOTE: FREE_NULL_BITMAP(tmp_feature) to avoid memory leak */
-
 		node_set_ptr[node_set_inx].cpus_per_node =
-			config_ptr->cpus;
+			base_set_ptr->cpus_per_node;
 		node_set_ptr[node_set_inx].real_memory =
-			config_ptr->real_memory;
-		node_set_ptr[node_set_inx].weight = config_ptr->weight;
+			base_set_ptr->real_memory;
+		node_set_ptr[node_set_inx].weight = base_set_ptr->weight;
 		node_set_ptr[node_set_inx].features =
-			xstrdup(config_ptr->feature);
-		node_set_ptr[node_set_inx].feature_bits = tmp_feature;
+			xstrdup(base_set_ptr->features);
+		node_set_ptr[node_set_inx].feature_bits =
+			bit_copy(base_set_ptr->feature_bits);
 		debug2("found %d usable nodes from config containing %s",
-		       node_set_ptr[node_set_inx].nodes, config_ptr->nodes);
+		       node_set_ptr[node_set_inx].nodes,
+		       base_set_ptr->features);
 		prev_node_set_ptr = node_set_ptr + node_set_inx;
 		node_set_inx++;
 		if (node_set_inx >= node_set_len) {
@@ -3306,17 +3564,19 @@ static int _build_node_list(struct job_record *job_ptr,
 		}
 		/* Split the node set record in two:
 		 * one set to reboot, one set available now */
-		node_set_ptr[node_set_inx].cpus_per_node = config_ptr->cpus;
+		node_set_ptr[node_set_inx].cpus_per_node =
+			base_set_ptr->cpus_per_node;
 		node_set_ptr[node_set_inx].features =
-			xstrdup(config_ptr->feature);
-		node_set_ptr[node_set_inx].feature_bits = bit_copy(tmp_feature);
+			xstrdup(base_set_ptr->features);
+		node_set_ptr[node_set_inx].feature_bits =
+			bit_copy(base_set_ptr->feature_bits);
 		node_set_ptr[node_set_inx].my_bitmap =
 			bit_copy(node_set_ptr[node_set_inx-1].my_bitmap);
 		bit_and(node_set_ptr[node_set_inx].my_bitmap, inactive_bitmap);
 		node_set_ptr[node_set_inx].nodes = bit_set_count(
 			node_set_ptr[node_set_inx].my_bitmap);
 		node_set_ptr[node_set_inx].real_memory =
-			config_ptr->real_memory;
+			base_set_ptr->real_memory;
 		node_set_ptr[node_set_inx].weight = INFINITE;
 		bit_and_not(node_set_ptr[node_set_inx-1].my_bitmap,inactive_bitmap);
 		node_set_ptr[node_set_inx-1].nodes -= bit_set_count(
@@ -3328,7 +3588,6 @@ static int _build_node_list(struct job_record *job_ptr,
 			break;
 		}
 	}
-	list_iterator_destroy(config_iterator);
 	/* eliminate any incomplete node_set record */
 	xfree(node_set_ptr[node_set_inx].features);
 	FREE_NULL_BITMAP(node_set_ptr[node_set_inx].my_bitmap);
@@ -97,6 +97,12 @@ extern void filter_by_node_mcs(struct job_record *job_ptr, int mcs_select,
 extern void filter_by_node_owner(struct job_record *job_ptr,
 				 bitstr_t *usable_node_mask);
 
+/*
+ * node_set_cache_purge - Purge all cached node set records. Call on any
+ *	change to node configuration records or node features.
+ */
+extern void node_set_cache_purge(void);
+
 /*
  * re_kill_job - for a given job, deallocate its nodes for a second time,
  *	basically a cleanup for failed deallocate() calls
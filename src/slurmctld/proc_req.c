@@ -74,6 +74,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_interface.h"
 #include "src/common/slurm_topology.h"
+#include "src/common/step_trace.h"
 #include "src/common/switch.h"
 #include "src/common/xstring.h"
 
@@ -111,6 +112,20 @@ static uint64_t *rpc_user_time = NULL;
 static pthread_mutex_t throttle_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t throttle_cond = PTHREAD_COND_INITIALIZER;
 
+/*
+ * MESSAGE_EPILOG_COMPLETE messages waiting to be applied. The first RPC
+ * thread to find no other thread applying them takes the job write lock
+ * once for everything queued, the others return without waiting for it.
+ */
+typedef struct {
+	uint32_t job_id;
+	char *node_name;
+	uint32_t return_code;
+} epilog_comp_t;
+static List epilog_comp_list = NULL;
+static bool epilog_comp_active = false;
+static pthread_mutex_t epilog_comp_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static void         _fill_ctld_conf(slurm_ctl_conf_t * build_ptr);
 static void         _kill_job_on_msg_fail(uint32_t job_id);
 static int          _is_prolog_finished(uint32_t job_id);
@@ -119,6 +134,10 @@ static int          _make_step_cred(struct step_record *step_rec,
 				    uint16_t protocol_version);
 static void         _throttle_fini(int *active_rpc_cnt);
 static void         _throttle_start(int *active_rpc_cnt);
+static void         _epilog_comp_free(void *x);
+static void         _epilog_complete_one(uint32_t job_id, char *node_name,
+					 uint32_t return_code,
+					 bool *run_scheduler);
 
 inline static void  _slurm_rpc_accounting_first_reg(slurm_msg_t *msg);
 inline static void  _slurm_rpc_accounting_register_ctld(slurm_msg_t *msg);
@@ -1795,6 +1814,46 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 	}
 }
 
+static void _epilog_comp_free(void *x)
+{
+	epilog_comp_t *epilog_comp = (epilog_comp_t *) x;
+
+	if (epilog_comp) {
+		xfree(epilog_comp->node_name);
+		xfree(epilog_comp);
+	}
+}
+
+/* Note the completion of a job's epilog on one node.
+ * Caller must hold the job and node write locks */
+static void _epilog_complete_one(uint32_t job_id, char *node_name,
+				 uint32_t return_code, bool *run_scheduler)
+{
+	struct job_record *job_ptr;
+	char jbuf[JBUFSIZ];
+	DEF_TIMERS;
+
+	START_TIMER;
+	if (slurmctld_conf.debug_flags & DEBUG_FLAG_ROUTE)
+		info("%s: node_name = %s, job_id = %u",
+		     __func__, node_name, job_id);
+
+	if (job_epilog_complete(job_id, node_name, return_code))
+		*run_scheduler = true;
+
+	job_ptr = find_job_record(job_id);
+	END_TIMER;
+
+	if (return_code)
+		error("%s: epilog error %s Node=%s Err=%s %s",
+		      __func__, jobid2str(job_ptr, jbuf, sizeof(jbuf)),
+		      node_name, slurm_strerror(return_code), TIME_STR);
+	else
+		debug2("%s: %s Node=%s %s",
+		       __func__, jobid2str(job_ptr, jbuf, sizeof(jbuf)),
+		       node_name, TIME_STR);
+}
+
 /* _slurm_rpc_epilog_complete - process RPC noting the completion of
  * the epilog denoting the completion of a job it its entirety */
 static void  _slurm_rpc_epilog_complete(slurm_msg_t *msg,
@@ -1812,8 +1871,9 @@ static void  _slurm_rpc_epilog_complete(slurm_msg_t *msg,
 					 slurmctld_config.auth_info);
 	epilog_complete_msg_t *epilog_msg =
 		(epilog_complete_msg_t *) msg->data;
-	struct job_record  *job_ptr;
-	char jbuf[JBUFSIZ];
+	epilog_comp_t *epilog_comp;
+	List batch;
+	int batch_cnt = 0;
 
 	START_TIMER;
 	debug2("Processing RPC: MESSAGE_EPILOG_COMPLETE uid=%d", uid);
@@ -1823,51 +1883,73 @@ static void  _slurm_rpc_epilog_complete(slurm_msg_t *msg,
 		return;
 	}
 
-	/* Only throttle on none composite messages, the lock should
-	 * already be set earlier. */
-	if (!running_composite) {
-		if (config_update != slurmctld_conf.last_update) {
-			char *sched_params = slurm_get_sched_params();
-			defer_sched = (sched_params &&
-				       strstr(sched_params, "defer"));
-			xfree(sched_params);
-			config_update = slurmctld_conf.last_update;
-		}
-
-		_throttle_start(&active_rpc_cnt);
-		lock_slurmctld(job_write_lock);
+	/* The lock is already set for composite messages */
+	if (running_composite) {
+		_epilog_complete_one(epilog_msg->job_id, epilog_msg->node_name,
+				     epilog_msg->return_code, run_scheduler);
+		END_TIMER2("_slurm_rpc_epilog_complete");
+		return;
 	}
 
-	if (slurmctld_conf.debug_flags & DEBUG_FLAG_ROUTE)
-		info("_slurm_rpc_epilog_complete: "
-		     "node_name = %s, job_id = %u", epilog_msg->node_name,
-		     epilog_msg->job_id);
-
-	if (job_epilog_complete(epilog_msg->job_id, epilog_msg->node_name,
-				epilog_msg->return_code))
-		*run_scheduler = true;
+	epilog_comp = xmalloc(sizeof(epilog_comp_t));
+	epilog_comp->job_id      = epilog_msg->job_id;
+	epilog_comp->node_name   = xstrdup(epilog_msg->node_name);
+	epilog_comp->return_code = epilog_msg->return_code;
+	slurm_mutex_lock(&epilog_comp_mutex);
+	if (!epilog_comp_list)
+		epilog_comp_list = list_create(_epilog_comp_free);
+	list_append(epilog_comp_list, epilog_comp);
+	if (epilog_comp_active) {
+		/* Another thread will apply it */
+		slurm_mutex_unlock(&epilog_comp_mutex);
+		END_TIMER2("_slurm_rpc_epilog_complete");
+		return;
+	}
+	epilog_comp_active = true;
+	slurm_mutex_unlock(&epilog_comp_mutex);
 
-	job_ptr = find_job_record(epilog_msg->job_id);
+	if (config_update != slurmctld_conf.last_update) {
+		char *sched_params = slurm_get_sched_params();
+		defer_sched = (sched_params && strstr(sched_params, "defer"));
+		xfree(sched_params);
+		config_update = slurmctld_conf.last_update;
+	}
 
-	if (epilog_msg->return_code)
-		error("%s: epilog error %s Node=%s Err=%s %s",
-		      __func__, jobid2str(job_ptr, jbuf, sizeof(jbuf)),
-		      epilog_msg->node_name,
-		      slurm_strerror(epilog_msg->return_code), TIME_STR);
-	else
-		debug2("%s: %s Node=%s %s",
-		       __func__, jobid2str(job_ptr, jbuf, sizeof(jbuf)),
-		       epilog_msg->node_name, TIME_STR);
+	_throttle_start(&active_rpc_cnt);
+	while (1) {
+		slurm_mutex_lock(&epilog_comp_mutex);
+		if (list_count(epilog_comp_list) == 0) {
+			epilog_comp_active = false;
+			slurm_mutex_unlock(&epilog_comp_mutex);
+			break;
+		}
+		batch = epilog_comp_list;
+		epilog_comp_list = list_create(_epilog_comp_free);
+		slurm_mutex_unlock(&epilog_comp_mutex);
 
-	if (!running_composite) {
+		/* Messages which arrive while this batch is applied form
+		 * the next batch, other RPCs can get the locks between */
+		lock_slurmctld(job_write_lock);
+		while ((epilog_comp = list_pop(batch))) {
+			_epilog_complete_one(epilog_comp->job_id,
+					     epilog_comp->node_name,
+					     epilog_comp->return_code,
+					     run_scheduler);
+			_epilog_comp_free(epilog_comp);
+			batch_cnt++;
+		}
 		unlock_slurmctld(job_write_lock);
-		_throttle_fini(&active_rpc_cnt);
+		FREE_NULL_LIST(batch);
 	}
+	_throttle_fini(&active_rpc_cnt);
 
 	END_TIMER2("_slurm_rpc_epilog_complete");
+	if (batch_cnt > 1)
+		debug2("%s: applied %d messages %s",
+		       __func__, batch_cnt, TIME_STR);
 
 	/* Functions below provide their own locking */
-	if (!running_composite && *run_scheduler) {
+	if (*run_scheduler) {
 		/*
 		 * In defer mode, avoid triggering the scheduler logic
 		 * for every epilog complete message.
@@ -2350,6 +2432,7 @@ static void _slurm_rpc_job_step_create(slurm_msg_t * msg)
 	job_step_create_request_msg_t *req_step_msg =
 		(job_step_create_request_msg_t *) msg->data;
 	slurm_cred_t *slurm_cred = (slurm_cred_t *) NULL;
+	uint32_t job_id;
 	/* Locks: Write jobs, read nodes */
 	slurmctld_lock_t job_write_lock = {
 		NO_LOCK, WRITE_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
@@ -2434,6 +2517,7 @@ static void _slurm_rpc_job_step_create(slurm_msg_t * msg)
 		job_step_resp.use_protocol_ver = step_rec->start_protocol_ver;
 		job_step_resp.select_jobinfo = step_rec->select_jobinfo;
 		job_step_resp.switch_job     = step_rec->switch_job;
+		job_id = step_rec->job_ptr->job_id;
 
 		unlock_slurmctld(job_write_lock);
 		_throttle_fini(&active_rpc_cnt);
@@ -2447,6 +2531,8 @@ static void _slurm_rpc_job_step_create(slurm_msg_t * msg)
 
 		slurm_send_node_msg(msg->conn_fd, &resp);
 		slurm_cred_destroy(slurm_cred);
+		/* Written once the reply is sent and with no locks held */
+		step_trace_dump(job_id, job_step_resp.job_step_id);
 		schedule_job_save();	/* Sets own locks */
 	}
 }
@@ -3082,6 +3168,7 @@ static void _slurm_rpc_reconfigure_controller(slurm_msg_t * msg)
 		assoc_mgr_set_missing_uids();
 		start_power_mgr(&slurmctld_config.thread_id_power);
 		trigger_reconfig();
+		step_trace_reconfig();
 	}
 	END_TIMER2("_slurm_rpc_reconfigure_controller");
 
@@ -5354,11 +5441,15 @@ inline static void _slurm_rpc_dump_stats(slurm_msg_t * msg)
 		_clear_rpc_stats();
 		pack_all_stat(0, &dump, &dump_size, msg->protocol_version);
 		_pack_rpc_stats(0, &dump, &dump_size, msg->protocol_version);
+		pack_dbd_agent_stat(0, &dump, &dump_size,
+				    msg->protocol_version);
 		response_msg.data = dump;
 		response_msg.data_size = dump_size;
 	} else {
 		pack_all_stat(1, &dump, &dump_size, msg->protocol_version);
 		_pack_rpc_stats(1, &dump, &dump_size, msg->protocol_version);
+		pack_dbd_agent_stat(1, &dump, &dump_size,
+				    msg->protocol_version);
 		response_msg.data = dump;
 		response_msg.data_size = dump_size;
 	}
@@ -1286,6 +1286,7 @@ extern void build_feature_list_eq(void)
 
 	char *tmp_str, *token, *last = NULL;
 
+	node_set_cache_purge();
 	FREE_NULL_LIST(active_feature_list);
 	FREE_NULL_LIST(avail_feature_list);
 	active_feature_list = list_create(_list_delete_feature);
@@ -1328,6 +1329,7 @@ extern void build_feature_list_ne(void)
 	char *tmp_str, *token, *last = NULL;
 	int i;
 
+	node_set_cache_purge();
 	FREE_NULL_LIST(active_feature_list);
 	FREE_NULL_LIST(avail_feature_list);
 	active_feature_list = list_create(_list_delete_feature);
@@ -1369,6 +1371,7 @@ extern void update_feature_list(List feature_list, char *new_features,
 	ListIterator feature_iter;
 	char *tmp_str, *token, *last = NULL;
 
+	node_set_cache_purge();
 	/* Clear these nodes from the feature_list record,
 	 * then restore as needed */
 	feature_iter = list_iterator_create(feature_list);
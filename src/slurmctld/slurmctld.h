@@ -1803,6 +1803,10 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 			  uint16_t protocol_version);
 
+/* Append the state of the SlurmDBD agent to packed statistics */
+extern void pack_dbd_agent_stat(int resp, char **buffer_ptr, int *buffer_size,
+				uint16_t protocol_version);
+
 /*
  * pack_ctld_job_step_info_response_msg - packs job step info
  * IN job_id - specific id or NO_VAL for all
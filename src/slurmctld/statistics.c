@@ -42,6 +42,7 @@
 #include "src/slurmctld/slurmctld.h"
 #include "src/common/list.h"
 #include "src/common/pack.h"
+#include "src/common/slurmdbd_defs.h"
 #include "src/common/xstring.h"
 
 extern int retry_list_size(void);
@@ -118,6 +119,33 @@ extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 	buffer_ptr[0] = xfer_buf_data(buffer);
 }
 
+/* Append the state of the SlurmDBD agent to packed statistics */
+extern void pack_dbd_agent_stat(int resp, char **buffer_ptr, int *buffer_size,
+				uint16_t protocol_version)
+{
+	Buf buffer;
+	slurmdbd_agent_stats_t stats;
+
+	if (!resp)
+		return;
+
+	slurmdbd_agent_get_stats(&stats);
+	buffer = create_buf(*buffer_ptr, *buffer_size);
+	set_buf_offset(buffer, *buffer_size);
+	pack32(stats.queue_size, buffer);
+	pack32(stats.overflow_size, buffer);
+	pack32(stats.inflight_batches, buffer);
+	pack32(stats.inflight_recs, buffer);
+	pack32(stats.batch_size, buffer);
+	pack32(stats.rtt_last, buffer);
+	pack32(stats.rtt_max, buffer);
+	pack64(stats.rtt_sum, buffer);
+	pack32(stats.rtt_cnt, buffer);
+
+	*buffer_size = get_buf_offset(buffer);
+	buffer_ptr[0] = xfer_buf_data(buffer);
+}
+
 /* Reset all scheduling statistics
  * level IN - clear backfilled_jobs count if set */
 extern void reset_stats(int level)
@@ -151,5 +179,7 @@ extern void reset_stats(int level)
 	slurmctld_diag_stats.bf_last_depth_try = 0;
 	slurmctld_diag_stats.bf_active = 0;
 
+	slurmdbd_agent_reset_stats();
+
 	last_proc_req_start = time(NULL);
 }
@@ -63,6 +63,7 @@
 #include "src/common/slurm_jobacct_gather.h"
 #include "src/common/slurm_mcs.h"
 #include "src/common/slurm_protocol_interface.h"
+#include "src/common/step_trace.h"
 #include "src/common/switch.h"
 #include "src/common/xstring.h"
 #include "src/common/slurm_ext_sensors.h"
@@ -2195,6 +2196,7 @@ step_create(job_step_create_request_msg_t *step_specs,
 	List step_gres_list = (List) NULL;
 	dynamic_plugin_data_t *select_jobinfo = NULL;
 	uint32_t task_dist;
+	struct timeval start_tv, pick_tv, pick_end_tv;
 
 #ifdef HAVE_ALPS_CRAY
 	uint32_t resv_id = 0;
@@ -2204,6 +2206,7 @@ step_create(job_step_create_request_msg_t *step_specs,
 #elif (!defined HAVE_ALPS_CRAY)
 	uint32_t max_tasks;
 #endif
+	gettimeofday(&start_tv, NULL);
 	*new_step_record = NULL;
 	job_ptr = find_job_record (step_specs->job_id);
 	if (job_ptr == NULL)
@@ -2373,9 +2376,11 @@ step_create(job_step_create_request_msg_t *step_specs,
 	/* make sure this exists since we need it so we don't core on
 	 * a xassert */
 	select_jobinfo = select_g_select_jobinfo_alloc();
+	gettimeofday(&pick_tv, NULL);
 	nodeset = _pick_step_nodes(job_ptr, step_specs, step_gres_list,
 				   cpus_per_task, node_count, select_jobinfo,
 				   &ret_code);
+	gettimeofday(&pick_end_tv, NULL);
 	if (nodeset == NULL) {
 		FREE_NULL_LIST(step_gres_list);
 		select_g_select_jobinfo_free(select_jobinfo);
@@ -2598,6 +2603,14 @@ step_create(job_step_create_request_msg_t *step_specs,
 	step_set_alloc_tres(step_ptr, node_count, false, true);
 
 	jobacct_storage_g_step_start(acct_db_conn, step_ptr);
+
+	if (step_trace_enabled()) {
+		step_trace_span(job_ptr->job_id, step_ptr->step_id,
+				"ctld_pick_step_nodes", &pick_tv,
+				&pick_end_tv);
+		step_trace_span(job_ptr->job_id, step_ptr->step_id,
+				"ctld_step_create", &start_tv, NULL);
+	}
 	return SLURM_SUCCESS;
 }
 
@@ -86,6 +86,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_interface.h"
 #include "src/common/stepd_api.h"
+#include "src/common/step_trace.h"
 #include "src/common/uid.h"
 #include "src/common/util-net.h"
 #include "src/common/xstring.h"
@@ -94,6 +95,7 @@
 #include "src/bcast/file_bcast.h"
 
 #include "src/slurmd/slurmd/get_mach_stat.h"
+#include "src/slurmd/slurmd/req.h"
 #include "src/slurmd/slurmd/slurmd.h"
 
 #include "src/slurmd/common/fname.h"
@@ -172,7 +174,6 @@ static void _note_batch_job_finished(uint32_t job_id);
 static int  _prolog_is_running (uint32_t jobid);
 static int  _step_limits_match(void *x, void *key);
 static int  _terminate_all_steps(uint32_t jobid, bool batch);
-static int  _receive_fd(int socket);
 static void _rpc_launch_tasks(slurm_msg_t *);
 static void _rpc_abort_job(slurm_msg_t *);
 static void _rpc_batch_job(slurm_msg_t *msg, bool new_msg);
@@ -204,6 +205,7 @@ static int  _rpc_step_complete(slurm_msg_t *msg);
 static int  _rpc_step_complete_aggr(slurm_msg_t *msg);
 static int  _rpc_stat_jobacct(slurm_msg_t *msg);
 static int  _rpc_list_pids(slurm_msg_t *msg);
+static int  _rpc_step_io_forward(slurm_msg_t *msg);
 static int  _rpc_daemon_status(slurm_msg_t *msg);
 static int  _run_epilog(job_env_t *job_env);
 static int  _run_prolog(job_env_t *job_env, slurm_cred_t *cred);
@@ -219,7 +221,6 @@ static void _sync_messages_kill(kill_job_msg_t *req);
 static int  _waiter_init (uint32_t jobid);
 static int  _waiter_complete (uint32_t jobid);
 
-static void _send_back_fd(int socket, int fd);
 static bool _steps_completed_now(uint32_t jobid);
 static int  _valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid,
 			       uint16_t block_no, uint32_t *job_id);
@@ -276,6 +277,27 @@ static uint32_t active_job_id[JOB_STATE_CNT];
 static pthread_mutex_t prolog_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t prolog_serial_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Pool of slurmstepd processes started in advance, waiting for their
+ * initialization data (LaunchParameters=slurmstepd_pool=#). Also
+ * protects the launch latency histograms.
+ */
+typedef struct {
+	int to_stepd;		/* write end of slurmstepd's stdin */
+	int to_slurmd;		/* read end of slurmstepd's stdout */
+} stepd_pool_t;
+static pthread_mutex_t stepd_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static stepd_pool_t stepd_pool[STEPD_POOL_MAX];
+static int stepd_pool_cnt = 0;
+static uint32_t stepd_pool_gen = 0;	/* bumped by stepd_pool_purge() */
+static bool stepd_pool_filling = false;
+static uint32_t stepd_pool_hits = 0, stepd_pool_misses = 0;
+
+/* Launch latency histograms, bucket i counts samples < 2^i msec */
+#define LAUNCH_HIST_CNT 16
+static uint32_t launch_spawn_hist[LAUNCH_HIST_CNT];
+static uint32_t launch_init_hist[LAUNCH_HIST_CNT];
+
 #define FILE_BCAST_TIMEOUT 300
 static pthread_mutex_t file_bcast_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  file_bcast_cond  = PTHREAD_COND_INITIALIZER;
@@ -433,6 +455,9 @@ slurmd_req(slurm_msg_t *msg)
 	case REQUEST_JOB_STEP_PIDS:
 		(void) _rpc_list_pids(msg);
 		break;
+	case REQUEST_STEP_IO_FORWARD:
+		(void) _rpc_step_io_forward(msg);
+		break;
 	case REQUEST_DAEMON_STATUS:
 		_rpc_daemon_status(msg);
 		break;
@@ -481,6 +506,30 @@ static int _send_slurmd_conf_lite (int fd, slurmd_conf_t *cf)
 	return (-1);
 }
 
+/*
+ * Send slurmstepd the initialization data which does not depend on the
+ * job step: the slurmd configuration, GRES and cpu frequency information.
+ * A pooled slurmstepd gets it when it is started and sets itself up with
+ * it before waiting for the rest from _send_slurmstepd_init().
+ */
+static int
+_send_slurmstepd_node_init(int fd)
+{
+	/* send conf over to slurmstepd */
+	if (_send_slurmd_conf_lite(fd, conf) < 0) {
+		error("%s failed", __func__);
+		return errno;
+	}
+
+	/* Send GRES information to slurmstepd */
+	gres_plugin_send_stepd(fd);
+
+	/* send cpu_frequency info to slurmstepd */
+	cpu_freq_send_info(fd);
+
+	return 0;
+}
+
 static int
 _send_slurmstepd_init(int fd, int type, void *req,
 		      slurm_addr_t *cli, slurm_addr_t *self,
@@ -586,10 +635,6 @@ _send_slurmstepd_init(int fd, int type, void *req,
 	safe_write(fd, &max_depth, sizeof(int));
 	safe_write(fd, &parent_addr, sizeof(slurm_addr_t));
 
-	/* send conf over to slurmstepd */
-	if (_send_slurmd_conf_lite(fd, conf) < 0)
-		goto rwfail;
-
 	/* send cli address over to slurmstepd */
 	buffer = init_buf(0);
 	slurm_pack_slurm_addr(cli, buffer);
@@ -614,12 +659,6 @@ _send_slurmstepd_init(int fd, int type, void *req,
 		safe_write(fd, &len, sizeof(int));
 	}
 
-	/* Send GRES information to slurmstepd */
-	gres_plugin_send_stepd(fd);
-
-	/* send cpu_frequency info to slurmstepd */
-	cpu_freq_send_info(fd);
-
 	/* send req over to slurmstepd */
 	switch(type) {
 	case LAUNCH_BATCH_JOB:
@@ -724,9 +763,401 @@ rwfail:
 
 
 /*
- * Fork and exec the slurmstepd, then send the slurmstepd its
- * initialization data.  Then wait for slurmstepd to send an "ok"
- * message before returning.  When the "ok" message is received,
+ * Exec the slurmstepd in the child of a fork. This forks again so that it
+ * is the grandchild that becomes the slurmstepd process, and the
+ * slurmstepd's parent process will be init, not slurmd.
+ * type and req are only used for logging under SLURMSTEPD_MEMCHECK.
+ * Never returns.
+ */
+static void
+_exec_slurmstepd(uint16_t type, void *req, int to_stepd[2], int to_slurmd[2])
+{
+#if (SLURMSTEPD_MEMCHECK == 1)
+	/* memcheck test of slurmstepd, option #1 */
+	char *const argv[3] = {"memcheck",
+			       (char *)conf->stepd_loc, NULL};
+#elif (SLURMSTEPD_MEMCHECK == 2)
+	/* valgrind test of slurmstepd, option #2 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[13] = {"valgrind", "--tool=memcheck",
+				"--error-limit=no",
+				"--leak-check=summary",
+				"--show-reachable=yes",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				"--track-origins=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
+#elif (SLURMSTEPD_MEMCHECK == 3)
+	/* valgrind/drd test of slurmstepd, option #3 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[10] = {"valgrind", "--tool=drd",
+				"--error-limit=no",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
+#elif (SLURMSTEPD_MEMCHECK == 4)
+	/* valgrind/helgrind test of slurmstepd, option #4 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[10] = {"valgrind", "--tool=helgrind",
+				"--error-limit=no",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
+#else
+	/* no memory checking, default */
+	char *const argv[2] = { (char *)conf->stepd_loc, NULL};
+#endif
+	pid_t pid;
+	int i;
+	int failed = 0;
+	/* inform slurmstepd about our config */
+	setenv("SLURM_CONF", conf->conffile, 1);
+
+	/*
+	 * Child forks and exits
+	 */
+	if (setsid() < 0) {
+		error("_forkexec_slurmstepd: setsid: %m");
+		failed = 1;
+	}
+	if ((pid = fork()) < 0) {
+		error("_forkexec_slurmstepd: "
+		      "Unable to fork grandchild: %m");
+		failed = 2;
+	} else if (pid > 0) { /* child */
+		exit(0);
+	}
+
+	/*
+	 * Just incase we (or someone we are linking to)
+	 * opened a file and didn't do a close on exec.  This
+	 * is needed mostly to protect us against libs we link
+	 * to that don't set the flag as we should already be
+	 * setting it for those that we open.  The number 256
+	 * is an arbitrary number based off test7.9.
+	 */
+	for (i=3; i<256; i++) {
+		(void) fcntl(i, F_SETFD, FD_CLOEXEC);
+	}
+
+	/*
+	 * Grandchild exec's the slurmstepd
+	 *
+	 * If the slurmd is being shutdown/restarted before
+	 * the pipe happens the old conf->lfd could be reused
+	 * and if we close it the dup2 below will fail.
+	 */
+	if ((to_stepd[0] != conf->lfd)
+	    && (to_slurmd[1] != conf->lfd))
+		slurm_shutdown_msg_engine(conf->lfd);
+
+	if (close(to_stepd[1]) < 0)
+		error("close write to_stepd in grandchild: %m");
+	if (close(to_slurmd[0]) < 0)
+		error("close read to_slurmd in parent: %m");
+
+	(void) close(STDIN_FILENO); /* ignore return */
+	if (dup2(to_stepd[0], STDIN_FILENO) == -1) {
+		error("dup2 over STDIN_FILENO: %m");
+		exit(1);
+	}
+	fd_set_close_on_exec(to_stepd[0]);
+	(void) close(STDOUT_FILENO); /* ignore return */
+	if (dup2(to_slurmd[1], STDOUT_FILENO) == -1) {
+		error("dup2 over STDOUT_FILENO: %m");
+		exit(1);
+	}
+	fd_set_close_on_exec(to_slurmd[1]);
+	(void) close(STDERR_FILENO); /* ignore return */
+	if (dup2(devnull, STDERR_FILENO) == -1) {
+		error("dup2 /dev/null to STDERR_FILENO: %m");
+		exit(1);
+	}
+	fd_set_noclose_on_exec(STDERR_FILENO);
+	log_fini();
+	if (!failed) {
+		if (conf->chos_loc && !access(conf->chos_loc, X_OK))
+			execvp(conf->chos_loc, argv);
+		else
+			execvp(argv[0], argv);
+		error("exec of slurmstepd failed: %m");
+	}
+	exit(2);
+}
+
+#if (SLURMSTEPD_MEMCHECK == 0)
+/*
+ * Start a slurmstepd for the pool and send it the initialization data
+ * which does not depend on the job step. It sets itself up with that,
+ * then blocks reading the rest of its initialization data.
+ * Returns the slurmd ends of its stdin and stdout pipes.
+ */
+static int
+_stepd_pool_spawn(stepd_pool_t *stepd)
+{
+	pid_t pid;
+	int to_stepd[2] = {-1, -1};
+	int to_slurmd[2] = {-1, -1};
+
+	if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
+		error("%s: pipe failed: %m", __func__);
+		goto fail;
+	}
+	if ((pid = fork()) < 0) {
+		error("%s: fork: %m", __func__);
+		goto fail;
+	} else if (pid == 0) {
+		_exec_slurmstepd(0, NULL, to_stepd, to_slurmd);
+	}
+
+	if (close(to_stepd[0]) < 0)
+		error("Unable to close read to_stepd in parent: %m");
+	if (close(to_slurmd[1]) < 0)
+		error("Unable to close write to_slurmd in parent: %m");
+	/* Reap child, the slurmstepd is its child */
+	if (waitpid(pid, NULL, 0) < 0)
+		error("Unable to reap slurmd child process");
+	fd_set_close_on_exec(to_stepd[1]);
+	fd_set_close_on_exec(to_slurmd[0]);
+	if (_send_slurmstepd_node_init(to_stepd[1]) != 0) {
+		close(to_stepd[1]);
+		close(to_slurmd[0]);
+		return SLURM_FAILURE;
+	}
+	stepd->to_stepd = to_stepd[1];
+	stepd->to_slurmd = to_slurmd[0];
+	return SLURM_SUCCESS;
+
+fail:
+	if (to_stepd[0] >= 0) {
+		close(to_stepd[0]);
+		close(to_stepd[1]);
+	}
+	if (to_slurmd[0] >= 0) {
+		close(to_slurmd[0]);
+		close(to_slurmd[1]);
+	}
+	return SLURM_FAILURE;
+}
+
+static void *
+_stepd_pool_fill(void *arg)
+{
+	stepd_pool_t stepd;
+	uint32_t gen;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	while (stepd_pool_cnt < conf->stepd_pool_size) {
+		gen = stepd_pool_gen;
+		slurm_mutex_unlock(&stepd_pool_mutex);
+		if (_stepd_pool_spawn(&stepd) != SLURM_SUCCESS) {
+			slurm_mutex_lock(&stepd_pool_mutex);
+			break;
+		}
+		slurm_mutex_lock(&stepd_pool_mutex);
+		/* A slurmstepd spawned before the pool was purged got the
+		 * old configuration, don't add it to the new pool */
+		if ((gen == stepd_pool_gen) &&
+		    (stepd_pool_cnt < conf->stepd_pool_size)) {
+			stepd_pool[stepd_pool_cnt++] = stepd;
+		} else {	/* pool purged or shrunk meanwhile */
+			close(stepd.to_stepd);
+			close(stepd.to_slurmd);
+		}
+	}
+	stepd_pool_filling = false;
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	return NULL;
+}
+
+/*
+ * Take a slurmstepd from the pool, skipping any which have exited.
+ * RET true if to_stepd[1] and to_slurmd[0] were set
+ */
+static bool
+_stepd_pool_get(int to_stepd[2], int to_slurmd[2])
+{
+	struct pollfd ufd;
+	stepd_pool_t stepd;
+	bool found = false;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	while (stepd_pool_cnt > 0) {
+		stepd = stepd_pool[--stepd_pool_cnt];
+		/* A waiting slurmstepd writes nothing, so anything readable
+		 * means it is gone */
+		ufd.fd = stepd.to_slurmd;
+		ufd.events = POLLIN;
+		ufd.revents = 0;
+		if (poll(&ufd, 1, 0) != 0) {
+			debug("%s: discarding exited slurmstepd", __func__);
+			close(stepd.to_stepd);
+			close(stepd.to_slurmd);
+			continue;
+		}
+		to_stepd[1] = stepd.to_stepd;
+		to_slurmd[0] = stepd.to_slurmd;
+		found = true;
+		break;
+	}
+	if (found)
+		stepd_pool_hits++;
+	else if (conf->stepd_pool_size)
+		stepd_pool_misses++;
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	if (conf->stepd_pool_size)
+		stepd_pool_fill();
+
+	return found;
+}
+#endif
+
+/* Start filling the slurmstepd pool in the background, if configured */
+extern void
+stepd_pool_fill(void)
+{
+#if (SLURMSTEPD_MEMCHECK == 0)
+	pthread_attr_t attr;
+	pthread_t thread_id;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	if (stepd_pool_filling || (stepd_pool_cnt >= conf->stepd_pool_size)) {
+		slurm_mutex_unlock(&stepd_pool_mutex);
+		return;
+	}
+	stepd_pool_filling = true;
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	slurm_attr_init(&attr);
+	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+		error("pthread_attr_setdetachstate: %m");
+	if (pthread_create(&thread_id, &attr, _stepd_pool_fill, NULL)) {
+		error("%s: pthread_create: %m", __func__);
+		slurm_mutex_lock(&stepd_pool_mutex);
+		stepd_pool_filling = false;
+		slurm_mutex_unlock(&stepd_pool_mutex);
+	}
+	slurm_attr_destroy(&attr);
+#endif
+}
+
+/* Discard all pooled slurmstepd processes, they exit on EOF */
+extern void
+stepd_pool_purge(void)
+{
+	int i;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	for (i = 0; i < stepd_pool_cnt; i++) {
+		close(stepd_pool[i].to_stepd);
+		close(stepd_pool[i].to_slurmd);
+	}
+	stepd_pool_cnt = 0;
+	stepd_pool_gen++;
+	slurm_mutex_unlock(&stepd_pool_mutex);
+}
+
+/* Add a sample, in microseconds, to a launch latency histogram */
+static void
+_launch_hist_add(uint32_t *hist, long usec)
+{
+	int i = 0;
+	long msec = usec / 1000;
+
+	while ((msec > 0) && (i < (LAUNCH_HIST_CNT - 1))) {
+		msec >>= 1;
+		i++;
+	}
+	slurm_mutex_lock(&stepd_pool_mutex);
+	hist[i]++;
+	slurm_mutex_unlock(&stepd_pool_mutex);
+}
+
+static void
+_launch_hist_log(char *stage, uint32_t *hist)
+{
+	char *out = NULL, *sep = "";
+	int i;
+
+	for (i = 0; i < LAUNCH_HIST_CNT; i++) {
+		if (!hist[i])
+			continue;
+		if (i == (LAUNCH_HIST_CNT - 1))
+			xstrfmtcat(out, "%s>=%dms:%u", sep, 1 << (i - 1),
+				   hist[i]);
+		else
+			xstrfmtcat(out, "%s<%dms:%u", sep, 1 << i, hist[i]);
+		sep = " ";
+	}
+	info("slurmstepd launch %s latency: %s", stage, out ? out : "none");
+	xfree(out);
+}
+
+/*
+ * Log histograms of slurmstepd launch latency. "spawn" is the time to
+ * fork slurmstepd or take one from the pool, "init" the time from
+ * sending slurmstepd its initialization data until it reports the job
+ * step set up (including exec and plugin loading if not pooled).
+ */
+extern void
+stepd_launch_stats_log(void)
+{
+	slurm_mutex_lock(&stepd_pool_mutex);
+	if (stepd_pool_hits || stepd_pool_misses) {
+		info("slurmstepd pool: size %u hits %u misses %u",
+		     conf->stepd_pool_size, stepd_pool_hits,
+		     stepd_pool_misses);
+	}
+	_launch_hist_log("spawn", launch_spawn_hist);
+	_launch_hist_log("init", launch_init_hist);
+	slurm_mutex_unlock(&stepd_pool_mutex);
+}
+
+/*
+ * Fork and exec the slurmstepd, or take one from the pool, then send the
+ * slurmstepd its initialization data.  Then wait for slurmstepd to send
+ * an "ok" message before returning.  When the "ok" message is received,
  * the slurmstepd has created and begun listening on its unix
  * domain socket.
  *
@@ -739,34 +1170,44 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 		     slurm_addr_t *cli, slurm_addr_t *self,
 		     const hostset_t step_hset, uint16_t protocol_version)
 {
-	pid_t pid;
+	pid_t pid = 0;
 	int to_stepd[2] = {-1, -1};
 	int to_slurmd[2] = {-1, -1};
-
-	if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
-		error("_forkexec_slurmstepd pipe failed: %m");
-		return SLURM_FAILURE;
-	}
+	int rc = SLURM_SUCCESS;
+	bool pooled = false;
+#if (SLURMSTEPD_MEMCHECK == 0)
+	int i;
+	time_t start_time = time(NULL);
+	DEF_TIMERS;
+#endif
 
 	if (_add_starting_step(type, req)) {
 		error("_forkexec_slurmstepd failed in _add_starting_step: %m");
 		return SLURM_FAILURE;
 	}
 
-	if ((pid = fork()) < 0) {
-		error("_forkexec_slurmstepd: fork: %m");
-		close(to_stepd[0]);
-		close(to_stepd[1]);
-		close(to_slurmd[0]);
-		close(to_slurmd[1]);
-		_remove_starting_step(type, req);
-		return SLURM_FAILURE;
-	} else if (pid > 0) {
-		int rc = SLURM_SUCCESS;
 #if (SLURMSTEPD_MEMCHECK == 0)
-		int i;
-		time_t start_time = time(NULL);
+	START_TIMER;
+	if (!(pooled = _stepd_pool_get(to_stepd, to_slurmd)))
 #endif
+	{
+		if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
+			error("_forkexec_slurmstepd pipe failed: %m");
+			_remove_starting_step(type, req);
+			return SLURM_FAILURE;
+		}
+		if ((pid = fork()) < 0) {
+			error("_forkexec_slurmstepd: fork: %m");
+			close(to_stepd[0]);
+			close(to_stepd[1]);
+			close(to_slurmd[0]);
+			close(to_slurmd[1]);
+			_remove_starting_step(type, req);
+			return SLURM_FAILURE;
+		} else if (pid == 0) {
+			_exec_slurmstepd(type, req, to_stepd, to_slurmd);
+		}
+
 		/*
 		 * Parent sends initialization data to the slurmstepd
 		 * over the to_stepd pipe, and waits for the return code
@@ -776,209 +1217,73 @@ _forkexec_slurmstepd(uint16_t type, void *req,
 			error("Unable to close read to_stepd in parent: %m");
 		if (close(to_slurmd[1]) < 0)
 			error("Unable to close write to_slurmd in parent: %m");
-
-		if ((rc = _send_slurmstepd_init(to_stepd[1], type,
-						req, cli, self,
-						step_hset,
-						protocol_version)) != 0) {
-			error("Unable to init slurmstepd");
-			goto done;
-		}
-
-		/* If running under valgrind/memcheck, this pipe doesn't work
-		 * correctly so just skip it. */
+	}
 #if (SLURMSTEPD_MEMCHECK == 0)
-		i = read(to_slurmd[0], &rc, sizeof(int));
-		if (i < 0) {
-			error("%s: Can not read return code from slurmstepd "
-			      "got %d: %m", __func__, i);
-			rc = SLURM_FAILURE;
-		} else if (i != sizeof(int)) {
-			error("%s: slurmstepd failed to send return code "
-			      "got %d: %m", __func__, i);
-			rc = SLURM_FAILURE;
-		} else {
-			int delta_time = time(NULL) - start_time;
-			int cc;
-			if (delta_time > 5) {
-				info("Warning: slurmstepd startup took %d sec, "
-				     "possible file system problem or full "
-				     "memory", delta_time);
-			}
-			if (rc != SLURM_SUCCESS)
-				error("slurmstepd return code %d", rc);
-
-			cc = SLURM_SUCCESS;
-			cc = write(to_stepd[1], &cc, sizeof(int));
-			if (cc != sizeof(int)) {
-				error("%s: failed to send ack to stepd %d: %m",
-				      __func__, cc);
-			}
-		}
-#endif
-	done:
-		if (_remove_starting_step(type, req))
-			error("Error cleaning up starting_step list");
-
-		/* Reap child */
-		if (waitpid(pid, NULL, 0) < 0)
-			error("Unable to reap slurmd child process");
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in parent: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-		return rc;
-	} else {
-#if (SLURMSTEPD_MEMCHECK == 1)
-		/* memcheck test of slurmstepd, option #1 */
-		char *const argv[3] = {"memcheck",
-				       (char *)conf->stepd_loc, NULL};
-#elif (SLURMSTEPD_MEMCHECK == 2)
-		/* valgrind test of slurmstepd, option #2 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[13] = {"valgrind", "--tool=memcheck",
-					"--error-limit=no",
-					"--leak-check=summary",
-					"--show-reachable=yes",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					"--track-origins=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
-#elif (SLURMSTEPD_MEMCHECK == 3)
-		/* valgrind/drd test of slurmstepd, option #3 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[10] = {"valgrind", "--tool=drd",
-					"--error-limit=no",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
-#elif (SLURMSTEPD_MEMCHECK == 4)
-		/* valgrind/helgrind test of slurmstepd, option #4 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[10] = {"valgrind", "--tool=helgrind",
-					"--error-limit=no",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
-#else
-		/* no memory checking, default */
-		char *const argv[2] = { (char *)conf->stepd_loc, NULL};
+	END_TIMER;
+	_launch_hist_add(launch_spawn_hist, DELTA_TIMER);
+	START_TIMER;
 #endif
-		int i;
-		int failed = 0;
-		/* inform slurmstepd about our config */
-		setenv("SLURM_CONF", conf->conffile, 1);
 
-		/*
-		 * Child forks and exits
-		 */
-		if (setsid() < 0) {
-			error("_forkexec_slurmstepd: setsid: %m");
-			failed = 1;
-		}
-		if ((pid = fork()) < 0) {
-			error("_forkexec_slurmstepd: "
-			      "Unable to fork grandchild: %m");
-			failed = 2;
-		} else if (pid > 0) { /* child */
-			exit(0);
-		}
+	/* A pooled slurmstepd got this when it was started */
+	if (!pooled &&
+	    ((rc = _send_slurmstepd_node_init(to_stepd[1])) != 0)) {
+		error("Unable to init slurmstepd");
+		goto done;
+	}
 
-		/*
-		 * Just incase we (or someone we are linking to)
-		 * opened a file and didn't do a close on exec.  This
-		 * is needed mostly to protect us against libs we link
-		 * to that don't set the flag as we should already be
-		 * setting it for those that we open.  The number 256
-		 * is an arbitrary number based off test7.9.
-		 */
-		for (i=3; i<256; i++) {
-			(void) fcntl(i, F_SETFD, FD_CLOEXEC);
-		}
+	if ((rc = _send_slurmstepd_init(to_stepd[1], type,
+					req, cli, self,
+					step_hset,
+					protocol_version)) != 0) {
+		error("Unable to init slurmstepd");
+		goto done;
+	}
 
-		/*
-		 * Grandchild exec's the slurmstepd
-		 *
-		 * If the slurmd is being shutdown/restarted before
-		 * the pipe happens the old conf->lfd could be reused
-		 * and if we close it the dup2 below will fail.
-		 */
-		if ((to_stepd[0] != conf->lfd)
-		    && (to_slurmd[1] != conf->lfd))
-			slurm_shutdown_msg_engine(conf->lfd);
-
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in grandchild: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-
-		(void) close(STDIN_FILENO); /* ignore return */
-		if (dup2(to_stepd[0], STDIN_FILENO) == -1) {
-			error("dup2 over STDIN_FILENO: %m");
-			exit(1);
-		}
-		fd_set_close_on_exec(to_stepd[0]);
-		(void) close(STDOUT_FILENO); /* ignore return */
-		if (dup2(to_slurmd[1], STDOUT_FILENO) == -1) {
-			error("dup2 over STDOUT_FILENO: %m");
-			exit(1);
-		}
-		fd_set_close_on_exec(to_slurmd[1]);
-		(void) close(STDERR_FILENO); /* ignore return */
-		if (dup2(devnull, STDERR_FILENO) == -1) {
-			error("dup2 /dev/null to STDERR_FILENO: %m");
-			exit(1);
+	/* If running under valgrind/memcheck, this pipe doesn't work
+	 * correctly so just skip it. */
+#if (SLURMSTEPD_MEMCHECK == 0)
+	i = read(to_slurmd[0], &rc, sizeof(int));
+	if (i < 0) {
+		error("%s: Can not read return code from slurmstepd "
+		      "got %d: %m", __func__, i);
+		rc = SLURM_FAILURE;
+	} else if (i != sizeof(int)) {
+		error("%s: slurmstepd failed to send return code "
+		      "got %d: %m", __func__, i);
+		rc = SLURM_FAILURE;
+	} else {
+		int delta_time = time(NULL) - start_time;
+		int cc;
+		END_TIMER;
+		_launch_hist_add(launch_init_hist, DELTA_TIMER);
+		if (delta_time > 5) {
+			info("Warning: slurmstepd startup took %d sec, "
+			     "possible file system problem or full "
+			     "memory", delta_time);
 		}
-		fd_set_noclose_on_exec(STDERR_FILENO);
-		log_fini();
-		if (!failed) {
-			if (conf->chos_loc && !access(conf->chos_loc, X_OK))
-				execvp(conf->chos_loc, argv);
-			else
-				execvp(argv[0], argv);
-			error("exec of slurmstepd failed: %m");
+		if (rc != SLURM_SUCCESS)
+			error("slurmstepd return code %d", rc);
+
+		cc = SLURM_SUCCESS;
+		cc = write(to_stepd[1], &cc, sizeof(int));
+		if (cc != sizeof(int)) {
+			error("%s: failed to send ack to stepd %d: %m",
+			      __func__, cc);
 		}
-		exit(2);
 	}
+#endif
+done:
+	if (_remove_starting_step(type, req))
+		error("Error cleaning up starting_step list");
+
+	/* Reap child */
+	if ((pid > 0) && (waitpid(pid, NULL, 0) < 0))
+		error("Unable to reap slurmd child process");
+	if (close(to_stepd[1]) < 0)
+		error("close write to_stepd in parent: %m");
+	if (close(to_slurmd[0]) < 0)
+		error("close read to_slurmd in parent: %m");
+	return rc;
 }
 
 
@@ -1404,6 +1709,9 @@ _rpc_launch_tasks(slurm_msg_t *msg)
 	job_mem_limits_t *job_limits_ptr;
 	int nodeid = 0;
 	bitstr_t *numa_bitmap = NULL;
+	struct timeval start_tv, stage_tv;
+
+	gettimeofday(&start_tv, NULL);
 
 #ifndef HAVE_FRONT_END
 	/* It is always 0 for front end systems */
@@ -1434,6 +1742,7 @@ _rpc_launch_tasks(slurm_msg_t *msg)
 	slurm_mutex_lock(&prolog_mutex);
 	first_job_run = !slurm_cred_jobid_cached(conf->vctx, req->job_id);
 #endif
+	gettimeofday(&stage_tv, NULL);
 	if (_check_job_credential(req, req_uid, nodeid, &step_hset,
 				  msg->protocol_version) < 0) {
 		errnum = errno;
@@ -1445,6 +1754,9 @@ _rpc_launch_tasks(slurm_msg_t *msg)
 		goto done;
 	}
 
+	step_trace_span(req->job_id, req->job_step_id, "slurmd_cred_verify",
+			&stage_tv, NULL);
+
 	/* Must follow _check_job_credential(), which sets some req fields */
 	task_g_slurmd_launch_request(req->job_id, req, nodeid);
 
@@ -1470,7 +1782,10 @@ _rpc_launch_tasks(slurm_msg_t *msg)
 		job_env.spank_job_env_size = req->spank_job_env_size;
 		job_env.uid = req->uid;
 		job_env.user_name = req->user_name;
+		gettimeofday(&stage_tv, NULL);
 		rc =  _run_prolog(&job_env, req->cred);
+		step_trace_span(req->job_id, req->job_step_id, "slurmd_prolog",
+				&stage_tv, NULL);
 		if (rc) {
 			int term_sig, exit_status;
 			if (WIFSIGNALED(rc)) {
@@ -1544,8 +1859,11 @@ _rpc_launch_tasks(slurm_msg_t *msg)
 	slurm_get_stream_addr(msg->conn_fd, &self);
 
 	debug3("_rpc_launch_tasks: call to _forkexec_slurmstepd");
+	gettimeofday(&stage_tv, NULL);
 	errnum = _forkexec_slurmstepd(LAUNCH_TASKS, (void *)req, cli, &self,
 				      step_hset, msg->protocol_version);
+	step_trace_span(req->job_id, req->job_step_id, "slurmd_forkexec_stepd",
+			&stage_tv, NULL);
 	debug3("_rpc_launch_tasks: return from _forkexec_slurmstepd");
 	_launch_complete_add(req->job_id);
 
@@ -1553,6 +1871,8 @@ _rpc_launch_tasks(slurm_msg_t *msg)
 	if (step_hset)
 		hostset_destroy(step_hset);
 
+	/* Includes waiting for replies from the nodes we forwarded to */
+	gettimeofday(&stage_tv, NULL);
 	if (slurm_send_rc_msg(msg, errnum) < 0) {
 		char addr_str[32];
 		slurm_print_slurm_addr(&msg->address, addr_str,
@@ -1570,6 +1890,13 @@ _rpc_launch_tasks(slurm_msg_t *msg)
 		save_cred_state(conf->vctx);
 		task_g_slurmd_reserve_resources(req->job_id, req, nodeid);
 	}
+	if (step_trace_enabled()) {
+		step_trace_span(req->job_id, req->job_step_id, "slurmd_reply",
+				&stage_tv, NULL);
+		step_trace_span(req->job_id, req->job_step_id,
+				"slurmd_launch_tasks", &start_tv, NULL);
+		step_trace_dump(req->job_id, req->job_step_id);
+	}
 
 	/*
 	 *  If job prolog failed, indicate failure to slurmctld
@@ -1624,7 +1951,7 @@ static int _open_as_other(char *path_name, batch_job_launch_msg_t *req)
 		(void) waitpid(child, &rc, 0);
 		_dealloc_gids(gids);
 		if (WIFEXITED(rc) && (WEXITSTATUS(rc) == 0))
-			fd = _receive_fd(pipe[1]);
+			fd = receive_fd_over_pipe(pipe[1]);
 		close(pipe[1]);
 		return fd;
 	}
@@ -1678,7 +2005,7 @@ static int _open_as_other(char *path_name, batch_job_launch_msg_t *req)
 		      __func__, req->uid, path_name);
 		exit(errno);
 	}
-	_send_back_fd(pipe[0], fd);
+	send_fd_over_pipe(pipe[0], fd);
 	close(fd);
 	exit(SLURM_SUCCESS);
 }
@@ -3665,6 +3992,50 @@ _rpc_list_pids(slurm_msg_t *msg)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Hand the connection of a slurmstepd on another node over to the local
+ * slurmstepd of the same step, which then forwards that slurmstepd's I/O
+ * to srun (LAUNCH_IO_TREE).
+ */
+static int
+_rpc_step_io_forward(slurm_msg_t *msg)
+{
+	job_step_id_msg_t *req = (job_step_id_msg_t *)msg->data;
+	int               rc = SLURM_SUCCESS;
+	int               fd;
+	uid_t             req_uid;
+	uint16_t protocol_version;
+
+	debug3("Entering _rpc_step_io_forward");
+	/* only other slurmstepds forward their I/O here,
+	 * so only root or SlurmUser is allowed */
+	req_uid = g_slurm_auth_get_uid(msg->auth_cred, conf->auth_info);
+	if (!_slurm_authorized_user(req_uid)) {
+		error("I/O forward request from uid %ld for job %u.%u",
+		      (long) req_uid, req->job_id, req->step_id);
+		rc = ESLURM_USER_ID_MISSING;
+		goto done;
+	}
+
+	/* The step may not be running here yet, the sender retries */
+	fd = stepd_connect(conf->spooldir, conf->node_name,
+			   req->job_id, req->step_id, &protocol_version);
+	if (fd == -1) {
+		debug("stepd_connect to %u.%u failed: %m",
+		      req->job_id, req->step_id);
+		rc = ESLURM_INVALID_JOB_ID;
+		goto done;
+	}
+
+	rc = stepd_io_forward(fd, protocol_version, msg->conn_fd);
+	close(fd);
+
+done:
+	slurm_send_rc_msg(msg, rc);
+
+	return rc;
+}
+
 /*
  *  For the specified job_id: reply to slurmctld,
  *   sleep(configured kill_wait), then send SIGKILL
@@ -4042,53 +4413,6 @@ static int _rpc_file_bcast(slurm_msg_t *msg)
 	return SLURM_SUCCESS;
 }
 
-/* pass an open file descriptor back to the parent process */
-static void _send_back_fd(int socket, int fd)
-{
-	struct msghdr msg = { 0 };
-	struct cmsghdr *cmsg;
-	char buf[CMSG_SPACE(sizeof(fd))];
-	memset(buf, '\0', sizeof(buf));
-
-	msg.msg_iov = NULL;
-	msg.msg_iovlen = 0;
-	msg.msg_control = buf;
-	msg.msg_controllen = sizeof(buf);
-
-	cmsg = CMSG_FIRSTHDR(&msg);
-	cmsg->cmsg_level = SOL_SOCKET;
-	cmsg->cmsg_type = SCM_RIGHTS;
-	cmsg->cmsg_len = CMSG_LEN(sizeof(fd));
-
-	memmove(CMSG_DATA(cmsg), &fd, sizeof(fd));
-	msg.msg_controllen = cmsg->cmsg_len;
-
-	if (sendmsg(socket, &msg, 0) < 0)
-		error("%s: failed to send fd: %m", __func__);
-}
-
-/* receive an open file descriptor from fork()'d child over unix socket */
-static int _receive_fd(int socket)
-{
-	struct msghdr msg = {0};
-	struct cmsghdr *cmsg;
-	int fd;
-	msg.msg_iov = NULL;
-	msg.msg_iovlen = 0;
-	char c_buffer[256];
-	msg.msg_control = c_buffer;
-	msg.msg_controllen = sizeof(c_buffer);
-
-	if (recvmsg(socket, &msg, 0) < 0) {
-		error("%s: failed to receive fd: %m", __func__);
-		return -1;
-	}
-
-	cmsg = CMSG_FIRSTHDR(&msg);
-	memmove(&fd, CMSG_DATA(cmsg), sizeof(fd));
-	return fd;
-}
-
 static int _file_bcast_register_file(slurm_msg_t *msg,
 				     file_bcast_info_t *key)
 {
@@ -4136,7 +4460,7 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 			return WEXITSTATUS(rc);
 		}
 
-		fd = _receive_fd(pipe[1]);
+		fd = receive_fd_over_pipe(pipe[1]);
 		close(pipe[1]);
 
 		file_info = xmalloc(sizeof(file_bcast_info_t));
@@ -4211,7 +4535,7 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 		      key->uid, key->fname);
 		exit(errno);
 	}
-	_send_back_fd(pipe[0], fd);
+	send_fd_over_pipe(pipe[0], fd);
 	close(fd);
 	exit(SLURM_SUCCESS);
 }
@@ -51,6 +51,16 @@ void destroy_starting_step(void *x);
 
 void gids_cache_purge(void);
 
+/* Start filling the pool of waiting slurmstepd processes in the background,
+ * up to conf->stepd_pool_size (LaunchParameters=slurmstepd_pool=#) */
+extern void stepd_pool_fill(void);
+
+/* Discard all waiting slurmstepd processes in the pool */
+extern void stepd_pool_purge(void);
+
+/* Log pool use and histograms of slurmstepd launch latency */
+extern void stepd_launch_stats_log(void);
+
 /* Add record for every launched job so we know they are ready for suspend */
 extern void record_launched_jobs(void);
 
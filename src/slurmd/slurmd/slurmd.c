@@ -89,6 +89,7 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_route.h"
 #include "src/common/slurm_topology.h"
+#include "src/common/step_trace.h"
 #include "src/common/stepd_api.h"
 #include "src/common/switch.h"
 #include "src/slurmd/common/task_plugin.h"
@@ -118,6 +119,7 @@
 #define HEALTH_RETRY_DELAY 10
 
 #define MAX_THREADS		256
+#define IDLE_THREAD_TIME	60	/* seconds an idle RPC thread is kept */
 
 #define _free_and_set(__dst, __src) \
 	xfree(__dst); __dst = __src
@@ -133,6 +135,16 @@ static int             active_threads = 0;
 static pthread_mutex_t active_mutex   = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  active_cond    = PTHREAD_COND_INITIALIZER;
 
+/*
+ * RPC threads wait for another connection after servicing one rather than
+ * exiting, so bursts of messages do not create a thread for each one.
+ * Connections are handed to idle threads through conn_list. Protected by
+ * active_mutex.
+ */
+static int             idle_threads   = 0;
+static List            conn_list      = NULL;
+static pthread_cond_t  conn_cond      = PTHREAD_COND_INITIALIZER;
+
 static pthread_mutex_t fork_mutex     = PTHREAD_MUTEX_INITIALIZER;
 
 typedef struct connection {
@@ -191,6 +203,7 @@ static int       _resource_spec_init(void);
 static int       _restore_cred_state(slurm_cred_ctx_t ctx);
 static void      _select_spec_cores(void);
 static void     *_service_connection(void *);
+static void      _service_connection_one(void *);
 static void      _set_msg_aggr_params(void);
 static int       _set_slurmd_spooldir(void);
 static int       _set_topo_info(void);
@@ -369,6 +382,7 @@ main (int argc, char **argv)
 	/* Wait for a successfull health check if HealthCheckInterval != 0 */
 	_wait_health_check();
 
+	stepd_pool_fill();
 	_spawn_registration_engine();
 	msg_aggr_sender_init(conf->hostname, conf->port,
 			     conf->msg_aggr_window_time,
@@ -385,6 +399,8 @@ main (int argc, char **argv)
 		error("Unable to remove pidfile `%s': %m", conf->pidfile);
 
 	_wait_for_all_threads(120);
+	stepd_launch_stats_log();
+	stepd_pool_purge();
 	_slurmd_fini();
 	_destroy_conf();
 	slurm_crypto_fini();	/* must be after _destroy_conf() */
@@ -477,6 +493,11 @@ _msg_engine(void)
 	}
 	verbose("got shutdown request");
 	slurm_shutdown_msg_engine(conf->lfd);
+
+	/* Release idle RPC threads */
+	slurm_mutex_lock(&active_mutex);
+	slurm_cond_broadcast(&conn_cond);
+	slurm_mutex_unlock(&active_mutex);
 	return;
 }
 
@@ -560,6 +581,20 @@ static void _handle_connection(int fd, slurm_addr_t *cli)
 	fd_set_close_on_exec(fd);
 
 	_increment_thd_count();
+
+	/* Hand the connection to an idle thread if there is one free */
+	slurm_mutex_lock(&active_mutex);
+	if (!conn_list)
+		conn_list = list_create(NULL);
+	if (idle_threads > list_count(conn_list)) {
+		list_enqueue(conn_list, arg);
+		slurm_cond_signal(&conn_cond);
+		slurm_mutex_unlock(&active_mutex);
+		slurm_attr_destroy(&attr);
+		return;
+	}
+	slurm_mutex_unlock(&active_mutex);
+
 	while (pthread_create(&id, &attr, &_service_connection, (void *)arg)) {
 		error("msg_engine: pthread_create: %m");
 		if (++retries > 3) {
@@ -567,18 +602,49 @@ static void _handle_connection(int fd, slurm_addr_t *cli)
 			      "a new thread slurmd will be "
 			      "unresponsive until done");
 
-			_service_connection((void *) arg);
+			_service_connection_one((void *) arg);
 			info("slurmd should be responsive now");
 			break;
 		}
 		usleep(10);	/* sleep and again */
 	}
+	slurm_attr_destroy(&attr);
 
 	return;
 }
 
+/*
+ * Service connections until none arrives within IDLE_THREAD_TIME seconds
+ * of the last one
+ */
 static void *
 _service_connection(void *arg)
+{
+	struct timespec ts;
+
+	while (arg) {
+		_service_connection_one(arg);
+		arg = NULL;
+
+		slurm_mutex_lock(&active_mutex);
+		idle_threads++;
+		ts.tv_sec  = time(NULL) + IDLE_THREAD_TIME;
+		ts.tv_nsec = 0;
+		while (!_shutdown && !list_count(conn_list)) {
+			if (pthread_cond_timedwait(&conn_cond, &active_mutex,
+						   &ts) == ETIMEDOUT)
+				break;
+		}
+		arg = list_dequeue(conn_list);
+		idle_threads--;
+		slurm_mutex_unlock(&active_mutex);
+	}
+
+	return NULL;
+}
+
+static void
+_service_connection_one(void *arg)
 {
 	conn_t *con = (conn_t *) arg;
 	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
@@ -608,7 +674,6 @@ cleanup:
 	xfree(con);
 	slurm_free_msg(msg);
 	_decrement_thd_count();
-	return NULL;
 }
 
 extern int
@@ -802,9 +867,9 @@ _massage_pathname(char **path)
 static void
 _read_config(void)
 {
-	char *path_pubkey = NULL;
+	char *path_pubkey = NULL, *tmp_ptr;
 	slurm_ctl_conf_t *cf = NULL;
-	int cc;
+	int cc, i;
 #ifndef HAVE_FRONT_END
 	bool cr_flag = false, gang_flag = false;
 #endif
@@ -1037,6 +1102,17 @@ _read_config(void)
 	conf->use_pam = cf->use_pam;
 	conf->task_plugin_param = cf->task_plugin_param;
 
+	conf->stepd_pool_size = 0;
+	if (cf->launch_params &&
+	    (tmp_ptr = strstr(cf->launch_params, "slurmstepd_pool="))) {
+		i = atoi(tmp_ptr + 16);
+		if ((i < 0) || (i > STEPD_POOL_MAX)) {
+			error("Invalid LaunchParameters slurmstepd_pool=%d, "
+			      "maximum is %d", i, STEPD_POOL_MAX);
+		} else
+			conf->stepd_pool_size = i;
+	}
+
 	conf->mem_limit_enforce = cf->mem_limit_enforce;
 	conf->health_check_interval = cf->health_check_interval;
 
@@ -1063,6 +1139,7 @@ _reconfigure(void)
 	_set_topo_info();
 	route_g_reconfigure();
 	cpu_freq_reconfig();
+	step_trace_reconfig();
 
 	msg_aggr_sender_reconfig(conf->msg_aggr_window_time,
 				 conf->msg_aggr_window_msgs);
@@ -1090,6 +1167,13 @@ _reconfigure(void)
 	 */
 	gids_cache_purge();
 
+	/*
+	 * Replace any waiting slurmstepd so they get the new configuration
+	 */
+	stepd_launch_stats_log();
+	stepd_pool_purge();
+	stepd_pool_fill();
+
 	/* send reconfig to each stepd so they can refresh their log
 	 * file handle
 	 */
@@ -1729,6 +1813,7 @@ _slurmd_fini(void)
 	acct_gather_conf_destroy();
 	fini_system_cgroup();
 	route_fini();
+	step_trace_fini();
 
 	return SLURM_SUCCESS;
 }
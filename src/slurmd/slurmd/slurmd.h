@@ -156,6 +156,8 @@ typedef struct slurmd_config {
 	uint32_t	task_plugin_param; /* TaskPluginParams, expressed
 					 * using cpu_bind_type_t flags */
 	uint16_t	propagate_prio;	/* PropagatePrioProcess flag       */
+	uint16_t	stepd_pool_size; /* slurmstepd processes to start in
+					  * advance, LaunchParameters */
 
 	List		starting_steps; /* steps that are starting but cannot
 					   receive RPCs yet */
@@ -169,6 +171,9 @@ typedef struct slurmd_config {
 					 * on job termination */
 } slurmd_conf_t;
 
+/* Maximum LaunchParameters=slurmstepd_pool value */
+#define STEPD_POOL_MAX 64
+
 extern slurmd_conf_t * conf;
 
 /* Send node registration message with status to controller
@@ -61,6 +61,7 @@
 #include "src/common/cbuf.h"
 #include "src/common/eio.h"
 #include "src/common/fd.h"
+#include "src/common/hostlist.h"
 #include "src/common/io_hdr.h"
 #include "src/common/list.h"
 #include "src/common/log.h"
@@ -73,6 +74,8 @@
 #include "src/common/xstring.h"
 
 #include "src/slurmd/common/fname.h"
+#include "src/slurmd/common/reverse_tree.h"
+#include "src/slurmd/common/reverse_tree_math.h"
 #include "src/slurmd/slurmd/slurmd.h"
 #include "src/slurmd/slurmstepd/io.h"
 #include "src/slurmd/slurmstepd/slurmstepd.h"
@@ -119,6 +122,9 @@ struct client_io_info {
 
 	/* true if writing to a file, false if writing to a socket */
 	bool is_local_file;
+
+	/* true if the I/O of io_children is forwarded to this client */
+	bool upstream;
 };
 
 
@@ -131,6 +137,54 @@ struct io_operations local_file_ops = {
 };
 
 
+/**********************************************************************
+ * I/O tree child connection declarations
+ **********************************************************************/
+static bool _child_readable(eio_obj_t *);
+static bool _child_writable(eio_obj_t *);
+static int  _child_read(eio_obj_t *, List);
+static int  _child_write(eio_obj_t *, List);
+
+struct io_operations child_ops = {
+	.readable = &_child_readable,
+	.writable = &_child_writable,
+	.handle_read = &_child_read,
+	.handle_write = &_child_write,
+};
+
+/* Connection from a slurmstepd on another node which forwards its I/O to
+ * srun through this one (LAUNCH_IO_TREE) */
+struct child_io_info {
+#ifndef NDEBUG
+#define CHILD_IO_MAGIC  0x10104
+	int                   magic;
+#endif
+	stepd_step_rec_t    *job;		 /* pointer back to job data   */
+	uint32_t nodeid;	/* node rank of the child */
+	bool init;		/* true once its io init msg is read */
+	Buf init_msg_buf;	/* io init msg being read */
+	bool down;		/* srun found the child's node down */
+
+	/* frames from the child, forwarded to the upstream client */
+	struct slurm_io_header header;
+	struct io_buf *in_msg;
+	int32_t in_remaining;
+	bool in_eof;
+
+	/* stdin frames for the child */
+	List msg_queue;
+	struct io_buf *out_msg;
+	int32_t out_remaining;
+	bool out_eof;
+};
+
+static pthread_mutex_t io_tree_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  io_tree_cond = PTHREAD_COND_INITIALIZER;
+static int  io_tree_child_cnt = 0;	/* child connections still open */
+static bool io_tree_closed = false;	/* no more child connections taken */
+static int  io_tree_parent_fd = -1;	/* connection to parent slurmstepd */
+static time_t io_tree_kill_time = 0;	/* when the step was terminated */
+
 /**********************************************************************
  * Task write declarations
  **********************************************************************/
@@ -179,6 +233,7 @@ struct task_read_info {
 	cbuf_t           buf;
 	bool		 eof;
 	bool		 eof_msg_sent;
+	bool		 stalled;	/* buf is full */
 };
 
 /**********************************************************************
@@ -204,6 +259,10 @@ static struct io_buf *_task_build_message(struct task_read_info *out,
 					  stepd_step_rec_t *job, cbuf_t cbuf);
 static void *_io_thr(void *arg);
 static void _route_msg_task_to_client(eio_obj_t *obj);
+static void _enqueue_msg_to_clients(struct task_read_info *out,
+				    struct io_buf *msg);
+static void _pack_msg_header(struct task_read_info *out, struct io_buf *msg,
+			     int length);
 static void _free_outgoing_msg(struct io_buf *msg, stepd_step_rec_t *job);
 static void _free_incoming_msg(struct io_buf *msg, stepd_step_rec_t *job);
 static void _free_all_outgoing_msgs(List msg_queue, stepd_step_rec_t *job);
@@ -211,6 +270,12 @@ static bool _incoming_buf_free(stepd_step_rec_t *job);
 static bool _outgoing_buf_free(stepd_step_rec_t *job);
 static int  _send_connection_okay_response(stepd_step_rec_t *job);
 static struct io_buf *_build_connection_okay_message(stepd_step_rec_t *job);
+static void _forward_msg_to_upstream(stepd_step_rec_t *job,
+				     struct io_buf *msg);
+static void _route_msg_to_children(stepd_step_rec_t *job,
+				   struct io_buf *msg);
+static void _io_tree_child_down(stepd_step_rec_t *job, struct io_buf *msg);
+static void _io_tree_upstream_closed(stepd_step_rec_t *job);
 
 /**********************************************************************
  * IO client socket functions
@@ -236,7 +301,10 @@ _client_readable(eio_obj_t *obj)
 
 	if (obj->shutdown) {
 		debug5("  false, shutdown");
-		shutdown(obj->fd, SHUT_RD);
+		/* Data queued after SHUT_RD can't be drained, and would
+		 * reset the connection when closed */
+		if (!client->upstream)
+			shutdown(obj->fd, SHUT_RD);
 		client->in_eof = true;
 		return false;
 	}
@@ -299,6 +367,7 @@ _client_read(eio_obj_t *obj, List objs)
 {
 	struct client_io_info *client = (struct client_io_info *) obj->arg;
 	void *buf;
+	Buf packbuf;
 	int n;
 
 	debug4("Entering _client_read");
@@ -321,6 +390,8 @@ _client_read(eio_obj_t *obj, List objs)
 			client->in_eof = true;
 			list_enqueue(client->job->free_incoming, client->in_msg);
 			client->in_msg = NULL;
+			if (client->upstream)
+				_io_tree_upstream_closed(client->job);
 			return SLURM_SUCCESS;
 		}
 		debug5("client->header.length = %u", client->header.length);
@@ -329,6 +400,14 @@ _client_read(eio_obj_t *obj, List objs)
 			      client->header.length, MAX_MSG_LEN);
 		client->in_remaining = client->header.length;
 		client->in_msg->length = client->header.length;
+
+		/* Keep the packed header ahead of the body, so the message
+		 * can be passed on to I/O tree children as it is */
+		packbuf = create_buf(client->in_msg->data,
+				     io_hdr_packed_size());
+		io_hdr_pack(&client->header, packbuf);
+		packbuf->head = NULL;
+		free_buf(packbuf);
 	}
 
 	/*
@@ -357,7 +436,7 @@ _client_read(eio_obj_t *obj, List objs)
 	} else if (client->header.length == 0) { /* zero length is an eof message */
 		debug5("  got stdin eof message!");
 	} else {
-		buf = client->in_msg->data +
+		buf = client->in_msg->data + io_hdr_packed_size() +
 			(client->in_msg->length - client->in_remaining);
 	again:
 		if ((n = read(obj->fd, buf, client->in_remaining)) < 0) {
@@ -375,6 +454,8 @@ _client_read(eio_obj_t *obj, List objs)
 			client->in_eof = true;
 			list_enqueue(client->job->free_incoming, client->in_msg);
 			client->in_msg = NULL;
+			if (client->upstream)
+				_io_tree_upstream_closed(client->job);
 			return SLURM_SUCCESS;
 		}
 		client->in_remaining -= n;
@@ -387,8 +468,10 @@ _client_read(eio_obj_t *obj, List objs)
 	/*
 	 * Route the message to its destination(s)
 	 */
-	if (client->header.type != SLURM_IO_STDIN
-	    && client->header.type != SLURM_IO_ALLSTDIN) {
+	if (client->header.type == SLURM_IO_FORWARD_DOWN) {
+		_io_tree_child_down(client->job, client->in_msg);
+	} else if ((client->header.type != SLURM_IO_STDIN) &&
+		   (client->header.type != SLURM_IO_ALLSTDIN)) {
 		error("Input client->header.type is not valid!");
 		client->in_msg = NULL;
 		return SLURM_ERROR;
@@ -419,6 +502,14 @@ _client_read(eio_obj_t *obj, List objs)
 				break;
 			}
 		}
+
+		/* Stdin not only for tasks on this node goes down the tree */
+		if ((client->header.type == SLURM_IO_ALLSTDIN) ||
+		    (client->in_msg->ref_count == 0))
+			_route_msg_to_children(client->job, client->in_msg);
+		if (client->in_msg->ref_count == 0)
+			list_enqueue(client->job->free_incoming,
+				     client->in_msg);
 	}
 	client->in_msg = NULL;
 	debug4("Leaving  _client_read");
@@ -471,6 +562,8 @@ again:
 		} else {
 			client->out_eof = true;
 			_free_all_outgoing_msgs(client->msg_queue, client->job);
+			if (client->upstream)
+				_io_tree_upstream_closed(client->job);
 			return SLURM_SUCCESS;
 		}
 	}
@@ -577,6 +670,301 @@ _local_file_write(eio_obj_t *obj, List objs)
 
 
 
+/**********************************************************************
+ * I/O tree child connection functions
+ **********************************************************************/
+static eio_obj_t *
+_create_child_eio(int fd, stepd_step_rec_t *job)
+{
+	struct child_io_info *child;
+
+	child = xmalloc(sizeof(struct child_io_info));
+#ifndef NDEBUG
+	child->magic = CHILD_IO_MAGIC;
+#endif
+	child->job = job;
+	/* Its messages go back to free_incoming, see _child_close() */
+	child->msg_queue = list_create(NULL);
+
+	return eio_obj_create(fd, &child_ops, (void *)child);
+}
+
+/* The child closed its connection, or it failed */
+static int
+_find_obj(void *x, void *key)
+{
+	return (x == key);
+}
+
+static void
+_child_close(eio_obj_t *obj)
+{
+	struct child_io_info *child = (struct child_io_info *) obj->arg;
+	struct io_buf *msg;
+
+	if (child->in_msg) {
+		list_enqueue(child->job->free_outgoing, child->in_msg);
+		child->in_msg = NULL;
+	}
+	if (child->out_msg) {
+		_free_incoming_msg(child->out_msg, child->job);
+		child->out_msg = NULL;
+	}
+	while ((msg = list_dequeue(child->msg_queue)))
+		_free_incoming_msg(msg, child->job);
+	child->in_eof = true;
+	child->out_eof = true;
+	if (child->init) {
+		debug("I/O forwarded from node %u closed", child->nodeid);
+		list_delete_all(child->job->io_children, _find_obj, obj);
+	}
+	if (child->init_msg_buf) {
+		free_buf(child->init_msg_buf);
+		child->init_msg_buf = NULL;
+	}
+	close(obj->fd);
+	obj->fd = -1;
+
+	slurm_mutex_lock(&io_tree_lock);
+	io_tree_child_cnt--;
+	slurm_cond_broadcast(&io_tree_cond);
+	slurm_mutex_unlock(&io_tree_lock);
+}
+
+static bool
+_child_readable(eio_obj_t *obj)
+{
+	struct child_io_info *child = (struct child_io_info *) obj->arg;
+
+	xassert(child->magic == CHILD_IO_MAGIC);
+
+	/* Read until the child closes the connection, even after shutdown,
+	 * the child's tasks may still be running */
+	if (child->in_eof)
+		return false;
+	/* io_tree_wait_children() gave up waiting for the child, or srun
+	 * found its node down */
+	if (io_tree_closed || child->down) {
+		_child_close(obj);
+		return false;
+	}
+	if (child->in_msg != NULL || _outgoing_buf_free(child->job))
+		return true;
+
+	return false;
+}
+
+/*
+ * Read the io init msg of the child, which is sent once the slurmd has
+ * replied to its request, and announce the child's I/O upstream. The
+ * connection is non-blocking, so the msg may take several calls to read.
+ */
+static int
+_child_read_init(eio_obj_t *obj)
+{
+	struct child_io_info *child = (struct child_io_info *) obj->arg;
+	stepd_step_rec_t *job = child->job;
+	struct slurm_io_init_msg init;
+	struct slurm_io_header header;
+	srun_info_t *srun = list_peek(job->sruns);
+	struct io_buf *msg;
+	Buf packbuf;
+	int n;
+
+	if (!child->init_msg_buf)
+		child->init_msg_buf = init_buf(io_init_msg_packed_size());
+	packbuf = child->init_msg_buf;
+again:
+	if ((n = read(obj->fd, get_buf_data(packbuf) + get_buf_offset(packbuf),
+		      remaining_buf(packbuf))) < 0) {
+		if (errno == EINTR)
+			goto again;
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			return SLURM_SUCCESS;
+	}
+	if (n <= 0) {
+		error("I/O forwarding connection closed before its init msg");
+		_child_close(obj);
+		return SLURM_ERROR;
+	}
+	set_buf_offset(packbuf, get_buf_offset(packbuf) + n);
+	if (remaining_buf(packbuf))
+		return SLURM_SUCCESS;
+
+	set_buf_offset(packbuf, 0);
+	if ((io_init_msg_unpack(&init, packbuf) != SLURM_SUCCESS) ||
+	    !srun ||
+	    (io_init_msg_validate(&init, (char *) srun->key->data) < 0) ||
+	    (init.nodeid >= job->nnodes)) {
+		error("Invalid I/O forwarding connection");
+		_child_close(obj);
+		return SLURM_ERROR;
+	}
+	free_buf(child->init_msg_buf);
+	child->init_msg_buf = NULL;
+
+	msg = list_dequeue(job->free_outgoing);
+	header.type = SLURM_IO_FORWARD_INIT;
+	header.gtaskid = 0;  /* Unused */
+	header.ltaskid = 0;  /* Unused */
+	header.length = io_init_msg_packed_size();
+	packbuf = create_buf(msg->data, io_hdr_packed_size() + header.length);
+	io_hdr_pack(&header, packbuf);
+	io_init_msg_pack(&init, packbuf);
+	msg->length = get_buf_offset(packbuf);
+	packbuf->head = NULL;
+	free_buf(packbuf);
+	_forward_msg_to_upstream(job, msg);
+
+	child->nodeid = init.nodeid;
+	child->init = true;
+	list_append(job->io_children, obj);
+	debug("Forwarding I/O of node %u", child->nodeid);
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Read frames of task output from the child and queue them as they are
+ * for the upstream client.
+ */
+static int
+_child_read(eio_obj_t *obj, List objs)
+{
+	struct child_io_info *child = (struct child_io_info *) obj->arg;
+	stepd_step_rec_t *job = child->job;
+	Buf packbuf;
+	void *buf;
+	int n;
+
+	xassert(child->magic == CHILD_IO_MAGIC);
+
+	if (!_outgoing_buf_free(job) && (child->in_msg == NULL))
+		return SLURM_SUCCESS;
+	if (!child->init)
+		return _child_read_init(obj);
+
+	if (child->in_msg == NULL) {
+		child->in_msg = list_dequeue(job->free_outgoing);
+		n = io_hdr_read_fd(obj->fd, &child->header);
+		if (n <= 0) {
+			_child_close(obj);
+			return SLURM_SUCCESS;
+		}
+		if (child->header.length > MAX_MSG_LEN) {
+			error("Message length of %u from node %u exceeds "
+			      "maximum of %u", child->header.length,
+			      child->nodeid, MAX_MSG_LEN);
+			_child_close(obj);
+			return SLURM_ERROR;
+		}
+		packbuf = create_buf(child->in_msg->data,
+				     io_hdr_packed_size());
+		io_hdr_pack(&child->header, packbuf);
+		packbuf->head = NULL;
+		free_buf(packbuf);
+		child->in_msg->length = io_hdr_packed_size() +
+					child->header.length;
+		child->in_remaining = child->header.length;
+	}
+
+	if (child->in_remaining > 0) {
+		buf = child->in_msg->data +
+			(child->in_msg->length - child->in_remaining);
+	again:
+		if ((n = read(obj->fd, buf, child->in_remaining)) < 0) {
+			if (errno == EINTR)
+				goto again;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return SLURM_SUCCESS;
+			debug("error reading I/O of node %u: %m",
+			      child->nodeid);
+		}
+		if (n <= 0) {
+			_child_close(obj);
+			return SLURM_SUCCESS;
+		}
+		child->in_remaining -= n;
+		if (child->in_remaining > 0)
+			return SLURM_SUCCESS;
+	}
+
+	if ((child->header.type == SLURM_IO_STDOUT) ||
+	    (child->header.type == SLURM_IO_STDERR) ||
+	    (child->header.type == SLURM_IO_FORWARD_INIT)) {
+		_forward_msg_to_upstream(job, child->in_msg);
+	} else {
+		error("Invalid I/O message type %u from node %u",
+		      child->header.type, child->nodeid);
+		list_enqueue(job->free_outgoing, child->in_msg);
+	}
+	child->in_msg = NULL;
+
+	return SLURM_SUCCESS;
+}
+
+static bool
+_child_writable(eio_obj_t *obj)
+{
+	struct child_io_info *child = (struct child_io_info *) obj->arg;
+
+	xassert(child->magic == CHILD_IO_MAGIC);
+
+	if (!child->init || child->out_eof)
+		return false;
+	if (child->out_msg != NULL || !list_is_empty(child->msg_queue))
+		return true;
+
+	return false;
+}
+
+/*
+ * Write stdin frames to the child, they hold the packed header
+ * followed by the body.
+ */
+static int
+_child_write(eio_obj_t *obj, List objs)
+{
+	struct child_io_info *child = (struct child_io_info *) obj->arg;
+	void *buf;
+	int len, n;
+
+	xassert(child->magic == CHILD_IO_MAGIC);
+
+	if (child->out_msg == NULL) {
+		child->out_msg = list_dequeue(child->msg_queue);
+		if (child->out_msg == NULL)
+			return SLURM_SUCCESS;
+		child->out_remaining = io_hdr_packed_size() +
+				       child->out_msg->length;
+	}
+
+	len = io_hdr_packed_size() + child->out_msg->length;
+	buf = child->out_msg->data + (len - child->out_remaining);
+again:
+	if ((n = write(obj->fd, buf, child->out_remaining)) < 0) {
+		if (errno == EINTR)
+			goto again;
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			return SLURM_SUCCESS;
+		debug("error writing stdin to node %u: %m", child->nodeid);
+		child->out_eof = true;
+		_free_incoming_msg(child->out_msg, child->job);
+		child->out_msg = NULL;
+		while ((child->out_msg = list_dequeue(child->msg_queue)))
+			_free_incoming_msg(child->out_msg, child->job);
+		return SLURM_SUCCESS;
+	}
+	child->out_remaining -= n;
+	if (child->out_remaining > 0)
+		return SLURM_SUCCESS;
+
+	_free_incoming_msg(child->out_msg, child->job);
+	child->out_msg = NULL;
+
+	return SLURM_SUCCESS;
+}
+
 /**********************************************************************
  * Task write functions
  **********************************************************************/
@@ -666,9 +1054,10 @@ _task_write(eio_obj_t *obj, List objs)
 	}
 
 	/*
-	 * Write message to pipe.
+	 * Write message to pipe, the body follows the packed header.
 	 */
-	buf = in->msg->data + (in->msg->length - in->remaining);
+	buf = in->msg->data + io_hdr_packed_size() +
+		(in->msg->length - in->remaining);
 again:
 	if ((n = write(obj->fd, buf, in->remaining)) < 0) {
 		if (errno == EINTR)
@@ -739,13 +1128,65 @@ _task_readable(eio_obj_t *obj)
 	}
 	if (cbuf_free(out->buf) > 0) {
 		debug5("  cbuf_free = %d", cbuf_free(out->buf));
+		out->stalled = false;
 		return true;
 	}
 
+	/* The task blocks writing output until clients take some */
+	if (!out->stalled) {
+		out->stalled = true;
+		out->job->io_stalls++;
+	}
 	debug5("  false");
 	return false;
 }
 
+/*
+ * Read unbuffered output from a task straight into outgoing messages
+ * rather than copying it through the task's cbuf. Used while the cbuf is
+ * empty and outgoing message buffers are free.
+ */
+static int
+_task_read_direct(eio_obj_t *obj)
+{
+	struct task_read_info *out = (struct task_read_info *)obj->arg;
+	struct io_buf *msg;
+	int i, n = 0;
+
+	/* Read no more per call than fits the cbuf, to be fair to others */
+	for (i = 0; (i < 4) && _outgoing_buf_free(out->job); i++) {
+		msg = list_dequeue(out->job->free_outgoing);
+again:
+		n = read(obj->fd, msg->data + io_hdr_packed_size(),
+			 MAX_MSG_LEN);
+		if ((n < 0) && (errno == EINTR))
+			goto again;
+		if (n <= 0) {
+			list_enqueue(out->job->free_outgoing, msg);
+			if ((n < 0) &&
+			    ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+				debug5("_task_read_direct returned EAGAIN");
+				return SLURM_SUCCESS;
+			}
+			if (n < 0)
+				debug5("  error in _task_read_direct: %m");
+			debug5("  got eof on task");
+			out->eof = true;
+			_send_eof_msg(out);
+			return SLURM_SUCCESS;
+		}
+
+		debug5("%d bytes read from task %s", n,
+		       out->type == SLURM_IO_STDOUT ? "STDOUT" : "STDERR");
+		_pack_msg_header(out, msg, n);
+		_enqueue_msg_to_clients(out, msg);
+		if (n < MAX_MSG_LEN)
+			break;
+	}
+
+	return SLURM_SUCCESS;
+}
+
 /*
  * Read output (stdout or stderr) from a task into a cbuf.  The cbuf
  * allows whole lines to be packed into messages if line buffering
@@ -761,6 +1202,10 @@ _task_read(eio_obj_t *obj, List objs)
 	xassert(out->magic == TASK_OUT_MAGIC);
 
 	debug4("Entering _task_read for obj %zx", (size_t)obj);
+	if (!(out->job->flags & LAUNCH_BUFFERED_IO) && !out->eof &&
+	    (cbuf_used(out->buf) == 0) && _outgoing_buf_free(out->job))
+		return _task_read_direct(obj);
+
 	len = cbuf_free(out->buf);
 	if (len > 0 && !out->eof) {
 again:
@@ -1303,10 +1748,7 @@ static void
 _route_msg_task_to_client(eio_obj_t *obj)
 {
 	struct task_read_info *out = (struct task_read_info *)obj->arg;
-	struct client_io_info *client;
 	struct io_buf *msg = NULL;
-	eio_obj_t *eio;
-	ListIterator clients;
 
 	/* Pack task output into messages for transfer to a client */
 	while (cbuf_used(out->buf) > 0
@@ -1315,39 +1757,150 @@ _route_msg_task_to_client(eio_obj_t *obj)
 		msg = _task_build_message(out, out->job, out->buf);
 		if (msg == NULL)
 			return;
+		_enqueue_msg_to_clients(out, msg);
+	}
+}
 
-		/* Add message to the msg_queue of all clients */
-		clients = list_iterator_create(out->job->clients);
-		while ((eio = list_next(clients))) {
-			client = (struct client_io_info *)eio->arg;
-			if (client->out_eof == true)
-				continue;
+/* Add a message of task output to the msg_queue of all clients */
+static void
+_enqueue_msg_to_clients(struct task_read_info *out, struct io_buf *msg)
+{
+	struct client_io_info *client;
+	eio_obj_t *eio;
+	ListIterator clients;
 
-			/* Some clients only take certain I/O streams */
-			if (out->type==SLURM_IO_STDOUT) {
-				if (client->ltaskid_stdout != -1 &&
-				    client->ltaskid_stdout != out->ltaskid)
-					continue;
-			}
-			if (out->type==SLURM_IO_STDERR) {
-				if (client->ltaskid_stderr != -1 &&
-				    client->ltaskid_stderr != out->ltaskid)
-					continue;
-			}
+	clients = list_iterator_create(out->job->clients);
+	while ((eio = list_next(clients))) {
+		client = (struct client_io_info *)eio->arg;
+		if (client->out_eof == true)
+			continue;
 
-			debug5("======================== Enqueued message");
-			xassert(client->magic == CLIENT_IO_MAGIC);
-			if (list_enqueue(client->msg_queue, msg))
-				msg->ref_count++;
+		/* Some clients only take certain I/O streams */
+		if (out->type==SLURM_IO_STDOUT) {
+			if (client->ltaskid_stdout != -1 &&
+			    client->ltaskid_stdout != out->ltaskid)
+				continue;
 		}
-		list_iterator_destroy(clients);
+		if (out->type==SLURM_IO_STDERR) {
+			if (client->ltaskid_stderr != -1 &&
+			    client->ltaskid_stderr != out->ltaskid)
+				continue;
+		}
+
+		debug5("======================== Enqueued message");
+		xassert(client->magic == CLIENT_IO_MAGIC);
+		if (list_enqueue(client->msg_queue, msg))
+			msg->ref_count++;
+	}
+	list_iterator_destroy(clients);
+	out->job->io_bytes_out += msg->length - io_hdr_packed_size();
+
+	/* Update the outgoing message cache */
+	if (list_enqueue(out->job->outgoing_cache, msg)) {
+		msg->ref_count++;
+		_shrink_msg_cache(out->job->outgoing_cache, out->job);
+	}
+}
+
+/* Queue a message relayed from an I/O tree child for the upstream client */
+static void
+_forward_msg_to_upstream(stepd_step_rec_t *job, struct io_buf *msg)
+{
+	struct client_io_info *client;
+	eio_obj_t *eio;
+	ListIterator clients;
 
-		/* Update the outgoing message cache */
-		if (list_enqueue(out->job->outgoing_cache, msg)) {
+	msg->ref_count = 0;
+	clients = list_iterator_create(job->clients);
+	while ((eio = list_next(clients))) {
+		client = (struct client_io_info *)eio->arg;
+		if (!client->upstream || client->out_eof)
+			continue;
+		xassert(client->magic == CLIENT_IO_MAGIC);
+		if (list_enqueue(client->msg_queue, msg))
 			msg->ref_count++;
-			_shrink_msg_cache(out->job->outgoing_cache, out->job);
+		break;
+	}
+	list_iterator_destroy(clients);
+
+	if (msg->ref_count == 0)	/* upstream is gone */
+		list_enqueue(job->free_outgoing, msg);
+}
+
+/* Queue a stdin message for all I/O tree children */
+static void
+_route_msg_to_children(stepd_step_rec_t *job, struct io_buf *msg)
+{
+	struct child_io_info *child;
+	eio_obj_t *eio;
+	ListIterator children;
+
+	children = list_iterator_create(job->io_children);
+	while ((eio = list_next(children))) {
+		child = (struct child_io_info *)eio->arg;
+		if (child->out_eof)
+			continue;
+		xassert(child->magic == CHILD_IO_MAGIC);
+		if (list_enqueue(child->msg_queue, msg))
+			msg->ref_count++;
+	}
+	list_iterator_destroy(children);
+}
+
+/*
+ * srun found the node of an I/O tree descendant down. Close its connection
+ * if it is one of our children, otherwise pass the message down the tree.
+ */
+static void
+_io_tree_child_down(stepd_step_rec_t *job, struct io_buf *msg)
+{
+	struct child_io_info *child;
+	eio_obj_t *eio;
+	ListIterator children;
+	Buf packbuf;
+	uint32_t nodeid = NO_VAL;
+	bool found = false;
+
+	packbuf = create_buf(msg->data + io_hdr_packed_size(), msg->length);
+	if (unpack32(&nodeid, packbuf) != SLURM_SUCCESS)
+		nodeid = NO_VAL;
+	packbuf->head = NULL;
+	free_buf(packbuf);
+
+	msg->ref_count = 0;
+	children = list_iterator_create(job->io_children);
+	while ((eio = list_next(children))) {
+		child = (struct child_io_info *)eio->arg;
+		xassert(child->magic == CHILD_IO_MAGIC);
+		if (child->nodeid == nodeid) {
+			/* _child_readable() closes it */
+			debug("Node %u is down, closing its I/O", nodeid);
+			child->down = true;
+			found = true;
+			break;
 		}
 	}
+	list_iterator_destroy(children);
+	if (!found && (nodeid != NO_VAL))
+		_route_msg_to_children(job, msg);
+	if (msg->ref_count == 0)
+		list_enqueue(job->free_incoming, msg);
+}
+
+/*
+ * Our connection towards srun is gone, so the I/O of child nodes can no
+ * longer be forwarded. Called by the eio thread.
+ */
+static void
+_io_tree_upstream_closed(stepd_step_rec_t *job)
+{
+	slurm_mutex_lock(&io_tree_lock);
+	if (io_tree_child_cnt && !io_tree_closed)
+		error("I/O connection towards srun lost, closing I/O "
+		      "forwarded from %d node(s)", io_tree_child_cnt);
+	io_tree_closed = true;
+	slurm_cond_broadcast(&io_tree_cond);
+	slurm_mutex_unlock(&io_tree_lock);
 }
 
 static void
@@ -1480,6 +2033,43 @@ io_close_local_fds(stepd_step_rec_t *job)
 
 
 
+/*
+ * In an I/O tree the reader of our output waits for the connection to close
+ * rather than counting eof messages, as they come from several nodes.
+ * Closing with unread stdin would reset the connection and drop output not
+ * yet sent, so close our end first and drain until the reader closes its.
+ */
+static void
+_close_client_sockets(stepd_step_rec_t *job)
+{
+	struct client_io_info *client;
+	eio_obj_t *eio;
+	ListIterator clients;
+	struct pollfd pfd;
+	char buf[1024];
+	int n, timeout = slurm_get_msg_timeout() * 1000;
+
+	clients = list_iterator_create(job->clients);
+	while ((eio = list_next(clients))) {
+		client = (struct client_io_info *)eio->arg;
+		if (client->is_local_file || (eio->fd < 0))
+			continue;
+		if (shutdown(eio->fd, SHUT_WR) == 0) {
+			pfd.fd = eio->fd;
+			pfd.events = POLLIN;
+			while (poll(&pfd, 1, timeout) > 0) {
+				n = read(eio->fd, buf, sizeof(buf));
+				if ((n == 0) || ((n < 0) && (errno != EINTR) &&
+						 (errno != EAGAIN)))
+					break;
+			}
+		}
+		close(eio->fd);
+		eio->fd = -1;
+	}
+	list_iterator_destroy(clients);
+}
+
 static void *
 _io_thr(void *arg)
 {
@@ -1499,6 +2089,11 @@ _io_thr(void *arg)
 	debug("IO handler started pid=%lu", (unsigned long) getpid());
 	rc = eio_handle_mainloop(job->eio);
 	debug("IO handler exited, rc=%d", rc);
+	if (job->flags & LAUNCH_IO_TREE)
+		_close_client_sockets(job);
+	debug("%u.%u: forwarded %"PRIu64" bytes of task output, "
+	      "output buffers filled %u times",
+	      job->jobid, job->stepid, job->io_bytes_out, job->io_stalls);
 	return (void *)1;
 }
 
@@ -1582,7 +2177,11 @@ io_initial_client_connect(srun_info_t *srun, stepd_step_rec_t *job,
 		debug4("connecting IO back to %s:%d", ip, ntohs(port));
 	}
 
-	if ((sock = (int) slurm_open_stream(&srun->ioaddr, true)) < 0) {
+	if (io_tree_parent_fd >= 0) {
+		/* Our I/O goes to srun through the parent slurmstepd */
+		sock = io_tree_parent_fd;
+		io_tree_parent_fd = -1;
+	} else if ((sock = (int) slurm_open_stream(&srun->ioaddr, true)) < 0) {
 		error("connect io: %m");
 		/* XXX retry or silently fail?
 		 *     fail for now.
@@ -1611,6 +2210,7 @@ io_initial_client_connect(srun_info_t *srun, stepd_step_rec_t *job,
 	client->labelio = false;
 	client->label_width = 0;
 	client->is_local_file = false;
+	client->upstream = (job->flags & LAUNCH_IO_TREE) ? true : false;
 
 	obj = eio_obj_create(sock, &client_ops, (void *)client);
 	list_append(job->clients, (void *)obj);
@@ -1620,6 +2220,189 @@ io_initial_client_connect(srun_info_t *srun, stepd_step_rec_t *job,
 	return SLURM_SUCCESS;
 }
 
+/* Ask the slurmd of the parent node to pass our connection to its
+ * slurmstepd. Return the connection or -1 to connect to srun directly */
+static int
+_io_tree_parent_request(slurm_addr_t *addr, stepd_step_rec_t *job,
+			bool *retry)
+{
+	job_step_id_msg_t req;
+	slurm_msg_t msg, resp_msg;
+	int fd, rc;
+
+	*retry = true;
+	if ((fd = slurm_open_msg_conn(addr)) < 0)
+		return -1;
+
+	memset(&req, 0, sizeof(job_step_id_msg_t));
+	req.job_id = job->jobid;
+	req.step_id = job->stepid;
+	slurm_msg_t_init(&msg);
+	msg.msg_type = REQUEST_STEP_IO_FORWARD;
+	msg.data = &req;
+	if (slurm_send_node_msg(fd, &msg) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	slurm_msg_t_init(&resp_msg);
+	if (slurm_receive_msg(fd, &resp_msg, 0) != 0)
+		rc = SLURM_ERROR;
+	else if (resp_msg.msg_type != RESPONSE_SLURM_RC)
+		rc = SLURM_UNEXPECTED_MSG_ERROR;
+	else
+		rc = slurm_get_return_code(resp_msg.msg_type, resp_msg.data);
+	slurm_free_msg_members(&resp_msg);
+
+	if (rc != SLURM_SUCCESS) {
+		/* Only retry while the parent slurmstepd may be starting */
+		if (rc != ESLURM_INVALID_JOB_ID)
+			*retry = false;
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Connect to the slurmstepd that forwards our I/O to srun, when the step
+ * uses an I/O tree. srun is the root of the tree, so a slurmstepd's rank
+ * in it is its node rank plus one. Must be called as root, the parent's
+ * slurmd only passes connections from root or SlurmUser on.
+ */
+void
+io_tree_parent_connect(stepd_step_rec_t *job)
+{
+#ifndef HAVE_FRONT_END
+	int parent = -1, children, depth, max_depth;
+	int width = slurm_get_io_tree_width(), i;
+	hostlist_t hl = NULL;
+	char *parent_name = NULL;
+	slurm_addr_t parent_addr;
+	bool retry = true;
+
+	if (!width || !job->msg || !job->msg->complete_nodelist ||
+	    job->msg->alias_list)
+		return;
+
+	reverse_tree_info(job->nodeid + 1, job->nnodes + 1, width,
+			  &parent, &children, &depth, &max_depth);
+	if (--parent < 0)	/* our parent is srun */
+		return;
+	if ((hl = hostlist_create(job->msg->complete_nodelist)))
+		parent_name = hostlist_nth(hl, parent);
+	hostlist_destroy(hl);
+	if (!parent_name ||
+	    (slurm_conf_get_addr(parent_name, &parent_addr) != SLURM_SUCCESS)) {
+		error("%s: no address for I/O tree parent %s", __func__,
+		      parent_name ? parent_name : "NONE");
+		free(parent_name);
+		return;
+	}
+
+	/* The parent slurmstepd may not have started yet, because of the
+	 * way that the launch message forwarding works */
+	for (i = 0; retry && (i < REVERSE_TREE_PARENT_RETRY); i++) {
+		if (i)
+			sleep(1);
+		io_tree_parent_fd = _io_tree_parent_request(&parent_addr, job,
+							    &retry);
+		if (io_tree_parent_fd >= 0) {
+			debug("Forwarding I/O through %s", parent_name);
+			net_set_keep_alive(io_tree_parent_fd);
+			break;
+		}
+	}
+	if (io_tree_parent_fd < 0)
+		verbose("Unable to forward I/O through %s, connecting to "
+			"srun directly", parent_name);
+	free(parent_name);
+#endif
+}
+
+/*
+ * Take the connection of a slurmstepd forwarding its I/O to srun through
+ * this one. Called by the message thread.
+ */
+int
+io_tree_add_child(stepd_step_rec_t *job, int fd)
+{
+	int rc = SLURM_SUCCESS;
+
+	slurm_mutex_lock(&io_tree_lock);
+	if (io_tree_closed) {
+		/* Our I/O is shutting down, the child connects to srun */
+		rc = ESLURMD_IO_ERROR;
+	} else {
+		io_tree_child_cnt++;
+		net_set_keep_alive(fd);
+		fd_set_nonblocking(fd);
+		eio_new_obj(job->eio, _create_child_eio(fd, job));
+	}
+	slurm_mutex_unlock(&io_tree_lock);
+
+	return rc;
+}
+
+/*
+ * The step is being terminated. Its slurmstepds on the child nodes are
+ * terminated too, give them KillWait plus MessageTimeout to close their
+ * connections. Called by the message thread.
+ */
+void
+io_tree_terminate(stepd_step_rec_t *job)
+{
+	slurm_mutex_lock(&io_tree_lock);
+	if (!io_tree_kill_time)
+		io_tree_kill_time = time(NULL);
+	slurm_cond_broadcast(&io_tree_cond);
+	slurm_mutex_unlock(&io_tree_lock);
+}
+
+/*
+ * Wait for the slurmstepds forwarding I/O through this one to close their
+ * connections, then refuse new ones. They close them once their own tasks
+ * have exited and their I/O is done, which may be long after our tasks.
+ * A child whose node failed is closed when srun reports the node down,
+ * when the step is terminated or when our own connection towards srun is
+ * lost.
+ */
+void
+io_tree_wait_children(stepd_step_rec_t *job)
+{
+	int wait_secs = slurm_get_kill_wait() + slurm_get_msg_timeout();
+	struct timespec ts = {0, 0};
+
+	slurm_mutex_lock(&io_tree_lock);
+	if (io_tree_child_cnt)
+		debug("Waiting for I/O forwarded from %d node(s)",
+		      io_tree_child_cnt);
+	while (io_tree_child_cnt && !io_tree_closed) {
+		if (!io_tree_kill_time) {
+			slurm_cond_wait(&io_tree_cond, &io_tree_lock);
+			continue;
+		}
+		ts.tv_sec = io_tree_kill_time + wait_secs;
+		if (time(NULL) >= ts.tv_sec) {
+			error("I/O forwarded from %d node(s) still open %d "
+			      "seconds after the step was terminated, "
+			      "closing it", io_tree_child_cnt, wait_secs);
+			break;
+		}
+		slurm_cond_timedwait(&io_tree_cond, &io_tree_lock, &ts);
+	}
+	io_tree_closed = true;
+	if (io_tree_child_cnt) {
+		/* The eio thread closes them, see _child_readable() */
+		eio_signal_wakeup(job->eio);
+		ts.tv_sec = time(NULL) + slurm_get_msg_timeout();
+		while (io_tree_child_cnt && (time(NULL) < ts.tv_sec))
+			slurm_cond_timedwait(&io_tree_cond, &io_tree_lock,
+					     &ts);
+	}
+	slurm_mutex_unlock(&io_tree_lock);
+}
+
 /*
  * Initiate a TCP connection back to a waiting client (e.g. srun).
  *
@@ -1806,10 +2589,8 @@ _task_build_message(struct task_read_info *out, stepd_step_rec_t *job, cbuf_t cb
 {
 	struct io_buf *msg;
 	char *ptr;
-	Buf packbuf;
 	bool must_truncate = false;
 	int avail;
-	struct slurm_io_header header;
 	int n;
 	bool buffered_stdio = job->flags & LAUNCH_BUFFERED_IO;
 
@@ -1853,16 +2634,29 @@ _task_build_message(struct task_read_info *out, stepd_step_rec_t *job, cbuf_t cb
 		}
 	}
 
+	_pack_msg_header(out, msg, n);
+
+	debug4("%s: Leaving", __func__);
+	return msg;
+}
+
+/* Pack the header of a message holding length bytes of task output */
+static void
+_pack_msg_header(struct task_read_info *out, struct io_buf *msg, int length)
+{
+	struct slurm_io_header header;
+	Buf packbuf;
+
 	header.type = out->type;
 	header.ltaskid = out->ltaskid;
 	header.gtaskid = out->gtaskid;
-	header.length = n;
+	header.length = length;
 
-	debug4("%s: header.length = %d", __func__, n);
+	debug4("%s: header.length = %d", __func__, length);
 	packbuf = create_buf(msg->data, io_hdr_packed_size());
 	if (!packbuf) {
 		fatal("Failure to allocate memory for a message header");
-		return msg;	/* Fix for CLANG false positive error */
+		return;	/* Fix for CLANG false positive error */
 	}
 	io_hdr_pack(&header, packbuf);
 	msg->length = io_hdr_packed_size() + header.length;
@@ -1871,9 +2665,6 @@ _task_build_message(struct task_read_info *out, stepd_step_rec_t *job, cbuf_t cb
 	/* free the Buf packbuf, but not the memory to which it points */
 	packbuf->head = NULL;	/* CLANG false positive bug here */
 	free_buf(packbuf);
-
-	debug4("%s: Leaving", __func__);
-	return msg;
 }
 
 struct io_buf *
@@ -1927,6 +2718,33 @@ _incoming_buf_free(stepd_step_rec_t *job)
 	return false;
 }
 
+/* Return the most outgoing message buffers to allocate */
+static int
+_max_outgoing_bufs(void)
+{
+	static int max_bufs = 0;
+	char *launch_params, *tmp_ptr;
+	long val;
+
+	if (max_bufs)
+		return max_bufs;
+
+	max_bufs = STDIO_MAX_FREE_BUF;
+	launch_params = slurm_get_launch_params();
+	if (launch_params &&
+	    (tmp_ptr = strstr(launch_params, "slurmstepd_io_bufs="))) {
+		val = strtol(tmp_ptr + 19, NULL, 10);
+		if ((val > STDIO_MAX_MSG_CACHE) && (val <= 1024 * 1024))
+			max_bufs = val;
+		else
+			error("Invalid LaunchParameters slurmstepd_io_bufs "
+			      "value: %ld", val);
+	}
+	xfree(launch_params);
+
+	return max_bufs;
+}
+
 static bool
 _outgoing_buf_free(stepd_step_rec_t *job)
 {
@@ -1934,7 +2752,7 @@ _outgoing_buf_free(stepd_step_rec_t *job)
 
 	if (list_count(job->free_outgoing) > 0) {
 		return true;
-	} else if (job->outgoing_count < STDIO_MAX_FREE_BUF) {
+	} else if (job->outgoing_count < _max_outgoing_bufs()) {
 		buf = alloc_io_buf();
 		if (buf != NULL) {
 			list_enqueue(job->free_outgoing, buf);
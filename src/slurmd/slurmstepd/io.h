@@ -45,7 +45,8 @@
 
 /*
  * The message cache uses up free message buffers, so STDIO_MAX_MSG_CACHE
- * must be a number smaller than STDIO_MAX_FREE_BUF.
+ * must be a number smaller than STDIO_MAX_FREE_BUF. The number of outgoing
+ * buffers can be raised with LaunchParameters=slurmstepd_io_bufs=<count>.
  */
 #define STDIO_MAX_FREE_BUF 1024
 #define STDIO_MAX_MSG_CACHE 128
@@ -86,6 +87,32 @@ void free_io_buf(struct io_buf *buf);
 int io_initial_client_connect(srun_info_t *srun, stepd_step_rec_t *job,
 			      int stdout_tasks, int stderr_tasks);
 
+/*
+ * With LAUNCH_IO_TREE, connect to the slurmstepd of our parent node in the
+ * I/O tree, which forwards our I/O to srun. io_initial_client_connect then
+ * uses that connection. Must be called as root.
+ */
+void io_tree_parent_connect(stepd_step_rec_t *job);
+
+/*
+ * Take the connection of a slurmstepd on a child node in the I/O tree and
+ * relay its messages to and from srun.
+ */
+int io_tree_add_child(stepd_step_rec_t *job, int fd);
+
+/*
+ * Note that the step is being terminated, so that io_tree_wait_children()
+ * stops waiting for child nodes KillWait plus MessageTimeout later.
+ */
+void io_tree_terminate(stepd_step_rec_t *job);
+
+/*
+ * Wait for all child node connections in the I/O tree to close, and refuse
+ * any later ones. Connections of failed nodes are closed once srun reports
+ * them down, the step is terminated or the connection to srun is lost.
+ */
+void io_tree_wait_children(stepd_step_rec_t *job);
+
 /*
  * Initiate a TCP connection back to a waiting client (e.g. srun).
  *
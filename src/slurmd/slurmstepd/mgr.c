@@ -85,6 +85,7 @@
 #include "src/common/slurm_cred.h"
 #include "src/common/slurm_jobacct_gather.h"
 #include "src/common/slurm_mpi.h"
+#include "src/common/step_trace.h"
 #include "src/common/switch.h"
 #include "src/common/util-net.h"
 #include "src/common/xmalloc.h"
@@ -509,6 +510,13 @@ _setup_normal_io(stepd_step_rec_t *job)
 
 	debug2("Entering _setup_normal_io");
 
+	/*
+	 * The parent's slurmd only passes on I/O tree connections made
+	 * by root, so connect before dropping privileges.
+	 */
+	if (job->flags & LAUNCH_IO_TREE)
+		io_tree_parent_connect(job);
+
 	/*
 	 * Temporarily drop permissions, initialize task stdio file
 	 * descriptors (which may be connected to files), then
@@ -1109,21 +1117,15 @@ fail1:
  * Returns 0 if job ran and completed successfully.
  * Returns errno if job startup failed. NOTE: This will DRAIN the node.
  */
-int
-job_manager(stepd_step_rec_t *job)
+/*
+ * Load the plugins used by every job step. Plugins already loaded are
+ * skipped, so this is called again by job_manager().
+ */
+extern int
+mgr_plugins_init(void)
 {
-	int  rc = SLURM_SUCCESS;
-	bool io_initialized = false;
 	char *ckpt_type = slurm_get_checkpoint_type();
-	char *err_msg = NULL;
-
-	debug3("Entered job_manager for %u.%u pid=%d",
-	       job->jobid, job->stepid, job->jmgr_pid);
-
-#ifdef PR_SET_DUMPABLE
-	if (prctl(PR_SET_DUMPABLE, 1) < 0)
-		debug ("Unable to set dumpable to 1");
-#endif /* PR_SET_DUMPABLE */
+	int rc = SLURM_SUCCESS;
 
 	/* run now so we don't drop permissions on any of the gather plugins */
 	acct_gather_conf_init();
@@ -1141,10 +1143,32 @@ job_manager(stepd_step_rec_t *job)
 	    (acct_gather_profile_init() != SLURM_SUCCESS)	||
 	    (slurm_crypto_init() != SLURM_SUCCESS)		||
 	    (job_container_init() != SLURM_SUCCESS)		||
-	    (gres_plugin_init() != SLURM_SUCCESS)) {
+	    (gres_plugin_init() != SLURM_SUCCESS))
 		rc = SLURM_PLUGIN_NAME_INVALID;
+
+	xfree(ckpt_type);
+	return rc;
+}
+
+int
+job_manager(stepd_step_rec_t *job)
+{
+	int  rc = SLURM_SUCCESS;
+	bool io_initialized = false;
+	char *err_msg = NULL;
+	struct timeval start_tv, fork_tv;
+
+	gettimeofday(&start_tv, NULL);
+	debug3("Entered job_manager for %u.%u pid=%d",
+	       job->jobid, job->stepid, job->jmgr_pid);
+
+#ifdef PR_SET_DUMPABLE
+	if (prctl(PR_SET_DUMPABLE, 1) < 0)
+		debug ("Unable to set dumpable to 1");
+#endif /* PR_SET_DUMPABLE */
+
+	if ((rc = mgr_plugins_init()) != SLURM_SUCCESS)
 		goto fail1;
-	}
 	if (mpi_hook_slurmstepd_init(&job->env) != SLURM_SUCCESS) {
 		rc = SLURM_MPI_PLUGIN_NAME_INVALID;
 		goto fail1;
@@ -1264,6 +1288,7 @@ job_manager(stepd_step_rec_t *job)
 	/* Calls pam_setup() and requires pam_finish() if
 	 * successful.  Only check for < 0 here since other slurm
 	 * error codes could come that are more descriptive. */
+	gettimeofday(&fork_tv, NULL);
 	if ((rc = _fork_all_tasks(job, &io_initialized)) < 0) {
 		debug("_fork_all_tasks failed");
 		rc = ESLURMD_EXECVE_FAILED;
@@ -1296,6 +1321,13 @@ job_manager(stepd_step_rec_t *job)
 	/* Send job launch response with list of pids */
 	_send_launch_resp(job, 0);
 	_set_job_state(job, SLURMSTEPD_STEP_RUNNING);
+	if (step_trace_enabled()) {
+		step_trace_span(job->jobid, job->stepid, "stepd_setup",
+				&start_tv, &fork_tv);
+		step_trace_span(job->jobid, job->stepid, "stepd_fork_tasks",
+				&fork_tv, NULL);
+		step_trace_dump(job->jobid, job->stepid);
+	}
 
 #ifdef PR_SET_DUMPABLE
 	/* RHEL6 requires setting "dumpable" flag AGAIN; after euid changes */
@@ -1398,7 +1430,6 @@ fail1:
 	if (!job->batch && core_spec_g_clear(job->cont_id))
 		error("core_spec_g_clear: %m");
 
-	xfree(ckpt_type);
 	return(rc);
 }
 
@@ -2154,6 +2185,8 @@ static void
 _wait_for_io(stepd_step_rec_t *job)
 {
 	debug("Waiting for IO");
+	if (job->flags & LAUNCH_IO_TREE)
+		io_tree_wait_children(job);
 	io_close_all(job);
 
 	/*
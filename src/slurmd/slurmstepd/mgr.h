@@ -68,6 +68,12 @@ stepd_step_rec_t *mgr_launch_batch_job_setup(batch_job_launch_msg_t *msg,
  */
 void mgr_launch_batch_job_cleanup(stepd_step_rec_t *job, int rc);
 
+/*
+ * Load the plugins used by every job step.
+ * Returns SLURM_PLUGIN_NAME_INVALID if one could not be loaded.
+ */
+extern int mgr_plugins_init(void);
+
 /*
  * Executes the functions of the slurmd job manager process,
  * which runs as root and performs shared memory and interconnect
@@ -85,6 +85,7 @@ static int _handle_signal_task_local(int fd, stepd_step_rec_t *job, uid_t uid);
 static int _handle_signal_container(int fd, stepd_step_rec_t *job, uid_t uid);
 static int _handle_checkpoint_tasks(int fd, stepd_step_rec_t *job, uid_t uid);
 static int _handle_attach(int fd, stepd_step_rec_t *job, uid_t uid);
+static int _handle_io_forward(int fd, stepd_step_rec_t *job, uid_t uid);
 static int _handle_pid_in_container(int fd, stepd_step_rec_t *job);
 static void *_wait_extern_pid(void *args);
 static int _handle_add_extern_pid_internal(stepd_step_rec_t *job, pid_t pid);
@@ -586,6 +587,10 @@ _handle_request(int fd, stepd_step_rec_t *job, uid_t uid, gid_t gid)
 		debug("Handling REQUEST_ADD_EXTERN_PID");
 		rc = _handle_add_extern_pid(fd, job);
 		break;
+	case REQUEST_IO_FORWARD:
+		debug("Handling REQUEST_IO_FORWARD");
+		rc = _handle_io_forward(fd, job, uid);
+		break;
 	default:
 		error("Unrecognized request: %d", req);
 		rc = SLURM_FAILURE;
@@ -891,6 +896,9 @@ _handle_signal_container(int fd, stepd_step_rec_t *job, uid_t uid)
 		goto done;
 	}
 
+	if ((sig == SIGKILL) && (job->flags & LAUNCH_IO_TREE))
+		io_tree_terminate(job);
+
 	/*
 	 * Signal the container
 	 */
@@ -1087,6 +1095,9 @@ _handle_terminate(int fd, stepd_step_rec_t *job, uid_t uid)
 		task->killed_by_cmd = true;
 	}
 
+	if (job->flags & LAUNCH_IO_TREE)
+		io_tree_terminate(job);
+
 	/*
 	 * Signal the container with SIGKILL
 	 */
@@ -1220,6 +1231,39 @@ rwfail:
 	return SLURM_FAILURE;
 }
 
+static int
+_handle_io_forward(int fd, stepd_step_rec_t *job, uid_t uid)
+{
+	int rc = SLURM_SUCCESS;
+	int io_fd;
+
+	debug("_handle_io_forward for job %u.%u", job->jobid, job->stepid);
+
+	if ((io_fd = receive_fd_over_pipe(fd)) < 0)
+		goto rwfail;
+	fd_set_close_on_exec(io_fd);
+
+	/* Only the slurmd passes connections of other slurmstepds here */
+	if (!_slurm_authorized_user(uid)) {
+		error("uid %ld attempt to forward I/O to job %u.%u owned by %ld",
+		      (long) uid, job->jobid, job->stepid, (long)job->uid);
+		rc = EPERM;
+	} else if (!(job->flags & LAUNCH_IO_TREE)) {
+		rc = ESLURMD_IO_ERROR;
+	} else {
+		rc = io_tree_add_child(job, io_fd);
+	}
+	if (rc != SLURM_SUCCESS)
+		close(io_fd);
+
+	/* Send the return code */
+	safe_write(fd, &rc, sizeof(int));
+	return SLURM_SUCCESS;
+
+rwfail:
+	return SLURM_FAILURE;
+}
+
 static int
 _handle_pid_in_container(int fd, stepd_step_rec_t *job)
 {
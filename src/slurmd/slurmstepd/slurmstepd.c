@@ -40,6 +40,7 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <sys/mman.h>
@@ -55,6 +56,7 @@
 #include "src/common/slurm_mpi.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_rlimits_info.h"
+#include "src/common/step_trace.h"
 #include "src/common/stepd_api.h"
 #include "src/common/switch.h"
 #include "src/common/xmalloc.h"
@@ -71,6 +73,7 @@
 #include "src/slurmd/slurmstepd/slurmstepd.h"
 #include "src/slurmd/slurmstepd/slurmstepd_job.h"
 
+static void _init_node_from_slurmd(int sock, char **argv);
 static int _init_from_slurmd(int sock, char **argv, slurm_addr_t **_cli,
 			     slurm_addr_t **_self, slurm_msg_t **_msg,
 			     int *_ngids, gid_t **_gids);
@@ -119,6 +122,14 @@ main (int argc, char **argv)
 	if (slurm_auth_init(NULL) != SLURM_SUCCESS)
 		fatal( "failed to initialize authentication plugin" );
 
+	/* Receive the slurmd's configuration and set up everything which
+	 * does not depend on the job step. A slurmstepd started in advance
+	 * (LaunchParameters=slurmstepd_pool) does this before it waits for
+	 * a job step, so that only the rest remains to do at launch. */
+	_init_node_from_slurmd(STDIN_FILENO, argv);
+	if (mgr_plugins_init() != SLURM_SUCCESS)
+		error("%s: failed to load plugins", __func__);
+
 	/* Receive job parameters from the slurmd */
 	_init_from_slurmd(STDIN_FILENO, argv, &cli, &self, &msg,
 			  &ngids, &gids);
@@ -427,6 +438,40 @@ rwfail:
 #endif
 }
 
+/*
+ *  This function handles the initialization information from slurmd
+ *  sent by _send_slurmstepd_node_init() in src/slurmd/slurmd/req.c,
+ *  which does not depend on the job step, and sets up logging, the
+ *  switch, GRES and cpu frequency information with it.
+ */
+static void
+_init_node_from_slurmd(int sock, char **argv)
+{
+	log_options_t lopts = LOG_OPTS_INITIALIZER;
+
+	log_init(argv[0], lopts, LOG_DAEMON, NULL);
+
+	/* receive conf from slurmd */
+	if ((conf = read_slurmd_conf_lite (sock)) == NULL)
+		fatal("Failed to read conf from slurmd");
+
+	log_alter(conf->log_opts, 0, conf->logfile);
+	log_set_timefmt(conf->log_fmt);
+
+	debug2("debug level is %d.", conf->debug_level);
+
+	switch_g_slurmd_step_init();
+
+	/* Receive GRES information from slurmd */
+	gres_plugin_recv_stepd(sock);
+
+	/* Grab the slurmd's spooldir. Has %n expanded. */
+	cpu_freq_init(conf);
+
+	/* Receive cpu_frequency info from slurmd */
+	cpu_freq_recv_info(sock);
+}
+
 /*
  *  This function handles the initialization information from slurmd
  *  sent by _send_slurmstepd_init() in src/slurmd/slurmd/req.c.
@@ -447,12 +492,18 @@ _init_from_slurmd(int sock, char **argv,
 	gid_t *gids = NULL;
 	uint16_t port;
 	char buf[16];
-	log_options_t lopts = LOG_OPTS_INITIALIZER;
 
-	log_init(argv[0], lopts, LOG_DAEMON, NULL);
-
-	/* receive job type from slurmd */
-	safe_read(sock, &step_type, sizeof(int));
+	/* receive job type from slurmd. A slurmstepd started in advance
+	 * (LaunchParameters=slurmstepd_pool) waits here and sees EOF if
+	 * slurmd discards it, so exit quietly in that case. */
+	while ((len = read(sock, &step_type, sizeof(int))) < 0) {
+		if ((errno != EINTR) && (errno != EAGAIN))
+			goto rwfail;
+	}
+	if (len == 0)
+		exit(0);
+	if (len != sizeof(int))
+		goto rwfail;
 	debug3("step_type = %d", step_type);
 
 	/* receive reverse-tree info from slurmd */
@@ -467,17 +518,6 @@ _init_from_slurmd(int sock, char **argv,
 	step_complete.jobacct = jobacctinfo_create(NULL);
 	slurm_mutex_unlock(&step_complete.lock);
 
-	/* receive conf from slurmd */
-	if ((conf = read_slurmd_conf_lite (sock)) == NULL)
-		fatal("Failed to read conf from slurmd");
-
-	log_alter(conf->log_opts, 0, conf->logfile);
-	log_set_timefmt(conf->log_fmt);
-
-	debug2("debug level is %d.", conf->debug_level);
-
-	switch_g_slurmd_step_init();
-
 	slurm_get_ip_str(&step_complete.parent_addr, &port, buf, 16);
 	debug3("slurmstepd rank %d, parent address = %s, port = %u",
 	       step_complete.rank, buf, port);
@@ -508,15 +548,6 @@ _init_from_slurmd(int sock, char **argv,
 		free_buf(buffer);
 	}
 
-	/* Receive GRES information from slurmd */
-	gres_plugin_recv_stepd(sock);
-
-	/* Grab the slurmd's spooldir. Has %n expanded. */
-	cpu_freq_init(conf);
-
-	/* Receive cpu_frequency info from slurmd */
-	cpu_freq_recv_info(sock);
-
 	/* get the protocol version of the srun */
 	safe_read(sock, &proto, sizeof(int));
 
@@ -654,6 +685,7 @@ _step_cleanup(stepd_step_rec_t *job, slurm_msg_t *msg, int rc)
 		xfree(msg);
 	}
 	jobacctinfo_destroy(step_complete.jobacct);
+	step_trace_fini();
 }
 #endif
 
@@ -319,6 +319,7 @@ stepd_step_rec_create(launch_tasks_request_msg_t *msg, uint16_t protocol_version
 	job->free_outgoing = list_create(NULL); /* FIXME! Needs destructor */
 	job->outgoing_count = 0;
 	job->outgoing_cache = list_create(NULL); /* FIXME! Needs destructor */
+	job->io_children = list_create(NULL);
 
 	job->envtp   = xmalloc(sizeof(env_t));
 	job->envtp->jobid = -1;
@@ -578,6 +579,7 @@ stepd_step_rec_destroy(stepd_step_rec_t *job)
 	FREE_NULL_LIST(job->free_incoming);
 	FREE_NULL_LIST(job->free_outgoing);
 	FREE_NULL_LIST(job->outgoing_cache);
+	FREE_NULL_LIST(job->io_children);
 	xfree(job->envtp);
 	xfree(job->node_name);
 	mpmd_free(job);
@@ -194,6 +194,12 @@ typedef struct {
 	List outgoing_cache;  /* cache of outgoing stdio messages
 			       * used when a new client attaches
 			       */
+	List io_children;     /* eio objs of slurmstepds on other nodes
+			       * forwarding their I/O through this one
+			       * (LAUNCH_IO_TREE)
+			       */
+	uint64_t io_bytes_out; /* bytes of task output forwarded       */
+	uint32_t io_stalls;   /* times task output filled its buffer  */
 
 	pthread_t      ioid;  /* pthread id of IO thread                    */
 	pthread_t      msgid; /* pthread id of message thread               */
@@ -120,6 +120,9 @@ static int   _get_events(slurmdbd_conn_t *slurmdbd_conn,
 static int   _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
 			    persist_msg_t *msg, Buf *out_buffer,
 			    uint32_t *uid);
+static int   _get_jobs_stream(slurmdbd_conn_t *slurmdbd_conn,
+			      persist_msg_t *msg, Buf *out_buffer,
+			      uint32_t *uid);
 static int   _get_probs(slurmdbd_conn_t *slurmdbd_conn,
 			persist_msg_t *msg, Buf *out_buffer, uint32_t *uid);
 static int   _get_qos(slurmdbd_conn_t *slurmdbd_conn,
@@ -350,6 +353,10 @@ proc_req(void *conn, persist_msg_t *msg,
 		rc = _get_jobs_cond(slurmdbd_conn,
 				    msg, out_buffer, uid);
 		break;
+	case DBD_GET_JOBS_STREAM:
+		rc = _get_jobs_stream(slurmdbd_conn,
+				      msg, out_buffer, uid);
+		break;
 	case DBD_GET_PROBS:
 		rc = _get_probs(slurmdbd_conn,
 				msg, out_buffer, uid);
@@ -544,13 +551,24 @@ proc_req(void *conn, persist_msg_t *msg,
 		      slurmdbd_conn->conn->fd,
 		      slurmdbd_msg_type_2_str(msg->msg_type, 1));
 	else if (slurmdbd_conn->conn->rem_port
-		 && !slurmdbd_conf->commit_delay) {
+		 && !slurmdbd_conf->commit_delay
+		 && !slurmdbd_conn->in_mult) {
 		/* If we are dealing with the slurmctld do the
 		   commit (SUCCESS or NOT) afterwards since we
 		   do transactions for performance reasons.
 		   (don't ever use autocommit with innodb)
 		*/
-		acct_storage_g_commit(slurmdbd_conn->db_conn, 1);
+		if (acct_storage_g_commit(slurmdbd_conn->db_conn, 1) &&
+		    (rc == SLURM_SUCCESS)) {
+			/* Nothing was written, don't let the sender
+			 * think otherwise */
+			comment = "Commit failed";
+			rc = SLURM_ERROR;
+			free_buf(*out_buffer);
+			*out_buffer = slurm_persist_make_rc_msg(
+				slurmdbd_conn->conn, rc, comment,
+				msg->msg_type);
+		}
 	}
 
 	END_TIMER;
@@ -1376,6 +1394,48 @@ static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
 	return rc;
 }
 
+/* Send one chunk of a DBD_GET_JOBS_STREAM reply */
+static int _send_jobs_chunk(List job_list, void *arg)
+{
+	slurmdbd_conn_t *slurmdbd_conn = arg;
+	dbd_list_msg_t list_msg = { NULL };
+	Buf buffer;
+	int rc;
+
+	list_msg.my_list = job_list;
+	buffer = init_buf(1024);
+	pack16((uint16_t) DBD_GOT_JOBS, buffer);
+	slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
+			       DBD_GOT_JOBS, buffer);
+	rc = slurm_persist_send_msg(slurmdbd_conn->conn, buffer);
+	free_buf(buffer);
+
+	return rc;
+}
+
+/* Jobs are sent as they are read in DBD_GOT_JOBS messages, so neither
+ * side holds the whole answer. The PERSIST_RC sent last ends the reply. */
+static int _get_jobs_stream(slurmdbd_conn_t *slurmdbd_conn,
+			    persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
+{
+	dbd_cond_msg_t *cond_msg = msg->data;
+	char *comment = NULL;
+	int rc;
+
+	debug2("DBD_GET_JOBS_STREAM: called");
+
+	rc = jobacct_storage_g_get_jobs_cond_stream(
+		slurmdbd_conn->db_conn, *uid, cond_msg->cond,
+		_send_jobs_chunk, slurmdbd_conn);
+	if (rc != SLURM_SUCCESS)
+		comment = slurm_strerror(rc);
+	*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
+						rc, comment,
+						DBD_GET_JOBS_STREAM);
+
+	return rc;
+}
+
 static int _get_probs(slurmdbd_conn_t *slurmdbd_conn,
 		      persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
 {
@@ -3268,6 +3328,157 @@ static int   _send_mult_job_start(slurmdbd_conn_t *slurmdbd_conn,
 	return SLURM_SUCCESS;
 }
 
+/* Records of one DBD_SEND_MULT_MSG written on one database connection */
+typedef struct {
+	bool commit;		/* commit the lane, else roll it back */
+	bool committed;		/* the lane's records are in the database */
+	uint64_t commit_time;	/* usecs spent committing */
+	bool failed;		/* one of the lane's records failed */
+	int lane;		/* index of this lane */
+	int *lanes;		/* lane of each record, -1 if not unpacked */
+	persist_msg_t *msgs;	/* unpacked records */
+	int *rcs;		/* return code of each record */
+	int rec_cnt;		/* number of records */
+	uint32_t run_cnt;	/* records processed by this lane */
+	Buf *ret_bufs;		/* response to each record */
+	slurmdbd_conn_t *slurmdbd_conn; /* connection to write records on */
+	uint32_t *uid;
+} mult_lane_t;
+
+static void _close_writer_conns(slurmdbd_conn_t *slurmdbd_conn)
+{
+	int i;
+
+	for (i = 0; i < slurmdbd_conn->writer_cnt; i++)
+		acct_storage_g_close_connection(
+			&slurmdbd_conn->writer_conns[i]);
+	xfree(slurmdbd_conn->writer_conns);
+	slurmdbd_conn->writer_cnt = 0;
+}
+
+/* Return the job a record of a DBD_SEND_MULT_MSG is about, 0 if none */
+static uint32_t _mult_rec_job_id(persist_msg_t *msg)
+{
+	switch (msg->msg_type) {
+	case DBD_JOB_COMPLETE:
+		return ((dbd_job_comp_msg_t *) msg->data)->job_id;
+	case DBD_JOB_START:
+		return ((dbd_job_start_msg_t *) msg->data)->job_id;
+	case DBD_JOB_SUSPEND:
+		return ((dbd_job_suspend_msg_t *) msg->data)->job_id;
+	case DBD_STEP_COMPLETE:
+		return ((dbd_step_comp_msg_t *) msg->data)->job_id;
+	case DBD_STEP_START:
+		return ((dbd_step_start_msg_t *) msg->data)->job_id;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Return the number of database connections to write the records of a
+ * DBD_SEND_MULT_MSG with, opening them the first time they are needed.
+ * They are only used for a slurmctld with commits done after each message,
+ * as with CommitDelay they would only be committed by the next message.
+ */
+static int _mult_lane_cnt(slurmdbd_conn_t *slurmdbd_conn)
+{
+	int i;
+
+	if ((slurmdbd_conf->storage_writers <= 1) ||
+	    !slurmdbd_conn->conn->rem_port || slurmdbd_conf->commit_delay)
+		return 1;
+
+	if (!slurmdbd_conn->writer_conns) {
+		slurmdbd_conn->writer_cnt = slurmdbd_conf->storage_writers - 1;
+		slurmdbd_conn->writer_conns =
+			xmalloc(sizeof(void *) * slurmdbd_conn->writer_cnt);
+		for (i = 0; i < slurmdbd_conn->writer_cnt; i++) {
+			errno = 0;
+			slurmdbd_conn->writer_conns[i] =
+				acct_storage_g_get_connection(
+					false, slurmdbd_conn->conn->fd, true,
+					slurmdbd_conn->conn->cluster_name);
+			if (errno) {
+				error("CONN:%u unable to open database "
+				      "connections for StorageWriters",
+				      slurmdbd_conn->conn->fd);
+				_close_writer_conns(slurmdbd_conn);
+				return 1;
+			}
+		}
+	}
+
+	return slurmdbd_conn->writer_cnt + 1;
+}
+
+/* Process the records of one lane in order, stopping at the first failure
+ * as then none of the batch is committed */
+static void *_mult_lane_proc(void *arg)
+{
+	mult_lane_t *lane = (mult_lane_t *) arg;
+	int i;
+
+	for (i = 0; i < lane->rec_cnt; i++) {
+		if (lane->lanes[i] != lane->lane)
+			continue;
+		lane->rcs[i] = proc_req(lane->slurmdbd_conn, &lane->msgs[i],
+					&lane->ret_bufs[i], lane->uid);
+		lane->run_cnt++;
+		if (lane->rcs[i] != SLURM_SUCCESS) {
+			lane->failed = true;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/* Commit the records of one lane, or roll them back if lane->commit is not
+ * set, setting lane->committed if they are now in the database */
+static void *_mult_lane_commit(void *arg)
+{
+	mult_lane_t *lane = (mult_lane_t *) arg;
+	DEF_TIMERS;
+
+	START_TIMER;
+	if (!lane->commit)
+		acct_storage_g_commit(lane->slurmdbd_conn->db_conn, 0);
+	else if (!acct_storage_g_commit(lane->slurmdbd_conn->db_conn, 1))
+		lane->committed = true;
+	END_TIMER;
+	lane->commit_time = DELTA_TIMER;
+
+	return NULL;
+}
+
+/* Run func for lanes first through lane_cnt - 1, all but the first of them
+ * in their own thread */
+static void _mult_lanes_run(mult_lane_t *lane_recs, int first, int lane_cnt,
+			    void *(*func) (void *))
+{
+	pthread_t *lane_threads = xmalloc(sizeof(pthread_t) * lane_cnt);
+	pthread_attr_t attr;
+	int i;
+
+	slurm_attr_init(&attr);
+	for (i = first + 1; i < lane_cnt; i++) {
+		if (pthread_create(&lane_threads[i], &attr, func,
+				   &lane_recs[i])) {
+			error("%s: pthread_create: %m", __func__);
+			(*func)(&lane_recs[i]);
+			lane_threads[i] = 0;
+		}
+	}
+	slurm_attr_destroy(&attr);
+	(*func)(&lane_recs[first]);
+	for (i = first + 1; i < lane_cnt; i++) {
+		if (lane_threads[i])
+			pthread_join(lane_threads[i], NULL);
+	}
+	xfree(lane_threads);
+}
+
 static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 			    persist_msg_t *msg, Buf *out_buffer,
 			    uint32_t *uid)
@@ -3276,9 +3487,19 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 	dbd_list_msg_t list_msg = { NULL };
 	char *comment = NULL;
 	ListIterator itr = NULL;
-	Buf req_buf = NULL, ret_buf = NULL;
-	int rc = SLURM_SUCCESS;
-	/* DEF_TIMERS; */
+	Buf req_buf = NULL;
+	int i, j, lane_cnt, rec_cnt = 0, rc = SLURM_SUCCESS;
+	int failed_rc = SLURM_SUCCESS, unpack_rc = SLURM_SUCCESS;
+	int *lanes, *rcs;
+	persist_msg_t *msgs;
+	Buf *ret_bufs;
+	mult_lane_t *lane_recs;
+	slurmdbd_conn_t *lane_conns;
+	bool acked = true, commit, rolled_back = false;
+	uint32_t job_id, run_cnt = 0;
+	uint64_t commit_time = 0;
+	long commit_start;
+	DEF_TIMERS;
 
 	if (*uid != slurmdbd_conf->slurm_user_id && *uid != 0) {
 		comment = "DBD_SEND_MULT_MSG message from invalid uid";
@@ -3290,38 +3511,211 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 		return SLURM_ERROR;
 	}
 
-	list_msg.my_list = list_create(slurmdbd_free_buffer);
-	/* START_TIMER; */
+	START_TIMER;
+	i = list_count(get_msg->my_list);
+	lanes = xmalloc(sizeof(int) * i);
+	rcs = xmalloc(sizeof(int) * i);
+	msgs = xmalloc(sizeof(persist_msg_t) * i);
+	ret_bufs = xmalloc(sizeof(Buf) * i);
+
+	/* Unpack all records first to know which lane each one goes to */
+	lane_cnt = _mult_lane_cnt(slurmdbd_conn);
 	itr = list_iterator_create(get_msg->my_list);
 	while ((req_buf = list_next(itr))) {
-		persist_msg_t sub_msg;
-
-		ret_buf = NULL;
-
 		rc = slurm_persist_conn_process_msg(
-			slurmdbd_conn->conn, &sub_msg,
+			slurmdbd_conn->conn, &msgs[rec_cnt],
 			get_buf_data(req_buf),
-			size_buf(req_buf), &ret_buf, 0);
+			size_buf(req_buf), &ret_bufs[rec_cnt], 0);
+		if (rc != SLURM_SUCCESS) {
+			rcs[rec_cnt] = rc;
+			lanes[rec_cnt++] = -1;
+			unpack_rc = rc;
+			break;
+		}
+		/* Until it is processed */
+		rcs[rec_cnt] = SLURM_ERROR;
+		/* All records of a job go to the same lane, in order */
+		lanes[rec_cnt] = _mult_rec_job_id(&msgs[rec_cnt]) % lane_cnt;
+		rec_cnt++;
+	}
+	list_iterator_destroy(itr);
 
-		if (rc == SLURM_SUCCESS) {
-			rc = proc_req(slurmdbd_conn, &sub_msg, &ret_buf, uid);
-			slurmdbd_free_msg((slurmdbd_msg_t *)&sub_msg);
+	/*
+	 * Writing a suspend record twice adds the suspended time twice, so
+	 * jobs with one go to the first lane, which is only committed once
+	 * all others were. Records of the other lanes can be sent again.
+	 */
+	for (i = 0; (lane_cnt > 1) && (i < rec_cnt); i++) {
+		if ((lanes[i] <= 0) || (msgs[i].msg_type != DBD_JOB_SUSPEND))
+			continue;
+		job_id = _mult_rec_job_id(&msgs[i]);
+		for (j = 0; j < rec_cnt; j++) {
+			if ((lanes[j] != -1) &&
+			    (_mult_rec_job_id(&msgs[j]) == job_id))
+				lanes[j] = 0;
 		}
+	}
 
-		if (ret_buf)
-			list_append(list_msg.my_list, ret_buf);
-		if (rc != SLURM_SUCCESS)
-			break;
+	/* Records about no job go to the first lane, which is processed
+	 * on the slurmctld's own connection as some of them update it.
+	 * Commit the whole batch once at the end instead of per record. */
+	lane_recs = xmalloc(sizeof(mult_lane_t) * lane_cnt);
+	lane_conns = xmalloc(sizeof(slurmdbd_conn_t) * lane_cnt);
+	for (i = 0; i < lane_cnt; i++) {
+		lane_recs[i].lane = i;
+		lane_recs[i].lanes = lanes;
+		lane_recs[i].msgs = msgs;
+		lane_recs[i].rcs = rcs;
+		lane_recs[i].rec_cnt = rec_cnt;
+		lane_recs[i].ret_bufs = ret_bufs;
+		lane_recs[i].uid = uid;
+		if (!i) {
+			lane_recs[i].slurmdbd_conn = slurmdbd_conn;
+			continue;
+		}
+		lane_conns[i].conn = slurmdbd_conn->conn;
+		lane_conns[i].db_conn = slurmdbd_conn->writer_conns[i - 1];
+		lane_conns[i].in_mult = true;
+		lane_recs[i].slurmdbd_conn = &lane_conns[i];
+	}
+
+run_lanes:
+	failed_rc = unpack_rc;
+	slurmdbd_conn->in_mult = true;
+	_mult_lanes_run(lane_recs, 0, lane_cnt, _mult_lane_proc);
+	slurmdbd_conn->in_mult = false;
+	for (i = 0; i < lane_cnt; i++) {
+		run_cnt += lane_recs[i].run_cnt;
+		if (lane_recs[i].failed && (failed_rc == SLURM_SUCCESS)) {
+			for (j = 0; j < rec_cnt; j++) {
+				if ((lanes[j] == i) &&
+				    (rcs[j] != SLURM_SUCCESS)) {
+					failed_rc = rcs[j];
+					break;
+				}
+			}
+		}
 	}
-	list_iterator_destroy(itr);
-	/* END_TIMER; */
-	/* info("%d multi took %s", list_count(get_msg->my_list), TIME_STR); */
 
-	*out_buffer = init_buf(1024);
-	pack16((uint16_t) DBD_GOT_MULT_MSG, *out_buffer);
-	slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
-			       DBD_GOT_MULT_MSG, *out_buffer);
+	/*
+	 * Queued queries of records that succeeded may have been lost along
+	 * with a failed one, so a failure rolls back every lane. Otherwise
+	 * the other lanes are committed in parallel, then the first one if
+	 * they all were. With CommitDelay there is a single lane with nothing
+	 * queued, replies are as for each record.
+	 */
+	END_TIMER;
+	commit_start = DELTA_TIMER;
+	if (slurmdbd_conn->conn->rem_port && !slurmdbd_conf->commit_delay) {
+		commit = (failed_rc == SLURM_SUCCESS);
+		for (i = 0; i < lane_cnt; i++)
+			lane_recs[i].commit = commit;
+		if (lane_cnt > 1)
+			_mult_lanes_run(lane_recs, 1, lane_cnt,
+					_mult_lane_commit);
+		for (i = 1; i < lane_cnt; i++) {
+			if (!lane_recs[i].committed)
+				lane_recs[0].commit = false;
+		}
+		_mult_lane_commit(&lane_recs[0]);
+		for (i = 0; i < lane_cnt; i++) {
+			commit_time += lane_recs[i].commit_time;
+			if (!lane_recs[i].committed)
+				rolled_back = true;
+		}
+	}
+	END_TIMER;
+	commit_time = MAX(commit_time, DELTA_TIMER - commit_start);
+
+	/*
+	 * A lane waiting for a lock another one holds gives up, as none of
+	 * them commits before all are done. Write the batch again on the
+	 * slurmctld's connection alone, where no lane waits for another.
+	 */
+	if (rolled_back && (lane_cnt > 1) && (unpack_rc == SLURM_SUCCESS)) {
+		debug("CONN:%u DBD_SEND_MULT_MSG failed on %d connections, "
+		      "writing it again on one",
+		      slurmdbd_conn->conn->fd, lane_cnt);
+		for (i = 0; i < rec_cnt; i++) {
+			lanes[i] = 0;
+			rcs[i] = SLURM_ERROR;
+			free_buf(ret_bufs[i]);
+			ret_bufs[i] = NULL;
+		}
+		lane_cnt = 1;
+		lane_recs[0].committed = false;
+		lane_recs[0].failed = false;
+		lane_recs[0].run_cnt = 0;
+		rolled_back = false;
+		run_cnt = 0;
+		goto run_lanes;
+	}
+
+	slurm_mutex_lock(&rpc_mutex);
+	rpc_stats.mult_cnt++;
+	rpc_stats.mult_rec_cnt += run_cnt;
+	rpc_stats.mult_time += DELTA_TIMER;
+	rpc_stats.mult_max_time = MAX(rpc_stats.mult_max_time, DELTA_TIMER);
+	rpc_stats.mult_commit_time += commit_time;
+	if (rolled_back)
+		rpc_stats.mult_fail_cnt++;
+	slurm_mutex_unlock(&rpc_mutex);
+
+	/*
+	 * Reply to the records in order up to the first one that failed, was
+	 * not processed or was not committed. The sender sends everything
+	 * after that again.
+	 */
+	list_msg.my_list = list_create(slurmdbd_free_buffer);
+	for (i = 0; i < rec_cnt; i++) {
+		if (acked && rolled_back &&
+		    ((lanes[i] == -1) || !lane_recs[lanes[i]].committed)) {
+			if (list_count(list_msg.my_list))
+				list_append(list_msg.my_list,
+					    slurm_persist_make_rc_msg(
+						    slurmdbd_conn->conn,
+						    SLURM_ERROR,
+						    "Commit failed",
+						    msgs[i].msg_type));
+			acked = false;
+		}
+		if (lanes[i] != -1)
+			slurmdbd_free_msg((slurmdbd_msg_t *) &msgs[i]);
+		if (acked && ret_bufs[i]) {
+			list_append(list_msg.my_list, ret_bufs[i]);
+			ret_bufs[i] = NULL;
+		}
+		if (rcs[i] != SLURM_SUCCESS)
+			acked = false;
+		free_buf(ret_bufs[i]);
+	}
+
+	if (rolled_back && !list_count(list_msg.my_list)) {
+		/* None of the batch was written, have all of it sent again */
+		comment = "DBD_SEND_MULT_MSG rolled back";
+		error("CONN:%u %s", slurmdbd_conn->conn->fd, comment);
+		*out_buffer = slurm_persist_make_rc_msg(
+			slurmdbd_conn->conn,
+			failed_rc ? failed_rc : SLURM_ERROR, comment,
+			DBD_SEND_MULT_MSG);
+	} else {
+		if (rolled_back)
+			error("CONN:%u DBD_SEND_MULT_MSG only partly committed, "
+			      "%d of %d records acknowledged",
+			      slurmdbd_conn->conn->fd,
+			      list_count(list_msg.my_list) - 1, rec_cnt);
+		*out_buffer = init_buf(1024);
+		pack16((uint16_t) DBD_GOT_MULT_MSG, *out_buffer);
+		slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
+				       DBD_GOT_MULT_MSG, *out_buffer);
+	}
 	FREE_NULL_LIST(list_msg.my_list);
+	xfree(lane_conns);
+	xfree(lane_recs);
+	xfree(lanes);
+	xfree(msgs);
+	xfree(rcs);
+	xfree(ret_bufs);
 
 	return SLURM_SUCCESS;
 }
@@ -3529,6 +3923,12 @@ static int  _clear_stats(slurmdbd_conn_t *slurmdbd_conn,
 		rpc_stats.rpc_user_cnt[i] = 0;
 		rpc_stats.rpc_user_time[i] = 0;
 	}
+	rpc_stats.mult_cnt = 0;
+	rpc_stats.mult_rec_cnt = 0;
+	rpc_stats.mult_time = 0;
+	rpc_stats.mult_max_time = 0;
+	rpc_stats.mult_commit_time = 0;
+	rpc_stats.mult_fail_cnt = 0;
 	slurm_mutex_unlock(&rpc_mutex);
 
 	*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
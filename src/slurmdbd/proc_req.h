@@ -46,7 +46,10 @@
 typedef struct {
 	slurm_persist_conn_t *conn;
 	void *db_conn; /* database connection */
+	bool in_mult; /* processing a DBD_SEND_MULT_MSG, commit at its end */
 	char *tres_str;
+	int writer_cnt; /* length of writer_conns */
+	void **writer_conns; /* more database connections for StorageWriters */
 } slurmdbd_conn_t;
 
 /* Process an incoming RPC
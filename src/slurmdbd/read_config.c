@@ -99,6 +99,7 @@ static void _clear_slurmdbd_conf(void)
 		slurmdbd_conf->debug_level = 0;
 		xfree(slurmdbd_conf->default_qos);
 		xfree(slurmdbd_conf->log_file);
+		slurmdbd_conf->partition_job_table = 0;
 		xfree(slurmdbd_conf->pid_file);
 		xfree(slurmdbd_conf->plugindir);
 		slurmdbd_conf->private_data = 0;
@@ -109,6 +110,7 @@ static void _clear_slurmdbd_conf(void)
 		slurmdbd_conf->purge_suspend = 0;
 		slurmdbd_conf->purge_txn = 0;
 		slurmdbd_conf->purge_usage = 0;
+		slurmdbd_conf->rollup_workers = 0;
 		slurmdbd_conf->slurm_user_id = NO_VAL;
 		xfree(slurmdbd_conf->slurm_user_name);
 		xfree(slurmdbd_conf->storage_backup_host);
@@ -118,6 +120,7 @@ static void _clear_slurmdbd_conf(void)
 		slurmdbd_conf->storage_port = 0;
 		xfree(slurmdbd_conf->storage_type);
 		xfree(slurmdbd_conf->storage_user);
+		slurmdbd_conf->storage_writers = 0;
 		slurmdbd_conf->track_wckey = 0;
 		slurmdbd_conf->track_ctld = 0;
 	}
@@ -155,6 +158,7 @@ extern int read_slurmdbd_conf(void)
 		{"LogFile", S_P_STRING},
 		{"LogTimeFormat", S_P_STRING},
 		{"MessageTimeout", S_P_UINT16},
+		{"PartitionJobTable", S_P_BOOLEAN},
 		{"PidFile", S_P_STRING},
 		{"PluginDir", S_P_STRING},
 		{"PrivateData", S_P_STRING},
@@ -171,6 +175,7 @@ extern int read_slurmdbd_conf(void)
 		{"PurgeSuspendMonths", S_P_UINT32},
 		{"PurgeTXNMonths", S_P_UINT32},
 		{"PurgeUsageMonths", S_P_UINT32},
+		{"RollupWorkers", S_P_UINT16},
 		{"SlurmUser", S_P_STRING},
 		{"StepPurge", S_P_UINT32},
 		{"StorageBackupHost", S_P_STRING},
@@ -180,6 +185,7 @@ extern int read_slurmdbd_conf(void)
 		{"StoragePort", S_P_UINT16},
 		{"StorageType", S_P_STRING},
 		{"StorageUser", S_P_STRING},
+		{"StorageWriters", S_P_UINT16},
 		{"TCPTimeout", S_P_UINT16},
 		{"TrackWCKey", S_P_BOOLEAN},
 		{"TrackSlurmctldDown", S_P_BOOLEAN},
@@ -292,6 +298,12 @@ extern int read_slurmdbd_conf(void)
 			info("WARNING: MessageTimeout is too high for "
 			     "effective fault-tolerance");
 		}
+
+		if (!s_p_get_boolean(
+			    (bool *)&slurmdbd_conf->partition_job_table,
+			    "PartitionJobTable", tbl))
+			slurmdbd_conf->partition_job_table = false;
+
 		s_p_get_string(&slurmdbd_conf->pid_file, "PidFile", tbl);
 		s_p_get_string(&slurmdbd_conf->plugindir, "PluginDir", tbl);
 
@@ -439,6 +451,11 @@ extern int read_slurmdbd_conf(void)
 					|= SLURMDB_PURGE_MONTHS;
 		}
 
+		if (!s_p_get_uint16(&slurmdbd_conf->rollup_workers,
+				    "RollupWorkers", tbl) ||
+		    !slurmdbd_conf->rollup_workers)
+			slurmdbd_conf->rollup_workers = 1;
+
 		s_p_get_string(&slurmdbd_conf->slurm_user_name,
 			       "SlurmUser", tbl);
 
@@ -465,6 +482,10 @@ extern int read_slurmdbd_conf(void)
 			       "StorageType", tbl);
 		s_p_get_string(&slurmdbd_conf->storage_user,
 			       "StorageUser", tbl);
+		if (!s_p_get_uint16(&slurmdbd_conf->storage_writers,
+				    "StorageWriters", tbl) ||
+		    !slurmdbd_conf->storage_writers)
+			slurmdbd_conf->storage_writers = 1;
 
 		if (!s_p_get_uint16(&slurmdbd_conf->tcp_timeout,
 				    "TCPTimeout", tbl))
@@ -623,6 +644,7 @@ extern void log_config(void)
 
 	debug2("LogFile           = %s", slurmdbd_conf->log_file);
 	debug2("MessageTimeout    = %u", slurmdbd_conf->msg_timeout);
+	debug2("PartitionJobTable = %u", slurmdbd_conf->partition_job_table);
 	debug2("PidFile           = %s", slurmdbd_conf->pid_file);
 	debug2("PluginDir         = %s", slurmdbd_conf->plugindir);
 
@@ -658,6 +680,8 @@ extern void log_config(void)
 			     tmp_str, sizeof(tmp_str), 1);
 	debug2("PurgeUsageAfter = %s", tmp_str);
 
+	debug2("RollupWorkers     = %u", slurmdbd_conf->rollup_workers);
+
 	debug2("SlurmUser         = %s(%u)",
 	       slurmdbd_conf->slurm_user_name, slurmdbd_conf->slurm_user_id);
 
@@ -668,6 +692,7 @@ extern void log_config(void)
 	debug2("StoragePort       = %u", slurmdbd_conf->storage_port);
 	debug2("StorageType       = %s", slurmdbd_conf->storage_type);
 	debug2("StorageUser       = %s", slurmdbd_conf->storage_user);
+	debug2("StorageWriters    = %u", slurmdbd_conf->storage_writers);
 
 	debug2("TCPTimeout        = %u", slurmdbd_conf->tcp_timeout);
 
@@ -829,6 +854,12 @@ extern List dump_config(void)
 	key_pair->value = xstrdup_printf("%u secs", slurmdbd_conf->msg_timeout);
 	list_append(my_list, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("PartitionJobTable");
+	key_pair->value = xstrdup(slurmdbd_conf->partition_job_table ?
+				  "Yes" : "No");
+	list_append(my_list, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("PidFile");
 	key_pair->value = xstrdup(slurmdbd_conf->pid_file);
@@ -916,6 +947,11 @@ extern List dump_config(void)
 		key_pair->value = xstrdup("NONE");
 	list_append(my_list, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("RollupWorkers");
+	key_pair->value = xstrdup_printf("%u", slurmdbd_conf->rollup_workers);
+	list_append(my_list, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("SLURMDBD_CONF");
 	key_pair->value = get_extra_conf_path("slurmdbd.conf");
@@ -965,6 +1001,11 @@ extern List dump_config(void)
 	key_pair->value = xstrdup(slurmdbd_conf->storage_user);
 	list_append(my_list, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("StorageWriters");
+	key_pair->value = xstrdup_printf("%u", slurmdbd_conf->storage_writers);
+	list_append(my_list, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("TCPTimeout");
 	key_pair->value = xstrdup_printf("%u secs", slurmdbd_conf->tcp_timeout);
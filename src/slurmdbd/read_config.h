@@ -75,6 +75,8 @@ typedef struct slurm_dbd_conf {
 	char *		log_file;	/* Log file			*/
 	uint16_t        log_fmt;        /* Log file timestamt format    */
 	uint16_t        msg_timeout;    /* message timeout		*/
+	uint16_t	partition_job_table; /* partition job tables by
+					      * month of time_submit	*/
 	char *		pid_file;	/* where to store current PID	*/
 	char *		plugindir;	/* dir to look for plugins	*/
 	uint16_t        private_data;   /* restrict information         */
@@ -91,6 +93,8 @@ typedef struct slurm_dbd_conf {
 					 * than this in months or days	*/
 	uint32_t        purge_usage;    /* purge usage data older
 					 * than this in months or days	*/
+	uint16_t	rollup_workers;	/* DB connections rolling up the
+					 * hours of each cluster	*/
 	uint32_t	slurm_user_id;	/* uid of slurm_user_name	*/
 	char *		slurm_user_name;/* user that slurmcdtld runs as	*/
 	char *		storage_backup_host;/* backup host where DB is
@@ -101,6 +105,8 @@ typedef struct slurm_dbd_conf {
 	uint16_t	storage_port;	/* port DB is listening to	*/
 	char *		storage_type;	/* DB to be used for storage	*/
 	char *		storage_user;	/* user authorized to write DB	*/
+	uint16_t	storage_writers;/* DB connections writing each
+					 * slurmctld's job records	*/
 	uint16_t        track_wckey;    /* Whether or not to track wckey*/
 	uint16_t        track_ctld;     /* Whether or not track when a
 					 * slurmctld goes down or not   */
@@ -144,6 +144,7 @@ extern void rpc_mgr_wake(void)
 static void _connection_fini_callback(void *arg)
 {
 	slurmdbd_conn_t *conn = (slurmdbd_conn_t *) arg;
+	int i;
 
 	if (conn->conn->rem_port) {
 		if (!shutdown_time) {
@@ -177,6 +178,10 @@ static void _connection_fini_callback(void *arg)
 	}
 
 	acct_storage_g_close_connection(&conn->db_conn);
+	/* Committed after each DBD_SEND_MULT_MSG, nothing left to do */
+	for (i = 0; i < conn->writer_cnt; i++)
+		acct_storage_g_close_connection(&conn->writer_conns[i]);
+	xfree(conn->writer_conns);
 	/* handled directly in the internal persist_conn code */
 	//slurm_persist_conn_members_destroy(&conn->conn);
 	xfree(conn->tres_str);
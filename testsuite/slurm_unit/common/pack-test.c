@@ -1,7 +1,9 @@
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <src/common/pack.h>
 #include <src/common/xmalloc.h>
@@ -25,8 +27,8 @@ int main (int argc, char *argv[])
 	char testbytes[] = "TEST BYTES", *outbytes;
 	char teststring[] = "TEST STRING",  *outstring = NULL;
 	char *nullstr = NULL;
-	char *data;
-	int data_size;
+	char *data, file[64];
+	int data_size, fd;
 	long double test_double = 1340664754944.2132312, test_double2;
 	uint64_t test64;
 
@@ -82,6 +84,26 @@ int main (int argc, char *argv[])
 
 	xfree(outstring);
 
+	/* Unpack the same data from a mapped file */
+	set_buf_offset(buffer, 0);
+	snprintf(file, sizeof(file), "/tmp/pack-test.%d", (int) getpid());
+	fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	TEST((fd < 0) || (write(fd, get_buf_data(buffer), data_size)
+			  != data_size), "write mmap file");
+	if (fd >= 0)
+		close(fd);
+	free_buf(buffer);
+
+	buffer = create_mmap_buf(file);
+	(void) unlink(file);
+	TEST(!buffer || (size_buf(buffer) != data_size), "create_mmap_buf");
+	if (buffer) {
+		unpack16(&out16, buffer);
+		unpack32(&out32, buffer);
+		TEST((out16 != test16) || (out32 != test32),
+		     "unpack from mmap buffer");
+	}
+
 	free_buf(buffer);
 	totals();
 	return failed;
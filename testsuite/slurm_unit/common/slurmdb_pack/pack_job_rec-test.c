@@ -0,0 +1,192 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/common/slurmdb_pack.h"
+#include "src/common/slurmdb_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/common/slurm_protocol_common.h"
+#include "src/common/list.h"
+
+static slurmdb_job_rec_t *_make_job(uint32_t fields)
+{
+	slurmdb_job_rec_t *job = slurmdb_create_job_rec();
+	slurmdb_step_rec_t *step = slurmdb_create_step_rec();
+
+	job->account        = xstrdup("default_acct");
+	job->cluster        = xstrdup("default_cluster");
+	job->elapsed        = 3600;
+	job->fields         = fields;
+	job->jobid          = 12345;
+	job->jobname        = xstrdup("job_name");
+	job->nodes          = xstrdup("node[1-4]");
+	job->partition      = xstrdup("debug");
+	job->state          = 3;
+	job->tres_alloc_str = xstrdup("1=16,4=4");
+	job->user           = xstrdup("user");
+
+	step->job_ptr        = job;
+	step->elapsed        = 1800;
+	step->nodes          = xstrdup("node1");
+	step->stats.cpu_min  = 10;
+	step->stepid         = 0;
+	step->stepname       = xstrdup("step_name");
+	step->tres_alloc_str = xstrdup("1=4");
+	list_append(job->steps, step);
+
+	return job;
+}
+
+START_TEST(invalid_protocol)
+{
+	int rc;
+	slurmdb_job_rec_t *job = NULL;
+	Buf buf = init_buf(1024);
+
+	rc = slurmdb_unpack_job_rec((void **)&job, 0, buf);
+	ck_assert_int_eq(rc, SLURM_ERROR);
+
+	free_buf(buf);
+}
+END_TEST
+
+START_TEST(pack_1711_job_rec_all_fields)
+{
+	int rc;
+	slurmdb_job_rec_t *pack_job = _make_job(0);
+	slurmdb_job_rec_t *unpack_job = NULL;
+	slurmdb_step_rec_t *step;
+	Buf buf = init_buf(1024);
+
+	slurmdb_pack_job_rec(pack_job, SLURM_17_11_PROTOCOL_VERSION, buf);
+
+	set_buf_offset(buf, 0);
+
+	rc = slurmdb_unpack_job_rec((void **)&unpack_job,
+				    SLURM_17_11_PROTOCOL_VERSION, buf);
+	ck_assert(rc == SLURM_SUCCESS);
+	ck_assert(unpack_job->fields == JOBCOND_FIELD_ALL);
+	ck_assert_str_eq(pack_job->account, unpack_job->account);
+	ck_assert_str_eq(pack_job->jobname, unpack_job->jobname);
+	ck_assert_str_eq(pack_job->nodes, unpack_job->nodes);
+	ck_assert_str_eq(pack_job->tres_alloc_str,
+			 unpack_job->tres_alloc_str);
+	ck_assert(pack_job->jobid == unpack_job->jobid);
+	ck_assert(list_count(unpack_job->steps) == 1);
+	step = list_peek(unpack_job->steps);
+	ck_assert_str_eq(step->stepname, "step_name");
+	ck_assert_str_eq(step->nodes, "node1");
+	ck_assert(step->stats.cpu_min == 10);
+
+	free_buf(buf);
+	slurmdb_destroy_job_rec(pack_job);
+	slurmdb_destroy_job_rec(unpack_job);
+}
+END_TEST
+
+START_TEST(pack_1711_job_rec_sparse)
+{
+	int rc;
+	slurmdb_job_rec_t *pack_job =
+		_make_job(JOBCOND_FIELD_BASE | JOBCOND_FIELD_NAME);
+	slurmdb_job_rec_t *unpack_job = NULL;
+	slurmdb_step_rec_t *step;
+	uint32_t size;
+	Buf buf = init_buf(1024);
+
+	slurmdb_pack_job_rec(pack_job, SLURM_17_11_PROTOCOL_VERSION, buf);
+	size = get_buf_offset(buf);
+
+	set_buf_offset(buf, 0);
+
+	rc = slurmdb_unpack_job_rec((void **)&unpack_job,
+				    SLURM_17_11_PROTOCOL_VERSION, buf);
+	ck_assert(rc == SLURM_SUCCESS);
+	ck_assert(get_buf_offset(buf) == size);
+	ck_assert(unpack_job->fields == pack_job->fields);
+	ck_assert_str_eq(pack_job->cluster, unpack_job->cluster);
+	ck_assert_str_eq(pack_job->jobname, unpack_job->jobname);
+	ck_assert_str_eq(pack_job->user, unpack_job->user);
+	ck_assert(pack_job->elapsed == unpack_job->elapsed);
+	ck_assert(pack_job->jobid == unpack_job->jobid);
+	ck_assert(pack_job->state == unpack_job->state);
+	ck_assert(unpack_job->account == NULL);
+	ck_assert(unpack_job->nodes == NULL);
+	ck_assert(unpack_job->partition == NULL);
+	ck_assert(unpack_job->tres_alloc_str == NULL);
+	ck_assert(unpack_job->stats.cpu_min == NO_VAL);
+	ck_assert(list_count(unpack_job->steps) == 1);
+	step = list_peek(unpack_job->steps);
+	ck_assert(step->job_ptr == unpack_job);
+	ck_assert(step->elapsed == 1800);
+	ck_assert_str_eq(step->stepname, "step_name");
+	ck_assert(step->nodes == NULL);
+	ck_assert(step->tres_alloc_str == NULL);
+	ck_assert(step->stats.cpu_min == NO_VAL);
+
+	free_buf(buf);
+	slurmdb_destroy_job_rec(pack_job);
+	slurmdb_destroy_job_rec(unpack_job);
+}
+END_TEST
+
+START_TEST(pack_1702_job_rec_ignores_fields)
+{
+	int rc;
+	slurmdb_job_rec_t *pack_job = _make_job(JOBCOND_FIELD_BASE);
+	slurmdb_job_rec_t *unpack_job = NULL;
+	Buf buf = init_buf(1024);
+
+	slurmdb_pack_job_rec(pack_job, SLURM_17_02_PROTOCOL_VERSION, buf);
+
+	set_buf_offset(buf, 0);
+
+	rc = slurmdb_unpack_job_rec((void **)&unpack_job,
+				    SLURM_17_02_PROTOCOL_VERSION, buf);
+	ck_assert(rc == SLURM_SUCCESS);
+	ck_assert_str_eq(pack_job->account, unpack_job->account);
+	ck_assert_str_eq(pack_job->nodes, unpack_job->nodes);
+	ck_assert_str_eq(pack_job->tres_alloc_str,
+			 unpack_job->tres_alloc_str);
+
+	free_buf(buf);
+	slurmdb_destroy_job_rec(pack_job);
+	slurmdb_destroy_job_rec(unpack_job);
+}
+END_TEST
+
+/*****************************************************************************
+ * TEST SUITE                                                                *
+ ****************************************************************************/
+
+Suite* suite(void)
+{
+	Suite* s = suite_create("Pack slurmdb_job_rec_t");
+	TCase* tc_core = tcase_create("Pack slurmdb_job_rec_t");
+	tcase_add_test(tc_core, invalid_protocol);
+	tcase_add_test(tc_core, pack_1711_job_rec_all_fields);
+	tcase_add_test(tc_core, pack_1711_job_rec_sparse);
+	tcase_add_test(tc_core, pack_1702_job_rec_ignores_fields);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+/*****************************************************************************
+ * TEST RUNNER                                                               *
+ ****************************************************************************/
+
+int main(void)
+{
+    int number_failed;
+    SRunner* sr = srunner_create(suite());
+
+    srunner_set_fork_status(sr, CK_NOFORK);
+
+    srunner_run_all(sr, CK_VERBOSE);
+    //srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}